@@ -10,6 +10,7 @@
 #include "tree.h"
 #include "profile.h"
 #include "timing.h"
+#include <vcclr.h>
 
 #pragma once
 
@@ -40,8 +41,62 @@ namespace Muscle
 	}
 
 
+	// Rows of msa in id order, as DoMuscle returns them.
+	static void MSAToAlns(const MSA &msa, List<String ^>^ alns)
+	{
+		const unsigned uSeqCount = msa.GetSeqCount();
+		Dictionary<int, System::String^> seqdict = gcnew Dictionary<int, System::String^>();
+		const unsigned uColCount = msa.GetColCount();
+		char* chars = new char[uColCount+1];
+		for (int i = 0; i < uSeqCount; i++)
+		{
+			for(int j = 0; j < uColCount; j++)
+			{
+				chars[j] = msa.GetChar(i, j);
+				// FIXME: i don't know what is the different between 'X' and '-'
+				if (chars[j] == 'X')
+				{
+					chars[j] = '-';
+				}
+			}
+			chars[uColCount] = 0;
+			const unsigned id = msa.GetSeqId(i);
+			
+			// alns->Insert(id, gcnew System::String(chars));
+			seqdict[id] = gcnew System::String(chars);
+		}
+		delete[] chars;
+
+		for (int i = 0; i < uSeqCount; i++)
+		{
+			alns->Add(seqdict[i]);
+		}
+	}
+
+	struct CHECKPOINT_DATA
+	{
+		gcroot<AlignmentCallback ^> Callback;
+	};
+
+	static bool OnCheckpoint(const MSA &msa, SCORE Score, void *ptrUser)
+	{
+		CHECKPOINT_DATA &Data = *(CHECKPOINT_DATA *) ptrUser;
+		MSA msaOut;
+		msaOut.Copy(msa);
+		MHackEnd(msaOut);
+		List<String ^>^ alns = gcnew List<String ^>();
+		MSAToAlns(msaOut, alns);
+		return Data.Callback->Invoke(alns, Score);
+	}
+
 	bool Multialign::DoMuscle(List<String ^>^ seqs, List<String ^>^ ids, 
 			List<String ^>^ alns)
+	{
+		return DoMuscle(seqs, ids, alns, 0, nullptr);
+	}
+
+	bool Multialign::DoMuscle(List<String ^>^ seqs, List<String ^>^ ids, 
+			List<String ^>^ alns, double MaxSecs, AlignmentCallback ^Callback)
 	{
 		vector<string> sSeqs;
 		vector<string> sIds;
@@ -56,7 +111,20 @@ namespace Muscle
 			sIds.push_back(id);
 		}
 
+		// Each call runs in its own context, so that several
+		// alignments can run at the same time on different threads.
+		MuscleContext *ptrContext = new MuscleContext;
+		MuscleContext *ptrPrevContext = SetMuscleContext(ptrContext);
+		SetRefineDeadline(MaxSecs);
+		CHECKPOINT_DATA Data;
+		if (nullptr != Callback)
+		{
+			Data.Callback = Callback;
+			SetCheckpointCallback(OnCheckpoint, &Data);
+		}
 		_doMuscle(sSeqs, sIds, alns);
+		SetMuscleContext(ptrPrevContext);
+		delete ptrContext;
 
 		
 
@@ -230,6 +298,7 @@ namespace Muscle
 		else
 			ProgressiveAlign(v, GuideTree, msa);
 		SetCurrentAlignment(msa);
+		CheckpointAlignment(msa);
 
 
 
@@ -237,10 +306,8 @@ namespace Muscle
 
 		if (1 == g_uMaxIters || 2 == uSeqCount)
 		{
-			//TextFile fileOut(g_pstrOutFileName, true);
-			//MHackEnd(msa);
-			//msa.ToFile(fileOut);
-			MuscleOutput(msa);
+			MHackEnd(msa);
+			MSAToAlns(msa, alns);
 			return;
 		}
 
@@ -256,6 +323,7 @@ namespace Muscle
 			}
 			else
 				RefineTree(msa, GuideTree);
+			CheckpointAlignment(msa);
 
 			const char *Tree2 = ValueOpt("Tree2");
 			if (0 != Tree2)
@@ -271,7 +339,8 @@ namespace Muscle
 		if (g_bAnchors)
 			RefineVert(msa, GuideTree, g_uMaxIters - 2);
 		else
-			RefineHoriz(msa, GuideTree, g_uMaxIters - 2, false, false);
+			RefineHoriz(msa, GuideTree, g_uMaxIters - 2, false, false, true);
+		UseBestAlignment(msa);
 
 
 		ValidateMuscleIds(msa);
@@ -284,31 +353,7 @@ namespace Muscle
 		//msa.ToFile(fileOut);
 		//MuscleOutput(msa);
 
-		Dictionary<int, System::String^> seqdict = gcnew Dictionary<int, System::String^>();
-		const unsigned uColCount = msa.GetColCount();
-		for (int i = 0; i < uSeqCount; i++)
-		{
-			char* chars = new char[uColCount+1];
-			for(int j = 0; j < uColCount; j++)
-			{
-				chars[j] = msa.GetChar(i, j);
-				// FIXME: i don't know what is the different between 'X' and '-'
-				if (chars[j] == 'X')
-				{
-					chars[j] = '-';
-				}
-			}
-			chars[uColCount] = 0;
-			const unsigned id = msa.GetSeqId(i);
-			
-			// alns->Insert(id, gcnew System::String(chars));
-			seqdict[id] = gcnew System::String(chars);
-		}
-
-		for (int i = 0; i < uSeqCount; i++)
-		{
-			alns->Add(seqdict[i]);
-		}
+		MSAToAlns(msa, alns);
 		
 	}
 
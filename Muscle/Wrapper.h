@@ -8,7 +8,10 @@ using namespace System::Collections::Generic;
 
 namespace Muscle
 {
-	
+	// Receives each better alignment found during a DoMuscle call,
+	// with its score. Return false to stop refining.
+	public delegate bool AlignmentCallback(List<String ^>^ alns, double Score);
+
 	public ref class Multialign
 	{
 	public:
@@ -16,6 +19,12 @@ namespace Muscle
 		static bool DoMuscle(List<String ^>^ seqs, List<String ^>^ ids, 
 			List<String ^>^ alns);
 
+		// Anytime alignment: stop refining after MaxSecs seconds
+		// (0 = no limit) and return the best alignment found.
+		// Callback may be nullptr.
+		static bool DoMuscle(List<String ^>^ seqs, List<String ^>^ ids, 
+			List<String ^>^ alns, double MaxSecs, AlignmentCallback ^Callback);
+
 	private:
 		Multialign()
 			{
@@ -1,5 +1,6 @@
 #include "muscle.h"
 #include "msa.h"
+#include "msaview.h"
 #include "pwpath.h"
 #include "profile.h"
 
@@ -91,7 +92,7 @@ static void ValidateProf(const ProfPos *Prof, unsigned uLength)
 static void ScoresFromFreqsPos(ProfPos *Prof, unsigned uLength, unsigned uPos)
 	{
 	ProfPos &PP = Prof[uPos];
-	SortCounts(PP.m_fcCounts, PP.m_uSortOrder);
+	SortLetters(PP);
 	PP.m_uResidueGroup = ResidueGroupFromFCounts(PP.m_fcCounts);
 
 // "Occupancy"
@@ -118,13 +119,7 @@ static void ScoresFromFreqsPos(ProfPos *Prof, unsigned uLength, unsigned uPos)
 	PP.m_scoreGapClose2 = (SCORE) ((1.0 - fcClose)*g_scoreGapOpen2/2.0);
 #endif
 
-	for (unsigned i = 0; i < g_AlphaSize; ++i)
-		{
-		SCORE scoreSum = 0;
-		for (unsigned j = 0; j < g_AlphaSize; ++j)
-			scoreSum += PP.m_fcCounts[j]*(*g_ptrScoreMatrix)[i][j];
-		PP.m_AAScores[i] = scoreSum;
-		}
+	SetAAScores(PP);
 	}
 
 void ProfScoresFromFreqs(ProfPos *Prof, unsigned uLength)
@@ -372,10 +367,75 @@ void AlignTwoMSAsGivenPath(const PWPath &Path, const MSA &msaA, const MSA &msaB,
 	assert(msaCombined.GetColCount() == uEdgeCount);
 	}
 
+static void SetRowsGivenCols(const MSAView &v, const unsigned Cols[],
+  unsigned uColCount, unsigned uSeqIndexFrom, MSA &msaCombined)
+	{
+	const unsigned uSeqCount = v.GetSeqCount();
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+		{
+		const unsigned uSeqIndexCombined = uSeqIndexFrom + uSeqIndex;
+		msaCombined.SetSeqName(uSeqIndexCombined, v.GetSeqName(uSeqIndex));
+		msaCombined.SetSeqId(uSeqIndexCombined, v.GetSeqId(uSeqIndex));
+
+		const char *Row = v.GetSeqBuffer(uSeqIndex);
+		for (unsigned uColIndex = 0; uColIndex < uColCount; ++uColIndex)
+			{
+			const unsigned uCol = Cols[uColIndex];
+			const char c = (uInsane == uCol) ? '-' : Row[uCol];
+			msaCombined.SetChar(uSeqIndexCombined, uColIndex, c);
+			}
+		}
+	}
+
+// The same for views, but the combined MSA is written a row at a time
+// straight from the parent rows. Each edge is one column: the
+// parent column of A and of B, or a gap.
+void AlignTwoMSAsGivenPath(const PWPath &Path, const MSAView &msaA,
+  const MSAView &msaB, MSA &msaCombined)
+	{
+	msaCombined.Clear();
+
+	const unsigned uSeqCountA = msaA.GetSeqCount();
+	const unsigned uSeqCountB = msaB.GetSeqCount();
+	const unsigned *ColIndexesA = msaA.GetColIndexes();
+	const unsigned *ColIndexesB = msaB.GetColIndexes();
+	const unsigned uEdgeCount = Path.GetEdgeCount();
+
+	unsigned *ColsA = new unsigned[uEdgeCount];
+	unsigned *ColsB = new unsigned[uEdgeCount];
+	for (unsigned uEdgeIndex = 0; uEdgeIndex < uEdgeCount; ++uEdgeIndex)
+		{
+		const PWEdge &Edge = Path.GetEdge(uEdgeIndex);
+		const char cType = Edge.cType;
+		ColsA[uEdgeIndex] = uInsane;
+		ColsB[uEdgeIndex] = uInsane;
+		if ('M' == cType || 'D' == cType)
+			{
+			assert(Edge.uPrefixLengthA > 0 &&
+			  Edge.uPrefixLengthA <= msaA.GetColCount());
+			ColsA[uEdgeIndex] = ColIndexesA[Edge.uPrefixLengthA - 1];
+			}
+		if ('M' == cType || 'I' == cType)
+			{
+			assert(Edge.uPrefixLengthB > 0 &&
+			  Edge.uPrefixLengthB <= msaB.GetColCount());
+			ColsB[uEdgeIndex] = ColIndexesB[Edge.uPrefixLengthB - 1];
+			}
+		}
+
+	msaCombined.SetSize(uSeqCountA + uSeqCountB, uEdgeCount);
+	SetRowsGivenCols(msaA, ColsA, uEdgeCount, 0, msaCombined);
+	SetRowsGivenCols(msaB, ColsB, uEdgeCount, uSeqCountA, msaCombined);
+
+	delete[] ColsA;
+	delete[] ColsB;
+	}
+
 static const ProfPos PPStart =
 	{
 	false,		//m_bAllGaps;
-	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }, // m_uSortOrder[21];
+	0,		// m_uLetterCount;
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }, // m_uLetters[20];
 	{ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }, // m_fcCounts[20];
 	1.0,	// m_LL;
 	0.0,	// m_LG;
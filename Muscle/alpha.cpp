@@ -29,20 +29,9 @@ IUPAC-IUB SYMBOLS FOR NUCLEOTIDE NOMENCLATURE:
          Cornish-Bowden (1985) Nucl. Acids Res. 13: 3021-3030.
 ***/
 
-unsigned g_CharToLetter[MAX_CHAR];
-unsigned g_CharToLetterEx[MAX_CHAR];
-
-char g_LetterToChar[MAX_ALPHA];
-char g_LetterExToChar[MAX_ALPHA_EX];
-
-char g_UnalignChar[MAX_CHAR];
-char g_AlignChar[MAX_CHAR];
-
-bool g_IsWildcardChar[MAX_CHAR];
-bool g_IsResidueChar[MAX_CHAR];
-
-ALPHA g_Alpha = ALPHA_Undefined;
-unsigned g_AlphaSize = 0;
+// The tables are in the current MuscleContext, see alpha.h.
+#define InvalidLetters		(GetMuscleContext()->alpha.InvalidLetters)
+#define InvalidLetterCount	(GetMuscleContext()->alpha.InvalidLetterCount)
 
 #define Res(c, Letter)												\
 	{																\
@@ -213,6 +202,7 @@ void SetAlpha(ALPHA Alpha)
 
 	g_AlphaSize = GetAlphaSize(Alpha);
 	g_Alpha = Alpha;
+	SetPPKernels();
 
 	if (g_bVerbose)
 		Log("Alphabet %s\n", ALPHAToStr(g_Alpha));
@@ -250,9 +240,6 @@ bool IsRNA(char c)
 	return strchr("AGCUNagcun", c) != 0;
 	}
 
-static char InvalidLetters[256];
-static int InvalidLetterCount = 0;
-
 void ClearInvalidLetterWarning()
 	{
 	memset(InvalidLetters, 0, 256);
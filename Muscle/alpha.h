@@ -7,17 +7,19 @@ void ClearInvalidLetterWarning();
 void InvalidLetterWarning(char c, char w);
 void ReportInvalidLetters();
 
-extern unsigned g_CharToLetter[];
-extern unsigned g_CharToLetterEx[];
+// Alphabet tables are members of the current MuscleContext,
+// see musclecontext.h.
+#define g_CharToLetter		(GetMuscleContext()->alpha.CharToLetter)
+#define g_CharToLetterEx	(GetMuscleContext()->alpha.CharToLetterEx)
 
-extern char g_LetterToChar[];
-extern char g_LetterExToChar[];
+#define g_LetterToChar		(GetMuscleContext()->alpha.LetterToChar)
+#define g_LetterExToChar	(GetMuscleContext()->alpha.LetterExToChar)
 
-extern char g_UnalignChar[];
-extern char g_AlignChar[];
+#define g_UnalignChar		(GetMuscleContext()->alpha.UnalignChar)
+#define g_AlignChar			(GetMuscleContext()->alpha.AlignChar)
 
-extern bool g_IsWildcardChar[];
-extern bool g_IsResidueChar[];
+#define g_IsWildcardChar	(GetMuscleContext()->alpha.IsWildcardChar)
+#define g_IsResidueChar		(GetMuscleContext()->alpha.IsResidueChar)
 
 #define CharToLetter(c)		(g_CharToLetter[(unsigned char) (c)])
 #define CharToLetterEx(c)	(g_CharToLetterEx[(unsigned char) (c)])
@@ -94,8 +96,8 @@ const unsigned MAX_ALPHA = 20;
 const unsigned MAX_ALPHA_EX = AX_COUNT;
 const unsigned MAX_CHAR = 256;
 
-extern ALPHA g_Alpha;
-extern unsigned g_AlphaSize;
+#define g_Alpha				(GetMuscleContext()->alpha.Alpha)
+#define g_AlphaSize			(GetMuscleContext()->alpha.AlphaSize)
 
 void SetAlpha(ALPHA Alpha);
 char GetWildcardChar();
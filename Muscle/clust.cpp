@@ -1,6 +1,7 @@
 #include "muscle.h"
 #include "clust.h"
 #include "clustset.h"
+#include "distfunc.h"
 #include <stdio.h>
 
 #define TRACE		0
@@ -13,14 +14,17 @@ Clust::Clust()
 	m_uClusterCount = 0;
 	m_JoinStyle = JOIN_Undefined;
 	m_dDist = 0;
+	m_ptrDistFile = 0;
+	m_ptrNJ = 0;
 	m_uLeafCount = 0;
 	m_ptrSet = 0;
 	}
 
 Clust::~Clust()
 	{
+	FreeNJ();
 	delete[] m_Nodes;
-	delete[] m_dDist;
+	FreeDistTriangle(m_dDist, m_ptrDistFile);
 	delete[] m_ClusterIndexToNodeIndex;
 	}
 
@@ -99,6 +103,9 @@ void Clust::Create(ClustSet &Set, CLUSTER Method)
 			}
 	ProgressStepsDone();
 
+	if (JOIN_NeighborJoining == m_JoinStyle)
+		InitNJ();
+
 // Call CreateCluster once for each internal node in the tree
 	SetProgressDesc("Build guide tree");
 	m_uClusterCount = m_uLeafCount;
@@ -145,6 +152,9 @@ void Clust::CreateCluster()
 		SetDist(uNewNodeIndex, uNodeIndex, dDist);
 		}
 
+	if (0 != m_ptrNJ)
+		UpdateNJ(uLeftNodeIndex, uRightNodeIndex, uNewNodeIndex);
+
 	for (unsigned uNodeIndex = GetFirstCluster(); uNodeIndex != uInsane;
 	  uNodeIndex = GetNextCluster(uNodeIndex))
 		{
@@ -481,8 +491,8 @@ void Clust::SetLeafCount(unsigned uLeafCount)
 	const unsigned uNodeCount = GetNodeCount();
 
 // Triangular matrix size excluding diagonal (all zeros in our case).
-	m_uTriangularMatrixSize = (uNodeCount*(uNodeCount - 1))/2;
-	m_dDist = new float[m_uTriangularMatrixSize];
+	m_uTriangularMatrixSize = ((size_t) uNodeCount*(uNodeCount - 1))/2;
+	m_dDist = AllocDistTriangle(m_uTriangularMatrixSize, &m_ptrDistFile);
 	}
 
 unsigned Clust::GetLeafCount() const
@@ -490,29 +500,29 @@ unsigned Clust::GetLeafCount() const
 	return m_uLeafCount;
 	}
 
-unsigned Clust::VectorIndex(unsigned uIndex1, unsigned uIndex2) const
+size_t Clust::VectorIndex(unsigned uIndex1, unsigned uIndex2) const
 	{
 	const unsigned uNodeCount = GetNodeCount();
 	if (uIndex1 >= uNodeCount || uIndex2 >= uNodeCount)
 		Quit("DistVectorIndex(%u,%u) %u", uIndex1, uIndex2, uNodeCount);
-	unsigned v;
+	size_t v;
 	if (uIndex1 >= uIndex2)
-		v = uIndex2 + (uIndex1*(uIndex1 - 1))/2;
+		v = uIndex2 + ((size_t) uIndex1*(uIndex1 - 1))/2;
 	else
-		v = uIndex1 + (uIndex2*(uIndex2 - 1))/2;
+		v = uIndex1 + ((size_t) uIndex2*(uIndex2 - 1))/2;
 	assert(v < m_uTriangularMatrixSize);
 	return v;
 	}
 
 float Clust::GetDist(unsigned uIndex1, unsigned uIndex2) const
 	{
-	unsigned v = VectorIndex(uIndex1, uIndex2);
+	size_t v = VectorIndex(uIndex1, uIndex2);
 	return m_dDist[v];
 	}
 
 void Clust::SetDist(unsigned uIndex1, unsigned uIndex2, float dDist)
 	{
-	unsigned v = VectorIndex(uIndex1, uIndex2);
+	size_t v = VectorIndex(uIndex1, uIndex2);
 	m_dDist[v] = dDist;
 	}
 
@@ -662,5 +672,7 @@ float Clust::GetMinMetricBruteForce(unsigned *ptruIndex1, unsigned *ptruIndex2)
 
 float Clust::GetMinMetric(unsigned *ptruIndex1, unsigned *ptruIndex2) const
 	{
+	if (0 != m_ptrNJ)
+		return GetMinMetricNJ(ptruIndex1, ptruIndex2);
 	return GetMinMetricBruteForce(ptruIndex1, ptruIndex2);
 	}
@@ -6,6 +6,8 @@ class ClustNode;
 class ClustSet;
 class Phylip;
 class SortedNode;
+class MappedFile;
+struct NJ_STATE;
 
 const unsigned RB_NIL = ((unsigned) 0xfff0);
 
@@ -99,7 +101,7 @@ public:
 
 	float Calc_r(unsigned uNodeIndex) const;
 
-	unsigned VectorIndex(unsigned uIndex1, unsigned uIndex2) const;
+	size_t VectorIndex(unsigned uIndex1, unsigned uIndex2) const;
 
 	unsigned GetFirstCluster() const;
 	unsigned GetNextCluster(unsigned uNodeIndex) const;
@@ -112,10 +114,16 @@ public:
 	void InsertMetric(unsigned uIndex1, unsigned uIndex2, float dMetric);
 	float GetMinMetric(unsigned *ptruIndex1, unsigned *ptruIndex2) const;
 	float GetMinMetricBruteForce(unsigned *ptruIndex1, unsigned *ptruIndex2) const;
+	float GetMinMetricNJ(unsigned *ptruIndex1, unsigned *ptruIndex2) const;
 	void DeleteMetric(unsigned uIndex);
 	void DeleteMetric(unsigned uIndex1, unsigned uIndex2);
 	void ListMetric() const;
 
+	void InitNJ();
+	void UpdateNJ(unsigned uLeftNodeIndex, unsigned uRightNodeIndex,
+	  unsigned uNewNodeIndex);
+	void FreeNJ();
+
 	void DeleteFromClusterList(unsigned uNodeIndex);
 	void AddToClusterList(unsigned uNodeIndex);
 
@@ -139,8 +147,10 @@ public:
 	unsigned m_uLeafCount;
 	unsigned m_uNodeCount;
 	unsigned m_uClusterCount;
-	unsigned m_uTriangularMatrixSize;
+	size_t m_uTriangularMatrixSize;
 	float *m_dDist;
+	MappedFile *m_ptrDistFile;
+	NJ_STATE *m_ptrNJ;
 	ClustSet *m_ptrSet;
 	ClustNode *m_ptrClusterList;
 	};
@@ -0,0 +1,525 @@
+#include "muscle.h"
+#include "clust.h"
+#include "threads.h"
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#define TRACE		0
+
+/***
+Neighbor-joining join selection in the style of RapidNJ
+(Simonsen, Mailund & Pedersen 2008).
+
+The NJ metric of clusters i and j is
+
+	Q(i, j) = d(i, j) - (r(i) + r(j)),
+
+where r(i) is the sum of distances from i to the other clusters
+divided by (cluster count - 2). Computing it for every pair at each
+join is O(N^2) per join, or worse if r is recomputed per pair.
+
+Here the row sums are updated incrementally as clusters are joined,
+and each cluster i keeps a row of (d(i, j), j) for the clusters j
+that existed when i was created, sorted by distance. If r(j) is at
+most rMax,
+
+	Q(i, j) >= d(i, j) - (r(i) + rMax),
+
+so a row is scanned in increasing distance only until this bound
+exceeds the smallest Q found so far. A single rMax over all clusters
+gives a loose bound when r varies a lot, so each cluster is put in
+one of NJ_BUCKETS buckets by its r when it is created, rows are
+sorted by bucket and then by distance, and each bucket of a row is
+scanned with the largest current r in that bucket as rMax. Before
+the scan, the smallest Q of the first entries of the buckets is
+taken as a starting value, so that typically only a few entries of
+each row are visited. Entries for clusters that have since been
+joined are skipped, rather than removed from the rows, except at
+the start of a bucket. When the number of clusters has halved, all
+rows are rebuilt without them and with buckets for the current r,
+which costs O(N^2 log N) over the whole tree.
+
+Each pair is in the row of the newer cluster only, i.e. row i holds
+j < i. Ties are broken as the exhaustive scan of the cluster list
+in GetMinMetricBruteForce, which visits clusters in decreasing node
+index and keeps the first minimum: the pair with the larger i, then
+the larger j, wins. Exact ties are common (with three clusters all
+pairs tie), but r here is summed in a different order than there, so
+Q values that differ by rounding error only are treated as ties:
+each thread keeps the pairs within NJ_TIE_EPSILON of its minimum Q,
+and the first in scan order of those within NJ_TIE_EPSILON of the
+overall minimum is chosen. Rows are searched in parallel, and the
+result doesn't depend on the number of threads.
+
+The last joins, where ties are most frequent, are chosen exactly as
+the exhaustive scan does, with r summed in single precision in
+cluster list order. With r computed once per join rather than once
+per pair this costs O(N^2) per join, which is cheap for up to
+NJ_EXACT_COUNT clusters.
+***/
+
+// Relative difference in Q below which pairs are taken as tied.
+static const double NJ_TIE_EPSILON = 1e-6;
+
+static const unsigned NJ_EXACT_COUNT = 128;
+static const unsigned NJ_BUCKETS = 8;
+
+struct NJ_ENTRY
+	{
+	float dDist;
+	unsigned uNodeIndex;
+	};
+
+struct NJ_STATE
+	{
+	unsigned uThreadCount;
+
+// Bucket b of row i is Rows[i][SegStarts[i*NJ_BUCKETS + b]] up to
+// SegEnds[i*NJ_BUCKETS + b].
+	NJ_ENTRY **Rows;
+	unsigned *SegStarts;
+	unsigned *SegEnds;
+	double *RowSums;
+	double *r;
+	bool *Active;
+	unsigned *Buckets;
+	double BucketCuts[NJ_BUCKETS - 1];
+	double rMax[NJ_BUCKETS];
+
+// Cluster count when the rows were last rebuilt.
+	unsigned uBuildCount;
+
+// Active clusters, rebuilt before each search.
+	unsigned *Clusters;
+	unsigned uClusterCount;
+	};
+
+struct NJ_PAIR
+	{
+	double dQ;
+	unsigned i;
+	unsigned j;
+	};
+
+// Smallest Q found by one thread, and the pairs within tolerance of it.
+struct NJ_MIN
+	{
+	double dMinQ;
+	std::vector<NJ_PAIR> Ties;
+	};
+
+struct NJ_SEARCH
+	{
+	const NJ_STATE *ptrNJ;
+	double dStartQ;
+	NJ_MIN *Mins;
+	};
+
+struct NJ_BUILD
+	{
+	const Clust *ptrClust;
+	NJ_STATE *ptrNJ;
+	};
+
+// Row order: bucket of the column, then distance.
+struct NJ_ENTRY_LESS
+	{
+	const unsigned *Buckets;
+	bool operator()(const NJ_ENTRY &e1, const NJ_ENTRY &e2) const
+		{
+		const unsigned b1 = Buckets[e1.uNodeIndex];
+		const unsigned b2 = Buckets[e2.uNodeIndex];
+		if (b1 != b2)
+			return b1 < b2;
+		return e1.dDist < e2.dDist;
+		}
+	};
+
+static inline double GetTieLimit(double dMinQ)
+	{
+	return dMinQ + NJ_TIE_EPSILON*(1 + fabs(dMinQ));
+	}
+
+// True if the exhaustive scan would reach pair 1 before pair 2.
+static inline bool NJBefore(const NJ_PAIR &Pair1, const NJ_PAIR &Pair2)
+	{
+	return Pair1.i > Pair2.i || (Pair1.i == Pair2.i && Pair1.j > Pair2.j);
+	}
+
+static unsigned GetBucket(const NJ_STATE &NJ, double r)
+	{
+	return (unsigned) (std::upper_bound(NJ.BucketCuts,
+	  NJ.BucketCuts + NJ_BUCKETS - 1, r) - NJ.BucketCuts);
+	}
+
+// Bucket boundaries at quantiles of r over the active clusters.
+static void SetBucketCuts(NJ_STATE &NJ)
+	{
+	const unsigned uCount = NJ.uClusterCount;
+	double *rs = new double[uCount];
+	for (unsigned k = 0; k < uCount; ++k)
+		rs[k] = NJ.r[NJ.Clusters[k]];
+	std::sort(rs, rs + uCount);
+	for (unsigned b = 0; b < NJ_BUCKETS - 1; ++b)
+		NJ.BucketCuts[b] = rs[((b + 1)*uCount)/NJ_BUCKETS];
+	delete[] rs;
+	}
+
+static void BuildRow(const Clust &C, NJ_STATE &NJ, unsigned uNodeIndex,
+  const unsigned Cols[], unsigned uColCount)
+	{
+	NJ_ENTRY *Row = new NJ_ENTRY[uColCount];
+	for (unsigned k = 0; k < uColCount; ++k)
+		{
+		Row[k].uNodeIndex = Cols[k];
+		Row[k].dDist = C.GetDist(uNodeIndex, Cols[k]);
+		}
+	NJ_ENTRY_LESS Less;
+	Less.Buckets = NJ.Buckets;
+	std::sort(Row, Row + uColCount, Less);
+	NJ.Rows[uNodeIndex] = Row;
+
+	unsigned *SegStarts = NJ.SegStarts + uNodeIndex*NJ_BUCKETS;
+	unsigned *SegEnds = NJ.SegEnds + uNodeIndex*NJ_BUCKETS;
+	unsigned k = 0;
+	for (unsigned b = 0; b < NJ_BUCKETS; ++b)
+		{
+		SegStarts[b] = k;
+		while (k < uColCount && NJ.Buckets[Row[k].uNodeIndex] == b)
+			++k;
+		SegEnds[b] = k;
+		}
+	assert(k == uColCount);
+	}
+
+static void FreeRow(NJ_STATE &NJ, unsigned uNodeIndex)
+	{
+	delete[] NJ.Rows[uNodeIndex];
+	NJ.Rows[uNodeIndex] = 0;
+	for (unsigned b = 0; b < NJ_BUCKETS; ++b)
+		NJ.SegEnds[uNodeIndex*NJ_BUCKETS + b] = 0;
+	}
+
+static void BuildRowsThread(unsigned uThreadIndex, void *ptrUser)
+	{
+	const NJ_BUILD &B = *(const NJ_BUILD *) ptrUser;
+	const Clust &C = *B.ptrClust;
+	NJ_STATE &NJ = *B.ptrNJ;
+	unsigned *Cols = new unsigned[NJ.uClusterCount];
+	for (unsigned k = uThreadIndex; k < NJ.uClusterCount; k += NJ.uThreadCount)
+		{
+		const unsigned i = NJ.Clusters[k];
+		unsigned uColCount = 0;
+		for (unsigned m = 0; m < NJ.uClusterCount; ++m)
+			if (NJ.Clusters[m] < i)
+				Cols[uColCount++] = NJ.Clusters[m];
+		BuildRow(C, NJ, i, Cols, uColCount);
+		}
+	delete[] Cols;
+	}
+
+static void SearchRowsThread(unsigned uThreadIndex, void *ptrUser)
+	{
+	const NJ_SEARCH &S = *(const NJ_SEARCH *) ptrUser;
+	const NJ_STATE &NJ = *S.ptrNJ;
+	NJ_MIN &Min = S.Mins[uThreadIndex];
+	Min.dMinQ = S.dStartQ;
+	Min.Ties.clear();
+	double dLimit = GetTieLimit(S.dStartQ);
+	for (unsigned k = uThreadIndex; k < NJ.uClusterCount; k += NJ.uThreadCount)
+		{
+		const unsigned i = NJ.Clusters[k];
+		const NJ_ENTRY *Row = NJ.Rows[i];
+		const double ri = NJ.r[i];
+		for (unsigned b = 0; b < NJ_BUCKETS; ++b)
+			{
+		// rMax of an empty bucket is MINUS_INFINITY, which ends the
+		// scan of entries left in it at once.
+			const double rBound = ri + NJ.rMax[b];
+			const unsigned uEnd = NJ.SegEnds[i*NJ_BUCKETS + b];
+			for (unsigned n = NJ.SegStarts[i*NJ_BUCKETS + b]; n < uEnd; ++n)
+				{
+				const double d = Row[n].dDist;
+				if (d - rBound > dLimit)
+					break;
+				const unsigned j = Row[n].uNodeIndex;
+				if (!NJ.Active[j])
+					continue;
+				const double dQ = d - (ri + NJ.r[j]);
+				if (dQ > dLimit)
+					continue;
+				if (dQ < Min.dMinQ)
+					{
+					Min.dMinQ = dQ;
+					dLimit = GetTieLimit(dQ);
+					unsigned uTieCount = 0;
+					for (unsigned t = 0; t < (unsigned) Min.Ties.size(); ++t)
+						if (Min.Ties[t].dQ <= dLimit)
+							Min.Ties[uTieCount++] = Min.Ties[t];
+					Min.Ties.resize(uTieCount);
+					}
+				NJ_PAIR Pair;
+				Pair.dQ = dQ;
+				Pair.i = i;
+				Pair.j = j;
+				Min.Ties.push_back(Pair);
+				}
+			}
+		}
+	}
+
+static unsigned GetNJThreadCount(unsigned uClusterCount)
+	{
+// Threads are only worth starting for long searches.
+	const unsigned MIN_ROWS_PER_THREAD = 512;
+	unsigned uThreadCount = GetThreadCount();
+	if (uThreadCount > uClusterCount/MIN_ROWS_PER_THREAD)
+		uThreadCount = uClusterCount/MIN_ROWS_PER_THREAD;
+	if (0 == uThreadCount)
+		uThreadCount = 1;
+	return uThreadCount;
+	}
+
+// Set r from the row sums, the largest r in each bucket, and the
+// active cluster list.
+static void SetNJr(const Clust &C, NJ_STATE &NJ)
+	{
+	const unsigned uClusterCount = C.GetClusterCount();
+	NJ.uClusterCount = 0;
+	for (unsigned b = 0; b < NJ_BUCKETS; ++b)
+		NJ.rMax[b] = MINUS_INFINITY;
+	for (unsigned i = C.GetFirstCluster(); i != uInsane; i = C.GetNextCluster(i))
+		{
+		const double r = (2 == uClusterCount) ? 0 : NJ.RowSums[i]/(uClusterCount - 2);
+		NJ.r[i] = r;
+		const unsigned b = NJ.Buckets[i];
+		if (r > NJ.rMax[b])
+			NJ.rMax[b] = r;
+		NJ.Clusters[NJ.uClusterCount++] = i;
+		}
+	assert(NJ.uClusterCount == uClusterCount);
+	}
+
+// Build the rows of all active clusters, after SetNJr.
+static void BuildRows(const Clust &C, NJ_STATE &NJ)
+	{
+	SetBucketCuts(NJ);
+	for (unsigned k = 0; k < NJ.uClusterCount; ++k)
+		{
+		const unsigned i = NJ.Clusters[k];
+		delete[] NJ.Rows[i];
+		NJ.Rows[i] = 0;
+		NJ.Buckets[i] = GetBucket(NJ, NJ.r[i]);
+		}
+
+	NJ_BUILD B;
+	B.ptrClust = &C;
+	B.ptrNJ = &NJ;
+	NJ.uThreadCount = GetNJThreadCount(NJ.uClusterCount);
+	RunThreads(NJ.uThreadCount, BuildRowsThread, &B);
+	NJ.uBuildCount = NJ.uClusterCount;
+	}
+
+void Clust::InitNJ()
+	{
+	const unsigned uNodeCount = GetNodeCount();
+	m_ptrNJ = new NJ_STATE;
+	NJ_STATE &NJ = *m_ptrNJ;
+	NJ.Rows = new NJ_ENTRY *[uNodeCount];
+	NJ.SegStarts = new unsigned[uNodeCount*NJ_BUCKETS];
+	NJ.SegEnds = new unsigned[uNodeCount*NJ_BUCKETS];
+	NJ.RowSums = new double[uNodeCount];
+	NJ.r = new double[uNodeCount];
+	NJ.Active = new bool[uNodeCount];
+	NJ.Buckets = new unsigned[uNodeCount];
+	NJ.Clusters = new unsigned[m_uLeafCount];
+	NJ.uClusterCount = 0;
+	for (unsigned i = 0; i < uNodeCount; ++i)
+		{
+		NJ.Rows[i] = 0;
+		NJ.RowSums[i] = 0;
+		NJ.Active[i] = (i < m_uLeafCount);
+		NJ.Buckets[i] = 0;
+		}
+	memset(NJ.SegStarts, 0, uNodeCount*NJ_BUCKETS*sizeof(unsigned));
+	memset(NJ.SegEnds, 0, uNodeCount*NJ_BUCKETS*sizeof(unsigned));
+
+	for (unsigned i = 0; i < m_uLeafCount; ++i)
+		for (unsigned j = 0; j < i; ++j)
+			{
+			const double d = GetDist(i, j);
+			NJ.RowSums[i] += d;
+			NJ.RowSums[j] += d;
+			}
+
+	SetNJr(*this, NJ);
+	BuildRows(*this, NJ);
+	}
+
+void Clust::FreeNJ()
+	{
+	if (0 == m_ptrNJ)
+		return;
+	NJ_STATE &NJ = *m_ptrNJ;
+	const unsigned uNodeCount = GetNodeCount();
+	for (unsigned i = 0; i < uNodeCount; ++i)
+		delete[] NJ.Rows[i];
+	delete[] NJ.Rows;
+	delete[] NJ.SegStarts;
+	delete[] NJ.SegEnds;
+	delete[] NJ.RowSums;
+	delete[] NJ.r;
+	delete[] NJ.Active;
+	delete[] NJ.Buckets;
+	delete[] NJ.Clusters;
+	delete m_ptrNJ;
+	m_ptrNJ = 0;
+	}
+
+// Called after the distances from the new node to the other clusters
+// have been set.
+void Clust::UpdateNJ(unsigned uLeftNodeIndex, unsigned uRightNodeIndex,
+  unsigned uNewNodeIndex)
+	{
+	NJ_STATE &NJ = *m_ptrNJ;
+
+	NJ.Active[uLeftNodeIndex] = false;
+	NJ.Active[uRightNodeIndex] = false;
+	FreeRow(NJ, uLeftNodeIndex);
+	FreeRow(NJ, uRightNodeIndex);
+
+	double dNewSum = 0;
+	for (unsigned k = GetFirstCluster(); k != uInsane; k = GetNextCluster(k))
+		{
+		if (k == uNewNodeIndex)
+			continue;
+		const float dNew = GetDist(uNewNodeIndex, k);
+		NJ.RowSums[k] += dNew - GetDist(uLeftNodeIndex, k) -
+		  GetDist(uRightNodeIndex, k);
+		dNewSum += dNew;
+		}
+	NJ.RowSums[uNewNodeIndex] = dNewSum;
+	NJ.Active[uNewNodeIndex] = true;
+
+// Rows aren't used by the exact search of the last joins.
+	if (GetClusterCount() <= NJ_EXACT_COUNT)
+		return;
+
+	SetNJr(*this, NJ);
+	if (2*NJ.uClusterCount <= NJ.uBuildCount)
+		{
+		BuildRows(*this, NJ);
+		return;
+		}
+	SetBucketCuts(NJ);
+	NJ.Buckets[uNewNodeIndex] = GetBucket(NJ, NJ.r[uNewNodeIndex]);
+
+	unsigned uColCount = 0;
+	for (unsigned k = 0; k < NJ.uClusterCount; ++k)
+		if (NJ.Clusters[k] != uNewNodeIndex)
+			NJ.Clusters[uColCount++] = NJ.Clusters[k];
+	BuildRow(*this, NJ, uNewNodeIndex, NJ.Clusters, uColCount);
+	}
+
+// Same result as GetMinMetricBruteForce, in O(N^2).
+static float GetMinMetricNJExact(const Clust &C, NJ_STATE &NJ,
+  unsigned *ptruIndex1, unsigned *ptruIndex2)
+	{
+	for (unsigned k = 0; k < NJ.uClusterCount; ++k)
+		{
+		const unsigned i = NJ.Clusters[k];
+		NJ.r[i] = C.Calc_r(i);
+		}
+
+	unsigned uMinIndex1 = uInsane;
+	unsigned uMinIndex2 = uInsane;
+	float dMinMetric = PLUS_INFINITY;
+	for (unsigned k1 = 0; k1 < NJ.uClusterCount; ++k1)
+		{
+		const unsigned i = NJ.Clusters[k1];
+		const float ri = (float) NJ.r[i];
+		for (unsigned k2 = k1 + 1; k2 < NJ.uClusterCount; ++k2)
+			{
+			const unsigned j = NJ.Clusters[k2];
+			const float rj = (float) NJ.r[j];
+			const float dij = C.GetDist(i, j);
+			const float dMetric = dij - (ri + rj);
+			if (dMetric < dMinMetric)
+				{
+				dMinMetric = dMetric;
+				uMinIndex1 = i;
+				uMinIndex2 = j;
+				}
+			}
+		}
+	*ptruIndex1 = uMinIndex1;
+	*ptruIndex2 = uMinIndex2;
+	return dMinMetric;
+	}
+
+float Clust::GetMinMetricNJ(unsigned *ptruIndex1, unsigned *ptruIndex2) const
+	{
+	NJ_STATE &NJ = *m_ptrNJ;
+	SetNJr(*this, NJ);
+	if (NJ.uClusterCount <= NJ_EXACT_COUNT)
+		return GetMinMetricNJExact(*this, NJ, ptruIndex1, ptruIndex2);
+	NJ.uThreadCount = GetNJThreadCount(NJ.uClusterCount);
+
+// Drop joined clusters from the start of each bucket, and take the
+// smallest Q of the first entries as the starting value. It is the
+// Q of a pair, so the minimum can't be larger.
+	NJ_SEARCH S;
+	S.ptrNJ = &NJ;
+	S.dStartQ = PLUS_INFINITY;
+	for (unsigned k = 0; k < NJ.uClusterCount; ++k)
+		{
+		const unsigned i = NJ.Clusters[k];
+		const NJ_ENTRY *Row = NJ.Rows[i];
+		for (unsigned b = 0; b < NJ_BUCKETS; ++b)
+			{
+			unsigned &uStart = NJ.SegStarts[i*NJ_BUCKETS + b];
+			const unsigned uEnd = NJ.SegEnds[i*NJ_BUCKETS + b];
+			while (uStart < uEnd && !NJ.Active[Row[uStart].uNodeIndex])
+				++uStart;
+			if (uStart < uEnd)
+				{
+				const unsigned j = Row[uStart].uNodeIndex;
+				const double dQ = Row[uStart].dDist - (NJ.r[i] + NJ.r[j]);
+				if (dQ < S.dStartQ)
+					S.dStartQ = dQ;
+				}
+			}
+		}
+	S.Mins = new NJ_MIN[NJ.uThreadCount];
+	RunThreads(NJ.uThreadCount, SearchRowsThread, &S);
+
+	double dMinQ = PLUS_INFINITY;
+	for (unsigned t = 0; t < NJ.uThreadCount; ++t)
+		if (S.Mins[t].dMinQ < dMinQ)
+			dMinQ = S.Mins[t].dMinQ;
+	const double dLimit = GetTieLimit(dMinQ);
+
+	NJ_PAIR Min;
+	Min.dQ = PLUS_INFINITY;
+	Min.i = uInsane;
+	Min.j = uInsane;
+	for (unsigned t = 0; t < NJ.uThreadCount; ++t)
+		{
+		const std::vector<NJ_PAIR> &Ties = S.Mins[t].Ties;
+		for (unsigned n = 0; n < (unsigned) Ties.size(); ++n)
+			if (Ties[n].dQ <= dLimit && (uInsane == Min.i || NJBefore(Ties[n], Min)))
+				Min = Ties[n];
+		}
+	delete[] S.Mins;
+
+	if (uInsane == Min.i)
+		Quit("Clust::GetMinMetricNJ, no pair");
+
+#if	TRACE
+	Log("NJ join %u %u Q=%.6g\n", Min.i, Min.j, Min.dQ);
+#endif
+	*ptruIndex1 = Min.i;
+	*ptruIndex2 = Min.j;
+	return (float) Min.dQ;
+	}
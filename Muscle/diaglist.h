@@ -86,4 +86,11 @@ void FindDiagsNuc(const ProfPos *PX, unsigned uLengthX, const ProfPos *PY,
   unsigned uLengthY, DiagList &DL);
 void MergeDiags(DiagList &DL);
 
+// Tuple starting at uPos, or EMPTY if it has a position with no
+// residue group.
+typedef unsigned (*TUPLE_FN)(const ProfPos *PP, unsigned uPos);
+void FindDiagsSeeds(const ProfPos *PX, unsigned uLengthX, const ProfPos *PY,
+  unsigned uLengthY, unsigned uK, unsigned uTupleCount, TUPLE_FN GetTuple,
+  DiagList &DL);
+
 #endif // diaglist_h
@@ -0,0 +1,390 @@
+#include "muscle.h"
+#include "profile.h"
+#include "diaglist.h"
+
+#define TRACE	0
+
+/***
+Seed index and chaining shared by FindDiags and FindDiagsNuc.
+
+Every k-tuple of the longer profile, B, is put in a table sorted by
+tuple (a counting sort, so the table is a suffix array of B bucketed
+on the first k letters). All positions of a tuple are kept, so a
+tuple that occurs more than once in B still gives a seed at each
+occurrence.
+
+Each seed is extended forwards along its diagonal while the residue
+groups agree. Seeds that fall inside a match already found on the same
+diagonal are skipped. Matches of at least g_uMinDiagLength are the
+candidate diagonals.
+
+Candidates may overlap or cross, for example at repeats. The diagonals
+returned are the co-linear chain of candidates with the most matched
+positions. Each diagonal in the chain ends before the next starts in
+both profiles. The chain is found by the usual chaining DP: candidates
+are visited in order of start in A, and a prefix-maximum tree indexed
+by end in B holds the best chain ending at each candidate that is
+already complete in A.
+
+Tuples that occur more than MAX_TUPLE_COUNT times in B are low
+complexity and give no seeds.
+
+The buffers are in the thread's DPWorkspace, so FindDiags is
+re-entrant.
+***/
+
+static const unsigned MAX_TUPLE_COUNT = 64;
+
+void FreeDiagSeedsMem(DIAGSEEDS_MEMORY &DSM)
+	{
+	delete[] DSM.TupleStart;
+	delete[] DSM.TuplesA;
+	delete[] DSM.TuplesB;
+	delete[] DSM.PosB;
+	delete[] DSM.DiagEnd;
+	delete[] DSM.EndCount;
+	delete[] DSM.TreeScore;
+	delete[] DSM.TreeIndex;
+	delete[] DSM.Cands;
+	delete[] DSM.ChainScore;
+	delete[] DSM.ChainPrev;
+	delete[] DSM.ByEnd;
+
+	memset(&DSM, 0, sizeof(DSM));
+	}
+
+static void AllocSeeds(DIAGSEEDS_MEMORY &DSM, unsigned uTupleCount,
+  unsigned uLength)
+	{
+	if (uTupleCount > DSM.uTupleCount)
+		{
+		delete[] DSM.TupleStart;
+		DSM.uTupleCount = uTupleCount;
+		DSM.TupleStart = new unsigned[uTupleCount + 1];
+		}
+
+	if (uLength > DSM.uLength)
+		{
+		delete[] DSM.TuplesA;
+		delete[] DSM.TuplesB;
+		delete[] DSM.PosB;
+		delete[] DSM.DiagEnd;
+		delete[] DSM.EndCount;
+		delete[] DSM.TreeScore;
+		delete[] DSM.TreeIndex;
+
+		DSM.uLength = uLength + 1024;
+		DSM.TuplesA = new unsigned[DSM.uLength];
+		DSM.TuplesB = new unsigned[DSM.uLength];
+		DSM.PosB = new unsigned[DSM.uLength];
+		DSM.DiagEnd = new unsigned[DSM.uLength];
+		DSM.EndCount = new unsigned[DSM.uLength];
+		DSM.TreeScore = new unsigned[DSM.uLength];
+		DSM.TreeIndex = new unsigned[DSM.uLength];
+		}
+	}
+
+static void AllocCands(DIAGSEEDS_MEMORY &DSM, unsigned uCandCount)
+	{
+	if (uCandCount <= DSM.uMaxCandCount)
+		return;
+
+	const unsigned uNewMax = uCandCount + uCandCount/2 + 256;
+	Diag *Cands = new Diag[uNewMax];
+	if (0 != DSM.uCandCount)
+		memcpy(Cands, DSM.Cands, DSM.uCandCount*sizeof(Diag));
+
+	delete[] DSM.Cands;
+	delete[] DSM.ChainScore;
+	delete[] DSM.ChainPrev;
+	delete[] DSM.ByEnd;
+
+	DSM.uMaxCandCount = uNewMax;
+	DSM.Cands = Cands;
+	DSM.ChainScore = new unsigned[uNewMax];
+	DSM.ChainPrev = new unsigned[uNewMax];
+	DSM.ByEnd = new unsigned[uNewMax];
+	}
+
+static void GetTuples(const ProfPos *PP, unsigned uLength, unsigned uK,
+  TUPLE_FN GetTuple, unsigned Tuples[])
+	{
+	for (unsigned uPos = 0; uPos + uK <= uLength; ++uPos)
+		Tuples[uPos] = GetTuple(PP, uPos);
+	}
+
+// Positions of each tuple of B, in order, are
+// PosB[TupleStart[t]] .. PosB[TupleStart[t+1]-1].
+static void IndexTuples(DIAGSEEDS_MEMORY &DSM, unsigned uTupleCount,
+  unsigned uTuplePosCount)
+	{
+	unsigned *TupleStart = DSM.TupleStart;
+	const unsigned *TuplesB = DSM.TuplesB;
+	unsigned *PosB = DSM.PosB;
+
+	memset(TupleStart, 0, (uTupleCount + 1)*sizeof(unsigned));
+	for (unsigned uPos = 0; uPos < uTuplePosCount; ++uPos)
+		{
+		const unsigned uTuple = TuplesB[uPos];
+		if (EMPTY != uTuple)
+			++TupleStart[uTuple + 1];
+		}
+	for (unsigned t = 0; t < uTupleCount; ++t)
+		TupleStart[t+1] += TupleStart[t];
+
+// Filling moves each start to the start of the next tuple, so shift
+// back afterwards.
+	for (unsigned uPos = 0; uPos < uTuplePosCount; ++uPos)
+		{
+		const unsigned uTuple = TuplesB[uPos];
+		if (EMPTY != uTuple)
+			PosB[TupleStart[uTuple]++] = uPos;
+		}
+	for (unsigned t = uTupleCount; t > 0; --t)
+		TupleStart[t] = TupleStart[t-1];
+	TupleStart[0] = 0;
+	}
+
+static unsigned ExtendMatch(const ProfPos *PA, unsigned uLengthA,
+  const ProfPos *PB, unsigned uLengthB, unsigned uEndPosA, unsigned uEndPosB)
+	{
+	for (;;)
+		{
+		if (uLengthA - 1 == uEndPosA || uLengthB - 1 == uEndPosB)
+			break;
+		const unsigned uGroupA = PA[uEndPosA+1].m_uResidueGroup;
+		if (RESIDUE_GROUP_MULTIPLE == uGroupA)
+			break;
+		const unsigned uGroupB = PB[uEndPosB+1].m_uResidueGroup;
+		if (RESIDUE_GROUP_MULTIPLE == uGroupB)
+			break;
+		if (uGroupA != uGroupB)
+			break;
+		++uEndPosA;
+		++uEndPosB;
+		}
+	return uEndPosA;
+	}
+
+// Candidates are found in order of start in A, then start in B.
+static unsigned FindCands(DIAGSEEDS_MEMORY &DSM, const ProfPos *PA,
+  unsigned uLengthA, const ProfPos *PB, unsigned uLengthB, unsigned uK)
+	{
+	const unsigned *TupleStart = DSM.TupleStart;
+	const unsigned *TuplesA = DSM.TuplesA;
+	const unsigned *PosB = DSM.PosB;
+	unsigned *DiagEnd = DSM.DiagEnd;
+
+// Diagonal uPosB - uPosA is DiagEnd[uPosB + uLengthA - uPosA], which
+// is the end in A (exclusive) of the last match found on it.
+	memset(DiagEnd, 0, (uLengthA + uLengthB)*sizeof(unsigned));
+
+	DSM.uCandCount = 0;
+	for (unsigned uPosA = 0; uPosA + uK <= uLengthA; ++uPosA)
+		{
+		const unsigned uTuple = TuplesA[uPosA];
+		if (EMPTY == uTuple)
+			continue;
+		const unsigned uFrom = TupleStart[uTuple];
+		const unsigned uTo = TupleStart[uTuple+1];
+		if (uTo - uFrom > MAX_TUPLE_COUNT)
+			continue;
+
+		for (unsigned n = uFrom; n < uTo; ++n)
+			{
+			const unsigned uPosB = PosB[n];
+			unsigned &uDiagEnd = DiagEnd[uPosB + uLengthA - uPosA];
+			if (uPosA < uDiagEnd)
+				continue;
+
+			const unsigned uEndPosA = ExtendMatch(PA, uLengthA, PB, uLengthB,
+			  uPosA + uK - 1, uPosB + uK - 1);
+			uDiagEnd = uEndPosA + 1;
+
+			const unsigned uLength = uEndPosA - uPosA + 1;
+			if (uLength < g_uMinDiagLength)
+				continue;
+
+			AllocCands(DSM, DSM.uCandCount + 1);
+			Diag &d = DSM.Cands[DSM.uCandCount++];
+			d.m_uStartPosA = uPosA;
+			d.m_uStartPosB = uPosB;
+			d.m_uLength = uLength;
+#if	TRACE
+			Log("Cand A %u-%u B %u-%u\n", uPosA, uEndPosA, uPosB,
+			  uPosB + uLength - 1);
+#endif
+			}
+		}
+	return DSM.uCandCount;
+	}
+
+// Prefix-maximum tree over end positions in B, 1-based.
+static void TreeUpdate(unsigned TreeScore[], unsigned TreeIndex[],
+  unsigned uSize, unsigned uPos, unsigned uScore, unsigned uIndex)
+	{
+	for (; uPos <= uSize; uPos += uPos & (0 - uPos))
+		if (uScore > TreeScore[uPos])
+			{
+			TreeScore[uPos] = uScore;
+			TreeIndex[uPos] = uIndex;
+			}
+	}
+
+static unsigned TreeQuery(const unsigned TreeScore[], const unsigned TreeIndex[],
+  unsigned uPos, unsigned *ptruIndex)
+	{
+	unsigned uBest = 0;
+	unsigned uBestIndex = EMPTY;
+	for (; uPos > 0; uPos -= uPos & (0 - uPos))
+		if (TreeScore[uPos] > uBest)
+			{
+			uBest = TreeScore[uPos];
+			uBestIndex = TreeIndex[uPos];
+			}
+	*ptruIndex = uBestIndex;
+	return uBest;
+	}
+
+// Returns the last candidate of the best chain. ChainPrev links back
+// to the first.
+static unsigned ChainCands(DIAGSEEDS_MEMORY &DSM, unsigned uLengthA,
+  unsigned uLengthB)
+	{
+	const unsigned uCandCount = DSM.uCandCount;
+	const Diag *Cands = DSM.Cands;
+	unsigned *ChainScore = DSM.ChainScore;
+	unsigned *ChainPrev = DSM.ChainPrev;
+	unsigned *ByEnd = DSM.ByEnd;
+	unsigned *EndCount = DSM.EndCount;
+	unsigned *TreeScore = DSM.TreeScore;
+	unsigned *TreeIndex = DSM.TreeIndex;
+
+// Candidates in order of end in A (exclusive), by counting sort.
+	memset(EndCount, 0, (uLengthA + 2)*sizeof(unsigned));
+	for (unsigned i = 0; i < uCandCount; ++i)
+		++EndCount[Cands[i].m_uStartPosA + Cands[i].m_uLength + 1];
+	for (unsigned uPos = 0; uPos <= uLengthA; ++uPos)
+		EndCount[uPos+1] += EndCount[uPos];
+	for (unsigned i = 0; i < uCandCount; ++i)
+		ByEnd[EndCount[Cands[i].m_uStartPosA + Cands[i].m_uLength]++] = i;
+
+	memset(TreeScore, 0, (uLengthB + 1)*sizeof(unsigned));
+
+	unsigned uBestScore = 0;
+	unsigned uBestIndex = EMPTY;
+	unsigned uAdded = 0;
+	for (unsigned i = 0; i < uCandCount; ++i)
+		{
+		const Diag &d = Cands[i];
+
+	// Candidates that end in A before this one starts may precede it.
+		while (uAdded < uCandCount)
+			{
+			const unsigned j = ByEnd[uAdded];
+			const Diag &dj = Cands[j];
+			if (dj.m_uStartPosA + dj.m_uLength > d.m_uStartPosA)
+				break;
+			TreeUpdate(TreeScore, TreeIndex, uLengthB,
+			  dj.m_uStartPosB + dj.m_uLength, ChainScore[j], j);
+			++uAdded;
+			}
+
+		unsigned uPrev;
+		const unsigned uPrevScore = TreeQuery(TreeScore, TreeIndex,
+		  d.m_uStartPosB, &uPrev);
+		ChainScore[i] = uPrevScore + d.m_uLength;
+		ChainPrev[i] = uPrev;
+		if (ChainScore[i] > uBestScore)
+			{
+			uBestScore = ChainScore[i];
+			uBestIndex = i;
+			}
+		}
+	return uBestIndex;
+	}
+
+// DiagList has room for MAX_DIAGS. If the chain is longer, the
+// shortest diagonals are left out, which keeps it co-linear.
+static void ChainToDiagList(const DIAGSEEDS_MEMORY &DSM, unsigned uLast,
+  bool bSwap, DiagList &DL)
+	{
+	const Diag *Cands = DSM.Cands;
+	const unsigned *ChainPrev = DSM.ChainPrev;
+
+	unsigned uChainCount = 0;
+	unsigned uMinLength = 0;
+	for (unsigned i = uLast; EMPTY != i; i = ChainPrev[i])
+		++uChainCount;
+	while (uChainCount > MAX_DIAGS)
+		{
+		++uMinLength;
+		uChainCount = 0;
+		for (unsigned i = uLast; EMPTY != i; i = ChainPrev[i])
+			if (Cands[i].m_uLength > uMinLength)
+				++uChainCount;
+		}
+
+	for (unsigned i = uLast; EMPTY != i; i = ChainPrev[i])
+		{
+		const Diag &d = Cands[i];
+		if (d.m_uLength <= uMinLength)
+			continue;
+		if (bSwap)
+			DL.Add(d.m_uStartPosB, d.m_uStartPosA, d.m_uLength);
+		else
+			DL.Add(d.m_uStartPosA, d.m_uStartPosB, d.m_uLength);
+		}
+	}
+
+void FindDiagsSeeds(const ProfPos *PX, unsigned uLengthX, const ProfPos *PY,
+  unsigned uLengthY, unsigned uK, unsigned uTupleCount, TUPLE_FN GetTuple,
+  DiagList &DL)
+	{
+	DL.Clear();
+
+// Set A to shorter profile, B to longer
+	const ProfPos *PA;
+	const ProfPos *PB;
+	unsigned uLengthA;
+	unsigned uLengthB;
+	bool bSwap;
+	if (uLengthX < uLengthY)
+		{
+		bSwap = false;
+		PA = PX;
+		PB = PY;
+		uLengthA = uLengthX;
+		uLengthB = uLengthY;
+		}
+	else
+		{
+		bSwap = true;
+		PA = PY;
+		PB = PX;
+		uLengthA = uLengthY;
+		uLengthB = uLengthX;
+		}
+
+	if (uLengthA < uK)
+		Quit("FindDiagsSeeds: profile too short");
+
+	DIAGSEEDS_MEMORY &DSM = GetDPWorkspace()->DiagSeedsMem;
+	AllocSeeds(DSM, uTupleCount, uLengthA + uLengthB + 2);
+
+	GetTuples(PA, uLengthA, uK, GetTuple, DSM.TuplesA);
+	GetTuples(PB, uLengthB, uK, GetTuple, DSM.TuplesB);
+	IndexTuples(DSM, uTupleCount, uLengthB - uK + 1);
+
+	const unsigned uCandCount = FindCands(DSM, PA, uLengthA, PB, uLengthB, uK);
+	if (0 == uCandCount)
+		return;
+
+	const unsigned uLast = ChainCands(DSM, uLengthA, uLengthB);
+	ChainToDiagList(DSM, uLast, bSwap, DL);
+
+#if	TRACE
+	Log("FindDiagsSeeds: %u candidates, %u in chain\n", uCandCount,
+	  DL.GetCount());
+#endif
+	}
@@ -118,8 +118,6 @@ SCORE DiffObjScore(
 #endif
 
 #if	COMPARE_3_52
-	extern SCORE g_SPScoreLetters;
-	extern SCORE g_SPScoreGaps;
 	SCORE SP1 = ObjScoreSP(msa1);
 	SCORE SPLetters1 = g_SPScoreLetters;
 	SCORE SPGaps1 = g_SPScoreGaps;
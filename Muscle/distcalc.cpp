@@ -10,8 +10,7 @@ void DistCalcDF::Init(const DistFunc &DF)
 
 void DistCalcDF::CalcDistRange(unsigned i, dist_t Dist[]) const
 	{
-	for (unsigned j = 0; j < i; ++j)
-		Dist[j] = m_ptrDF->GetDist(i, j);
+	memcpy(Dist, m_ptrDF->GetRow(i), i*sizeof(dist_t));
 	}
 
 unsigned DistCalcDF::GetCount() const
@@ -1,7 +1,22 @@
 #include "muscle.h"
 #include "distfunc.h"
+#include "mappedfile.h"
 #include <assert.h>
 
+// Header of a distance matrix file (-distmx), followed by the
+// triangle as laid out in memory. Native byte order.
+static const char DISTMX_MAGIC[8] = { 'M', 'U', 'S', 'D', 'I', 'S', 'T', '1' };
+
+struct DISTMX_HEADER
+	{
+	char Magic[8];
+	unsigned uCount;
+	unsigned uKey;
+	unsigned uComplete;
+	unsigned uFloatSize;
+	unsigned uReserved[2];
+	};
+
 DistFunc::DistFunc()
 	{
 	m_Dists = 0;
@@ -9,6 +24,7 @@ DistFunc::DistFunc()
 	m_uCacheCount = 0;
 	m_Names = 0;
 	m_Ids = 0;
+	m_ptrFile = 0;
 	}
 
 DistFunc::~DistFunc()
@@ -18,7 +34,10 @@ DistFunc::~DistFunc()
 		for (unsigned i = 0; i < m_uCount; ++i)
 			free(m_Names[i]);
 		}
-	delete[] m_Dists;
+	if (0 != m_ptrFile)
+		delete m_ptrFile;
+	else
+		delete[] m_Dists;
 	delete[] m_Names;
 	delete[] m_Ids;
 	}
@@ -33,11 +52,19 @@ unsigned DistFunc::GetCount() const
 	return m_uCount;
 	}
 
+const float *DistFunc::GetRow(unsigned uIndex) const
+	{
+	assert(uIndex < m_uCount);
+	return m_Dists + ((size_t) uIndex*(uIndex + 1))/2;
+	}
+
 void DistFunc::SetCount(unsigned uCount)
 	{
 	m_uCount = uCount;
 	if (uCount <= m_uCacheCount)
 		return;
+	if (0 != m_ptrFile)
+		Quit("DistFunc::SetCount(%u), file has %u", uCount, m_uCacheCount);
 	delete[] m_Dists;
 	m_Dists = new float[VectorLength()];
 	m_Names = new char *[m_uCount];
@@ -52,18 +79,74 @@ void DistFunc::SetCount(unsigned uCount)
 void DistFunc::SetDist(unsigned uIndex1, unsigned uIndex2, float dDist)
 	{
 	m_Dists[VectorIndex(uIndex1, uIndex2)] = dDist;
-	m_Dists[VectorIndex(uIndex2, uIndex1)] = dDist;
 	}
 
-unsigned DistFunc::VectorIndex(unsigned uIndex1, unsigned uIndex2) const
+size_t DistFunc::VectorIndex(unsigned uIndex1, unsigned uIndex2) const
 	{
 	assert(uIndex1 < m_uCount && uIndex2 < m_uCount);
-	return uIndex1*m_uCount + uIndex2;
+	if (uIndex1 >= uIndex2)
+		return ((size_t) uIndex1*(uIndex1 + 1))/2 + uIndex2;
+	return ((size_t) uIndex2*(uIndex2 + 1))/2 + uIndex1;
+	}
+
+size_t DistFunc::VectorLength() const
+	{
+	return ((size_t) m_uCount*(m_uCount + 1))/2;
+	}
+
+bool DistFunc::MapFile(const char *FileName, unsigned uCount, unsigned uKey)
+	{
+	if (0 != m_uCacheCount)
+		Quit("DistFunc::MapFile, already allocated");
+
+// Check an existing file before mapping, which may resize it.
+	DISTMX_HEADER Header;
+	bool bReuse = false;
+	FILE *f = fopen(FileName, "rb");
+	if (0 != f)
+		{
+		const size_t uRead = fread(&Header, 1, sizeof(Header), f);
+		fclose(f);
+		if (uRead > 0 && (uRead < sizeof(Header) ||
+		  0 != memcmp(Header.Magic, DISTMX_MAGIC, sizeof(DISTMX_MAGIC))))
+			Quit("%s exists and is not a distance matrix file", FileName);
+		bReuse = (uRead == sizeof(Header) && Header.uCount == uCount &&
+		  Header.uKey == uKey && Header.uFloatSize == sizeof(float) &&
+		  0 != Header.uComplete);
+		}
+
+	m_uCount = uCount;
+	m_uCacheCount = uCount;
+	m_ptrFile = new MappedFile;
+	m_ptrFile->Open(FileName, sizeof(DISTMX_HEADER) + VectorLength()*sizeof(float));
+	DISTMX_HEADER *ptrHeader = (DISTMX_HEADER *) m_ptrFile->GetData();
+	m_Dists = (float *) (ptrHeader + 1);
+
+	m_Names = new char *[m_uCount];
+	m_Ids = new unsigned[m_uCount];
+	memset(m_Names, 0, m_uCount*sizeof(char *));
+	memset(m_Ids, 0xff, m_uCount*sizeof(unsigned));
+	if (bReuse)
+		return true;
+
+// Every pair i > j will be set, so only the diagonal is cleared
+// rather than touching every page of the file.
+	memset(ptrHeader, 0, sizeof(DISTMX_HEADER));
+	memcpy(ptrHeader->Magic, DISTMX_MAGIC, sizeof(DISTMX_MAGIC));
+	ptrHeader->uCount = uCount;
+	ptrHeader->uKey = uKey;
+	ptrHeader->uFloatSize = sizeof(float);
+	for (unsigned i = 0; i < m_uCount; ++i)
+		m_Dists[VectorIndex(i, i)] = 0;
+	return false;
 	}
 
-unsigned DistFunc::VectorLength() const
+void DistFunc::SetComplete()
 	{
-	return m_uCount*m_uCount;
+	if (0 == m_ptrFile)
+		return;
+	DISTMX_HEADER *ptrHeader = (DISTMX_HEADER *) m_ptrFile->GetData();
+	ptrHeader->uComplete = 1;
 	}
 
 void DistFunc::SetName(unsigned uIndex, const char szName[])
@@ -111,3 +194,23 @@ void DistFunc::LogMe() const
 		Log("\n");
 		}
 	}
+
+float *AllocDistTriangle(size_t uSize, MappedFile **ptrptrFile)
+	{
+	*ptrptrFile = 0;
+	if (0 == g_pstrDistMxFileName || 0 == uSize)
+		return new float[uSize];
+
+	MappedFile *ptrFile = new MappedFile;
+	ptrFile->OpenTemp(g_pstrDistMxFileName, uSize*sizeof(float));
+	*ptrptrFile = ptrFile;
+	return (float *) ptrFile->GetData();
+	}
+
+void FreeDistTriangle(float *Dists, MappedFile *ptrFile)
+	{
+	if (0 != ptrFile)
+		delete ptrFile;
+	else
+		delete[] Dists;
+	}
@@ -1,6 +1,14 @@
 #ifndef DistFunc_h
 #define DistFunc_h
 
+class MappedFile;
+
+// Symmetric matrix of distances between N objects, stored as the
+// lower triangle including the diagonal, row by row, so that the
+// distances from i to 0 .. i-1 are contiguous (GetRow).
+// The triangle is on the heap, or in a memory-mapped file (MapFile)
+// so that very large matrices are bounded by disk rather than RAM,
+// and can be computed once and reused by later runs.
 class DistFunc
 	{
 public:
@@ -19,11 +27,22 @@ public:
 	virtual float GetDist(unsigned uIndex1, unsigned uIndex2) const;
 	virtual unsigned GetCount() const;
 
+// Distances from uIndex to 0 .. uIndex-1.
+	const float *GetRow(unsigned uIndex) const;
+
+// Keep the distances for uCount objects in FileName. uKey identifies
+// the data they are computed from. Returns true if the file already
+// holds a complete matrix with the same count and key, which can be
+// used as it is; otherwise the distances must be set, followed by a
+// call to SetComplete.
+	bool MapFile(const char *FileName, unsigned uCount, unsigned uKey);
+	void SetComplete();
+
 	void LogMe() const;
 
 protected:
-	unsigned VectorIndex(unsigned uIndex, unsigned uIndex2) const;
-	unsigned VectorLength() const;
+	size_t VectorIndex(unsigned uIndex, unsigned uIndex2) const;
+	size_t VectorLength() const;
 
 private:
 	unsigned m_uCount;
@@ -31,6 +50,14 @@ private:
 	float *m_Dists;
 	char **m_Names;
 	unsigned *m_Ids;
+	MappedFile *m_ptrFile;
 	};
 
+// Working triangle of uSize distances for the clustering code
+// (UPGMA2, Clust). With -distmx it is in a scratch file next to the
+// matrix file and *ptrptrFile is set, otherwise it is on the heap
+// and *ptrptrFile is 0.
+float *AllocDistTriangle(size_t uSize, MappedFile **ptrptrFile);
+void FreeDistTriangle(float *Dists, MappedFile *ptrFile);
+
 #endif	// DistFunc_h
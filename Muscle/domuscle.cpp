@@ -175,6 +175,7 @@ void DoMuscle()
 	else
 		ProgressiveAlign(v, GuideTree, msa);
 	SetCurrentAlignment(msa);
+	CheckpointAlignment(msa);
 
 	if (0 != g_pstrComputeWeightsFileName)
 		{
@@ -207,6 +208,7 @@ void DoMuscle()
 			}
 		else
 			RefineTree(msa, GuideTree);
+		CheckpointAlignment(msa);
 
 		const char *Tree2 = ValueOpt("Tree2");
 		if (0 != Tree2)
@@ -222,7 +224,8 @@ void DoMuscle()
 	if (g_bAnchors)
 		RefineVert(msa, GuideTree, g_uMaxIters - 2);
 	else
-		RefineHoriz(msa, GuideTree, g_uMaxIters - 2, false, false);
+		RefineHoriz(msa, GuideTree, g_uMaxIters - 2, false, false, true);
+	UseBestAlignment(msa);
 
 #if	0
 // Refining by subfamilies is disabled as it didn't give better
@@ -260,6 +263,8 @@ void Run()
 		}
 	else if (g_bProfDB)
 		ProfDB();
+	else if (g_bProfSearch)
+		ProfSearch();
 	else if (g_bSW)
 		Local();
 	else if (0 != g_pstrSPFileName)
@@ -270,6 +275,8 @@ void Run()
 		PPScore();
 	else if (g_bPAS)
 		ProgAlignSubFams();
+	else if (g_bTestNWLinear)
+		TestNWLinear();
 	else
 		DoMuscle();
 
@@ -295,5 +302,7 @@ void Run()
 #endif
 
 	ListDiagSavings();
+	ListSPStats();
+	ListNWLinearStats();
 	Log("Finished %s\n", GetTimeAsStr());
 	}
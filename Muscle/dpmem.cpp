@@ -0,0 +1,90 @@
+#include "muscle.h"
+
+/***
+Row buffers of GlobalAlignSP, SPN, LE and SS.
+
+All buffers of a DP_MEMORY are carved from one block, each aligned to
+DP_ALIGN bytes. Data per position and letter are strided arrays rather
+than arrays of pointers to 20-element rows:
+
+	SortOrderA[i*uAlphaSize + n]
+	FreqsA[i*uAlphaSize + n]
+	ScoreMxB[uLetter*uLength + j]
+
+so a row of ScoreMxB is contiguous and the kernels step through it
+with a fixed stride. SortOrderA and FreqsA hold (letter, count) pairs
+of position i, from ProfPos::m_uLetters, ended by a zero count if
+there are fewer than uAlphaSize.
+
+A DP_MEMORY belongs to a thread's DPWorkspace and is kept from one
+call to the next. When a longer profile comes along the block is
+replaced by one at least twice as long, so a run whose profiles grow
+steadily reallocates a logarithmic number of times.
+***/
+
+static const size_t DP_ALIGN = 64;
+
+template<class T> static void Carve(char *Base, size_t &uOffset, T *&Ptr,
+  size_t uCount)
+	{
+	uOffset = (uOffset + DP_ALIGN - 1) & ~(DP_ALIGN - 1);
+	Ptr = (0 == Base) ? 0 : (T *) (Base + uOffset);
+	uOffset += uCount*sizeof(T);
+	}
+
+// Set the buffer pointers for a block at Base, or only compute the
+// size if Base is 0. Returns the size in bytes.
+static size_t Layout(DP_MEMORY &DPM, char *Base, unsigned uLength,
+  unsigned uAlphaSize)
+	{
+	size_t uOffset = 0;
+	Carve(Base, uOffset, DPM.GapOpenA, uLength);
+	Carve(Base, uOffset, DPM.GapOpenB, uLength);
+	Carve(Base, uOffset, DPM.GapCloseA, uLength);
+	Carve(Base, uOffset, DPM.GapCloseB, uLength);
+	Carve(Base, uOffset, DPM.MPrev, uLength);
+	Carve(Base, uOffset, DPM.MCurr, uLength);
+	Carve(Base, uOffset, DPM.MWork, uLength);
+	Carve(Base, uOffset, DPM.DPrev, uLength);
+	Carve(Base, uOffset, DPM.DCurr, uLength);
+	Carve(Base, uOffset, DPM.DWork, uLength);
+	Carve(Base, uOffset, DPM.MxRowA, uLength);
+	Carve(Base, uOffset, DPM.LettersB, uLength);
+	Carve(Base, uOffset, DPM.OccA, uLength);
+	Carve(Base, uOffset, DPM.OccB, uLength);
+	Carve(Base, uOffset, DPM.uDeletePos, uLength);
+	Carve(Base, uOffset, DPM.TBRow, uLength);
+	Carve(Base, uOffset, DPM.SortOrderA, (size_t) uLength*uAlphaSize);
+	Carve(Base, uOffset, DPM.FreqsA, (size_t) uLength*uAlphaSize);
+	Carve(Base, uOffset, DPM.ScoreMxB, (size_t) uLength*uAlphaSize);
+	return uOffset;
+	}
+
+void AllocDPMem(DP_MEMORY &DPM, unsigned uLengthA, unsigned uLengthB,
+  unsigned uAlphaSize)
+	{
+// Max prefix length
+	unsigned uLength = (uLengthA > uLengthB ? uLengthA : uLengthB) + 1;
+	if (uLength <= DPM.uLength && uAlphaSize == DPM.uAlphaSize)
+		return;
+
+	if (uLength < 2*DPM.uLength)
+		uLength = 2*DPM.uLength;
+	uLength += 32 - uLength%32;
+
+	const size_t uSize = Layout(DPM, 0, uLength, uAlphaSize);
+	delete[] DPM.Slab;
+	DPM.Slab = new char[uSize + DP_ALIGN];
+	char *Base = DPM.Slab + (DP_ALIGN - (size_t) DPM.Slab%DP_ALIGN)%DP_ALIGN;
+	Layout(DPM, Base, uLength, uAlphaSize);
+
+	DPM.uLength = uLength;
+	DPM.uAlphaSize = uAlphaSize;
+	}
+
+void FreeDPMem(DP_MEMORY &DPM)
+	{
+	delete[] DPM.Slab;
+	FreePackedTB(DPM.TB);
+	memset(&DPM, 0, sizeof(DPM));
+	}
@@ -57,6 +57,8 @@ c(DISTANCE, Kmer4_6)
 c(DISTANCE, PctIdKimura)
 c(DISTANCE, PctIdLog)
 c(DISTANCE, PWKimura)
+c(DISTANCE, MinHash20_4)
+c(DISTANCE, PWKimuraFast)
 e(DISTANCE)
 
 s(PPSCORE)
@@ -3,6 +3,7 @@
 #include <ctype.h>
 #include "msa.h"
 #include "textfile.h"
+#include "fastamap.h"
 
 const unsigned FASTA_BLOCK = 60;
 
@@ -10,6 +11,24 @@ void MSA::FromFASTAFile(TextFile &File)
 	{
 	Clear();
 
+	FastaMap Map;
+	if (Map.Open(File))
+		{
+		FASTA_RECORD Rec;
+		while (Map.GetRecord(Rec))
+			{
+			char *SeqData = new char[Rec.uDataBytes];
+			const unsigned uSeqLength = FastaMap::GetLetters(Rec, SeqData, false);
+			if (0 == uSeqLength)
+				{
+				delete[] SeqData;
+				continue;
+				}
+			AppendSeq(SeqData, uSeqLength, FastaMap::GetLabel(Rec));
+			}
+		return;
+		}
+
 	FILE *f = File.GetStdioFile();
 	
 	unsigned uSeqCount = 0;
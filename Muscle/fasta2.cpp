@@ -1,4 +1,6 @@
 #include "muscle.h"
+#include "fastamap.h"
+#include "textfile.h"
 #include <stdio.h>
 #include <errno.h>
 
@@ -115,3 +117,129 @@ char *GetFastaSeq(FILE *f, unsigned *ptrSeqLength, char **ptrLabel, bool DeleteG
 	*ptrSeqLength = Pos;
 	return Buffer;
 	}
+
+FastaMap::FastaMap()
+	{
+	m_ptrPos = 0;
+	m_ptrEnd = 0;
+	}
+
+bool FastaMap::Open(TextFile &File)
+	{
+	Close();
+	if (0 == strcmp(File.GetFileName(), "-"))
+		return false;
+
+	FILE *f = File.GetStdioFile();
+	const long lOffset = ftell(f);
+	if (lOffset < 0 || !m_File.OpenRead(File.GetFileName()) ||
+	  (size_t) lOffset >= m_File.GetSize())
+		{
+		m_File.Close();
+		return false;
+		}
+
+// The records now belong to the map, so leave the file at the end
+// as GetFastaSeq would.
+	fseek(f, 0, SEEK_END);
+	const char *ptrData = (const char *) m_File.GetData();
+	m_ptrPos = ptrData + lOffset;
+	m_ptrEnd = ptrData + m_File.GetSize();
+	return true;
+	}
+
+void FastaMap::Close()
+	{
+	m_File.Close();
+	m_ptrPos = 0;
+	m_ptrEnd = 0;
+	}
+
+// GetFastaSeq takes a '>' as the start of a record if the last byte
+// before it that is not ignored as invalid is NL, or if there is no
+// such byte in the sequence data.
+static bool IsRecordStart(const char *Data, const char *ptrGt)
+	{
+	for (const char *p = ptrGt; p > Data; )
+		{
+		const int c = (unsigned char) *--p;
+		if (NL == c)
+			return true;
+		if (isspace(c) || IsGapChar(c) || isalpha(c))
+			return false;
+		}
+	return true;
+	}
+
+bool FastaMap::GetRecord(FASTA_RECORD &Rec)
+	{
+	if (m_ptrPos == m_ptrEnd)
+		return false;
+	if ('>' != *m_ptrPos)
+		Quit("Invalid file format, expected '>' to start FASTA label");
+
+	const char *Label = m_ptrPos + 1;
+	const char *EndOfLabel = (const char *) memchr(Label, NL, m_ptrEnd - Label);
+	if (0 == EndOfLabel)
+		Quit("End-of-file or input error in FASTA label");
+
+	const char *Data = EndOfLabel + 1;
+	const char *p = Data;
+	for (;;)
+		{
+		p = (const char *) memchr(p, '>', m_ptrEnd - p);
+		if (0 == p)
+			{
+			p = m_ptrEnd;
+			break;
+			}
+		if (IsRecordStart(Data, p))
+			break;
+		Quit("Unexpected '>' in FASTA sequence data");
+		}
+
+	Rec.Label = Label;
+	Rec.uLabelLength = (unsigned) (EndOfLabel - Label);
+	Rec.Data = Data;
+	Rec.uDataBytes = (size_t) (p - Data);
+	m_ptrPos = p;
+	return true;
+	}
+
+unsigned FastaMap::GetLetters(const FASTA_RECORD &Rec, char *Buffer,
+  bool DeleteGaps)
+	{
+	unsigned Pos = 0;
+	const char *Data = Rec.Data;
+	for (size_t i = 0; i < Rec.uDataBytes; ++i)
+		{
+		const int c = (unsigned char) Data[i];
+		if (isupper(c))
+			Buffer[Pos++] = (char) c;
+		else if (isspace(c))
+			;
+		else if (IsGapChar(c))
+			{
+			if (!DeleteGaps)
+				Buffer[Pos++] = (char) c;
+			}
+		else if (isalpha(c))
+			Buffer[Pos++] = (char) toupper(c);
+		else if (isprint(c))
+			Warning("Invalid character '%c' in FASTA sequence data, ignored", c);
+		else
+			Warning("Invalid byte hex %02x in FASTA sequence data, ignored", (unsigned char) c);
+		}
+	return Pos;
+	}
+
+char *FastaMap::GetLabel(const FASTA_RECORD &Rec)
+	{
+	char *Label = new char[Rec.uLabelLength + 1];
+	unsigned Pos = 0;
+	for (unsigned i = 0; i < Rec.uLabelLength; ++i)
+		if (CR != Rec.Label[i])
+			Label[Pos++] = Rec.Label[i];
+	Label[Pos] = 0;
+	return Label;
+	}
@@ -0,0 +1,54 @@
+#ifndef fastamap_h
+#define fastamap_h
+
+#include "mappedfile.h"
+
+class TextFile;
+
+// A FASTA record in a FastaMap. Label and Data point into the
+// mapping: Label is not nul-terminated and may contain CRs, Data is
+// the sequence text as in the file, including line breaks.
+struct FASTA_RECORD
+	{
+	const char *Label;
+	unsigned uLabelLength;
+	const char *Data;
+	size_t uDataBytes;
+	};
+
+// Reads the records of a FASTA file in place from a read-only
+// mapping, rather than a character at a time through stdio as
+// GetFastaSeq does. Record boundaries are found with memchr, and
+// letters are copied once, by GetLetters, into the caller's buffer.
+// The rules for labels, letters and errors are those of GetFastaSeq.
+class FastaMap
+	{
+public:
+	FastaMap();
+
+// Map the rest of File. Returns false if it can't be mapped, e.g.
+// if it is standard input; then GetFastaSeq must be used instead.
+	bool Open(TextFile &File);
+	void Close();
+
+// Next record, false at end of file.
+	bool GetRecord(FASTA_RECORD &Rec);
+
+// Letters of a record, as GetFastaSeq returns them. Buffer must have
+// room for Rec.uDataBytes chars. Returns the number of letters.
+	static unsigned GetLetters(const FASTA_RECORD &Rec, char *Buffer,
+	  bool DeleteGaps);
+
+// Label as a new nul-terminated string, to be deleted with delete[].
+	static char *GetLabel(const FASTA_RECORD &Rec);
+
+private:
+	FastaMap(const FastaMap &);
+	FastaMap &operator=(const FastaMap &);
+
+	MappedFile m_File;
+	const char *m_ptrPos;
+	const char *m_ptrEnd;
+	};
+
+#endif	// fastamap_h
@@ -2,10 +2,46 @@
 #include "distfunc.h"
 #include "seqvect.h"
 
-void DistUnaligned(const SeqVect &v, DISTANCE DistMethod, DistFunc &DF)
+// FNV-1a hash of the bytes of a block.
+static unsigned HashBytes(unsigned uHash, const void *ptrData, unsigned uBytes)
+	{
+	const byte *Bytes = (const byte *) ptrData;
+	for (unsigned i = 0; i < uBytes; ++i)
+		uHash = (uHash ^ Bytes[i])*16777619u;
+	return uHash;
+	}
+
+// Key of a -distmx file: the measure, with its parameters, and the
+// names and letters of the sequences in order.
+static unsigned GetDistMxKey(const SeqVect &v, DISTANCE DistMethod)
 	{
+	unsigned uHash = 2166136261u;
+	const unsigned uMethod = (unsigned) DistMethod;
+	const unsigned uAlpha = (unsigned) g_Alpha;
+	uHash = HashBytes(uHash, &uMethod, sizeof(uMethod));
+	uHash = HashBytes(uHash, &uAlpha, sizeof(uAlpha));
+	if (DISTANCE_MinHash20_4 == DistMethod)
+		uHash = HashBytes(uHash, &g_uSketchSize, sizeof(g_uSketchSize));
+
 	const unsigned uSeqCount = v.Length();
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+		{
+		const Seq &s = *(v[uSeqIndex]);
+		const char *ptrName = s.GetName();
+		uHash = HashBytes(uHash, ptrName, (unsigned) strlen(ptrName) + 1);
+		const unsigned uLength = s.Length();
+		for (unsigned uCol = 0; uCol < uLength; ++uCol)
+			{
+			const char c = s.GetChar(uCol);
+			uHash = HashBytes(uHash, &c, 1);
+			}
+		uHash = HashBytes(uHash, &uLength, sizeof(uLength));
+		}
+	return uHash;
+	}
 
+static void CalcDistUnaligned(const SeqVect &v, DISTANCE DistMethod, DistFunc &DF)
+	{
 	switch (DistMethod)
 		{
 	case DISTANCE_Kmer6_6:
@@ -32,9 +68,34 @@ void DistUnaligned(const SeqVect &v, DISTANCE DistMethod, DistFunc &DF)
 		DistPWKimura(v, DF);
 		break;
 
+	case DISTANCE_MinHash20_4:
+		DistMinHash20_4(v, DF);
+		break;
+
+	case DISTANCE_PWKimuraFast:
+		DistPWKimuraFast(v, DF);
+		break;
+
 	default:
 		Quit("DistUnaligned, unsupported distance method %d", DistMethod);
 		}
+	}
+
+void DistUnaligned(const SeqVect &v, DISTANCE DistMethod, DistFunc &DF)
+	{
+	const unsigned uSeqCount = v.Length();
+
+// With -distmx the matrix is kept in a file, and a matrix left by an
+// earlier run on the same sequences is used instead of recomputing.
+	bool bReuse = false;
+	if (0 != g_pstrDistMxFileName)
+		bReuse = DF.MapFile(g_pstrDistMxFileName, uSeqCount,
+		  GetDistMxKey(v, DistMethod));
+
+	if (bReuse)
+		Log("Distance matrix read from %s\n", g_pstrDistMxFileName);
+	else
+		CalcDistUnaligned(v, DistMethod, DF);
 
 //	const char **SeqNames = (const char **) malloc(uSeqCount*sizeof(char *));
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
@@ -47,4 +108,5 @@ void DistUnaligned(const SeqVect &v, DISTANCE DistMethod, DistFunc &DF)
 		DF.SetName(uSeqIndex, ptrName);
 		DF.SetId(uSeqIndex, uId);
 		}
+	DF.SetComplete();
 	}
@@ -1,6 +1,7 @@
 #include "muscle.h"
 #include "distfunc.h"
 #include "seqvect.h"
+#include "kmerdist.h"
 #include <math.h>
 
 #define	MIN(x, y)	((x) < (y) ? (x) : (y))
@@ -42,29 +43,60 @@ static void SetKmerBitVector(const Seq &s, byte Bits[])
 		}
 	}
 
+// Number of bits set in each byte value.
+static byte BitCount[256];
+static bool InitBitCount()
+	{
+	for (unsigned i = 0; i < 256; ++i)
+		{
+		byte n = 0;
+		for (unsigned b = i; b != 0; b >>= 1)
+			n += (byte) (b & 1);
+		BitCount[i] = n;
+		}
+	return true;
+	}
+static bool bBitCountInit = InitBitCount();
+
 static unsigned CommonBitCount(const byte Bits1[], const byte Bits2[])
 	{
 	const byte * const p1end = Bits1 + 1000;
 	const byte *p2 = Bits2;
 
 	unsigned uCount = 0;
+// This is the count the original bit-by-bit loop over the word
+// *p1 | (*p2 << 8) produced: a bit is counted where it is set in
+// either byte, and again where it is set in the second byte.
 	for (const byte *p1 = Bits1; p1 != p1end; ++p1)
 		{
-	// Here is a cute trick for efficiently counting the
-	// bits common between two bytes by combining them into
-	// a single word.
-		unsigned b = *p1 | (*p2 << 8);
-		while (b != 0)
-			{
-			if (b & 0x101)
-				++uCount;
-			b >>= 1;
-			}
+		uCount += BitCount[*p1 | *p2] + BitCount[*p2];
 		++p2;
 		}
 	return uCount;
 	}
 
+struct KBIT_DIST
+	{
+	const SeqVect *ptrSeqVect;
+	const byte *BitVector;
+	};
+
+static float KbitDist(unsigned uSeqIndex1, unsigned uSeqIndex2, void *ptrUser)
+	{
+	const KBIT_DIST &KD = *(const KBIT_DIST *) ptrUser;
+	const SeqVect &v = *KD.ptrSeqVect;
+
+	const byte *Bits1 = KD.BitVector + uSeqIndex1*1000;
+	const byte *Bits2 = KD.BitVector + uSeqIndex2*1000;
+	const unsigned uLength1 = v[uSeqIndex1]->Length();
+	const unsigned uLength2 = v[uSeqIndex2]->Length();
+	const float fCount = (float) CommonBitCount(Bits1, Bits2);
+
+// Distance measure = K / min(L1, L2)
+// K is number of distinct kmers that are found in both sequences
+	return fCount / MIN(uLength1, uLength2);
+	}
+
 void DistKbit20_3(const SeqVect &v, DistFunc &DF)
 	{
 	const unsigned uSeqCount = v.Length();
@@ -82,27 +114,12 @@ void DistKbit20_3(const SeqVect &v, DistFunc &DF)
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		SetKmerBitVector(*v[uSeqIndex], BitVector + uSeqIndex*1000);
 
-	unsigned uDone = 0;
-	const unsigned uTotal = (uSeqCount*(uSeqCount - 1))/2;
-	for (unsigned uSeqIndex1 = 0; uSeqIndex1 < uSeqCount; ++uSeqIndex1)
-		{
-		const byte *Bits1 = BitVector + uSeqIndex1*1000;
-		const unsigned uLength1 = v[uSeqIndex1]->Length();
-		for (unsigned uSeqIndex2 = 0; uSeqIndex2 < uSeqIndex1; ++uSeqIndex2)
-			{
-			const byte *Bits2 = BitVector + uSeqIndex2*1000;
-			const unsigned uLength2 = v[uSeqIndex2]->Length();
-			const float fCount = (float) CommonBitCount(Bits1, Bits2);
-
-		// Distance measure = K / min(L1, L2)
-		// K is number of distinct kmers that are found in both sequences
-			const float fDist = fCount / MIN(uLength1, uLength2);
-			DF.SetDist(uSeqIndex1, uSeqIndex2, fDist);
-			if (uDone%10000 == 0)
-				Progress(uDone, uTotal);
-			++uDone;
-			}
-		}
+// The pairs are computed in cache-sized blocks spread over the
+// threads, see DistPairBlocks.
+	KBIT_DIST KD;
+	KD.ptrSeqVect = &v;
+	KD.BitVector = BitVector;
+	DistPairBlocks(uSeqCount, 1000, KbitDist, &KD, DF);
 	ProgressStepsDone();
 
 	delete[] BitVector;
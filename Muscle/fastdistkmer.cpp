@@ -3,6 +3,7 @@
 #include "seqvect.h"
 #include "seq.h"
 #include "distfunc.h"
+#include "kmerdist.h"
 #include <math.h>
 
 #define TRACE	0
@@ -76,12 +77,12 @@ const char *KmerToStr(unsigned Kmer)
 	return s;
 	}
 
-void CountKmers(const byte s[], unsigned uSeqLength, byte KmerCounts[])
+// Append the k-mers of a sequence to Kmers[], return the number
+// of k-mers. A sequence shorter than K has none.
+static unsigned GetKmers(const byte s[], unsigned uSeqLength, unsigned Kmers[])
 	{
-#if	TRACE
-	Log("CountKmers\n");
-#endif
-	memset(KmerCounts, 0, TABLE_SIZE*sizeof(byte));
+	if (uSeqLength < K)
+		return 0;
 
 	const byte *ptrKmerStart = s;
 	const byte *ptrKmerEnd = s + 4;
@@ -94,6 +95,7 @@ void CountKmers(const byte s[], unsigned uSeqLength, byte KmerCounts[])
 
 	unsigned Kmer = c3 + c2 + c1 + c0;
 
+	unsigned uKmerCount = 0;
 	for (;;)
 		{
 		assert(Kmer < TABLE_SIZE);
@@ -101,50 +103,7 @@ void CountKmers(const byte s[], unsigned uSeqLength, byte KmerCounts[])
 #if	TRACE
 		Log("Kmer=%d=%s\n", Kmer, KmerToStr(Kmer));
 #endif
-		++(KmerCounts[Kmer]);
-
-		if (ptrKmerEnd == ptrSeqEnd)
-			break;
-
-	// Compute k-mer as function of previous k-mer:
-	// 1. Subtract first letter from previous k-mer.
-	// 2. Multiply by N.
-	// 3. Add next letter.
-		c3 = (*ptrKmerStart++) * N_3;
-		Kmer = (Kmer - c3)*N;
-		Kmer += *ptrKmerEnd++;
-		}
-	}
-
-unsigned CommonKmerCount(const byte Seq[], unsigned uSeqLength,
-  const byte KmerCounts1[], const byte Seq2[], unsigned uSeqLength2)
-	{
-	byte KmerCounts2[TABLE_SIZE];
-	CountKmers(Seq2, uSeqLength2, KmerCounts2);
-
-	const byte *ptrKmerStart = Seq;
-	const byte *ptrKmerEnd = Seq + 4;
-	const byte *ptrSeqEnd = Seq + uSeqLength;
-
-	unsigned c3 = Seq[0]*N_3;
-	unsigned c2 = Seq[1]*N_2;
-	unsigned c1 = Seq[2]*N;
-	unsigned c0 = Seq[3];
-
-	unsigned Kmer = c3 + c2 + c1 + c0;
-
-	unsigned uCommonCount = 0;
-	for (;;)
-		{
-		assert(Kmer < TABLE_SIZE);
-
-		const byte Count1 = KmerCounts1[Kmer];
-		const byte Count2 = KmerCounts2[Kmer];
-
-		uCommonCount += MIN(Count1, Count2);
-
-	// Hack so we don't double-count
-		KmerCounts2[Kmer] = 0;
+		Kmers[uKmerCount++] = Kmer;
 
 		if (ptrKmerEnd == ptrSeqEnd)
 			break;
@@ -157,7 +116,7 @@ unsigned CommonKmerCount(const byte Seq[], unsigned uSeqLength,
 		Kmer = (Kmer - c3)*N;
 		Kmer += *ptrKmerEnd++;
 		}
-	return uCommonCount;
+	return uKmerCount;
 	}
 
 static void SeqToLetters(const Seq &s, byte Letters[])
@@ -175,73 +134,77 @@ static void SeqToLetters(const Seq &s, byte Letters[])
 		}
 	}
 
-void FastDistKmer(const SeqVect &v, DistFunc &DF)
+struct FAST_KMER_DIST
+	{
+	const SeqVect *ptrSeqVect;
+	};
+
+static float KmerDist(unsigned uSeqIndex1, unsigned uSeqIndex2,
+  unsigned uCommonKmerCount, void *ptrUser)
+	{
+	const FAST_KMER_DIST &KD = *(const FAST_KMER_DIST *) ptrUser;
+	const SeqVect &v = *KD.ptrSeqVect;
+
+	const unsigned uSeqLength1 = v.GetSeq(uSeqIndex1).Length();
+	const unsigned uSeqLength2 = v.GetSeq(uSeqIndex2).Length();
+
+	unsigned uMinLength = MIN(uSeqLength1, uSeqLength2);
+	double F = (double) uCommonKmerCount / (uMinLength - K + 1);
+	if (0.0 == F)
+		F = 0.01;
+#if	TRACE
 	{
-	byte KmerCounts[TABLE_SIZE];
+	double Y = log(0.02 + F);
+	double EstimatedPctId = Y/4.12 + 0.995;
+	double dKimuraDist = KimuraDist(EstimatedPctId);
+	Log("CommonCount=%u, MinLength=%u, F=%6.4f Y=%6.4f, %%id=%6.4f, KimuraDist=%8.4f\n",
+	  uCommonKmerCount, uMinLength, F, Y, EstimatedPctId, dKimuraDist);
+	}
+#endif
+	return (float) (1 - F);
+	}
 
+// Each sequence is reduced once to a sparse signature of its
+// distinct k-mers with counts (counted in bytes, so modulo 256),
+// rather than counting every pair into a 160,000-entry table. The
+// common counts are computed in cache-sized blocks spread over the
+// threads, see DistKmerSigs.
+void FastDistKmer(const SeqVect &v, DistFunc &DF)
+	{
 	const unsigned uSeqCount = v.GetSeqCount();
 
 	DF.SetCount(uSeqCount);
 	if (0 == uSeqCount)
 		return;
 
-// Initialize distance matrix to zero
-	for (unsigned uSeq1 = 0; uSeq1 < uSeqCount; ++uSeq1)
-		{
-		DF.SetDist(uSeq1, uSeq1, 0);
-		for (unsigned uSeq2 = 0; uSeq2 < uSeq1; ++uSeq2)
-			DF.SetDist(uSeq1, uSeq2, 0);
-		}
-
 	unsigned uMaxLength = 0;
+	unsigned uTotalLength = 0;
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		{
 		const Seq &s = v.GetSeq(uSeqIndex);
 		unsigned uSeqLength = s.Length();
 		if (uSeqLength > uMaxLength)
 			uMaxLength = uSeqLength;
+		uTotalLength += uSeqLength;
 		}
-	if (0 == uMaxLength)
-		return;
 
-	byte *Seq1Letters = new byte[uMaxLength];
-	byte *Seq2Letters = new byte[uMaxLength];
+	byte *Letters = new byte[uMaxLength + 1];
+	unsigned *Kmers = new unsigned[uMaxLength + 1];
 
-	for (unsigned uSeqIndex1 = 0; uSeqIndex1 < uSeqCount - 1; ++uSeqIndex1)
+	FAST_KMER_DIST KD;
+	KD.ptrSeqVect = &v;
+	KMER_SIGS KS;
+	InitKmerSigs(KS, uSeqCount, uTotalLength, TABLE_SIZE, 8);
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		{
-		const Seq &s1 = v.GetSeq(uSeqIndex1);
-		const unsigned uSeqLength1 = s1.Length();
-
-		SeqToLetters(s1, Seq1Letters);
-		CountKmers(Seq1Letters, uSeqLength1, KmerCounts);
-
-		for (unsigned uSeqIndex2 = uSeqIndex1 + 1; uSeqIndex2 < uSeqCount;
-		  ++uSeqIndex2)
-			{
-			const Seq &s2 = v.GetSeq(uSeqIndex2);
-			const unsigned uSeqLength2 = s2.Length();
-
-			SeqToLetters(s2, Seq2Letters);
-
-			unsigned uCommonKmerCount = CommonKmerCount(Seq1Letters, uSeqLength1,
-			  KmerCounts, Seq2Letters, uSeqLength2);
-
-			unsigned uMinLength = MIN(uSeqLength1, uSeqLength2);
-			double F = (double) uCommonKmerCount / (uMinLength - K + 1);
-			if (0.0 == F)
-				F = 0.01;
-			double Y = log(0.02 + F);
-			double EstimatedPctId = Y/4.12 + 0.995;
-			double KD = KimuraDist(EstimatedPctId);
-//			DF.SetDist(uSeqIndex1, uSeqIndex2, (float) KD);
-			DF.SetDist(uSeqIndex1, uSeqIndex2, (float) (1 - F));
-#if	TRACE
-			Log("CommonCount=%u, MinLength=%u, F=%6.4f Y=%6.4f, %%id=%6.4f, KimuraDist=%8.4f\n",
-			  uCommonKmerCount, uMinLength, F, Y, EstimatedPctId, KD);
-#endif
-			}
+		const Seq &s = v.GetSeq(uSeqIndex);
+		SeqToLetters(s, Letters);
+		const unsigned uKmerCount = GetKmers(Letters, s.Length(), Kmers);
+		AddKmerSig(KS, Kmers, uKmerCount);
 		}
+	delete[] Letters;
+	delete[] Kmers;
 
-	delete[] Seq1Letters;
-	delete[] Seq2Letters;
+	DistKmerSigs(KS, KmerDist, &KD, DF);
+	FreeKmerSigs(KS);
 	}
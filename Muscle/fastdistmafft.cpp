@@ -1,5 +1,6 @@
 #include "muscle.h"
 #include "distfunc.h"
+#include "kmerdist.h"
 #include "seqvect.h"
 #include <math.h>
 
@@ -9,8 +10,6 @@
 #define MAX(x, y)	(((x) > (y)) ? (x) : (y))
 
 const unsigned TUPLE_COUNT = 6*6*6*6*6*6;
-static unsigned char Count1[TUPLE_COUNT];
-static unsigned char Count2[TUPLE_COUNT];
 
 // Amino acid groups according to MAFFT (sextet5)
 // 0 =  A G P S T
@@ -91,26 +90,50 @@ static unsigned GetTuple(const unsigned uLetters[], unsigned n)
 	return u6 + u5*6 + u4*6*6 + u3*6*6*6 + u2*6*6*6*6 + u1*6*6*6*6*6;
 	}
 
-static void CountTuples(const unsigned L[], unsigned uTupleCount, unsigned char Count[])
+static void GetTuples(const unsigned L[], unsigned uTupleCount, unsigned Tuples[])
 	{
-	memset(Count, 0, TUPLE_COUNT*sizeof(unsigned char));
 	for (unsigned n = 0; n < uTupleCount; ++n)
-		{
-		const unsigned uTuple = GetTuple(L, n);
-		++(Count[uTuple]);
-		}
+		Tuples[n] = GetTuple(L, n);
 	}
 
-static void ListCount(const unsigned char Count[])
+struct TUPLE_DIST
 	{
-	for (unsigned n = 0; n < TUPLE_COUNT; ++n)
-		{
-		if (0 == Count[n])
-			continue;
-		Log("%s  %u\n", TupleToStr(n), Count[n]);
-		}
+	unsigned *SelfCounts;
+	};
+
+static float TupleDist(unsigned uSeq1, unsigned uSeq2, unsigned uCommonTupleCount,
+  void *ptrUser)
+	{
+	const TUPLE_DIST &TD = *(const TUPLE_DIST *) ptrUser;
+
+	double dCommonTupleCount11 = TD.SelfCounts[uSeq1];
+	if (0 == dCommonTupleCount11)
+		dCommonTupleCount11 = 1;
+
+	double dCommonTupleCount22 = TD.SelfCounts[uSeq2];
+	if (0 == dCommonTupleCount22)
+		dCommonTupleCount22 = 1;
+
+	const double dDist1 = 3.0*(dCommonTupleCount11 - uCommonTupleCount)
+	  /dCommonTupleCount11;
+	const double dDist2 = 3.0*(dCommonTupleCount22 - uCommonTupleCount)
+	  /dCommonTupleCount22;
+
+// dMinDist is the value used for tree-building in MAFFT
+	const double dMinDist = MIN(dDist1, dDist2);
+#if	TRACE
+	Log("Common count %u - %u =%u dist=%g\n", uSeq1, uSeq2, uCommonTupleCount,
+	  dMinDist);
+#endif
+	return (float) dMinDist;
 	}
 
+// The common tuple count of a pair is MAFFT's sum over the unique
+// tuples of the minimum of the number of times the tuple is found
+// in the two sequences (counted in bytes, so modulo 256). Each
+// sequence is reduced once to a sparse signature of its distinct
+// tuples, and the common counts are computed in cache-sized blocks
+// spread over the threads, see DistKmerSigs.
 void DistKmer6_6(const SeqVect &v, DistFunc &DF)
 	{
 	const unsigned uSeqCount = v.Length();
@@ -119,161 +142,63 @@ void DistKmer6_6(const SeqVect &v, DistFunc &DF)
 	if (0 == uSeqCount)
 		return;
 
-// Initialize distance matrix to zero
-	for (unsigned uSeq1 = 0; uSeq1 < uSeqCount; ++uSeq1)
+	unsigned uMaxLength = 0;
+	unsigned uTotalLength = 0;
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		{
-		DF.SetDist(uSeq1, uSeq1, 0);
-		for (unsigned uSeq2 = 0; uSeq2 < uSeq1; ++uSeq2)
-			DF.SetDist(uSeq1, uSeq2, 0);
+		const unsigned uSeqLength = v[uSeqIndex]->Length();
+		if (uSeqLength > uMaxLength)
+			uMaxLength = uSeqLength;
+		uTotalLength += uSeqLength;
 		}
 
-// Convert to letters
-	unsigned **Letters = new unsigned *[uSeqCount];
+	unsigned *L = new unsigned[uMaxLength + 1];
+	unsigned *Tuples = new unsigned[uMaxLength + 1];
+
+	TUPLE_DIST TD;
+	KMER_SIGS KS;
+	InitKmerSigs(KS, uSeqCount, uTotalLength, TUPLE_COUNT, 8);
+	TD.SelfCounts = new unsigned[uSeqCount];
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		{
 		Seq &s = *(v[uSeqIndex]);
 		const unsigned uSeqLength = s.Length();
-		unsigned *L = new unsigned[uSeqLength];
-		Letters[uSeqIndex] = L;
+
+	// Convert to letters
 		for (unsigned n = 0; n < uSeqLength; ++n)
 			{
 			char c = s[n];
 			L[n] = CharToLetterEx(c);
 			assert(L[n] < uResidueGroupCount);
 			}
-		}
 
-	unsigned **uCommonTupleCount = new unsigned *[uSeqCount];
-	for (unsigned n = 0; n < uSeqCount; ++n)
-		{
-		uCommonTupleCount[n] = new unsigned[uSeqCount];
-		memset(uCommonTupleCount[n], 0, uSeqCount*sizeof(unsigned));
-		}
-
-	const unsigned uPairCount = (uSeqCount*(uSeqCount + 1))/2;
-	unsigned uCount = 0;
-	for (unsigned uSeq1 = 0; uSeq1 < uSeqCount; ++uSeq1)
-		{
-		Seq &seq1 = *(v[uSeq1]);
-		const unsigned uSeqLength1 = seq1.Length();
-		if (uSeqLength1 < 5)
-			continue;
-
-		const unsigned uTupleCount = uSeqLength1 - 5;
-		const unsigned *L = Letters[uSeq1];
-		CountTuples(L, uTupleCount, Count1);
+		const unsigned uTupleCount = uSeqLength < 5 ? 0 : uSeqLength - 5;
+		GetTuples(L, uTupleCount, Tuples);
+		AddKmerSig(KS, Tuples, uTupleCount);
+		TD.SelfCounts[uSeqIndex] = SelfKmerCount(KS, uSeqIndex);
 #if	TRACE
 		{
-		Log("Seq1=%d\n", uSeq1);
+		Log("Seq=%d\n", uSeqIndex);
 		Log("Groups:\n");
-		for (unsigned n = 0; n < uSeqLength1; ++n)
+		for (unsigned n = 0; n < uSeqLength; ++n)
 			Log("%u", ResidueGroup[L[n]]);
 		Log("\n");
 
 		Log("Tuples:\n");
-		ListCount(Count1);
+		for (unsigned n = KS.Starts[uSeqIndex]; n < KS.Starts[uSeqIndex+1]; ++n)
+			Log("%s  %u\n", TupleToStr(GetSigKmer(KS, n)), GetSigCount(KS, n));
 		}
 #endif
-
-		SetProgressDesc("K-mer dist pass 1");
-		for (unsigned uSeq2 = 0; uSeq2 <= uSeq1; ++uSeq2)
-			{
-			if (0 == uCount%500)
-				Progress(uCount, uPairCount);
-			++uCount;
-			Seq &seq2 = *(v[uSeq2]);
-			const unsigned uSeqLength2 = seq2.Length();
-			if (uSeqLength2 < 5)
-				{
-				if (uSeq1 == uSeq2)
-					DF.SetDist(uSeq1, uSeq2, 0);
-				else
-					DF.SetDist(uSeq1, uSeq2, 1);
-				continue;
-				}
-
-		// First pass through seq 2 to count tuples
-			const unsigned uTupleCount = uSeqLength2 - 5;
-			const unsigned *L = Letters[uSeq2];
-			CountTuples(L, uTupleCount, Count2);
-#if	TRACE
-			Log("Seq2=%d Counts=\n", uSeq2);
-			ListCount(Count2);
-#endif
-
-		// Second pass to accumulate sum of shared tuples
-		// MAFFT defines this as the sum over unique tuples
-		// in seq2 of the minimum of the number of tuples found
-		// in the two sequences.
-			unsigned uSum = 0;
-			for (unsigned n = 0; n < uTupleCount; ++n)
-				{
-				const unsigned uTuple = GetTuple(L, n);
-				uSum += MIN(Count1[uTuple], Count2[uTuple]);
-
-			// This is a hack to make sure each unique tuple counted only once.
-				Count2[uTuple] = 0;
-				}
-#if	TRACE
-			{
-			Seq &s1 = *(v[uSeq1]);
-			Seq &s2 = *(v[uSeq2]);
-			const char *pName1 = s1.GetName();
-			const char *pName2 = s2.GetName();
-			Log("Common count %s(%d) - %s(%d) =%u\n",
-			  pName1, uSeq1, pName2, uSeq2, uSum);
-			}
-#endif
-			uCommonTupleCount[uSeq1][uSeq2] = uSum;
-			uCommonTupleCount[uSeq2][uSeq1] = uSum;
-			}
 		}
-	ProgressStepsDone();
-
-	uCount = 0;
-	SetProgressDesc("K-mer dist pass 2");
-	for (unsigned uSeq1 = 0; uSeq1 < uSeqCount; ++uSeq1)
-		{
-		Seq &s1 = *(v[uSeq1]);
-		const char *pName1 = s1.GetName();
-
-		double dCommonTupleCount11 = uCommonTupleCount[uSeq1][uSeq1];
-		if (0 == dCommonTupleCount11)
-			dCommonTupleCount11 = 1;
-
-		DF.SetDist(uSeq1, uSeq1, 0);
-		for (unsigned uSeq2 = 0; uSeq2 < uSeq1; ++uSeq2)
-			{
-			if (0 == uCount%500)
-				Progress(uCount, uPairCount);
-			++uCount;
+	delete[] L;
+	delete[] Tuples;
 
-			double dCommonTupleCount22 = uCommonTupleCount[uSeq2][uSeq2];
-			if (0 == dCommonTupleCount22)
-				dCommonTupleCount22 = 1;
-
-			const double dDist1 = 3.0*(dCommonTupleCount11 - uCommonTupleCount[uSeq1][uSeq2])
-			  /dCommonTupleCount11;
-			const double dDist2 = 3.0*(dCommonTupleCount22 - uCommonTupleCount[uSeq1][uSeq2])
-			  /dCommonTupleCount22;
-
-		// dMinDist is the value used for tree-building in MAFFT
-			const double dMinDist = MIN(dDist1, dDist2);
-			DF.SetDist(uSeq1, uSeq2, (float) dMinDist);
-
-			//const double dEstimatedPctId = TupleDistToEstimatedPctId(dMinDist);
-			//g_dfPwId.SetDist(uSeq1, uSeq2, dEstimatedPctId);
-		// **** TODO **** why does this make score slightly worse??
-			//const double dKimuraDist = KimuraDist(dEstimatedPctId);
-			//DF.SetDist(uSeq1, uSeq2, dKimuraDist);
-			}
-		}
+	SetProgressDesc("K-mer dist");
+	DistKmerSigs(KS, TupleDist, &TD, DF);
 	ProgressStepsDone();
 
-	for (unsigned n = 0; n < uSeqCount; ++n)
-		delete[] uCommonTupleCount[n];
-	delete[] uCommonTupleCount;
-	delete[] Letters;
+	FreeKmerSigs(KS);
+	delete[] TD.SelfCounts;
 	}
 
 double PctIdToMAFFTDist(double dPctId)
@@ -0,0 +1,789 @@
+#include "muscle.h"
+#include "distfunc.h"
+#include "seqvect.h"
+#include "threads.h"
+#include "simd.h"
+#include <algorithm>
+#include <limits.h>
+
+#define TRACE	0
+
+extern SCOREMATRIX VTML_SP;
+extern SCOREMATRIX NUC_SP;
+
+/***
+Kimura distance from the percent identity of pairwise alignments,
+-distance1 pwkimurafast.
+
+DistPWKimura aligns each pair by building two one-sequence MSAs and
+running the profile aligner, then reads the identity off the output
+MSA. Here pairs are aligned by a dedicated sequence-sequence global
+aligner which never builds a path or an MSA: each cell of the DP
+matrices carries, as well as its score, the number of identities and
+of aligned pairs on the best path ending there (Daily 2016). The
+identity is these two counts at the final cell, over columns where
+neither sequence has a gap, as in MSA::GetPctIdentityPair. Wildcards
+are never counted as identical.
+
+Scores are integers: VTML_SP (amino) or NUC_SP (nucleotides), which
+have the center pre-added, divided by SCORE_SCALE and rounded, with
+the gap open penalty of -sv and -spn. Gap extension is free, as in
+those score modes; a terminal gap costs the same as an internal one.
+
+The vector kernels align one query against a batch of W targets at
+once, one target per lane (Rognes 2011): W = 8 with SSE4.1 and 16
+with AVX2, scores and counts in 16 bits with saturating arithmetic.
+The DP runs over the longest target of the batch; lane k reads its
+result at column L(k), the length of its own target. The targets of
+a batch are interleaved letter by letter, and the substitution score
+of each query letter against them precomputed, so a cell costs a
+handful of vector operations for all lanes. A lane whose scores
+reached the 16-bit limit is aligned again with the 32-bit scalar
+aligner, which uses the same scores and ties, so the result does not
+depend on the kernel. -nosimd uses the scalar aligner for all pairs.
+
+Sequences are sorted by length and cut into batches of W consecutive
+sequences, so the targets of a batch have similar lengths. Batch b is
+aligned against itself and against every longer sequence, which
+covers each pair once. The batches are handed out to threads.
+***/
+
+static const float SCORE_SCALE = 8;
+static const float AMINO_GAP_OPEN = 300;
+static const float NUC_GAP_OPEN = 400;
+static const float GAP_EXTEND = 0;
+
+// Longest sequence the 16-bit kernels align; the identity and pair
+// counts are kept as 16-bit unsigned.
+static const unsigned MAX_SIMD_LENGTH = 65535;
+
+static const unsigned SIMD_ALIGN = 32;
+
+// The targets of one batch, interleaved: item (j, k) is at j*W + k,
+// for j = 0 .. uLength-1 and lanes k = 0 .. W-1. Letters are -1 for
+// wildcards and beyond the end of a target. Scores has uRowCount rows
+// of uLength*W items, row a being the score of query letter a at
+// each item (0 beyond the end).
+struct PWID_BATCH
+	{
+	unsigned uLength;
+	unsigned uRowCount;
+	int iGapOpen;
+	int iGapExtend;
+	const short *Letters;
+	const short *Scores;
+	};
+
+// Align Query (letters 0 .. uRowCount-1, the last one for wildcards)
+// against the batch. On return the last row is in Work: the score,
+// identities and pairs at column j of lane k are Work[j*W + k],
+// Work[uRowSize + j*W + k] and Work[2*uRowSize + j*W + k], where
+// uRowSize = (uLength + 1)*W. Saturated[k] is set if lane k reached
+// the limit of the 16-bit scores.
+typedef void (*PWID_BATCH_FN)(const PWID_BATCH &B, const byte Query[],
+  unsigned uLengthQ, short Work[], bool Saturated[]);
+
+#if	defined(_MANAGED)
+#pragma managed(push, off)
+#endif
+
+#if	SIMD_SSE4
+
+TARGET_SSE4 static void PWIdBatchSSE4(const PWID_BATCH &B, const byte Query[],
+  unsigned uLengthQ, short Work[], bool Saturated[])
+	{
+	const unsigned W = 8;
+	const unsigned uLength = B.uLength;
+	const size_t uRowSize = (size_t) (uLength + 1)*W;
+	short *H = Work;
+	short *HM = H + uRowSize;
+	short *HP = HM + uRowSize;
+	short *F = HP + uRowSize;
+	short *FM = F + uRowSize;
+	short *FP = FM + uRowSize;
+
+	const __m128i vZero = _mm_setzero_si128();
+	const __m128i vOne = _mm_set1_epi16(1);
+	const __m128i vMinusInf = _mm_set1_epi16(SHRT_MIN);
+	const __m128i vOpen = _mm_set1_epi16((short) B.iGapOpen);
+	const __m128i vExtend = _mm_set1_epi16((short) B.iGapExtend);
+	const __m128i vEdge = _mm_set1_epi16((short) -B.iGapOpen);
+
+// Row 0: a gap in the query.
+	for (unsigned j = 0; j <= uLength; ++j)
+		{
+		const size_t o = (size_t) j*W;
+		_mm_storeu_si128((__m128i *) (H + o), 0 == j ? vZero : vEdge);
+		_mm_storeu_si128((__m128i *) (HM + o), vZero);
+		_mm_storeu_si128((__m128i *) (HP + o), vZero);
+		_mm_storeu_si128((__m128i *) (F + o), vMinusInf);
+		_mm_storeu_si128((__m128i *) (FM + o), vZero);
+		_mm_storeu_si128((__m128i *) (FP + o), vZero);
+		}
+
+	__m128i vMax = vZero;
+	__m128i vMin = vEdge;
+	for (unsigned i = 1; i <= uLengthQ; ++i)
+		{
+		const unsigned uLetter = Query[i-1];
+		const short *Scores = B.Scores + (size_t) uLetter*uLength*W;
+		const __m128i vQuery = _mm_set1_epi16(uLetter + 1 == B.uRowCount ?
+		  (short) -2 : (short) uLetter);
+
+		__m128i vDiag = _mm_loadu_si128((const __m128i *) H);
+		__m128i vDiagM = vZero;
+		__m128i vDiagP = vZero;
+		_mm_storeu_si128((__m128i *) H, vEdge);
+
+		__m128i vLeft = vEdge;
+		__m128i vLeftM = vZero;
+		__m128i vLeftP = vZero;
+		__m128i vE = vMinusInf;
+		__m128i vEM = vZero;
+		__m128i vEP = vZero;
+		for (unsigned j = 1; j <= uLength; ++j)
+			{
+			const size_t o = (size_t) j*W;
+			const __m128i vUp = _mm_loadu_si128((const __m128i *) (H + o));
+			const __m128i vUpM = _mm_loadu_si128((const __m128i *) (HM + o));
+			const __m128i vUpP = _mm_loadu_si128((const __m128i *) (HP + o));
+
+		// F: gap in the target, from the cell above.
+			__m128i vF = _mm_subs_epi16(_mm_loadu_si128((const __m128i *) (F + o)),
+			  vExtend);
+			__m128i vT = _mm_subs_epi16(vUp, vOpen);
+			__m128i vGt = _mm_cmpgt_epi16(vT, vF);
+			vF = _mm_max_epi16(vF, vT);
+			const __m128i vFM = _mm_blendv_epi8(
+			  _mm_loadu_si128((const __m128i *) (FM + o)), vUpM, vGt);
+			const __m128i vFP = _mm_blendv_epi8(
+			  _mm_loadu_si128((const __m128i *) (FP + o)), vUpP, vGt);
+
+		// E: gap in the query, from the cell to the left.
+			vE = _mm_subs_epi16(vE, vExtend);
+			vT = _mm_subs_epi16(vLeft, vOpen);
+			vGt = _mm_cmpgt_epi16(vT, vE);
+			vE = _mm_max_epi16(vE, vT);
+			vEM = _mm_blendv_epi8(vEM, vLeftM, vGt);
+			vEP = _mm_blendv_epi8(vEP, vLeftP, vGt);
+
+		// H: diagonal, else F, else E if strictly better.
+			const __m128i vScore = _mm_loadu_si128((const __m128i *) (Scores + o - W));
+			const __m128i vLetters = _mm_loadu_si128((const __m128i *) (B.Letters + o - W));
+			__m128i vH = _mm_adds_epi16(vDiag, vScore);
+			__m128i vHM = _mm_sub_epi16(vDiagM, _mm_cmpeq_epi16(vLetters, vQuery));
+			__m128i vHP = _mm_add_epi16(vDiagP, vOne);
+			vGt = _mm_cmpgt_epi16(vF, vH);
+			vH = _mm_max_epi16(vH, vF);
+			vHM = _mm_blendv_epi8(vHM, vFM, vGt);
+			vHP = _mm_blendv_epi8(vHP, vFP, vGt);
+			vGt = _mm_cmpgt_epi16(vE, vH);
+			vH = _mm_max_epi16(vH, vE);
+			vHM = _mm_blendv_epi8(vHM, vEM, vGt);
+			vHP = _mm_blendv_epi8(vHP, vEP, vGt);
+
+			vMax = _mm_max_epi16(vMax, vH);
+			vMin = _mm_min_epi16(vMin, vH);
+
+			vDiag = vUp;
+			vDiagM = vUpM;
+			vDiagP = vUpP;
+			vLeft = vH;
+			vLeftM = vHM;
+			vLeftP = vHP;
+
+			_mm_storeu_si128((__m128i *) (H + o), vH);
+			_mm_storeu_si128((__m128i *) (HM + o), vHM);
+			_mm_storeu_si128((__m128i *) (HP + o), vHP);
+			_mm_storeu_si128((__m128i *) (F + o), vF);
+			_mm_storeu_si128((__m128i *) (FM + o), vFM);
+			_mm_storeu_si128((__m128i *) (FP + o), vFP);
+			}
+		}
+
+	short Max[W];
+	short Min[W];
+	_mm_storeu_si128((__m128i *) Max, vMax);
+	_mm_storeu_si128((__m128i *) Min, vMin);
+	for (unsigned k = 0; k < W; ++k)
+		Saturated[k] = (SHRT_MAX == Max[k] || SHRT_MIN == Min[k]);
+	}
+
+#endif	// SIMD_SSE4
+
+#if	SIMD_AVX2
+
+TARGET_AVX2 static void PWIdBatchAVX2(const PWID_BATCH &B, const byte Query[],
+  unsigned uLengthQ, short Work[], bool Saturated[])
+	{
+	const unsigned W = 16;
+	const unsigned uLength = B.uLength;
+	const size_t uRowSize = (size_t) (uLength + 1)*W;
+	short *H = Work;
+	short *HM = H + uRowSize;
+	short *HP = HM + uRowSize;
+	short *F = HP + uRowSize;
+	short *FM = F + uRowSize;
+	short *FP = FM + uRowSize;
+
+	const __m256i vZero = _mm256_setzero_si256();
+	const __m256i vOne = _mm256_set1_epi16(1);
+	const __m256i vMinusInf = _mm256_set1_epi16(SHRT_MIN);
+	const __m256i vOpen = _mm256_set1_epi16((short) B.iGapOpen);
+	const __m256i vExtend = _mm256_set1_epi16((short) B.iGapExtend);
+	const __m256i vEdge = _mm256_set1_epi16((short) -B.iGapOpen);
+
+	for (unsigned j = 0; j <= uLength; ++j)
+		{
+		const size_t o = (size_t) j*W;
+		_mm256_storeu_si256((__m256i *) (H + o), 0 == j ? vZero : vEdge);
+		_mm256_storeu_si256((__m256i *) (HM + o), vZero);
+		_mm256_storeu_si256((__m256i *) (HP + o), vZero);
+		_mm256_storeu_si256((__m256i *) (F + o), vMinusInf);
+		_mm256_storeu_si256((__m256i *) (FM + o), vZero);
+		_mm256_storeu_si256((__m256i *) (FP + o), vZero);
+		}
+
+	__m256i vMax = vZero;
+	__m256i vMin = vEdge;
+	for (unsigned i = 1; i <= uLengthQ; ++i)
+		{
+		const unsigned uLetter = Query[i-1];
+		const short *Scores = B.Scores + (size_t) uLetter*uLength*W;
+		const __m256i vQuery = _mm256_set1_epi16(uLetter + 1 == B.uRowCount ?
+		  (short) -2 : (short) uLetter);
+
+		__m256i vDiag = _mm256_loadu_si256((const __m256i *) H);
+		__m256i vDiagM = vZero;
+		__m256i vDiagP = vZero;
+		_mm256_storeu_si256((__m256i *) H, vEdge);
+
+		__m256i vLeft = vEdge;
+		__m256i vLeftM = vZero;
+		__m256i vLeftP = vZero;
+		__m256i vE = vMinusInf;
+		__m256i vEM = vZero;
+		__m256i vEP = vZero;
+		for (unsigned j = 1; j <= uLength; ++j)
+			{
+			const size_t o = (size_t) j*W;
+			const __m256i vUp = _mm256_loadu_si256((const __m256i *) (H + o));
+			const __m256i vUpM = _mm256_loadu_si256((const __m256i *) (HM + o));
+			const __m256i vUpP = _mm256_loadu_si256((const __m256i *) (HP + o));
+
+			__m256i vF = _mm256_subs_epi16(
+			  _mm256_loadu_si256((const __m256i *) (F + o)), vExtend);
+			__m256i vT = _mm256_subs_epi16(vUp, vOpen);
+			__m256i vGt = _mm256_cmpgt_epi16(vT, vF);
+			vF = _mm256_max_epi16(vF, vT);
+			const __m256i vFM = _mm256_blendv_epi8(
+			  _mm256_loadu_si256((const __m256i *) (FM + o)), vUpM, vGt);
+			const __m256i vFP = _mm256_blendv_epi8(
+			  _mm256_loadu_si256((const __m256i *) (FP + o)), vUpP, vGt);
+
+			vE = _mm256_subs_epi16(vE, vExtend);
+			vT = _mm256_subs_epi16(vLeft, vOpen);
+			vGt = _mm256_cmpgt_epi16(vT, vE);
+			vE = _mm256_max_epi16(vE, vT);
+			vEM = _mm256_blendv_epi8(vEM, vLeftM, vGt);
+			vEP = _mm256_blendv_epi8(vEP, vLeftP, vGt);
+
+			const __m256i vScore = _mm256_loadu_si256(
+			  (const __m256i *) (Scores + o - W));
+			const __m256i vLetters = _mm256_loadu_si256(
+			  (const __m256i *) (B.Letters + o - W));
+			__m256i vH = _mm256_adds_epi16(vDiag, vScore);
+			__m256i vHM = _mm256_sub_epi16(vDiagM,
+			  _mm256_cmpeq_epi16(vLetters, vQuery));
+			__m256i vHP = _mm256_add_epi16(vDiagP, vOne);
+			vGt = _mm256_cmpgt_epi16(vF, vH);
+			vH = _mm256_max_epi16(vH, vF);
+			vHM = _mm256_blendv_epi8(vHM, vFM, vGt);
+			vHP = _mm256_blendv_epi8(vHP, vFP, vGt);
+			vGt = _mm256_cmpgt_epi16(vE, vH);
+			vH = _mm256_max_epi16(vH, vE);
+			vHM = _mm256_blendv_epi8(vHM, vEM, vGt);
+			vHP = _mm256_blendv_epi8(vHP, vEP, vGt);
+
+			vMax = _mm256_max_epi16(vMax, vH);
+			vMin = _mm256_min_epi16(vMin, vH);
+
+			vDiag = vUp;
+			vDiagM = vUpM;
+			vDiagP = vUpP;
+			vLeft = vH;
+			vLeftM = vHM;
+			vLeftP = vHP;
+
+			_mm256_storeu_si256((__m256i *) (H + o), vH);
+			_mm256_storeu_si256((__m256i *) (HM + o), vHM);
+			_mm256_storeu_si256((__m256i *) (HP + o), vHP);
+			_mm256_storeu_si256((__m256i *) (F + o), vF);
+			_mm256_storeu_si256((__m256i *) (FM + o), vFM);
+			_mm256_storeu_si256((__m256i *) (FP + o), vFP);
+			}
+		}
+
+	short Max[W];
+	short Min[W];
+	_mm256_storeu_si256((__m256i *) Max, vMax);
+	_mm256_storeu_si256((__m256i *) Min, vMin);
+	for (unsigned k = 0; k < W; ++k)
+		Saturated[k] = (SHRT_MAX == Max[k] || SHRT_MIN == Min[k]);
+	}
+
+#endif	// SIMD_AVX2
+
+#if	defined(_MANAGED)
+#pragma managed(pop)
+#endif
+
+static PWID_BATCH_FN GetPWIdBatchFn(unsigned *ptruLaneCount, const char **ptrName)
+	{
+	*ptrName = "scalar";
+	*ptruLaneCount = 16;
+	if (g_bNoSIMD)
+		return 0;
+#if	SIMD_AVX2
+	if (CPUHasAVX2())
+		{
+		*ptrName = "AVX2";
+		return PWIdBatchAVX2;
+		}
+#endif
+#if	SIMD_SSE4
+	if (CPUHasSSE41())
+		{
+		*ptrName = "SSE4.1";
+		*ptruLaneCount = 8;
+		return PWIdBatchSSE4;
+		}
+#endif
+	return 0;
+	}
+
+struct PWID_DIST
+	{
+	unsigned uSeqCount;
+	unsigned uRowCount;
+	int iGapOpen;
+	int iGapExtend;
+	const int *ScoreMx;			// uRowCount x uRowCount
+
+// Sequences as row indexes of ScoreMx, in order of length.
+	const byte *Letters;
+	const size_t *Starts;
+	const unsigned *Lengths;
+	const unsigned *SeqIndexes;	// input index of each
+	unsigned uMaxLength;
+
+	PWID_BATCH_FN BatchFn;
+	unsigned uLaneCount;
+	unsigned uBatchCount;
+	DistFunc *ptrDF;
+
+// Protected by Lock
+	Mutex Lock;
+	unsigned uNextBatch;
+	size_t uPairsDone;
+	size_t uPairCount;
+	};
+
+// Per-thread buffers, aligned to SIMD_ALIGN bytes.
+struct PWID_THREAD
+	{
+	short *BatchLetters;
+	short *BatchScores;
+	short *Work;
+	int *Row;
+	char *Buffer;
+	};
+
+static inline const byte *GetSeq(const PWID_DIST &PD, unsigned uPos)
+	{
+	return PD.Letters + PD.Starts[uPos];
+	}
+
+static size_t AlignUp(size_t n)
+	{
+	return (n + SIMD_ALIGN - 1) & ~(size_t) (SIMD_ALIGN - 1);
+	}
+
+static void AllocThread(const PWID_DIST &PD, PWID_THREAD &T)
+	{
+	const size_t L = PD.uMaxLength + 1;
+	const size_t W = PD.uLaneCount;
+	const size_t uLettersSize = AlignUp(L*W*sizeof(short));
+	const size_t uScoresSize = AlignUp(PD.uRowCount*L*W*sizeof(short));
+	const size_t uWorkSize = AlignUp(6*L*W*sizeof(short));
+	const size_t uRowSize = AlignUp(6*L*sizeof(int));
+	T.Buffer = new char[uLettersSize + uScoresSize + uWorkSize + uRowSize +
+	  SIMD_ALIGN];
+	char *p = T.Buffer + (SIMD_ALIGN - (size_t) T.Buffer%SIMD_ALIGN)%SIMD_ALIGN;
+	T.BatchLetters = (short *) p;
+	p += uLettersSize;
+	T.BatchScores = (short *) p;
+	p += uScoresSize;
+	T.Work = (short *) p;
+	p += uWorkSize;
+	T.Row = (int *) p;
+	}
+
+// Global alignment of A and B by the scalar recursion of the kernels,
+// in 32 bits. Returns the identity and pair counts of the best path.
+static void PWIdScalar(const PWID_DIST &PD, const byte A[], unsigned uLengthA,
+  const byte B[], unsigned uLengthB, int Row[], unsigned &uIdCount,
+  unsigned &uPairCount)
+	{
+	const int MINUS_INF = INT_MIN/2;
+	const int iOpen = PD.iGapOpen;
+	const int iExtend = PD.iGapExtend;
+	const unsigned uWildcard = PD.uRowCount - 1;
+	const size_t L = uLengthB + 1;
+	int *H = Row;
+	int *HM = H + L;
+	int *HP = HM + L;
+	int *F = HP + L;
+	int *FM = F + L;
+	int *FP = FM + L;
+
+	for (unsigned j = 0; j <= uLengthB; ++j)
+		{
+		H[j] = (0 == j) ? 0 : -iOpen;
+		HM[j] = 0;
+		HP[j] = 0;
+		F[j] = MINUS_INF;
+		FM[j] = 0;
+		FP[j] = 0;
+		}
+
+	for (unsigned i = 1; i <= uLengthA; ++i)
+		{
+		const unsigned uLetterA = A[i-1];
+		const int *Scores = PD.ScoreMx + uLetterA*PD.uRowCount;
+		int iDiag = H[0];
+		int iDiagM = 0;
+		int iDiagP = 0;
+		H[0] = -iOpen;
+
+		int iLeft = -iOpen;
+		int iLeftM = 0;
+		int iLeftP = 0;
+		int iE = MINUS_INF;
+		int iEM = 0;
+		int iEP = 0;
+		for (unsigned j = 1; j <= uLengthB; ++j)
+			{
+			const unsigned uLetterB = B[j-1];
+			const int iUp = H[j];
+			const int iUpM = HM[j];
+			const int iUpP = HP[j];
+
+			F[j] -= iExtend;
+			if (iUp - iOpen > F[j])
+				{
+				F[j] = iUp - iOpen;
+				FM[j] = iUpM;
+				FP[j] = iUpP;
+				}
+
+			iE -= iExtend;
+			if (iLeft - iOpen > iE)
+				{
+				iE = iLeft - iOpen;
+				iEM = iLeftM;
+				iEP = iLeftP;
+				}
+
+			int iH = iDiag + Scores[uLetterB];
+			int iHM = iDiagM + (uLetterA == uLetterB && uLetterA != uWildcard);
+			int iHP = iDiagP + 1;
+			if (F[j] > iH)
+				{
+				iH = F[j];
+				iHM = FM[j];
+				iHP = FP[j];
+				}
+			if (iE > iH)
+				{
+				iH = iE;
+				iHM = iEM;
+				iHP = iEP;
+				}
+
+			iDiag = iUp;
+			iDiagM = iUpM;
+			iDiagP = iUpP;
+			iLeft = iH;
+			iLeftM = iHM;
+			iLeftP = iHP;
+			H[j] = iH;
+			HM[j] = iHM;
+			HP[j] = iHP;
+			}
+		}
+	uIdCount = (unsigned) HM[uLengthB];
+	uPairCount = (unsigned) HP[uLengthB];
+	}
+
+static float PWIdDist(unsigned uIdCount, unsigned uPairCount)
+	{
+	const double dPctId = (0 == uPairCount) ? 0 : (double) uIdCount/uPairCount;
+	return (float) KimuraDist(dPctId);
+	}
+
+static void SetPairDist(PWID_DIST &PD, unsigned uPos1, unsigned uPos2,
+  unsigned uIdCount, unsigned uPairCount)
+	{
+	PD.ptrDF->SetDist(PD.SeqIndexes[uPos1], PD.SeqIndexes[uPos2],
+	  PWIdDist(uIdCount, uPairCount));
+#if	TRACE
+	Log("PWId %u - %u ids %u pairs %u\n", PD.SeqIndexes[uPos1],
+	  PD.SeqIndexes[uPos2], uIdCount, uPairCount);
+#endif
+	}
+
+// Interleave the targets of batch uBatch into T.
+static unsigned MakeBatch(const PWID_DIST &PD, unsigned uBatch, PWID_THREAD &T,
+  PWID_BATCH &B)
+	{
+	const unsigned W = PD.uLaneCount;
+	const unsigned uFirst = uBatch*W;
+	const unsigned uCount = Min2(W, PD.uSeqCount - uFirst);
+	const unsigned uWildcard = PD.uRowCount - 1;
+
+// Sorted by length, so the last target is the longest.
+	const unsigned uLength = PD.Lengths[uFirst + uCount - 1];
+	const size_t uRowSize = (size_t) uLength*W;
+	memset(T.BatchScores, 0, PD.uRowCount*uRowSize*sizeof(short));
+	for (size_t n = 0; n < uRowSize; ++n)
+		T.BatchLetters[n] = -1;
+
+	for (unsigned k = 0; k < uCount; ++k)
+		{
+		const byte *Seq = GetSeq(PD, uFirst + k);
+		const unsigned uLengthK = PD.Lengths[uFirst + k];
+		for (unsigned j = 0; j < uLengthK; ++j)
+			{
+			const unsigned uLetter = Seq[j];
+			const size_t n = (size_t) j*W + k;
+			if (uLetter != uWildcard)
+				T.BatchLetters[n] = (short) uLetter;
+			for (unsigned a = 0; a < PD.uRowCount; ++a)
+				T.BatchScores[a*uRowSize + n] =
+				  (short) PD.ScoreMx[a*PD.uRowCount + uLetter];
+			}
+		}
+
+	B.uLength = uLength;
+	B.uRowCount = PD.uRowCount;
+	B.iGapOpen = PD.iGapOpen;
+	B.iGapExtend = PD.iGapExtend;
+	B.Letters = T.BatchLetters;
+	B.Scores = T.BatchScores;
+	return uCount;
+	}
+
+// Align batch uBatch against itself and all longer sequences.
+static void AlignBatch(PWID_DIST &PD, unsigned uBatch, PWID_THREAD &T)
+	{
+	const unsigned W = PD.uLaneCount;
+	const unsigned uFirst = uBatch*W;
+	const unsigned uCount = Min2(W, PD.uSeqCount - uFirst);
+
+	if (0 == PD.BatchFn)
+		{
+		for (unsigned uPosQ = uFirst + 1; uPosQ < PD.uSeqCount; ++uPosQ)
+			{
+			const unsigned uEnd = Min2(uFirst + uCount, uPosQ);
+			for (unsigned uPosT = uFirst; uPosT < uEnd; ++uPosT)
+				{
+				unsigned uIdCount;
+				unsigned uPairCount;
+				PWIdScalar(PD, GetSeq(PD, uPosQ), PD.Lengths[uPosQ],
+				  GetSeq(PD, uPosT), PD.Lengths[uPosT], T.Row, uIdCount,
+				  uPairCount);
+				SetPairDist(PD, uPosQ, uPosT, uIdCount, uPairCount);
+				}
+			}
+		return;
+		}
+
+	PWID_BATCH B;
+	MakeBatch(PD, uBatch, T, B);
+	const size_t uRowSize = (size_t) (B.uLength + 1)*W;
+	const unsigned short *HM = (const unsigned short *) T.Work + uRowSize;
+	const unsigned short *HP = HM + uRowSize;
+	bool Saturated[32];
+
+	for (unsigned uPosQ = uFirst + 1; uPosQ < PD.uSeqCount; ++uPosQ)
+		{
+		const byte *Query = GetSeq(PD, uPosQ);
+		const unsigned uLengthQ = PD.Lengths[uPosQ];
+		const bool bSIMD = (uLengthQ <= MAX_SIMD_LENGTH &&
+		  B.uLength <= MAX_SIMD_LENGTH);
+		if (bSIMD)
+			PD.BatchFn(B, Query, uLengthQ, T.Work, Saturated);
+
+		const unsigned uEnd = Min2(uFirst + uCount, uPosQ);
+		for (unsigned uPosT = uFirst; uPosT < uEnd; ++uPosT)
+			{
+			const unsigned k = uPosT - uFirst;
+			unsigned uIdCount;
+			unsigned uPairCount;
+			if (bSIMD && !Saturated[k])
+				{
+				const size_t n = (size_t) PD.Lengths[uPosT]*W + k;
+				uIdCount = HM[n];
+				uPairCount = HP[n];
+				}
+			else
+				PWIdScalar(PD, Query, uLengthQ, GetSeq(PD, uPosT),
+				  PD.Lengths[uPosT], T.Row, uIdCount, uPairCount);
+			SetPairDist(PD, uPosQ, uPosT, uIdCount, uPairCount);
+			}
+		}
+	}
+
+static size_t GetBatchPairCount(const PWID_DIST &PD, unsigned uBatch)
+	{
+	const unsigned uFirst = uBatch*PD.uLaneCount;
+	const unsigned uCount = Min2(PD.uLaneCount, PD.uSeqCount - uFirst);
+	const unsigned uAfter = PD.uSeqCount - uFirst - uCount;
+	return (uCount*(uCount - 1))/2 + (size_t) uCount*uAfter;
+	}
+
+static void PWIdThread(unsigned /* uThreadIndex */, void *ptrUser)
+	{
+	PWID_DIST &PD = *(PWID_DIST *) ptrUser;
+	PWID_THREAD T;
+	AllocThread(PD, T);
+	for (;;)
+		{
+		PD.Lock.Lock();
+		const unsigned uBatch = PD.uNextBatch;
+		if (uBatch < PD.uBatchCount)
+			{
+			++PD.uNextBatch;
+		// In 1/10000ths, as the pair counts do not fit Progress's steps.
+			Progress((unsigned) ((10000.0*PD.uPairsDone)/PD.uPairCount), 10000);
+			PD.uPairsDone += GetBatchPairCount(PD, uBatch);
+			}
+		PD.Lock.Unlock();
+		if (uBatch >= PD.uBatchCount)
+			break;
+
+		AlignBatch(PD, uBatch, T);
+		}
+	delete[] T.Buffer;
+	}
+
+static int ScaleScore(float Score)
+	{
+	const float f = Score/SCORE_SCALE;
+	return (int) (f >= 0 ? f + 0.5f : f - 0.5f);
+	}
+
+struct LengthLess
+	{
+	const unsigned *Lengths;
+	bool operator()(unsigned i, unsigned j) const
+		{
+		return Lengths[i] < Lengths[j];
+		}
+	};
+
+void DistPWKimuraFast(const SeqVect &v, DistFunc &DF)
+	{
+	const unsigned uSeqCount = v.GetSeqCount();
+	DF.SetCount(uSeqCount);
+	for (unsigned i = 0; i < uSeqCount; ++i)
+		DF.SetDist(i, i, 0);
+	if (uSeqCount < 2)
+		return;
+
+	PWID_DIST PD;
+	PD.uSeqCount = uSeqCount;
+	PD.ptrDF = &DF;
+
+// Letters 0 .. g_AlphaSize-1, then a row for wildcards, which is the
+// X row of VTML_SP (AX_X = 20) and a zero row of NUC_SP.
+	const bool bAmino = (ALPHA_Amino == g_Alpha);
+	SCOREMATRIX &Mx = bAmino ? VTML_SP : NUC_SP;
+	const unsigned uWildcard = g_AlphaSize;
+	PD.uRowCount = uWildcard + 1;
+	int *ScoreMx = new int[PD.uRowCount*PD.uRowCount];
+	for (unsigned a = 0; a < PD.uRowCount; ++a)
+		for (unsigned b = 0; b < PD.uRowCount; ++b)
+			ScoreMx[a*PD.uRowCount + b] = ScaleScore(Mx[a][b]);
+	PD.ScoreMx = ScoreMx;
+	PD.iGapOpen = ScaleScore(bAmino ? AMINO_GAP_OPEN : NUC_GAP_OPEN);
+	PD.iGapExtend = ScaleScore(GAP_EXTEND);
+
+	unsigned *InputLengths = new unsigned[uSeqCount];
+	unsigned *SeqIndexes = new unsigned[uSeqCount];
+	size_t uTotalLength = 0;
+	for (unsigned i = 0; i < uSeqCount; ++i)
+		{
+		InputLengths[i] = v.GetSeq(i).Length();
+		SeqIndexes[i] = i;
+		uTotalLength += InputLengths[i];
+		}
+	LengthLess Less;
+	Less.Lengths = InputLengths;
+	std::stable_sort(SeqIndexes, SeqIndexes + uSeqCount, Less);
+
+	byte *Letters = new byte[uTotalLength + 1];
+	size_t *Starts = new size_t[uSeqCount];
+	unsigned *Lengths = new unsigned[uSeqCount];
+	size_t uStart = 0;
+	for (unsigned uPos = 0; uPos < uSeqCount; ++uPos)
+		{
+		const Seq &s = v.GetSeq(SeqIndexes[uPos]);
+		const unsigned uLength = s.Length();
+		Starts[uPos] = uStart;
+		Lengths[uPos] = uLength;
+		for (unsigned j = 0; j < uLength; ++j)
+			{
+			const char c = s.GetChar(j);
+			unsigned uLetter = CharToLetter(c);
+			if (IsWildcardChar(c) || uLetter >= g_AlphaSize)
+				uLetter = uWildcard;
+			Letters[uStart + j] = (byte) uLetter;
+			}
+		uStart += uLength;
+		}
+	delete[] InputLengths;
+
+	PD.Letters = Letters;
+	PD.Starts = Starts;
+	PD.Lengths = Lengths;
+	PD.SeqIndexes = SeqIndexes;
+	PD.uMaxLength = Lengths[uSeqCount - 1];
+
+	const char *ptrName;
+	PD.BatchFn = GetPWIdBatchFn(&PD.uLaneCount, &ptrName);
+	PD.uBatchCount = (uSeqCount + PD.uLaneCount - 1)/PD.uLaneCount;
+	PD.uNextBatch = 0;
+	PD.uPairsDone = 0;
+	PD.uPairCount = ((size_t) uSeqCount*(uSeqCount - 1))/2;
+
+	unsigned uThreadCount = GetThreadCount();
+	if (uThreadCount > PD.uBatchCount)
+		uThreadCount = PD.uBatchCount;
+
+#if	TRACE
+	Log("DistPWKimuraFast seqs=%u kernel=%s lanes=%u batches=%u threads=%u\n",
+	  uSeqCount, ptrName, PD.uLaneCount, PD.uBatchCount, uThreadCount);
+#endif
+
+	SetProgressDesc("PWKimura distance");
+	RunThreads(uThreadCount, PWIdThread, &PD);
+	ProgressStepsDone();
+
+	delete[] ScoreMx;
+	delete[] Letters;
+	delete[] Starts;
+	delete[] Lengths;
+	delete[] SeqIndexes;
+	}
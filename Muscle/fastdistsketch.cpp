@@ -0,0 +1,207 @@
+#include "muscle.h"
+#include "distfunc.h"
+#include "seqvect.h"
+#include "kmerdist.h"
+#include <math.h>
+#include <algorithm>
+
+#define TRACE	0
+
+/***
+MinHash distance for very large sets of sequences.
+
+Each sequence is reduced to a bottom-s sketch: the s smallest hash
+values of its distinct 4-mers in the 20-letter alphabet, with s set
+by -sketchsize. The hash is a bijection on 32-bit words, so distinct
+k-mers never collide. A pair is compared by merging the two sketches
+up to s values of their union, and the fraction of those values
+found in both sketches estimates the Jaccard index J of the two
+k-mer sets (Broder 1997).
+
+The k-mer distance kmer20_4 is based on F, the number of common
+k-mers as a fraction of the number of k-mers in the shorter sequence.
+With distinct k-mer counts a and b,
+
+	|A & B| = J(a + b)/(1 + J)
+	F = |A & B| / min(a, b)
+
+and F is converted to fractional identity D with the fit used for
+kmer20_4 (see fastdistkmer.cpp), Y = -4.1 + 4.12*D:
+
+	if F is 0: F = 0.01 (also if a or b is 0)
+	Y = log(0.02 + F)
+	D = Y/4.12 + 0.995
+
+The distance is 1 - D, with D clamped to 0 .. 1.
+Sketches are O(s) per sequence regardless of length, so the cost of
+a pair is O(s) rather than O(L).
+***/
+
+const unsigned K = 4;
+const unsigned N = 20;
+const unsigned N_3 = 20*20*20;
+
+// Thomas Wang's 32-bit integer hash, a bijection.
+static unsigned HashKmer(unsigned Kmer)
+	{
+	Kmer = (Kmer ^ 61) ^ (Kmer >> 16);
+	Kmer = Kmer + (Kmer << 3);
+	Kmer = Kmer ^ (Kmer >> 4);
+	Kmer = Kmer*0x27d4eb2d;
+	Kmer = Kmer ^ (Kmer >> 15);
+	return Kmer;
+	}
+
+struct SKETCH_DIST
+	{
+	unsigned uSketchSize;
+	unsigned *Sketches;			// uSketchSize per sequence, ascending
+	unsigned *SketchLengths;	// < uSketchSize if fewer distinct k-mers
+	unsigned *KmerCounts;		// distinct k-mers per sequence
+	};
+
+// Distinct hashed k-mers of s in Hashes[], sorted, return count.
+static unsigned GetHashedKmers(const Seq &s, byte Letters[], unsigned Hashes[])
+	{
+	const unsigned uSeqLength = s.Length();
+	for (unsigned uCol = 0; uCol < uSeqLength; ++uCol)
+		{
+		char c = s.GetChar(uCol);
+	// As FastDistKmer, replace wildcards by a specific amino acid.
+		if (IsWildcardChar(c))
+			c = 'A';
+		Letters[uCol] = (byte) CharToLetter(c);
+		}
+	if (uSeqLength < K)
+		return 0;
+
+	unsigned Kmer = 0;
+	for (unsigned i = 0; i < K - 1; ++i)
+		Kmer = Kmer*N + Letters[i];
+
+	unsigned uCount = 0;
+	for (unsigned i = K - 1; i < uSeqLength; ++i)
+		{
+		Kmer = (Kmer%N_3)*N + Letters[i];
+		Hashes[uCount++] = HashKmer(Kmer);
+		}
+
+	std::sort(Hashes, Hashes + uCount);
+	unsigned uDistinctCount = 0;
+	for (unsigned i = 0; i < uCount; ++i)
+		if (0 == i || Hashes[i] != Hashes[i-1])
+			Hashes[uDistinctCount++] = Hashes[i];
+	return uDistinctCount;
+	}
+
+static float SketchDist(unsigned uSeqIndex1, unsigned uSeqIndex2, void *ptrUser)
+	{
+	const SKETCH_DIST &SD = *(const SKETCH_DIST *) ptrUser;
+	const unsigned uSketchSize = SD.uSketchSize;
+	const unsigned *Sketch1 = SD.Sketches + (size_t) uSeqIndex1*uSketchSize;
+	const unsigned *Sketch2 = SD.Sketches + (size_t) uSeqIndex2*uSketchSize;
+	const unsigned uLength1 = SD.SketchLengths[uSeqIndex1];
+	const unsigned uLength2 = SD.SketchLengths[uSeqIndex2];
+
+// Bottom-s of the union, counting values found in both.
+	unsigned i1 = 0;
+	unsigned i2 = 0;
+	unsigned uUnionCount = 0;
+	unsigned uSharedCount = 0;
+	while (uUnionCount < uSketchSize && (i1 < uLength1 || i2 < uLength2))
+		{
+		if (i2 == uLength2 || (i1 < uLength1 && Sketch1[i1] < Sketch2[i2]))
+			++i1;
+		else if (i1 == uLength1 || Sketch2[i2] < Sketch1[i1])
+			++i2;
+		else
+			{
+			++uSharedCount;
+			++i1;
+			++i2;
+			}
+		++uUnionCount;
+		}
+
+// A sequence shorter than K has no k-mers, and so nothing in common.
+	double F = 0;
+	const double a = SD.KmerCounts[uSeqIndex1];
+	const double b = SD.KmerCounts[uSeqIndex2];
+	if (uUnionCount > 0 && a > 0 && b > 0)
+		{
+		const double J = (double) uSharedCount/uUnionCount;
+		F = J*(a + b)/((1 + J)*Min2(a, b));
+		if (F > 1)
+			F = 1;
+		}
+	if (0.0 == F)
+		F = 0.01;
+
+	const double Y = log(0.02 + F);
+	double dEstimatedPctId = Y/4.12 + 0.995;
+	if (dEstimatedPctId < 0)
+		dEstimatedPctId = 0;
+	else if (dEstimatedPctId > 1)
+		dEstimatedPctId = 1;
+	assert(dEstimatedPctId >= 0 && dEstimatedPctId <= 1);
+#if	TRACE
+	Log("Sketch %u - %u shared %u/%u F=%6.4f %%id=%6.4f\n",
+	  uSeqIndex1, uSeqIndex2, uSharedCount, uUnionCount, F, dEstimatedPctId);
+#endif
+	return (float) (1 - dEstimatedPctId);
+	}
+
+void DistMinHash20_4(const SeqVect &v, DistFunc &DF)
+	{
+	if (ALPHA_Amino != g_Alpha)
+		Quit("DistMinHash20_4 requires amino alphabet");
+
+	const unsigned uSeqCount = v.GetSeqCount();
+
+	DF.SetCount(uSeqCount);
+	if (0 == uSeqCount)
+		return;
+
+	unsigned uMaxLength = 0;
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+		{
+		const unsigned uSeqLength = v.GetSeq(uSeqIndex).Length();
+		if (uSeqLength > uMaxLength)
+			uMaxLength = uSeqLength;
+		}
+
+	SKETCH_DIST SD;
+	SD.uSketchSize = g_uSketchSize;
+	if (0 == SD.uSketchSize)
+		Quit("-sketchsize must be > 0");
+	SD.Sketches = new unsigned[(size_t) uSeqCount*SD.uSketchSize];
+	SD.SketchLengths = new unsigned[uSeqCount];
+	SD.KmerCounts = new unsigned[uSeqCount];
+
+	byte *Letters = new byte[uMaxLength + 1];
+	unsigned *Hashes = new unsigned[uMaxLength + 1];
+	SetProgressDesc("MinHash sketches");
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+		{
+		if (0 == uSeqIndex%1000)
+			Progress(uSeqIndex, uSeqCount);
+		const unsigned uKmerCount = GetHashedKmers(v.GetSeq(uSeqIndex), Letters,
+		  Hashes);
+		const unsigned uLength = Min2(uKmerCount, SD.uSketchSize);
+		memcpy(SD.Sketches + (size_t) uSeqIndex*SD.uSketchSize, Hashes,
+		  uLength*sizeof(unsigned));
+		SD.SketchLengths[uSeqIndex] = uLength;
+		SD.KmerCounts[uSeqIndex] = uKmerCount;
+		}
+	ProgressStepsDone();
+	delete[] Letters;
+	delete[] Hashes;
+
+	SetProgressDesc("MinHash distance");
+	DistPairBlocks(uSeqCount, SD.uSketchSize*sizeof(unsigned), SketchDist, &SD, DF);
+	ProgressStepsDone();
+
+	delete[] SD.Sketches;
+	delete[] SD.SketchLengths;
+	delete[] SD.KmerCounts;
+	}
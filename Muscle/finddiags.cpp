@@ -6,7 +6,6 @@
 
 const unsigned KTUP = 5;
 const unsigned KTUPS = 6*6*6*6*6;
-static unsigned TuplePos[KTUPS];
 
 static char *TupleToStr(int t)
 	{
@@ -63,99 +62,5 @@ void FindDiags(const ProfPos *PX, unsigned uLengthX, const ProfPos *PY,
 	if (uLengthX < 12 || uLengthY < 12)
 		return;
 
-// Set A to shorter profile, B to longer
-	const ProfPos *PA;
-	const ProfPos *PB;
-	unsigned uLengthA;
-	unsigned uLengthB;
-	bool bSwap;
-	if (uLengthX < uLengthY)
-		{
-		bSwap = false;
-		PA = PX;
-		PB = PY;
-		uLengthA = uLengthX;
-		uLengthB = uLengthY;
-		}
-	else
-		{
-		bSwap = true;
-		PA = PY;
-		PB = PX;
-		uLengthA = uLengthY;
-		uLengthB = uLengthX;
-		}
-
-// Build tuple map for the longer profile, B
-	if (uLengthB < KTUP)
-		Quit("FindDiags: profile too short");
-
-	memset(TuplePos, EMPTY, sizeof(TuplePos));
-
-	for (unsigned uPos = 0; uPos < uLengthB - KTUP; ++uPos)
-		{
-		const unsigned uTuple = GetTuple(PB, uPos);
-		if (EMPTY == uTuple)
-			continue;
-		TuplePos[uTuple] = uPos;
-		}
-
-// Find matches
-	for (unsigned uPosA = 0; uPosA < uLengthA - KTUP; ++uPosA)
-		{
-		const unsigned uTuple = GetTuple(PA, uPosA);
-		if (EMPTY == uTuple)
-			continue;
-		const unsigned uPosB = TuplePos[uTuple];
-		if (EMPTY == uPosB)
-			continue;
-
-	// This tuple is found in both profiles
-		unsigned uStartPosA = uPosA;
-		unsigned uStartPosB = uPosB;
-
-	// Try to extend the match forwards
-		unsigned uEndPosA = uPosA + KTUP - 1;
-		unsigned uEndPosB = uPosB + KTUP - 1;
-		for (;;)
-			{
-			if (uLengthA - 1 == uEndPosA || uLengthB - 1 == uEndPosB)
-				break;
-			const unsigned uAAGroupA = PA[uEndPosA+1].m_uResidueGroup;
-			if (RESIDUE_GROUP_MULTIPLE == uAAGroupA)
-				break;
-			const unsigned uAAGroupB = PB[uEndPosB+1].m_uResidueGroup;
-			if (RESIDUE_GROUP_MULTIPLE == uAAGroupB)
-				break;
-			if (uAAGroupA != uAAGroupB)
-				break;
-			++uEndPosA;
-			++uEndPosB;
-			}
-		uPosA = uEndPosA;
-
-#if	TRACE
-		{
-		Log("Match: A %4u-%4u   ", uStartPosA, uEndPosA);
-		for (unsigned n = uStartPosA; n <= uEndPosA; ++n)
-			Log("%c", 'A' + PA[n].m_uResidueGroup);
-		Log("\n");
-		Log("       B %4u-%4u   ", uStartPosB, uEndPosB);
-		for (unsigned n = uStartPosB; n <= uEndPosB; ++n)
-			Log("%c", 'A' + PB[n].m_uResidueGroup);
-		Log("\n");
-		}
-#endif
-
-		const unsigned uLength = uEndPosA - uStartPosA + 1;
-		assert(uEndPosB - uStartPosB + 1 == uLength);
-
-		if (uLength >= g_uMinDiagLength)
-			{
-			if (bSwap)
-				DL.Add(uStartPosB, uStartPosA, uLength);
-			else
-				DL.Add(uStartPosA, uStartPosB, uLength);
-			}
-		}
+	FindDiagsSeeds(PX, uLengthX, PY, uLengthY, KTUP, KTUPS, GetTuple, DL);
 	}
@@ -17,6 +17,8 @@ TICKS g_ticksDP = 0;
 extern bool g_bKeepSimpleDP;
 SCORE NWSmall(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path);
+SCORE NWLinear(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
+  unsigned uLengthB, PWPath &Path);
 SCORE NWDASmall(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path);
 SCORE NWDASimple(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
@@ -26,14 +28,14 @@ SCORE NWDASimple2(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 SCORE GlobalAlignSimple(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path);
 
+#if	COMPARE_SIMPLE
+
 SCORE GlobalAlignNoDiags(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path)
 	{
 	return GlobalAlign(PA, uLengthA, PB, uLengthB, Path);
 	}
 
-#if	COMPARE_SIMPLE
-
 SCORE GlobalAlign(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path)
 	{
@@ -64,13 +66,53 @@ SCORE GlobalAlign(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 
 #else // COMPARE_SIMPLE
 
+// -dp352 uses the row aligners of 3.52 (GlobalAlignSP, SPN and LE,
+// with the SIMD row kernels for SP) instead of NWSmall. They need
+// non-empty profiles.
+static SCORE GlobalAlign352(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
+  unsigned uLengthB, PWPath &Path)
+	{
+	switch (g_PPScore)
+		{
+	case PPSCORE_LE:
+		return GlobalAlignLE(PA, uLengthA, PB, uLengthB, Path);
+
+	case PPSCORE_SP:
+	case PPSCORE_SV:
+		return GlobalAlignSP(PA, uLengthA, PB, uLengthB, Path);
+
+	case PPSCORE_SPN:
+		return GlobalAlignSPN(PA, uLengthA, PB, uLengthB, Path);
+
+	default:
+		break;
+		}
+
+	Quit("Invalid PP score (GlobalAlign352)");
+	return 0;
+	}
+
+SCORE GlobalAlignNoDiags(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
+  unsigned uLengthB, PWPath &Path)
+	{
+	if (g_bDP352 && uLengthA > 0 && uLengthB > 0)
+		return GlobalAlign352(PA, uLengthA, PB, uLengthB, Path);
+	if (UseNWLinear(uLengthA, uLengthB))
+		return NWLinear(PA, uLengthA, PB, uLengthB, Path);
+	return NWSmall(PA, uLengthA, PB, uLengthB, Path);
+	}
+
 SCORE GlobalAlign(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path)
 	{
 #if	TIMING
 	TICKS t1 = GetClockTicks();
 #endif
-	SCORE Score = NWSmall(PA, uLengthA, PB, uLengthB, Path);
+	SCORE Score;
+	if (g_bDiags)
+		Score = GlobalAlignDiags(PA, uLengthA, PB, uLengthB, Path);
+	else
+		Score = GlobalAlignNoDiags(PA, uLengthA, PB, uLengthB, Path);
 #if	TIMING
 	TICKS t2 = GetClockTicks();
 	g_ticksDP += (t2 - t1);
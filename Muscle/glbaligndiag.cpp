@@ -1,5 +1,4 @@
 #include "muscle.h"
-#include "dpreglist.h"
 #include "diaglist.h"
 #include "pwpath.h"
 #include "profile.h"
@@ -9,47 +8,93 @@
 #define TRACE_PATH	0
 #define LIST_DIAGS	0
 
-static double g_dDPAreaWithoutDiags = 0.0;
-static double g_dDPAreaWithDiags = 0.0;
+#define g_dDPAreaWithoutDiags	(GetDPWorkspace()->dDPAreaWithoutDiags)
+#define g_dDPAreaWithDiags		(GetDPWorkspace()->dDPAreaWithDiags)
 
-static void OffsetPath(PWPath &Path, unsigned uOffsetA, unsigned uOffsetB)
+// Half-width of the first band around the diagonals. Doubled each time
+// the best path touches the edge of the band.
+static const unsigned BAND_WIDTH = 16;
+
+// Give up on the band and do the full DP once the band covers more
+// than this fraction of the matrix.
+static const double MAX_BAND_FRACTION = 0.5;
+
+/***
+Band for NWBanded from the diagonals found by FindDiags.
+
+The skeleton is the path that follows each diagonal exactly and, in
+between, the rectangle from the end of one diagonal to the start of
+the next (and from (0,0) to the first, and from the last to the end).
+Diagonals are sorted and compatible after DeleteIncompatible, so the
+skeleton is monotone in both sequences.
+
+Row i of the band is the skeleton of rows i-W .. i+W widened by W
+columns on each side, so every cell within W of the skeleton in
+either direction is in the band.
+***/
+static void SkelRect(unsigned SkelLo[], unsigned SkelHi[], unsigned uFromA,
+  unsigned uFromB, unsigned uToA, unsigned uToB)
 	{
-	const unsigned uEdgeCount = Path.GetEdgeCount();
-	for (unsigned uEdgeIndex = 0; uEdgeIndex < uEdgeCount; ++uEdgeIndex)
+	for (unsigned i = uFromA; i <= uToA; ++i)
 		{
-		const PWEdge &Edge = Path.GetEdge(uEdgeIndex);
-
-	// Nasty hack -- poke new values back into path, circumventing class
-		PWEdge &NonConstEdge = (PWEdge &) Edge;
-		NonConstEdge.uPrefixLengthA += uOffsetA;
-		NonConstEdge.uPrefixLengthB += uOffsetB;
+		if (uFromB < SkelLo[i])
+			SkelLo[i] = uFromB;
+		if (uToB > SkelHi[i])
+			SkelHi[i] = uToB;
 		}
 	}
 
-static void DiagToPath(const Diag &d, PWPath &Path)
+static void MakeSkeleton(const DiagList &DL, unsigned uLengthA,
+  unsigned uLengthB, unsigned SkelLo[], unsigned SkelHi[])
 	{
-	Path.Clear();
-	const unsigned uLength = d.m_uLength;
-	for (unsigned i = 0; i < uLength; ++i)
+	for (unsigned i = 0; i <= uLengthA; ++i)
 		{
-		PWEdge Edge;
-		Edge.cType = 'M';
-		Edge.uPrefixLengthA = d.m_uStartPosA + i + 1;
-		Edge.uPrefixLengthB = d.m_uStartPosB + i + 1;
-		Path.AppendEdge(Edge);
+		SkelLo[i] = uLengthB;
+		SkelHi[i] = 0;
 		}
+
+	unsigned uPosA = 0;
+	unsigned uPosB = 0;
+	const unsigned uDiagCount = DL.GetCount();
+	for (unsigned uDiagIndex = 0; uDiagIndex < uDiagCount; ++uDiagIndex)
+		{
+		const Diag &d = DL.Get(uDiagIndex);
+		const unsigned uStartA = d.m_uStartPosA;
+		const unsigned uStartB = d.m_uStartPosB;
+		SkelRect(SkelLo, SkelHi, uPosA, uPosB, uStartA, uStartB);
+		for (unsigned t = 0; t <= d.m_uLength; ++t)
+			SkelRect(SkelLo, SkelHi, uStartA + t, uStartB + t, uStartA + t,
+			  uStartB + t);
+		uPosA = uStartA + d.m_uLength;
+		uPosB = uStartB + d.m_uLength;
+		}
+	SkelRect(SkelLo, SkelHi, uPosA, uPosB, uLengthA, uLengthB);
 	}
 
-static void AppendRegPath(PWPath &Path, const PWPath &RegPath)
+// Returns the number of cells in the band.
+static double MakeBand(const unsigned SkelLo[], const unsigned SkelHi[],
+  unsigned uLengthA, unsigned uLengthB, unsigned uWidth, unsigned Lo[],
+  unsigned Hi[])
 	{
-	const unsigned uRegEdgeCount = RegPath.GetEdgeCount();
-	for (unsigned uRegEdgeIndex = 0; uRegEdgeIndex < uRegEdgeCount; ++uRegEdgeIndex)
+	double dArea = 0.0;
+	for (unsigned i = 0; i <= uLengthA; ++i)
 		{
-		const PWEdge &RegEdge = RegPath.GetEdge(uRegEdgeIndex);
-		Path.AppendEdge(RegEdge);
+		const unsigned uRowLo = SkelLo[i < uWidth ? 0 : i - uWidth];
+		const unsigned uRowHi = SkelHi[i + uWidth > uLengthA ? uLengthA : i + uWidth];
+		Lo[i] = uRowLo < uWidth ? 0 : uRowLo - uWidth;
+		Hi[i] = uRowHi + uWidth > uLengthB ? uLengthB : uRowHi + uWidth;
+		dArea += Hi[i] - Lo[i] + 1;
 		}
+	return dArea;
 	}
 
+/***
+Diagonals found by k-mer matching are used to restrict the DP to a
+band around them. The band starts narrow and is doubled until the
+best path in the band keeps away from its edge, or until the band is
+so wide that the full DP is cheaper. Inside the band the recursion is
+that of NWSmall, so a path found this way scores as it would there.
+***/
 SCORE GlobalAlignDiags(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path)
 	{
@@ -86,80 +131,58 @@ SCORE GlobalAlignDiags(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 	DL.LogMe();
 #endif
 
-	DPRegionList RL;
-	DiagListToDPRegionList(DL, RL, uLengthA, uLengthB);
+	const double dFullArea = (double) (uLengthA + 1)*(double) (uLengthB + 1);
+	g_dDPAreaWithoutDiags += dFullArea;
 
-#if	TRACE
-	Log("RegionList:\n");
-	RL.LogMe();
-#endif
-
-#if	LIST_DIAGS
-	{
-	TICKS t2 = GetClockTicks();
-	unsigned uArea = RL.GetDPArea();
-	Log("ticks=%ld\n", (long) (t2 - t1));
-	Log("area=%u\n", uArea);
-	}
-#endif
+	if (0 == DL.GetCount())
+		{
+		g_dDPAreaWithDiags += dFullArea;
+		return GlobalAlignNoDiags(PA, uLengthA, PB, uLengthB, Path);
+		}
 
-	g_dDPAreaWithoutDiags += uLengthA*uLengthB;
+	unsigned *SkelLo = new unsigned[uLengthA + 1];
+	unsigned *SkelHi = new unsigned[uLengthA + 1];
+	unsigned *Lo = new unsigned[uLengthA + 1];
+	unsigned *Hi = new unsigned[uLengthA + 1];
+	MakeSkeleton(DL, uLengthA, uLengthB, SkelLo, SkelHi);
 
-	double dDPAreaWithDiags = 0.0;
-	const unsigned uRegionCount = RL.GetCount();
-	for (unsigned uRegionIndex = 0; uRegionIndex < uRegionCount; ++uRegionIndex)
+	bool bDone = false;
+	SCORE Score = 0;
+	for (unsigned uWidth = BAND_WIDTH; ; uWidth *= 2)
 		{
-		const DPRegion &r = RL.Get(uRegionIndex);
-
-		PWPath RegPath;
-		if (DPREGIONTYPE_Diag == r.m_Type)
-			{
-			DiagToPath(r.m_Diag, RegPath);
-#if	TRACE_PATH
-			Log("DiagToPath, path=\n");
-			RegPath.LogMe();
+		const double dArea = MakeBand(SkelLo, SkelHi, uLengthA, uLengthB, uWidth,
+		  Lo, Hi);
+#if	LIST_DIAGS
+		Log("width=%u area=%.3g full=%.3g\n", uWidth, dArea, dFullArea);
 #endif
-			}
-		else if (DPREGIONTYPE_Rect == r.m_Type)
+		if (dArea > MAX_BAND_FRACTION*dFullArea)
+			break;
+
+		g_dDPAreaWithDiags += dArea;
+		if (NWBanded(PA, uLengthA, PB, uLengthB, Lo, Hi, Path, &Score))
 			{
-			const unsigned uRegStartPosA = r.m_Rect.m_uStartPosA;
-			const unsigned uRegStartPosB = r.m_Rect.m_uStartPosB;
-			const unsigned uRegLengthA = r.m_Rect.m_uLengthA;
-			const unsigned uRegLengthB = r.m_Rect.m_uLengthB;
-			const ProfPos *RegPA = PA + uRegStartPosA;
-			const ProfPos *RegPB = PB + uRegStartPosB;
-
-			dDPAreaWithDiags += uRegLengthA*uRegLengthB;
-			GlobalAlignNoDiags(RegPA, uRegLengthA, RegPB, uRegLengthB, RegPath);
-#if	TRACE_PATH
-			Log("GlobalAlignNoDiags RegPath=\n");
-			RegPath.LogMe();
-#endif
-			OffsetPath(RegPath, uRegStartPosA, uRegStartPosB);
-#if	TRACE_PATH
-			Log("After offset path, RegPath=\n");
-			RegPath.LogMe();
-#endif
+			bDone = true;
+			break;
 			}
-		else
-			Quit("GlobalAlignDiags, Invalid region type %u", r.m_Type);
-
-		AppendRegPath(Path, RegPath);
-#if	TRACE_PATH
-		Log("After AppendPath, path=");
-		Path.LogMe();
-#endif
 		}
 
-#if	TRACE
+#if	LIST_DIAGS
 	{
-	double dDPAreaWithoutDiags = uLengthA*uLengthB;
-	Log("DP area with diags %.3g without %.3g pct saved %.3g %%\n",
-	  dDPAreaWithDiags, dDPAreaWithoutDiags, (1.0 - dDPAreaWithDiags/dDPAreaWithoutDiags)*100.0);
+	TICKS t2 = GetClockTicks();
+	Log("ticks=%ld %s\n", (long) (t2 - t1), bDone ? "banded" : "full");
 	}
 #endif
-	g_dDPAreaWithDiags += dDPAreaWithDiags;
-	return 0;
+
+	delete[] SkelLo;
+	delete[] SkelHi;
+	delete[] Lo;
+	delete[] Hi;
+
+	if (bDone)
+		return Score;
+
+	g_dDPAreaWithDiags += dFullArea;
+	return GlobalAlignNoDiags(PA, uLengthA, PB, uLengthB, Path);
 	}
 
 void ListDiagSavings()
@@ -1,120 +1,32 @@
 #include "muscle.h"
 #include "profile.h"
 #include "pwpath.h"
+#include <time.h>
 
-struct DP_MEMORY
-	{
-	unsigned uLength;
-	SCORE *GapOpenA;
-	SCORE *GapOpenB;
-	SCORE *GapCloseA;
-	SCORE *GapCloseB;
-	SCORE *MPrev;
-	SCORE *MCurr;
-	SCORE *MWork;
-	SCORE *DPrev;
-	SCORE *DCurr;
-	SCORE *DWork;
-	SCORE **MxRowA;
-	unsigned *LettersB;
-	SCORE **ScoreMxB;
-	unsigned **SortOrderA;
-	unsigned *uDeletePos;
-	FCOUNT **FreqsA;
-	int **TraceBack;
-	};
-
-static struct DP_MEMORY DPM;
-
-static void AllocDPMem(unsigned uLengthA, unsigned uLengthB)
-	{
-// Max prefix length
-	unsigned uLength = (uLengthA > uLengthB ? uLengthA : uLengthB) + 1;
-	if (uLength < DPM.uLength)
-		return;
-
-// Add 256 to allow for future expansion and
-// round up to next multiple of 32.
-	uLength += 256;
-	uLength += 32 - uLength%32;
-
-	const unsigned uOldLength = DPM.uLength;
-	if (uOldLength > 0)
-		{
-		for (unsigned i = 0; i < uOldLength; ++i)
-			{
-			delete[] DPM.TraceBack[i];
-			delete[] DPM.FreqsA[i];
-			delete[] DPM.SortOrderA[i];
-			}
-		for (unsigned n = 0; n < 20; ++n)
-			delete[] DPM.ScoreMxB[n];
-
-		delete[] DPM.MPrev;
-		delete[] DPM.MCurr;
-		delete[] DPM.MWork;
-		delete[] DPM.DPrev;
-		delete[] DPM.DCurr;
-		delete[] DPM.DWork;
-		delete[] DPM.uDeletePos;
-		delete[] DPM.GapOpenA;
-		delete[] DPM.GapOpenB;
-		delete[] DPM.GapCloseA;
-		delete[] DPM.GapCloseB;
-		delete[] DPM.SortOrderA;
-		delete[] DPM.FreqsA;
-		delete[] DPM.ScoreMxB;
-		delete[] DPM.TraceBack;
-		}
-
-	DPM.uLength = uLength;
-
-	DPM.GapOpenA = new SCORE[uLength];
-	DPM.GapOpenB = new SCORE[uLength];
-	DPM.GapCloseA = new SCORE[uLength];
-	DPM.GapCloseB = new SCORE[uLength];
-
-	DPM.SortOrderA = new unsigned*[uLength];
-	DPM.FreqsA = new FCOUNT*[uLength];
-	DPM.ScoreMxB = new SCORE*[20];
-	DPM.MPrev = new SCORE[uLength];
-	DPM.MCurr = new SCORE[uLength];
-	DPM.MWork = new SCORE[uLength];
-
-	DPM.DPrev = new SCORE[uLength];
-	DPM.DCurr = new SCORE[uLength];
-	DPM.DWork = new SCORE[uLength];
-	DPM.uDeletePos = new unsigned[uLength];
-
-	DPM.TraceBack = new int*[uLength];
-
-	for (unsigned uLetter = 0; uLetter < 20; ++uLetter)
-		DPM.ScoreMxB[uLetter] = new SCORE[uLength];
-
-	for (unsigned i = 0; i < uLength; ++i)
-		{
-		DPM.SortOrderA[i] = new unsigned[20];
-		DPM.FreqsA[i] = new FCOUNT[20];
-		DPM.TraceBack[i] = new int[uLength];
-		}
-	}
+#define RowFn		(GetDPWorkspace()->SPRowFn)
+#define RowFnName	(GetDPWorkspace()->SPRowFnName)
+#define g_dSPCells	(GetDPWorkspace()->dSPCells)
+#define g_tSPTicks	(GetDPWorkspace()->tSPTicks)
 
 SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path)
 	{
-	const unsigned uPrefixCountA = uLengthA + 1;
-	const unsigned uPrefixCountB = uLengthB + 1;
+	DP_MEMORY &DPM = GetDPWorkspace()->DPMemSP;
+	AllocDPMem(DPM, uLengthA, uLengthB, 20);
 
-	AllocDPMem(uLengthA, uLengthB);
+	if (0 == RowFnName)
+		RowFn = GetSPRowFn(&RowFnName);
+	const clock_t tStart = clock();
 
 	SCORE *GapOpenA = DPM.GapOpenA;
 	SCORE *GapOpenB = DPM.GapOpenB;
 	SCORE *GapCloseA = DPM.GapCloseA;
 	SCORE *GapCloseB = DPM.GapCloseB;
 
-	unsigned **SortOrderA = DPM.SortOrderA;
-	FCOUNT **FreqsA = DPM.FreqsA;
-	SCORE **ScoreMxB = DPM.ScoreMxB;
+	unsigned *SortOrderA = DPM.SortOrderA;
+	FCOUNT *FreqsA = DPM.FreqsA;
+	SCORE *ScoreMxB = DPM.ScoreMxB;
+	const unsigned uStride = DPM.uLength;
 	SCORE *MPrev = DPM.MPrev;
 	SCORE *MCurr = DPM.MCurr;
 	SCORE *MWork = DPM.MWork;
@@ -124,17 +36,21 @@ SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 	SCORE *DWork = DPM.DWork;
 	unsigned *uDeletePos = DPM.uDeletePos;
 
-	int **TraceBack = DPM.TraceBack;
+	unsigned char *TBRow = DPM.TBRow;
+	AllocPackedTB(DPM.TB, uLengthA, uLengthB);
 
 	for (unsigned i = 0; i < uLengthA; ++i)
 		{
 		GapOpenA[i] = PA[i].m_scoreGapOpen;
 		GapCloseA[i] = PA[i].m_scoreGapClose;
 
-		for (unsigned uLetter = 0; uLetter < 20; ++uLetter)
+	// Letters with non-zero counts, then a zero count as terminator.
+		const unsigned uLetterCount = PA[i].m_uLetterCount;
+		for (unsigned n = 0; n < 20; ++n)
 			{
-			SortOrderA[i][uLetter] = PA[i].m_uSortOrder[uLetter];
-			FreqsA[i][uLetter] = PA[i].m_fcCounts[uLetter];
+			const unsigned uLetter = (n < uLetterCount) ? PA[i].m_uLetters[n] : 0;
+			SortOrderA[i*20 + n] = uLetter;
+			FreqsA[i*20 + n] = (n < uLetterCount) ? PA[i].m_fcCounts[uLetter] : 0;
 			}
 		}
 
@@ -147,30 +63,18 @@ SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 	for (unsigned uLetter = 0; uLetter < 20; ++uLetter)
 		{
 		for (unsigned j = 0; j < uLengthB; ++j)
-			ScoreMxB[uLetter][j] = PB[j].m_AAScores[uLetter];
+			ScoreMxB[uLetter*uStride + j] = PB[j].m_AAScores[uLetter];
 		}
 
-	for (unsigned i = 0; i < uPrefixCountA; ++i)
-		memset(TraceBack[i], 0, uPrefixCountB*sizeof(int));
-
 // Special case for i=0
-	unsigned **ptrSortOrderA = SortOrderA;
-	FCOUNT **ptrFreqsA = FreqsA;
-	assert(ptrSortOrderA == &(SortOrderA[0]));
-	assert(ptrFreqsA == &(FreqsA[0]));
-	TraceBack[0][0] = 0;
-
 	SCORE scoreSum = 0;
-	unsigned *ptrSortOrderAi = SortOrderA[0];
-	const unsigned *ptrSortOrderAEnd = ptrSortOrderAi + 20;
-	FCOUNT *ptrFreqsAi = FreqsA[0];
-	for (; ptrSortOrderAi != ptrSortOrderAEnd; ++ptrSortOrderAi)
+	for (unsigned n = 0; n < 20; ++n)
 		{
-		const unsigned uLetter = *ptrSortOrderAi;
-		const FCOUNT fcLetter = ptrFreqsAi[uLetter];
+		const unsigned uLetter = SortOrderA[n];
+		const FCOUNT fcLetter = FreqsA[n];
 		if (0 == fcLetter)
 			break;
-		scoreSum += fcLetter*ScoreMxB[uLetter][0];
+		scoreSum += fcLetter*ScoreMxB[uLetter*uStride];
 		}
 	MPrev[0] = scoreSum - g_scoreCenter;
 
@@ -185,19 +89,15 @@ SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 	//			0   j
 	// So gap-open at j=0, gap-close at j-1.
 		SCORE scoreSum = 0;
-		unsigned *ptrSortOrderAi = SortOrderA[0];
-		const unsigned *ptrSortOrderAEnd = ptrSortOrderAi + 20;
-		FCOUNT *ptrFreqsAi = FreqsA[0];
-		for (; ptrSortOrderAi != ptrSortOrderAEnd; ++ptrSortOrderAi)
+		for (unsigned n = 0; n < 20; ++n)
 			{
-			const unsigned uLetter = *ptrSortOrderAi;
-			const FCOUNT fcLetter = ptrFreqsAi[uLetter];
+			const unsigned uLetter = SortOrderA[n];
+			const FCOUNT fcLetter = FreqsA[n];
 			if (0 == fcLetter)
 				break;
-			scoreSum += fcLetter*ScoreMxB[uLetter][j];
+			scoreSum += fcLetter*ScoreMxB[uLetter*uStride + j];
 			}
 		MPrev[j] = scoreSum - g_scoreCenter + GapOpenB[0] + GapCloseB[j-1];
-		TraceBack[0][j] = -(int) j;
 
 	// Assume no D->I transitions, then can't be a delete if only
 	// one letter from A.
@@ -207,28 +107,33 @@ SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 	SCORE IPrev_j_1;
 	for (unsigned i = 1; i < uLengthA; ++i)
 		{
-		++ptrSortOrderA;
-		++ptrFreqsA;
-		assert(ptrSortOrderA == &(SortOrderA[i]));
-		assert(ptrFreqsA == &(FreqsA[i]));
+		const unsigned *SortOrderAi = SortOrderA + i*20;
+		const FCOUNT *FreqsAi = FreqsA + i*20;
+
+		if (0 != RowFn)
+			{
+			RowFn(i, uLengthB, SortOrderAi, FreqsAi, ScoreMxB, uStride,
+			  MPrev, MCurr, DPrev, DCurr, uDeletePos, GapOpenB, GapCloseB,
+			  GapOpenA[i], GapCloseA[i-1], g_scoreCenter,
+			  GapOpenA[0] + GapCloseA[i-1], TBRow);
+			PackTBRow(DPM.TB, i, TBRow, uLengthB);
+			Rotate(MPrev, MCurr, MWork);
+			Rotate(DPrev, DCurr, DWork);
+			continue;
+			}
 
 		SCORE *ptrMCurr_j = MCurr;
 		memset(ptrMCurr_j, 0, uLengthB*sizeof(SCORE));
-		const FCOUNT *FreqsAi = *ptrFreqsA;
 
-		const unsigned *SortOrderAi = *ptrSortOrderA;
-		const unsigned *ptrSortOrderAiEnd = SortOrderAi + 20;
 		const SCORE *ptrMCurrMax = MCurr + uLengthB;
-		for (const unsigned *ptrSortOrderAi = SortOrderAi;
-		  ptrSortOrderAi != ptrSortOrderAiEnd;
-		  ++ptrSortOrderAi)
+		for (unsigned n = 0; n < 20; ++n)
 			{
-			const unsigned uLetter = *ptrSortOrderAi;
-			SCORE *NSBR_Letter = ScoreMxB[uLetter];
-			const FCOUNT fcLetter = FreqsAi[uLetter];
+			const unsigned uLetter = SortOrderAi[n];
+			const SCORE *NSBR_Letter = ScoreMxB + uLetter*uStride;
+			const FCOUNT fcLetter = FreqsAi[n];
 			if (0 == fcLetter)
 				break;
-			SCORE *ptrNSBR = NSBR_Letter;
+			const SCORE *ptrNSBR = NSBR_Letter;
 			for (SCORE *ptrMCurr = MCurr; ptrMCurr != ptrMCurrMax; ++ptrMCurr)
 				*ptrMCurr += fcLetter*(*ptrNSBR++);
 			}
@@ -250,8 +155,8 @@ SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 
 		++ptrMCurr_j;
 
-		int *ptrTraceBack_ij = TraceBack[i];
-		*ptrTraceBack_ij++ = (int) i;
+		TBRow[0] = 0;
+		unsigned char *ptrTB_ij = TBRow + 1;
 
 		SCORE *ptrMPrev_j = MPrev;
 		SCORE *ptrDPrev = DPrev;
@@ -261,6 +166,7 @@ SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 			{
 			d = DNew;
 			*ptrDeletePos = i;
+			TBRow[0] = TB_DOPEN;
 			}
 
 		SCORE *ptrDCurr = DCurr;
@@ -271,7 +177,6 @@ SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 	// Can't have an insert if no letters from B
 		IPrev_j_1 = MINUS_INFINITY;
 
-		unsigned uInsertPos;
 		const SCORE scoreGapOpenAi = GapOpenA[i];
 		const SCORE scoreGapCloseAi_1 = GapCloseA[i-1];
 
@@ -280,14 +185,16 @@ SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 		// Here, MPrev_j is preserved from previous
 		// iteration so with current i,j is M[i-1][j-1]
 			SCORE MPrev_j = *ptrMPrev_j;
+			unsigned char TBOpen = 0;
 			SCORE INew = MPrev_j + GapOpenB[j];
 			if (INew > IPrev_j_1)
 				{
 				IPrev_j_1 = INew;
-				uInsertPos = j;
+				TBOpen = TB_IOPEN;
 				}
 
 			SCORE scoreMax = MPrev_j;
+			unsigned char TBType = TB_M;
 
 			assert(ptrDPrev == &(DPrev[j-1]));
 			SCORE scoreD = *ptrDPrev++ + scoreGapCloseAi_1;
@@ -295,8 +202,7 @@ SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 				{
 				scoreMax = scoreD;
 				assert(ptrDeletePos == &(uDeletePos[j-1]));
-				*ptrTraceBack_ij = (int) i - (int) *ptrDeletePos;
-				assert(*ptrTraceBack_ij > 0);
+				TBType = TB_D;
 				}
 			++ptrDeletePos;
 
@@ -304,13 +210,9 @@ SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 			if (scoreI > scoreMax)
 				{
 				scoreMax = scoreI;
-				*ptrTraceBack_ij = (int) uInsertPos - (int) j;
-				assert(*ptrTraceBack_ij < 0);
+				TBType = TB_I;
 				}
 
-			assert(ptrSortOrderA == &(SortOrderA[i]));
-			assert(ptrFreqsA == &(FreqsA[i]));
-
 			*ptrMCurr_j += scoreMax;
 			assert(ptrMCurr_j == &(MCurr[j]));
 			++ptrMCurr_j;
@@ -324,13 +226,15 @@ SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 				d = DNew;
 				assert(ptrDeletePos == &uDeletePos[j]);
 				*ptrDeletePos = i;
+				TBOpen |= TB_DOPEN;
 				}
 			assert(ptrDCurr + 1 == &(DCurr[j]));
 			*(++ptrDCurr) = d;
 
-			++ptrTraceBack_ij;
+			*ptrTB_ij++ = TBOpen | TBType;
 			}
 
+		PackTBRow(DPM.TB, i, TBRow, uLengthB);
 		Rotate(MPrev, MCurr, MWork);
 		Rotate(DPrev, DCurr, DWork);
 		}
@@ -368,9 +272,23 @@ SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 		iTraceBack = (int) uInsertPos - (int) uLengthB;
 		}
 
-	TraceBack[uLengthA][uLengthB] = iTraceBack;
+	DPM.TB.iLastTB = iTraceBack;
+
+	g_tSPTicks += clock() - tStart;
+	g_dSPCells += (double) uLengthA*(double) uLengthB;
 
-	TraceBackToPath(TraceBack, uLengthA, uLengthB, Path);
+	TraceBackToPath(DPM.TB, uLengthA, uLengthB, Path);
 
 	return scoreMax;
 	}
+
+void ListSPStats()
+	{
+	if (0 == g_dSPCells)
+		return;
+	const double dSecs = (double) g_tSPTicks/CLOCKS_PER_SEC;
+	Log("GlobalAlignSP (%s) %.3g cells, %.2f secs", RowFnName, g_dSPCells, dSecs);
+	if (dSecs > 0)
+		Log(", %.3g cell updates/sec", g_dSPCells/dSecs);
+	Log("\n");
+	}
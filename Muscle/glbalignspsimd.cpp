@@ -0,0 +1,424 @@
+#include "muscle.h"
+#include "profile.h"
+#include "simd.h"
+
+// Vectorized row kernels for GlobalAlignSP.
+// Each call computes one row i (1 <= i < uLengthA) of the M and D
+// recurrences plus the trace-back row, processing several B-columns
+// per instruction (4 with SSE4.1, 8 with AVX2). Scores are float,
+// and every cell is computed with exactly the same sequence of
+// float adds and compares as the scalar loop in GlobalAlignSP, so
+// the resulting paths are identical.
+// The row is done in three passes:
+//	1. Match scores: sum over A's letters of freq*ScoreMxB[letter*uStride + j].
+//	2. D recurrence, independent across j.
+//	3. I recurrence, a running max with earliest-position ties,
+//	   computed as an in-register prefix scan, then the M recurrence.
+
+#if	SIMD_SSE4 || SIMD_AVX2
+#include <math.h>
+#endif
+
+#if	defined(_MANAGED)
+#pragma managed(push, off)
+#endif
+
+#if	SIMD_SSE4
+
+// Trace-back bytes of 4 cells to and from 32-bit lanes.
+TARGET_SSE4 static inline __m128i LoadTB4(const unsigned char *p)
+	{
+	int n;
+	memcpy(&n, p, 4);
+	return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(n));
+	}
+
+TARGET_SSE4 static inline void StoreTB4(unsigned char *p, __m128i v)
+	{
+	v = _mm_packus_epi32(v, v);
+	v = _mm_packus_epi16(v, v);
+	const int n = _mm_cvtsi128_si32(v);
+	memcpy(p, &n, 4);
+	}
+
+TARGET_SSE4 static inline void ScanMax4(__m128 &v, __m128i &p)
+	{
+// Prefix max over 4 lanes, ties go to the lower lane.
+	const __m128 Fill = _mm_set1_ps(-HUGE_VALF);
+	__m128 sv = _mm_blend_ps(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)), Fill, 1);
+	__m128i sp = _mm_slli_si128(p, 4);
+	__m128 m = _mm_cmpgt_ps(v, sv);
+	v = _mm_blendv_ps(sv, v, m);
+	p = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(sp), _mm_castsi128_ps(p), m));
+
+	sv = _mm_blend_ps(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)), Fill, 3);
+	sp = _mm_slli_si128(p, 8);
+	m = _mm_cmpgt_ps(v, sv);
+	v = _mm_blendv_ps(sv, v, m);
+	p = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(sp), _mm_castsi128_ps(p), m));
+	}
+
+TARGET_SSE4 static void SPRowSSE4(unsigned i, unsigned uLengthB,
+  const unsigned SortOrderAi[], const FCOUNT FreqsAi[], const SCORE ScoreMxB[],
+  unsigned uStride,
+  const SCORE MPrev[], SCORE MCurr[], const SCORE DPrev[], SCORE DCurr[],
+  unsigned uDeletePos[], const SCORE GapOpenB[], const SCORE GapCloseB[],
+  SCORE scoreGapOpenAi, SCORE scoreGapCloseAi_1, SCORE scoreCenter,
+  SCORE scoreM0Gap, unsigned char TBRow[])
+	{
+	const SCORE *ScoreRows[20];
+	__m128 vFreqs[20];
+	unsigned uLetterCount = 0;
+	for (; uLetterCount < 20; ++uLetterCount)
+		{
+		const unsigned uLetter = SortOrderAi[uLetterCount];
+		const FCOUNT fcLetter = FreqsAi[uLetterCount];
+		if (0 == fcLetter)
+			break;
+		ScoreRows[uLetterCount] = ScoreMxB + uLetter*uStride;
+		vFreqs[uLetterCount] = _mm_set1_ps(fcLetter);
+		}
+	const __m128 vCenter = _mm_set1_ps(scoreCenter);
+
+// Pass 1: match scores into MCurr.
+	unsigned j = 0;
+	for (; j + 4 <= uLengthB; j += 4)
+		{
+		__m128 vSum = _mm_setzero_ps();
+		for (unsigned n = 0; n < uLetterCount; ++n)
+			vSum = _mm_add_ps(vSum, _mm_mul_ps(vFreqs[n],
+			  _mm_loadu_ps(ScoreRows[n] + j)));
+		_mm_storeu_ps(MCurr + j, _mm_sub_ps(vSum, vCenter));
+		}
+	for (; j < uLengthB; ++j)
+		{
+		SCORE scoreSum = 0;
+		for (unsigned n = 0; n < uLetterCount; ++n)
+			scoreSum += FreqsAi[n]*ScoreRows[n][j];
+		MCurr[j] = scoreSum - scoreCenter;
+		}
+	MCurr[0] += scoreM0Gap;
+
+// Pass 2: D(i, j) and its gap-open position, all columns.
+	const __m128 vGapOpenAi = _mm_set1_ps(scoreGapOpenAi);
+	const __m128i vi = _mm_set1_epi32((int) i);
+	const __m128i vDOpen = _mm_set1_epi32(TB_DOPEN);
+	for (j = 0; j + 4 <= uLengthB; j += 4)
+		{
+		const __m128 d = _mm_loadu_ps(DPrev + j);
+		const __m128 DNew = _mm_add_ps(_mm_loadu_ps(MPrev + j), vGapOpenAi);
+		const __m128 m = _mm_cmpgt_ps(DNew, d);
+		_mm_storeu_ps(DCurr + j, _mm_blendv_ps(d, DNew, m));
+		__m128i *ptrPos = (__m128i *) (uDeletePos + j);
+		const __m128i Pos = _mm_loadu_si128(ptrPos);
+		_mm_storeu_si128(ptrPos, _mm_castps_si128(_mm_blendv_ps(
+		  _mm_castsi128_ps(Pos), _mm_castsi128_ps(vi), m)));
+		StoreTB4(TBRow + j, _mm_and_si128(_mm_castps_si128(m), vDOpen));
+		}
+	for (; j < uLengthB; ++j)
+		{
+		SCORE d = DPrev[j];
+		SCORE DNew = MPrev[j] + scoreGapOpenAi;
+		unsigned char TBOpen = 0;
+		if (DNew > d)
+			{
+			d = DNew;
+			uDeletePos[j] = i;
+			TBOpen = TB_DOPEN;
+			}
+		DCurr[j] = d;
+		TBRow[j] = TBOpen;
+		}
+
+// Pass 3: I and M, j >= 1.
+	const __m128 vGapCloseAi_1 = _mm_set1_ps(scoreGapCloseAi_1);
+	const __m128i vLane = _mm_setr_epi32(0, 1, 2, 3);
+	const __m128i vTBD = _mm_set1_epi32(TB_D);
+	const __m128i vTBI = _mm_set1_epi32(TB_I);
+	const __m128i vIOpen = _mm_set1_epi32(TB_IOPEN);
+	__m128 vICarry = _mm_set1_ps(MINUS_INFINITY);
+	__m128i vPosCarry = _mm_setzero_si128();
+	for (j = 1; j + 4 <= uLengthB; j += 4)
+		{
+		const __m128i vj = _mm_add_epi32(_mm_set1_epi32((int) j), vLane);
+		const __m128 MPrev_j = _mm_loadu_ps(MPrev + j - 1);
+
+		__m128 I = _mm_add_ps(MPrev_j, _mm_loadu_ps(GapOpenB + j));
+		__m128i Pos = vj;
+		ScanMax4(I, Pos);
+		__m128 m = _mm_cmpgt_ps(I, vICarry);
+		I = _mm_blendv_ps(vICarry, I, m);
+		Pos = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(vPosCarry),
+		  _mm_castsi128_ps(Pos), m));
+		vICarry = _mm_shuffle_ps(I, I, _MM_SHUFFLE(3, 3, 3, 3));
+		vPosCarry = _mm_shuffle_epi32(Pos, _MM_SHUFFLE(3, 3, 3, 3));
+
+		__m128 scoreMax = MPrev_j;
+		__m128i TBType = _mm_setzero_si128();
+
+		const __m128 scoreD = _mm_add_ps(_mm_loadu_ps(DPrev + j - 1), vGapCloseAi_1);
+		m = _mm_cmpgt_ps(scoreD, scoreMax);
+		scoreMax = _mm_blendv_ps(scoreMax, scoreD, m);
+		TBType = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(TBType),
+		  _mm_castsi128_ps(vTBD), m));
+
+		const __m128 scoreI = _mm_add_ps(I, _mm_loadu_ps(GapCloseB + j - 1));
+		m = _mm_cmpgt_ps(scoreI, scoreMax);
+		scoreMax = _mm_blendv_ps(scoreMax, scoreI, m);
+		TBType = _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(TBType),
+		  _mm_castsi128_ps(vTBI), m));
+
+	// The insert was opened here if its position is this column.
+		const __m128i TBOpen = _mm_or_si128(LoadTB4(TBRow + j),
+		  _mm_and_si128(_mm_cmpeq_epi32(Pos, vj), vIOpen));
+
+		_mm_storeu_ps(MCurr + j, _mm_add_ps(_mm_loadu_ps(MCurr + j), scoreMax));
+		StoreTB4(TBRow + j, _mm_or_si128(TBOpen, TBType));
+		}
+
+	SCORE IPrev = _mm_cvtss_f32(vICarry);
+	for (; j < uLengthB; ++j)
+		{
+		const SCORE MPrev_j = MPrev[j-1];
+		const SCORE INew = MPrev_j + GapOpenB[j];
+		unsigned char TBOpen = TBRow[j];
+		if (INew > IPrev)
+			{
+			IPrev = INew;
+			TBOpen |= TB_IOPEN;
+			}
+		unsigned char TBType = TB_M;
+		SCORE scoreMax = MPrev_j;
+		const SCORE scoreD = DPrev[j-1] + scoreGapCloseAi_1;
+		if (scoreD > scoreMax)
+			{
+			scoreMax = scoreD;
+			TBType = TB_D;
+			}
+		const SCORE scoreI = IPrev + GapCloseB[j-1];
+		if (scoreI > scoreMax)
+			{
+			scoreMax = scoreI;
+			TBType = TB_I;
+			}
+		MCurr[j] += scoreMax;
+		TBRow[j] = TBOpen | TBType;
+		}
+	}
+
+#endif	// SIMD_SSE4
+
+#if	SIMD_AVX2
+
+TARGET_AVX2 static inline __m256i LoadTB8(const unsigned char *p)
+	{
+	return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) p));
+	}
+
+TARGET_AVX2 static inline void StoreTB8(unsigned char *p, __m256i v)
+	{
+	__m128i w = _mm_packus_epi32(_mm256_castsi256_si128(v),
+	  _mm256_extracti128_si256(v, 1));
+	w = _mm_packus_epi16(w, w);
+	_mm_storel_epi64((__m128i *) p, w);
+	}
+
+TARGET_AVX2 static inline void ScanMax8(__m256 &v, __m256i &p)
+	{
+// Prefix max over 8 lanes, ties go to the lower lane.
+	const __m256 Fill = _mm256_set1_ps(-HUGE_VALF);
+	const __m256i Shift1 = _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6);
+	const __m256i Shift2 = _mm256_setr_epi32(0, 0, 0, 1, 2, 3, 4, 5);
+	const __m256i Shift4 = _mm256_setr_epi32(0, 0, 0, 0, 0, 1, 2, 3);
+
+	__m256 sv = _mm256_blend_ps(_mm256_permutevar8x32_ps(v, Shift1), Fill, 0x01);
+	__m256i sp = _mm256_permutevar8x32_epi32(p, Shift1);
+	__m256 m = _mm256_cmp_ps(v, sv, _CMP_GT_OQ);
+	v = _mm256_blendv_ps(sv, v, m);
+	p = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(sp), _mm256_castsi256_ps(p), m));
+
+	sv = _mm256_blend_ps(_mm256_permutevar8x32_ps(v, Shift2), Fill, 0x03);
+	sp = _mm256_permutevar8x32_epi32(p, Shift2);
+	m = _mm256_cmp_ps(v, sv, _CMP_GT_OQ);
+	v = _mm256_blendv_ps(sv, v, m);
+	p = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(sp), _mm256_castsi256_ps(p), m));
+
+	sv = _mm256_blend_ps(_mm256_permutevar8x32_ps(v, Shift4), Fill, 0x0f);
+	sp = _mm256_permutevar8x32_epi32(p, Shift4);
+	m = _mm256_cmp_ps(v, sv, _CMP_GT_OQ);
+	v = _mm256_blendv_ps(sv, v, m);
+	p = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(sp), _mm256_castsi256_ps(p), m));
+	}
+
+TARGET_AVX2 static void SPRowAVX2(unsigned i, unsigned uLengthB,
+  const unsigned SortOrderAi[], const FCOUNT FreqsAi[], const SCORE ScoreMxB[],
+  unsigned uStride,
+  const SCORE MPrev[], SCORE MCurr[], const SCORE DPrev[], SCORE DCurr[],
+  unsigned uDeletePos[], const SCORE GapOpenB[], const SCORE GapCloseB[],
+  SCORE scoreGapOpenAi, SCORE scoreGapCloseAi_1, SCORE scoreCenter,
+  SCORE scoreM0Gap, unsigned char TBRow[])
+	{
+	const SCORE *ScoreRows[20];
+	__m256 vFreqs[20];
+	unsigned uLetterCount = 0;
+	for (; uLetterCount < 20; ++uLetterCount)
+		{
+		const unsigned uLetter = SortOrderAi[uLetterCount];
+		const FCOUNT fcLetter = FreqsAi[uLetterCount];
+		if (0 == fcLetter)
+			break;
+		ScoreRows[uLetterCount] = ScoreMxB + uLetter*uStride;
+		vFreqs[uLetterCount] = _mm256_set1_ps(fcLetter);
+		}
+	const __m256 vCenter = _mm256_set1_ps(scoreCenter);
+
+// Pass 1: match scores into MCurr. Multiply and add are kept as
+// separate instructions (no FMA) to round exactly like the scalar code.
+	unsigned j = 0;
+	for (; j + 8 <= uLengthB; j += 8)
+		{
+		__m256 vSum = _mm256_setzero_ps();
+		for (unsigned n = 0; n < uLetterCount; ++n)
+			vSum = _mm256_add_ps(vSum, _mm256_mul_ps(vFreqs[n],
+			  _mm256_loadu_ps(ScoreRows[n] + j)));
+		_mm256_storeu_ps(MCurr + j, _mm256_sub_ps(vSum, vCenter));
+		}
+	for (; j < uLengthB; ++j)
+		{
+		SCORE scoreSum = 0;
+		for (unsigned n = 0; n < uLetterCount; ++n)
+			scoreSum += FreqsAi[n]*ScoreRows[n][j];
+		MCurr[j] = scoreSum - scoreCenter;
+		}
+	MCurr[0] += scoreM0Gap;
+
+// Pass 2: D(i, j) and its gap-open position, all columns.
+	const __m256 vGapOpenAi = _mm256_set1_ps(scoreGapOpenAi);
+	const __m256i vi = _mm256_set1_epi32((int) i);
+	const __m256i vDOpen = _mm256_set1_epi32(TB_DOPEN);
+	for (j = 0; j + 8 <= uLengthB; j += 8)
+		{
+		const __m256 d = _mm256_loadu_ps(DPrev + j);
+		const __m256 DNew = _mm256_add_ps(_mm256_loadu_ps(MPrev + j), vGapOpenAi);
+		const __m256 m = _mm256_cmp_ps(DNew, d, _CMP_GT_OQ);
+		_mm256_storeu_ps(DCurr + j, _mm256_blendv_ps(d, DNew, m));
+		__m256i *ptrPos = (__m256i *) (uDeletePos + j);
+		const __m256i Pos = _mm256_loadu_si256(ptrPos);
+		_mm256_storeu_si256(ptrPos, _mm256_blendv_epi8(Pos, vi, _mm256_castps_si256(m)));
+		StoreTB8(TBRow + j, _mm256_and_si256(_mm256_castps_si256(m), vDOpen));
+		}
+	for (; j < uLengthB; ++j)
+		{
+		SCORE d = DPrev[j];
+		SCORE DNew = MPrev[j] + scoreGapOpenAi;
+		unsigned char TBOpen = 0;
+		if (DNew > d)
+			{
+			d = DNew;
+			uDeletePos[j] = i;
+			TBOpen = TB_DOPEN;
+			}
+		DCurr[j] = d;
+		TBRow[j] = TBOpen;
+		}
+
+// Pass 3: I and M, j >= 1.
+	const __m256 vGapCloseAi_1 = _mm256_set1_ps(scoreGapCloseAi_1);
+	const __m256i vLane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i Last = _mm256_set1_epi32(7);
+	const __m256i vTBD = _mm256_set1_epi32(TB_D);
+	const __m256i vTBI = _mm256_set1_epi32(TB_I);
+	const __m256i vIOpen = _mm256_set1_epi32(TB_IOPEN);
+	__m256 vICarry = _mm256_set1_ps(MINUS_INFINITY);
+	__m256i vPosCarry = _mm256_setzero_si256();
+	for (j = 1; j + 8 <= uLengthB; j += 8)
+		{
+		const __m256i vj = _mm256_add_epi32(_mm256_set1_epi32((int) j), vLane);
+		const __m256 MPrev_j = _mm256_loadu_ps(MPrev + j - 1);
+
+		__m256 I = _mm256_add_ps(MPrev_j, _mm256_loadu_ps(GapOpenB + j));
+		__m256i Pos = vj;
+		ScanMax8(I, Pos);
+		__m256 m = _mm256_cmp_ps(I, vICarry, _CMP_GT_OQ);
+		I = _mm256_blendv_ps(vICarry, I, m);
+		Pos = _mm256_blendv_epi8(vPosCarry, Pos, _mm256_castps_si256(m));
+		vICarry = _mm256_permutevar8x32_ps(I, Last);
+		vPosCarry = _mm256_permutevar8x32_epi32(Pos, Last);
+
+		__m256 scoreMax = MPrev_j;
+		__m256i TBType = _mm256_setzero_si256();
+
+		const __m256 scoreD = _mm256_add_ps(_mm256_loadu_ps(DPrev + j - 1), vGapCloseAi_1);
+		m = _mm256_cmp_ps(scoreD, scoreMax, _CMP_GT_OQ);
+		scoreMax = _mm256_blendv_ps(scoreMax, scoreD, m);
+		TBType = _mm256_blendv_epi8(TBType, vTBD, _mm256_castps_si256(m));
+
+		const __m256 scoreI = _mm256_add_ps(I, _mm256_loadu_ps(GapCloseB + j - 1));
+		m = _mm256_cmp_ps(scoreI, scoreMax, _CMP_GT_OQ);
+		scoreMax = _mm256_blendv_ps(scoreMax, scoreI, m);
+		TBType = _mm256_blendv_epi8(TBType, vTBI, _mm256_castps_si256(m));
+
+		const __m256i TBOpen = _mm256_or_si256(LoadTB8(TBRow + j),
+		  _mm256_and_si256(_mm256_cmpeq_epi32(Pos, vj), vIOpen));
+
+		_mm256_storeu_ps(MCurr + j, _mm256_add_ps(_mm256_loadu_ps(MCurr + j), scoreMax));
+		StoreTB8(TBRow + j, _mm256_or_si256(TBOpen, TBType));
+		}
+
+	SCORE IPrev = _mm_cvtss_f32(_mm256_castps256_ps128(vICarry));
+	for (; j < uLengthB; ++j)
+		{
+		const SCORE MPrev_j = MPrev[j-1];
+		const SCORE INew = MPrev_j + GapOpenB[j];
+		unsigned char TBOpen = TBRow[j];
+		if (INew > IPrev)
+			{
+			IPrev = INew;
+			TBOpen |= TB_IOPEN;
+			}
+		unsigned char TBType = TB_M;
+		SCORE scoreMax = MPrev_j;
+		const SCORE scoreD = DPrev[j-1] + scoreGapCloseAi_1;
+		if (scoreD > scoreMax)
+			{
+			scoreMax = scoreD;
+			TBType = TB_D;
+			}
+		const SCORE scoreI = IPrev + GapCloseB[j-1];
+		if (scoreI > scoreMax)
+			{
+			scoreMax = scoreI;
+			TBType = TB_I;
+			}
+		MCurr[j] += scoreMax;
+		TBRow[j] = TBOpen | TBType;
+		}
+	}
+
+#endif	// SIMD_AVX2
+
+#if	defined(_MANAGED)
+#pragma managed(pop)
+#endif
+
+SP_ROW_FN GetSPRowFn(const char **ptrName)
+	{
+	*ptrName = "scalar";
+	if (g_bNoSIMD)
+		return 0;
+#if	SIMD_AVX2
+	if (CPUHasAVX2())
+		{
+		*ptrName = "AVX2";
+		return SPRowAVX2;
+		}
+#endif
+#if	SIMD_SSE4
+	if (CPUHasSSE41())
+		{
+		*ptrName = "SSE4.1";
+		return SPRowSSE4;
+		}
+#endif
+	return 0;
+	}
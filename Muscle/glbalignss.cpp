@@ -18,79 +18,6 @@ static SCORE Subst(const Seq &seqA, const Seq &seqB, unsigned i, unsigned j)
 	return VTML_SP[uLetterA][uLetterB] + g_scoreCenter;
 	}
 
-struct DP_MEMORY
-	{
-	unsigned uLength;
-	SCORE *GapOpenA;
-	SCORE *GapOpenB;
-	SCORE *GapCloseA;
-	SCORE *GapCloseB;
-	SCORE *MPrev;
-	SCORE *MCurr;
-	SCORE *MWork;
-	SCORE *DPrev;
-	SCORE *DCurr;
-	SCORE *DWork;
-	SCORE **MxRowA;
-	SCORE **ScoreMxB;
-	unsigned *LettersB;
-	unsigned **SortOrderA;
-	unsigned *uDeletePos;
-	FCOUNT **FreqsA;
-	int **TraceBack;
-	};
-
-static struct DP_MEMORY DPM;
-
-static void AllocDPMem(unsigned uLengthA, unsigned uLengthB)
-	{
-// Max prefix length
-	unsigned uLength = (uLengthA > uLengthB ? uLengthA : uLengthB) + 1;
-	if (uLength < DPM.uLength)
-		return;
-
-// Add 256 to allow for future expansion and
-// round up to next multiple of 32.
-	uLength += 256;
-	uLength += 32 - uLength%32;
-
-	const unsigned uOldLength = DPM.uLength;
-	if (uOldLength > 0)
-		{
-		for (unsigned i = 0; i < uOldLength; ++i)
-			delete[] DPM.TraceBack[i];
-
-		delete[] DPM.MPrev;
-		delete[] DPM.MCurr;
-		delete[] DPM.MWork;
-		delete[] DPM.DPrev;
-		delete[] DPM.DCurr;
-		delete[] DPM.DWork;
-		delete[] DPM.MxRowA;
-		delete[] DPM.LettersB;
-		delete[] DPM.uDeletePos;
-		delete[] DPM.TraceBack;
-		}
-
-	DPM.uLength = uLength;
-
-	DPM.MPrev = new SCORE[uLength];
-	DPM.MCurr = new SCORE[uLength];
-	DPM.MWork = new SCORE[uLength];
-
-	DPM.DPrev = new SCORE[uLength];
-	DPM.DCurr = new SCORE[uLength];
-	DPM.DWork = new SCORE[uLength];
-	DPM.MxRowA = new SCORE *[uLength];
-	DPM.LettersB = new unsigned[uLength];
-	DPM.uDeletePos = new unsigned[uLength];
-
-	DPM.TraceBack = new int*[uLength];
-
-	for (unsigned i = 0; i < uLength; ++i)
-		DPM.TraceBack[i] = new int[uLength];
-	}
-
 static void RowFromSeq(const Seq &s, SCORE *Row[])
 	{
 	const unsigned uLength = s.Length();
@@ -126,7 +53,8 @@ SCORE GlobalAlignSS(const Seq &seqA, const Seq &seqB, PWPath &Path)
 	const unsigned uPrefixCountA = uLengthA + 1;
 	const unsigned uPrefixCountB = uLengthB + 1;
 
-	AllocDPMem(uLengthA, uLengthB);
+	DP_MEMORY &DPM = GetDPWorkspace()->DPMemSS;
+	AllocDPMem(DPM, uLengthA, uLengthB, 0);
 
 	SCORE *MPrev = DPM.MPrev;
 	SCORE *MCurr = DPM.MCurr;
@@ -143,15 +71,10 @@ SCORE GlobalAlignSS(const Seq &seqA, const Seq &seqB, PWPath &Path)
 
 	unsigned *uDeletePos = DPM.uDeletePos;
 
-	int **TraceBack = DPM.TraceBack;
-
-#if	DEBUG
-	for (unsigned i = 0; i < uPrefixCountA; ++i)
-		memset(TraceBack[i], 0, uPrefixCountB*sizeof(int));
-#endif
+	unsigned char *TBRow = DPM.TBRow;
+	AllocPackedTB(DPM.TB, uLengthA, uLengthB);
 
 // Special case for i=0
-	TraceBack[0][0] = 0;
 	MPrev[0] = MxRowA[0][LettersB[0]];
 
 // D(0,0) is -infinity (requires I->D).
@@ -167,7 +90,6 @@ SCORE GlobalAlignSS(const Seq &seqA, const Seq &seqB, PWPath &Path)
 	//			0   j
 	// So gap-open at j=0, gap-close at j-1.
 		MPrev[j] = MxRowA[0][uLetterB] + g_scoreGapOpen/2; // term gaps half
-		TraceBack[0][j] = -(int) j;
 
 	// Assume no D->I transitions, then can't be a delete if only
 	// one letter from A.
@@ -204,8 +126,8 @@ SCORE GlobalAlignSS(const Seq &seqA, const Seq &seqB, PWPath &Path)
 
 		++ptrMCurr_j;
 
-		int *ptrTraceBack_ij = TraceBack[i];
-		*ptrTraceBack_ij++ = (int) i;
+		TBRow[0] = 0;
+		unsigned char *ptrTB_ij = TBRow + 1;
 
 		SCORE *ptrMPrev_j = MPrev;
 		SCORE *ptrDPrev = DPrev;
@@ -215,6 +137,7 @@ SCORE GlobalAlignSS(const Seq &seqA, const Seq &seqB, PWPath &Path)
 			{
 			d = DNew;
 			*ptrDeletePos = i;
+			TBRow[0] = TB_DOPEN;
 			}
 
 		SCORE *ptrDCurr = DCurr;
@@ -225,21 +148,21 @@ SCORE GlobalAlignSS(const Seq &seqA, const Seq &seqB, PWPath &Path)
 	// Can't have an insert if no letters from B
 		IPrev_j_1 = MINUS_INFINITY;
 
-		unsigned uInsertPos;
-
 		for (unsigned j = 1; j < uLengthB; ++j)
 			{
 		// Here, MPrev_j is preserved from previous
 		// iteration so with current i,j is M[i-1][j-1]
 			SCORE MPrev_j = *ptrMPrev_j;
+			unsigned char TBOpen = 0;
 			SCORE INew = MPrev_j + g_scoreGapOpen;
 			if (INew > IPrev_j_1)
 				{
 				IPrev_j_1 = INew;
-				uInsertPos = j;
+				TBOpen = TB_IOPEN;
 				}
 
 			SCORE scoreMax = MPrev_j;
+			unsigned char TBType = TB_M;
 
 			assert(ptrDPrev == &(DPrev[j-1]));
 			SCORE scoreD = *ptrDPrev++;
@@ -247,8 +170,7 @@ SCORE GlobalAlignSS(const Seq &seqA, const Seq &seqB, PWPath &Path)
 				{
 				scoreMax = scoreD;
 				assert(ptrDeletePos == &(uDeletePos[j-1]));
-				*ptrTraceBack_ij = (int) i - (int) *ptrDeletePos;
-				assert(*ptrTraceBack_ij > 0);
+				TBType = TB_D;
 				}
 			++ptrDeletePos;
 
@@ -256,8 +178,7 @@ SCORE GlobalAlignSS(const Seq &seqA, const Seq &seqB, PWPath &Path)
 			if (scoreI > scoreMax)
 				{
 				scoreMax = scoreI;
-				*ptrTraceBack_ij = (int) uInsertPos - (int) j;
-				assert(*ptrTraceBack_ij < 0);
+				TBType = TB_I;
 				}
 
 			*ptrMCurr_j += scoreMax;
@@ -273,13 +194,15 @@ SCORE GlobalAlignSS(const Seq &seqA, const Seq &seqB, PWPath &Path)
 				d = DNew;
 				assert(ptrDeletePos == &uDeletePos[j]);
 				*ptrDeletePos = i;
+				TBOpen |= TB_DOPEN;
 				}
 			assert(ptrDCurr + 1 == &(DCurr[j]));
 			*(++ptrDCurr) = d;
 
-			++ptrTraceBack_ij;
+			*ptrTB_ij++ = TBOpen | TBType;
 			}
 
+		PackTBRow(DPM.TB, i, TBRow, uLengthB);
 		Rotate(MPrev, MCurr, MWork);
 		Rotate(DPrev, DCurr, DWork);
 		}
@@ -317,9 +240,9 @@ SCORE GlobalAlignSS(const Seq &seqA, const Seq &seqB, PWPath &Path)
 		iTraceBack = (int) uInsertPos - (int) uLengthB;
 		}
 
-	TraceBack[uLengthA][uLengthB] = iTraceBack;
+	DPM.TB.iLastTB = iTraceBack;
 
-	TraceBackToPath(TraceBack, uLengthA, uLengthB, Path);
+	TraceBackToPath(DPM.TB, uLengthA, uLengthB, Path);
 
 	return scoreMax;
 	}
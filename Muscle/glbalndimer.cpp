@@ -90,13 +90,11 @@ static bool PPTermInitialized = InitializePPTerm();
 static SCORE ScoreProfPosDimerLE(const ProfPos &PPA, const ProfPos &PPB)
 	{
 	SCORE Score = 0;
-	for (unsigned n = 0; n < 20; ++n)
+	const unsigned uLetterCount = PPA.m_uLetterCount;
+	for (unsigned n = 0; n < uLetterCount; ++n)
 		{
-		const unsigned uLetter = PPA.m_uSortOrder[n];
-		const FCOUNT fcLetter = PPA.m_fcCounts[uLetter];
-		if (0 == fcLetter)
-			break;
-		Score += fcLetter*PPB.m_AAScores[uLetter];
+		const unsigned uLetter = PPA.m_uLetters[n];
+		Score += PPA.m_fcCounts[uLetter]*PPB.m_AAScores[uLetter];
 		}
 	if (0 == Score)
 		return -2.5;
@@ -107,13 +105,11 @@ static SCORE ScoreProfPosDimerLE(const ProfPos &PPA, const ProfPos &PPB)
 static SCORE ScoreProfPosDimerPSP(const ProfPos &PPA, const ProfPos &PPB)
 	{
 	SCORE Score = 0;
-	for (unsigned n = 0; n < 20; ++n)
+	const unsigned uLetterCount = PPA.m_uLetterCount;
+	for (unsigned n = 0; n < uLetterCount; ++n)
 		{
-		const unsigned uLetter = PPA.m_uSortOrder[n];
-		const FCOUNT fcLetter = PPA.m_fcCounts[uLetter];
-		if (0 == fcLetter)
-			break;
-		Score += fcLetter*PPB.m_AAScores[uLetter];
+		const unsigned uLetter = PPA.m_uLetters[n];
+		Score += PPA.m_fcCounts[uLetter]*PPB.m_AAScores[uLetter];
 		}
 	return Score;
 	}
@@ -17,10 +17,10 @@
 #define	MAX_PATH	260
 #endif
 
-static char g_strListFileName[MAX_PATH];
-static bool g_bListFileAppend = false;
+#define g_strListFileName	(GetMuscleContext()->strListFileName)
+#define g_bListFileAppend	(GetMuscleContext()->bListFileAppend)
 
-static SEQWEIGHT g_SeqWeight = SEQWEIGHT_Undefined;
+#define g_SeqWeight			(GetMuscleContext()->SeqWeight)
 
 void SetSeqWeightMethod(SEQWEIGHT Method)
 	{
@@ -34,7 +34,7 @@ SEQWEIGHT GetSeqWeightMethod()
 
 void SetListFileName(const char *ptrListFileName, bool bAppend)
 	{
-	assert(strlen(ptrListFileName) < MAX_PATH);
+	assert(strlen(ptrListFileName) < MAX_LIST_FILE_NAME);
 	strcpy(g_strListFileName, ptrListFileName);
 	g_bListFileAppend = bAppend;
 	}
@@ -44,7 +44,7 @@ void Log(const char szFormat[], ...)
 	if (0 == g_strListFileName[0])
 		return;
 
-	static FILE *f = NULL;
+	FILE *&f = GetMuscleContext()->fListFile;
 	char *mode;
 	if (g_bListFileAppend)
 		mode = "a";
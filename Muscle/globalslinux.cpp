@@ -2,11 +2,18 @@
 
 #ifndef	WIN32
 #include <sys/time.h>
+#include <time.h>
 #include <sys/resource.h>
 #include <unistd.h>
 #include <errno.h>
 #include <stdio.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "threads.h"
+#include "mappedfile.h"
 
 const int ONE_MB = 1000000;
 const int MEM_WARNING_THRESHOLD = 20*ONE_MB;
@@ -93,6 +100,13 @@ double GetPeakMemUseMB()
 	return dPeakMemUseMB;
 	}
 
+double GetWallSecs()
+	{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec*1e-9;
+	}
+
 double GetCPUGHz()
 	{
 	double dGHz = 2.5;
@@ -102,6 +116,24 @@ double GetCPUGHz()
 	return dGHz;
 	}
 
+bool CPUHasSSE41()
+	{
+#if	defined(__x86_64__) || defined(__i386__)
+	return __builtin_cpu_supports("sse4.1") != 0;
+#else
+	return false;
+#endif
+	}
+
+bool CPUHasAVX2()
+	{
+#if	defined(__x86_64__) || defined(__i386__)
+	return __builtin_cpu_supports("avx2") != 0;
+#else
+	return false;
+#endif
+	}
+
 void CheckMemUse()
 	{
 	double dMB = GetMemUseMB();
@@ -160,4 +192,172 @@ double GetRAMSizeMB()
 	return ((double) Bytes)/1e6;
 	}
 
+__thread MuscleContext *g_ptrThreadContext;
+__thread DPWorkspace *g_ptrThreadWorkspace;
+
+MuscleContext *SetMuscleContext(MuscleContext *ptrContext)
+	{
+	MuscleContext *ptrPrev = g_ptrThreadContext;
+	g_ptrThreadContext = ptrContext;
+	g_ptrThreadWorkspace = (0 == ptrContext) ? 0 : &ptrContext->Workspace;
+	return ptrPrev;
+	}
+
+DPWorkspace *SetDPWorkspace(DPWorkspace *ptrWorkspace)
+	{
+	DPWorkspace *ptrPrev = g_ptrThreadWorkspace;
+	g_ptrThreadWorkspace = ptrWorkspace;
+	return ptrPrev;
+	}
+
+
+Mutex::Mutex()
+	{
+	pthread_mutex_t *ptrMutex = new pthread_mutex_t;
+	pthread_mutex_init(ptrMutex, 0);
+	m_ptrImpl = ptrMutex;
+	}
+
+Mutex::~Mutex()
+	{
+	pthread_mutex_t *ptrMutex = (pthread_mutex_t *) m_ptrImpl;
+	pthread_mutex_destroy(ptrMutex);
+	delete ptrMutex;
+	}
+
+void Mutex::Lock()
+	{
+	pthread_mutex_lock((pthread_mutex_t *) m_ptrImpl);
+	}
+
+void Mutex::Unlock()
+	{
+	pthread_mutex_unlock((pthread_mutex_t *) m_ptrImpl);
+	}
+
+struct THREAD_START
+	{
+	THREAD_START_FN Fn;
+	void *ptrArg;
+	pthread_t Thread;
+	};
+
+static void *ThreadStart(void *ptrArg)
+	{
+	THREAD_START *ptrStart = (THREAD_START *) ptrArg;
+	ptrStart->Fn(ptrStart->ptrArg);
+	return 0;
+	}
+
+THREAD_HANDLE StartThread(THREAD_START_FN Fn, void *ptrArg)
+	{
+	THREAD_START *ptrStart = new THREAD_START;
+	ptrStart->Fn = Fn;
+	ptrStart->ptrArg = ptrArg;
+	int iError = pthread_create(&ptrStart->Thread, 0, ThreadStart, ptrStart);
+	if (0 != iError)
+		Quit("pthread_create failed, error %d", iError);
+	return ptrStart;
+	}
+
+void WaitThread(THREAD_HANDLE hThread)
+	{
+	THREAD_START *ptrStart = (THREAD_START *) hThread;
+	pthread_join(ptrStart->Thread, 0);
+	delete ptrStart;
+	}
+
+void YieldThread()
+	{
+	sched_yield();
+	}
+
+unsigned GetCPUCount()
+	{
+	long lCount = sysconf(_SC_NPROCESSORS_ONLN);
+	if (lCount < 1)
+		return 1;
+	return (unsigned) lCount;
+	}
+
+MappedFile::MappedFile()
+	{
+	m_ptrData = 0;
+	m_uBytes = 0;
+	}
+
+MappedFile::~MappedFile()
+	{
+	Close();
+	}
+
+// The mapping keeps the file open, so the descriptor is closed here.
+static void *MapFd(int fd, const char *FileName, size_t uBytes)
+	{
+	if (0 != ftruncate(fd, (off_t) uBytes))
+		Quit("Cannot set size of %s to %.0f bytes, errno=%d %s",
+		  FileName, (double) uBytes, errno, strerror(errno));
+	void *ptrData = mmap(0, uBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (MAP_FAILED == ptrData)
+		Quit("Cannot map %s, errno=%d %s", FileName, errno, strerror(errno));
+	close(fd);
+	return ptrData;
+	}
+
+void MappedFile::Open(const char *FileName, size_t uBytes)
+	{
+	Close();
+	int fd = open(FileName, O_RDWR | O_CREAT, 0666);
+	if (-1 == fd)
+		Quit("Cannot open %s, errno=%d %s", FileName, errno, strerror(errno));
+	m_ptrData = MapFd(fd, FileName, uBytes);
+	m_uBytes = uBytes;
+	}
+
+void MappedFile::OpenTemp(const char *PathPrefix, size_t uBytes)
+	{
+	Close();
+	char *FileName = (char *) malloc(strlen(PathPrefix) + 8);
+	sprintf(FileName, "%s.XXXXXX", PathPrefix);
+	int fd = mkstemp(FileName);
+	if (-1 == fd)
+		Quit("Cannot create %s, errno=%d %s", FileName, errno, strerror(errno));
+	unlink(FileName);
+	m_ptrData = MapFd(fd, FileName, uBytes);
+	m_uBytes = uBytes;
+	free(FileName);
+	}
+
+bool MappedFile::OpenRead(const char *FileName)
+	{
+	Close();
+	int fd = open(FileName, O_RDONLY);
+	if (-1 == fd)
+		return false;
+	struct stat s;
+	if (0 != fstat(fd, &s) || !S_ISREG(s.st_mode) || 0 == s.st_size)
+		{
+		close(fd);
+		return false;
+		}
+	const size_t uBytes = (size_t) s.st_size;
+	void *ptrData = mmap(0, uBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (MAP_FAILED == ptrData)
+		return false;
+	madvise(ptrData, uBytes, MADV_SEQUENTIAL);
+	m_ptrData = ptrData;
+	m_uBytes = uBytes;
+	return true;
+	}
+
+void MappedFile::Close()
+	{
+	if (0 == m_ptrData)
+		return;
+	munmap(m_ptrData, m_uBytes);
+	m_ptrData = 0;
+	m_uBytes = 0;
+	}
+
 #endif	// !WIN32
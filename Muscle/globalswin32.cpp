@@ -6,6 +6,9 @@
 #include <psapi.h>
 #include <float.h>
 #include <stdio.h>
+#include <intrin.h>
+#include "threads.h"
+#include "mappedfile.h"
 
 void DebugPrintf(const char *szFormat, ...)
 	{
@@ -89,6 +92,15 @@ void CheckMemUse()
 	GetMemUseMB();
 	}
 
+double GetWallSecs()
+	{
+	LARGE_INTEGER Freq;
+	LARGE_INTEGER Count;
+	QueryPerformanceFrequency(&Freq);
+	QueryPerformanceCounter(&Count);
+	return (double) Count.QuadPart/(double) Freq.QuadPart;
+	}
+
 double GetCPUGHz()
 	{
 	double dGHz = 2.5;
@@ -99,4 +111,223 @@ double GetCPUGHz()
 		Quit("Invalid value '%s' for environment variable CPUGHZ", e);
 	return dGHz;
 	}
+bool CPUHasSSE41()
+	{
+	int Info[4];
+	__cpuid(Info, 1);
+	return (Info[2] & (1 << 19)) != 0;
+	}
+
+bool CPUHasAVX2()
+	{
+	int Info[4];
+	__cpuid(Info, 0);
+	if (Info[0] < 7)
+		return false;
+
+// OS must save YMM state (OSXSAVE and XCR0 bits 1, 2).
+	__cpuid(Info, 1);
+	const bool bOSXSAVE = (Info[2] & (1 << 27)) != 0;
+	const bool bAVX = (Info[2] & (1 << 28)) != 0;
+	if (!bOSXSAVE || !bAVX)
+		return false;
+	if ((_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(Info, 7, 0);
+	return (Info[1] & (1 << 5)) != 0;
+	}
+
+// Current context and workspace are thread-local, the TLS indexes
+// are allocated when the module is loaded.
+static DWORD g_dwContextTLS = TlsAlloc();
+static DWORD g_dwWorkspaceTLS = TlsAlloc();
+
+MuscleContext *GetMuscleContext()
+	{
+	return (MuscleContext *) TlsGetValue(g_dwContextTLS);
+	}
+
+DPWorkspace *GetDPWorkspace()
+	{
+	return (DPWorkspace *) TlsGetValue(g_dwWorkspaceTLS);
+	}
+
+MuscleContext *SetMuscleContext(MuscleContext *ptrContext)
+	{
+	MuscleContext *ptrPrev = GetMuscleContext();
+	TlsSetValue(g_dwContextTLS, ptrContext);
+	TlsSetValue(g_dwWorkspaceTLS, (0 == ptrContext) ? 0 : &ptrContext->Workspace);
+	return ptrPrev;
+	}
+
+DPWorkspace *SetDPWorkspace(DPWorkspace *ptrWorkspace)
+	{
+	DPWorkspace *ptrPrev = GetDPWorkspace();
+	TlsSetValue(g_dwWorkspaceTLS, ptrWorkspace);
+	return ptrPrev;
+	}
+
+Mutex::Mutex()
+	{
+	CRITICAL_SECTION *ptrCS = new CRITICAL_SECTION;
+	InitializeCriticalSection(ptrCS);
+	m_ptrImpl = ptrCS;
+	}
+
+Mutex::~Mutex()
+	{
+	CRITICAL_SECTION *ptrCS = (CRITICAL_SECTION *) m_ptrImpl;
+	DeleteCriticalSection(ptrCS);
+	delete ptrCS;
+	}
+
+void Mutex::Lock()
+	{
+	EnterCriticalSection((CRITICAL_SECTION *) m_ptrImpl);
+	}
+
+void Mutex::Unlock()
+	{
+	LeaveCriticalSection((CRITICAL_SECTION *) m_ptrImpl);
+	}
+
+struct THREAD_START
+	{
+	THREAD_START_FN Fn;
+	void *ptrArg;
+	};
+
+static DWORD WINAPI ThreadStart(LPVOID ptrArg)
+	{
+	THREAD_START *ptrStart = (THREAD_START *) ptrArg;
+	ptrStart->Fn(ptrStart->ptrArg);
+	delete ptrStart;
+	return 0;
+	}
+
+THREAD_HANDLE StartThread(THREAD_START_FN Fn, void *ptrArg)
+	{
+	THREAD_START *ptrStart = new THREAD_START;
+	ptrStart->Fn = Fn;
+	ptrStart->ptrArg = ptrArg;
+	HANDLE hThread = CreateThread(NULL, 0, ThreadStart, ptrStart, 0, NULL);
+	if (NULL == hThread)
+		Quit("CreateThread failed, error %u", (unsigned) GetLastError());
+	return hThread;
+	}
+
+void WaitThread(THREAD_HANDLE hThread)
+	{
+	WaitForSingleObject((HANDLE) hThread, INFINITE);
+	CloseHandle((HANDLE) hThread);
+	}
+
+void YieldThread()
+	{
+	SwitchToThread();
+	}
+
+unsigned GetCPUCount()
+	{
+	SYSTEM_INFO Info;
+	GetSystemInfo(&Info);
+	return (unsigned) Info.dwNumberOfProcessors;
+	}
+
+MappedFile::MappedFile()
+	{
+	m_ptrData = 0;
+	m_uBytes = 0;
+	}
+
+MappedFile::~MappedFile()
+	{
+	Close();
+	}
+
+// The view keeps the file open, so the handles are closed here.
+static void *MapHandle(HANDLE hFile, const char *FileName, size_t uBytes)
+	{
+	LARGE_INTEGER liSize;
+	liSize.QuadPart = (LONGLONG) uBytes;
+	if (!SetFilePointerEx(hFile, liSize, NULL, FILE_BEGIN) || !SetEndOfFile(hFile))
+		Quit("Cannot set size of %s to %.0f bytes, error %u",
+		  FileName, (double) uBytes, (unsigned) GetLastError());
+	HANDLE hMap = CreateFileMappingA(hFile, NULL, PAGE_READWRITE, 0, 0, NULL);
+	if (NULL == hMap)
+		Quit("CreateFileMapping %s failed, error %u", FileName,
+		  (unsigned) GetLastError());
+	void *ptrData = MapViewOfFile(hMap, FILE_MAP_ALL_ACCESS, 0, 0, uBytes);
+	if (NULL == ptrData)
+		Quit("MapViewOfFile %s failed, error %u", FileName,
+		  (unsigned) GetLastError());
+	CloseHandle(hMap);
+	CloseHandle(hFile);
+	return ptrData;
+	}
+
+void MappedFile::Open(const char *FileName, size_t uBytes)
+	{
+	Close();
+	HANDLE hFile = CreateFileA(FileName, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+	  OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+		Quit("Cannot open %s, error %u", FileName, (unsigned) GetLastError());
+	m_ptrData = MapHandle(hFile, FileName, uBytes);
+	m_uBytes = uBytes;
+	}
+
+void MappedFile::OpenTemp(const char *PathPrefix, size_t uBytes)
+	{
+	static volatile LONG lTempCount;
+	Close();
+	char *FileName = (char *) malloc(strlen(PathPrefix) + 32);
+	sprintf(FileName, "%s.%u.%u", PathPrefix, (unsigned) GetCurrentProcessId(),
+	  (unsigned) InterlockedIncrement(&lTempCount));
+	HANDLE hFile = CreateFileA(FileName, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+	  CREATE_NEW, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+		Quit("Cannot create %s, error %u", FileName, (unsigned) GetLastError());
+	m_ptrData = MapHandle(hFile, FileName, uBytes);
+	m_uBytes = uBytes;
+	free(FileName);
+	}
+
+bool MappedFile::OpenRead(const char *FileName)
+	{
+	Close();
+	HANDLE hFile = CreateFileA(FileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+	  OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (INVALID_HANDLE_VALUE == hFile)
+		return false;
+	LARGE_INTEGER liSize;
+	if (FILE_TYPE_DISK != GetFileType(hFile) || !GetFileSizeEx(hFile, &liSize) ||
+	  0 == liSize.QuadPart)
+		{
+		CloseHandle(hFile);
+		return false;
+		}
+	HANDLE hMap = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(hFile);
+	if (NULL == hMap)
+		return false;
+	void *ptrData = MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMap);
+	if (NULL == ptrData)
+		return false;
+	m_ptrData = ptrData;
+	m_uBytes = (size_t) liSize.QuadPart;
+	return true;
+	}
+
+void MappedFile::Close()
+	{
+	if (0 == m_ptrData)
+		return;
+	UnmapViewOfFile(m_ptrData);
+	m_ptrData = 0;
+	m_uBytes = 0;
+	}
+
 #endif	// WIN32
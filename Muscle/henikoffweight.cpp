@@ -1,5 +1,6 @@
 #include "muscle.h"
 #include "msa.h"
+#include "msacols.h"
 
 /***
 Compute Henikoff weights.
@@ -17,7 +18,7 @@ a sequence weight.
 See also HenikoffWeightPB.
 ***/
 
-void MSA::CalcHenikoffWeightsCol(unsigned uColIndex) const
+void MSA::CalcHenikoffWeightsCol(const char Col[]) const
 	{
 	const unsigned uSeqCount = GetSeqCount();
 
@@ -27,7 +28,7 @@ void MSA::CalcHenikoffWeightsCol(unsigned uColIndex) const
 	unsigned uDifferentLetterCount = 0;
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		{
-		unsigned uLetter = GetLetterEx(uSeqIndex, uColIndex);
+		unsigned uLetter = CharToLetterEx(Col[uSeqIndex]);
 		if (uLetter >= 20)
 			continue;
 		unsigned uNewCount = uLetterCount[uLetter] + 1;
@@ -39,7 +40,7 @@ void MSA::CalcHenikoffWeightsCol(unsigned uColIndex) const
 // Compute weight contributions
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		{
-		unsigned uLetter = GetLetterEx(uSeqIndex, uColIndex);
+		unsigned uLetter = CharToLetterEx(Col[uSeqIndex]);
 		if (uLetter >= 20)
 			continue;
 		const unsigned uCount = uLetterCount[uLetter];
@@ -72,8 +73,15 @@ void MSA::SetHenikoffWeights() const
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		m_Weights[uSeqIndex] = 0.0;
 
+	MSACols Cols;
+	Cols.FromMSA(*this);
+	char *Col = new char[uSeqCount];
 	for (unsigned uColIndex = 0; uColIndex < uColCount; ++uColIndex)
-		CalcHenikoffWeightsCol(uColIndex);
+		{
+		Cols.GetCol(uColIndex, Col);
+		CalcHenikoffWeightsCol(Col);
+		}
+	delete[] Col;
 
 // Set all-gap seqs weight to 0
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
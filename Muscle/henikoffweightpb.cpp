@@ -1,5 +1,6 @@
 #include "muscle.h"
 #include "msa.h"
+#include "msacols.h"
 
 /***
 Compute Henikoff weights.
@@ -20,7 +21,15 @@ and (b) ignores columns that are perfectly conserved.
 >>> WARNING -- I SUSPECT THIS DOESN'T WORK CORRECTLY <<<
 ***/
 
-void MSA::CalcHenikoffWeightsColPB(unsigned uColIndex) const
+static unsigned GetColLetter(char c)
+	{
+	const unsigned uLetter = CharToLetter(c);
+	if (uLetter >= 20)
+		Quit("Invalid letter '%c' in Henikoff weighting", c);
+	return uLetter;
+	}
+
+void MSA::CalcHenikoffWeightsColPB(const char Col[]) const
 	{
 	const unsigned uSeqCount = GetSeqCount();
 
@@ -30,10 +39,11 @@ void MSA::CalcHenikoffWeightsColPB(unsigned uColIndex) const
 	unsigned uLetter;
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		{
-		if (IsGap(uSeqIndex, uColIndex) || IsWildcard(uSeqIndex, uColIndex))
+		const char c = Col[uSeqIndex];
+		if (IsGapChar(c) || IsWildcardChar(c))
 			uLetter = MAX_ALPHA;
 		else
-			uLetter = GetLetter(uSeqIndex, uColIndex);
+			uLetter = GetColLetter(c);
 		++(uLetterCount[uLetter]);
 		}
 
@@ -56,10 +66,11 @@ void MSA::CalcHenikoffWeightsColPB(unsigned uColIndex) const
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		{
 		unsigned uLetter;
-		if (IsGap(uSeqIndex, uColIndex) || IsWildcard(uSeqIndex, uColIndex))
+		const char c = Col[uSeqIndex];
+		if (IsGapChar(c) || IsWildcardChar(c))
 			uLetter = MAX_ALPHA;
 		else
-			uLetter = GetLetter(uSeqIndex, uColIndex);
+			uLetter = GetColLetter(c);
 		const unsigned uCount = uLetterCount[uLetter];
 		m_Weights[uSeqIndex] += (WEIGHT) (1.0/uCount);
 		}
@@ -107,8 +118,15 @@ void MSA::SetHenikoffWeightsPB() const
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		m_Weights[uSeqIndex] = 0.0;
 
+	MSACols Cols;
+	Cols.FromMSA(*this);
+	char *Col = new char[uSeqCount];
 	for (unsigned uColIndex = 0; uColIndex < uColCount; ++uColIndex)
-		CalcHenikoffWeightsColPB(uColIndex);
+		{
+		Cols.GetCol(uColIndex, Col);
+		CalcHenikoffWeightsColPB(Col);
+		}
+	delete[] Col;
 
 // Set all-gap seqs weight to 0
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
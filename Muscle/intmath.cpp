@@ -103,20 +103,28 @@ SCORE SumLog(SCORE w, SCORE x, SCORE y, SCORE z)
 	return (SCORE) log2(pow2(w) + pow2(x) + pow2(y) + pow2(z));
 	}
 
+// The lp2Fast table is filled before main() so that threads
+// never see it half-initialized.
+static const int LP2_TABLE_SIZE = 1000;
+static const double LP2_RANGE = 20.0;
+static SCORE LP2Table[LP2_TABLE_SIZE];
+
+static bool InitLP2Table()
+	{
+	const double dScale = LP2_RANGE/LP2_TABLE_SIZE;
+	for (int i = 0; i < LP2_TABLE_SIZE; ++i)
+		LP2Table[i] = (SCORE) lp2(i*dScale);
+	return true;
+	}
+static bool bLP2TableInit = InitLP2Table();
+
 SCORE lp2Fast(SCORE x)
 	{
 	assert(x >= 0);
-	const int iTableSize = 1000;
-	const double dRange = 20.0;
+	const int iTableSize = LP2_TABLE_SIZE;
+	const double dRange = LP2_RANGE;
 	const double dScale = dRange/iTableSize;
-	static SCORE dValue[iTableSize];
-	static bool bInit = false;
-	if (!bInit)
-		{
-		for (int i = 0; i < iTableSize; ++i)
-			dValue[i] = (SCORE) lp2(i*dScale);
-		bInit = true;
-		}
+	const SCORE *dValue = LP2Table;
 	if (x >= dRange)
 		return 0.0;
 	int i = (int) (x/dScale);
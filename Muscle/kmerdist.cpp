@@ -0,0 +1,503 @@
+#include "muscle.h"
+#include "distfunc.h"
+#include "threads.h"
+#include "kmerdist.h"
+#include <algorithm>
+
+#define TRACE	0
+
+// Assumed size of the per-core second-level cache.
+const unsigned L2_CACHE_BYTES = 256*1024;
+
+const unsigned MIN_PAIR_BLOCK_SIZE = 16;
+const unsigned MAX_PAIR_BLOCK_SIZE = 512;
+
+void InitKmerSigs(KMER_SIGS &KS, unsigned uMaxSeqCount, unsigned uMaxEntryCount,
+  unsigned uKmerSpace, unsigned uCountBits)
+	{
+	assert(uCountBits > 0 && uCountBits < 32);
+	if (uKmerSpace > (1u << (32 - uCountBits)))
+		Quit("InitKmerSigs: k-mer space %u too large for %u-bit counts",
+		  uKmerSpace, uCountBits);
+
+	KS.uSeqCount = 0;
+	KS.uMaxSeqCount = uMaxSeqCount;
+	KS.uKmerSpace = uKmerSpace;
+	KS.uCountBits = uCountBits;
+	KS.uEntryCount = 0;
+	KS.uMaxEntryCount = uMaxEntryCount;
+	KS.Starts = new unsigned[uMaxSeqCount + 1];
+	KS.Entries = new unsigned[uMaxEntryCount];
+	KS.Starts[0] = 0;
+	}
+
+void FreeKmerSigs(KMER_SIGS &KS)
+	{
+	delete[] KS.Starts;
+	delete[] KS.Entries;
+	KS.Starts = 0;
+	KS.Entries = 0;
+	KS.uSeqCount = 0;
+	KS.uEntryCount = 0;
+	}
+
+void AddKmerSig(KMER_SIGS &KS, unsigned Kmers[], unsigned uCount)
+	{
+	assert(KS.uSeqCount < KS.uMaxSeqCount);
+	assert(KS.uEntryCount + uCount <= KS.uMaxEntryCount);
+
+	const unsigned uCountBits = KS.uCountBits;
+	const unsigned uCountMask = (1u << uCountBits) - 1;
+	std::sort(Kmers, Kmers + uCount);
+
+	unsigned *Entries = KS.Entries + KS.uEntryCount;
+	unsigned uSigLength = 0;
+	unsigned i = 0;
+	while (i < uCount)
+		{
+		const unsigned uKmer = Kmers[i];
+		assert(uKmer < KS.uKmerSpace);
+		unsigned n = 0;
+		while (i < uCount && Kmers[i] == uKmer)
+			{
+			++n;
+			++i;
+			}
+		n &= uCountMask;
+		if (0 == n)
+			continue;
+		Entries[uSigLength++] = (uKmer << uCountBits) | n;
+		}
+
+	KS.uEntryCount += uSigLength;
+	++KS.uSeqCount;
+	KS.Starts[KS.uSeqCount] = KS.uEntryCount;
+	}
+
+unsigned SelfKmerCount(const KMER_SIGS &KS, unsigned uSeqIndex)
+	{
+	unsigned uCount = 0;
+	const unsigned uEnd = KS.Starts[uSeqIndex+1];
+	for (unsigned uEntry = KS.Starts[uSeqIndex]; uEntry < uEnd; ++uEntry)
+		uCount += GetSigCount(KS, uEntry);
+	return uCount;
+	}
+
+unsigned CommonKmerCount(const KMER_SIGS &KS, unsigned uSeqIndex1,
+  unsigned uSeqIndex2)
+	{
+	const unsigned uStart1 = KS.Starts[uSeqIndex1];
+	const unsigned uStart2 = KS.Starts[uSeqIndex2];
+	return CommonKmerCountScalar(KS.Entries + uStart1,
+	  KS.Starts[uSeqIndex1+1] - uStart1, KS.Entries + uStart2,
+	  KS.Starts[uSeqIndex2+1] - uStart2, KS.uCountBits);
+	}
+
+// Block size such that two blocks of uBytesPerSeq bytes per
+// sequence fit in the second-level cache.
+static unsigned GetPairBlockSize(unsigned uBytesPerSeq)
+	{
+	if (0 == uBytesPerSeq)
+		uBytesPerSeq = 1;
+	unsigned uBlockSize = L2_CACHE_BYTES/(2*uBytesPerSeq);
+	if (uBlockSize < MIN_PAIR_BLOCK_SIZE)
+		uBlockSize = MIN_PAIR_BLOCK_SIZE;
+	if (uBlockSize > MAX_PAIR_BLOCK_SIZE)
+		uBlockSize = MAX_PAIR_BLOCK_SIZE;
+	return uBlockSize;
+	}
+
+// Block (uRowBlock, uColBlock) covers pairs (i, j) with i in rows
+// uRowBlock*uBlockSize ..., j in columns uColBlock*uBlockSize ...
+// and j < i.
+typedef void (*PAIR_BLOCK_FN)(unsigned uThreadIndex, unsigned uRowBlock,
+  unsigned uColBlock, void *ptrUser);
+
+struct PAIR_BLOCKS
+	{
+	unsigned uSeqCount;
+	unsigned uBlockSize;
+	PAIR_BLOCK_FN Fn;
+	void *ptrUser;
+
+	size_t uBlockCount;
+	unsigned *BlockRows;
+	unsigned *BlockCols;
+
+// Protected by Lock
+	Mutex Lock;
+	size_t uNextBlock;
+	size_t uPairsDone;
+	size_t uPairCount;
+	};
+
+static unsigned GetBlockEnd(unsigned uBlock, unsigned uBlockSize, unsigned uSeqCount)
+	{
+	return Min2((uBlock + 1)*uBlockSize, uSeqCount);
+	}
+
+static size_t GetBlockPairCount(const PAIR_BLOCKS &PB, size_t uBlockIndex)
+	{
+	const unsigned uRow = PB.BlockRows[uBlockIndex];
+	const unsigned uCol = PB.BlockCols[uBlockIndex];
+	const unsigned uSize = PB.uBlockSize;
+	const unsigned n1 = GetBlockEnd(uRow, uSize, PB.uSeqCount) - uRow*uSize;
+	if (uRow != uCol)
+		return (size_t) n1*uSize;
+	return ((size_t) n1*(n1 - 1))/2;
+	}
+
+static void PairBlockThread(unsigned uThreadIndex, void *ptrUser)
+	{
+	PAIR_BLOCKS &PB = *(PAIR_BLOCKS *) ptrUser;
+	for (;;)
+		{
+		PB.Lock.Lock();
+		const size_t uBlockIndex = PB.uNextBlock;
+		if (uBlockIndex < PB.uBlockCount)
+			{
+			++PB.uNextBlock;
+		// Pair counts do not fit Progress's unsigned steps for large
+		// sets, so report in 1/10000ths.
+			Progress((unsigned) ((10000.0*PB.uPairsDone)/PB.uPairCount), 10000);
+			PB.uPairsDone += GetBlockPairCount(PB, uBlockIndex);
+			}
+		PB.Lock.Unlock();
+		if (uBlockIndex >= PB.uBlockCount)
+			return;
+
+		PB.Fn(uThreadIndex, PB.BlockRows[uBlockIndex], PB.BlockCols[uBlockIndex],
+		  PB.ptrUser);
+		}
+	}
+
+static unsigned GetPairBlockThreadCount(unsigned uSeqCount, unsigned uBlockSize)
+	{
+	const unsigned uBlocksPerSide = (uSeqCount + uBlockSize - 1)/uBlockSize;
+	const size_t uBlockCount = ((size_t) uBlocksPerSide*(uBlocksPerSide + 1))/2;
+	unsigned uThreadCount = GetThreadCount();
+	if (uThreadCount > uBlockCount)
+		uThreadCount = (unsigned) uBlockCount;
+	return uThreadCount;
+	}
+
+static void RunPairBlocks(unsigned uSeqCount, unsigned uBlockSize,
+  PAIR_BLOCK_FN Fn, void *ptrUser)
+	{
+	assert(uSeqCount >= 2 && uBlockSize > 0);
+	const unsigned uBlocksPerSide = (uSeqCount + uBlockSize - 1)/uBlockSize;
+
+	PAIR_BLOCKS PB;
+	PB.uSeqCount = uSeqCount;
+	PB.uBlockSize = uBlockSize;
+	PB.Fn = Fn;
+	PB.ptrUser = ptrUser;
+	PB.uBlockCount = ((size_t) uBlocksPerSide*(uBlocksPerSide + 1))/2;
+	PB.BlockRows = new unsigned[PB.uBlockCount];
+	PB.BlockCols = new unsigned[PB.uBlockCount];
+	PB.uNextBlock = 0;
+	PB.uPairsDone = 0;
+	PB.uPairCount = ((size_t) uSeqCount*(uSeqCount - 1))/2;
+
+// Blocks are handed out column by column, so that consecutive
+// blocks taken by a thread usually share their column sequences.
+	size_t uBlockIndex = 0;
+	for (unsigned uCol = 0; uCol < uBlocksPerSide; ++uCol)
+		for (unsigned uRow = uCol; uRow < uBlocksPerSide; ++uRow)
+			{
+			PB.BlockRows[uBlockIndex] = uRow;
+			PB.BlockCols[uBlockIndex] = uCol;
+			++uBlockIndex;
+			}
+	assert(uBlockIndex == PB.uBlockCount);
+
+	const unsigned uThreadCount = GetPairBlockThreadCount(uSeqCount, uBlockSize);
+
+#if	TRACE
+	Log("RunPairBlocks seqs=%u block size=%u blocks=%u threads=%u\n",
+	  uSeqCount, uBlockSize, (unsigned) PB.uBlockCount, uThreadCount);
+#endif
+
+	RunThreads(uThreadCount, PairBlockThread, &PB);
+
+	delete[] PB.BlockRows;
+	delete[] PB.BlockCols;
+	}
+
+struct PAIR_DIST
+	{
+	unsigned uSeqCount;
+	unsigned uBlockSize;
+	PAIR_DIST_FN Fn;
+	void *ptrUser;
+	DistFunc *ptrDF;
+	};
+
+static void PairDistBlock(unsigned /* uThreadIndex */, unsigned uRowBlock,
+  unsigned uColBlock, void *ptrUser)
+	{
+	const PAIR_DIST &PD = *(const PAIR_DIST *) ptrUser;
+	DistFunc &DF = *PD.ptrDF;
+	const unsigned uSize = PD.uBlockSize;
+
+	const unsigned uFirst1 = uRowBlock*uSize;
+	const unsigned uEnd1 = GetBlockEnd(uRowBlock, uSize, PD.uSeqCount);
+	const unsigned uFirst2 = uColBlock*uSize;
+	const unsigned uEnd2 = GetBlockEnd(uColBlock, uSize, PD.uSeqCount);
+	for (unsigned i = uFirst1; i < uEnd1; ++i)
+		{
+		const unsigned uEnd = Min2(uEnd2, i);
+		for (unsigned j = uFirst2; j < uEnd; ++j)
+			DF.SetDist(i, j, PD.Fn(i, j, PD.ptrUser));
+		}
+	}
+
+void DistPairBlocks(unsigned uSeqCount, unsigned uBytesPerSeq, PAIR_DIST_FN Fn,
+  void *ptrUser, DistFunc &DF)
+	{
+	for (unsigned i = 0; i < uSeqCount; ++i)
+		DF.SetDist(i, i, 0);
+	if (uSeqCount < 2)
+		return;
+
+	PAIR_DIST PD;
+	PD.uSeqCount = uSeqCount;
+	PD.uBlockSize = GetPairBlockSize(uBytesPerSeq);
+	PD.Fn = Fn;
+	PD.ptrUser = ptrUser;
+	PD.ptrDF = &DF;
+	RunPairBlocks(uSeqCount, PD.uBlockSize, PairDistBlock, &PD);
+	}
+
+// Inverted index of the k-mers of the sequences in one column
+// block: the entries for k-mer w are Heads[w] .. Heads[w+1]-1, each
+// giving a sequence (as an offset in the block) and its count.
+// One per thread, rebuilt when the thread moves to another column.
+struct KMER_INDEX
+	{
+	unsigned uColBlock;
+	unsigned *Heads;
+	unsigned short *EntrySeqs;
+	unsigned short *EntryCounts;
+	unsigned *CommonCounts;
+	};
+
+struct KMER_DIST
+	{
+	const KMER_SIGS *ptrKS;
+	unsigned uBlockSize;
+	unsigned uMaxBlockEntryCount;
+	KMER_DIST_FN Fn;
+	void *ptrUser;
+	DistFunc *ptrDF;
+	KMER_INDEX *Indexes;
+	KMER_COMMON_FN CommonFn;
+	};
+
+static void BuildKmerIndex(const KMER_DIST &KD, unsigned uColBlock, KMER_INDEX &KI)
+	{
+	const KMER_SIGS &KS = *KD.ptrKS;
+	const unsigned uFirst = uColBlock*KD.uBlockSize;
+	const unsigned uEnd = GetBlockEnd(uColBlock, KD.uBlockSize, KS.uSeqCount);
+	const unsigned uFirstEntry = KS.Starts[uFirst];
+	const unsigned uEndEntry = KS.Starts[uEnd];
+	unsigned *Heads = KI.Heads;
+
+	memset(Heads, 0, (KS.uKmerSpace + 1)*sizeof(unsigned));
+	for (unsigned uEntry = uFirstEntry; uEntry < uEndEntry; ++uEntry)
+		++(Heads[GetSigKmer(KS, uEntry)]);
+
+// Heads[w] = end of the entries for w, then filling from the end
+// leaves Heads[w] = start of the entries for w.
+	unsigned uTotal = 0;
+	for (unsigned w = 0; w <= KS.uKmerSpace; ++w)
+		{
+		uTotal += Heads[w];
+		Heads[w] = uTotal;
+		}
+	assert(uTotal <= KD.uMaxBlockEntryCount);
+
+	for (unsigned j = uFirst; j < uEnd; ++j)
+		{
+		const unsigned uEndEntry = KS.Starts[j+1];
+		for (unsigned uEntry = KS.Starts[j]; uEntry < uEndEntry; ++uEntry)
+			{
+			const unsigned uIndex = --(Heads[GetSigKmer(KS, uEntry)]);
+			KI.EntrySeqs[uIndex] = (unsigned short) (j - uFirst);
+			KI.EntryCounts[uIndex] = (unsigned short) GetSigCount(KS, uEntry);
+			}
+		}
+	KI.uColBlock = uColBlock;
+	}
+
+static void KmerIndexBlock(unsigned uThreadIndex, unsigned uRowBlock,
+  unsigned uColBlock, void *ptrUser)
+	{
+	const KMER_DIST &KD = *(const KMER_DIST *) ptrUser;
+	const KMER_SIGS &KS = *KD.ptrKS;
+	KMER_INDEX &KI = KD.Indexes[uThreadIndex];
+	DistFunc &DF = *KD.ptrDF;
+	const unsigned uSize = KD.uBlockSize;
+
+	if (0 == KI.Heads)
+		{
+		KI.Heads = new unsigned[KS.uKmerSpace + 1];
+		KI.EntrySeqs = new unsigned short[KD.uMaxBlockEntryCount];
+		KI.EntryCounts = new unsigned short[KD.uMaxBlockEntryCount];
+		KI.CommonCounts = new unsigned[uSize];
+		}
+	if (KI.uColBlock != uColBlock)
+		BuildKmerIndex(KD, uColBlock, KI);
+
+	const unsigned *Heads = KI.Heads;
+	const unsigned short *EntrySeqs = KI.EntrySeqs;
+	const unsigned short *EntryCounts = KI.EntryCounts;
+	unsigned *CommonCounts = KI.CommonCounts;
+
+	const unsigned uFirst1 = uRowBlock*uSize;
+	const unsigned uEnd1 = GetBlockEnd(uRowBlock, uSize, KS.uSeqCount);
+	const unsigned uFirst2 = uColBlock*uSize;
+	const unsigned uEnd2 = GetBlockEnd(uColBlock, uSize, KS.uSeqCount);
+	for (unsigned i = uFirst1; i < uEnd1; ++i)
+		{
+		const unsigned uEnd = Min2(uEnd2, i);
+		if (uEnd <= uFirst2)
+			continue;
+
+		memset(CommonCounts, 0, uSize*sizeof(unsigned));
+		const unsigned uEndEntry = KS.Starts[i+1];
+		for (unsigned uEntry = KS.Starts[i]; uEntry < uEndEntry; ++uEntry)
+			{
+			const unsigned uKmer = GetSigKmer(KS, uEntry);
+			const unsigned uCount = GetSigCount(KS, uEntry);
+			const unsigned uIndexEnd = Heads[uKmer+1];
+			for (unsigned uIndex = Heads[uKmer]; uIndex < uIndexEnd; ++uIndex)
+				{
+				const unsigned uIndexCount = EntryCounts[uIndex];
+				CommonCounts[EntrySeqs[uIndex]] += Min2(uCount, uIndexCount);
+				}
+			}
+
+		for (unsigned j = uFirst2; j < uEnd; ++j)
+			DF.SetDist(i, j, KD.Fn(i, j, CommonCounts[j - uFirst2], KD.ptrUser));
+		}
+	}
+
+static void KmerMergeBlock(unsigned /* uThreadIndex */, unsigned uRowBlock,
+  unsigned uColBlock, void *ptrUser)
+	{
+	const KMER_DIST &KD = *(const KMER_DIST *) ptrUser;
+	const KMER_SIGS &KS = *KD.ptrKS;
+	DistFunc &DF = *KD.ptrDF;
+	const unsigned uSize = KD.uBlockSize;
+	const unsigned *Entries = KS.Entries;
+	const unsigned *Starts = KS.Starts;
+
+	const unsigned uFirst1 = uRowBlock*uSize;
+	const unsigned uEnd1 = GetBlockEnd(uRowBlock, uSize, KS.uSeqCount);
+	const unsigned uFirst2 = uColBlock*uSize;
+	const unsigned uEnd2 = GetBlockEnd(uColBlock, uSize, KS.uSeqCount);
+	for (unsigned i = uFirst1; i < uEnd1; ++i)
+		{
+		const unsigned uEnd = Min2(uEnd2, i);
+		for (unsigned j = uFirst2; j < uEnd; ++j)
+			{
+			const unsigned uCommonCount = KD.CommonFn(Entries + Starts[i],
+			  Starts[i+1] - Starts[i], Entries + Starts[j], Starts[j+1] - Starts[j],
+			  KS.uCountBits);
+			DF.SetDist(i, j, KD.Fn(i, j, uCommonCount, KD.ptrUser));
+			}
+		}
+	}
+
+// Rough operation counts for the two ways of computing a block.
+// The inverted index costs a pass over the k-mer space each time a
+// thread builds it for a column block, one look-up per k-mer of each
+// row per column block, and one step per (pair, shared k-mer). A
+// merge costs one step per entry of the two signatures of each pair.
+static bool UseKmerIndex(const KMER_SIGS &KS, unsigned uBlockSize,
+  unsigned uThreadCount)
+	{
+	const unsigned uSeqCount = KS.uSeqCount;
+	const double dEntryCount = KS.uEntryCount;
+	const double dBlocksPerSide = (uSeqCount + uBlockSize - 1)/uBlockSize;
+
+	unsigned *SeqCounts = new unsigned[KS.uKmerSpace];
+	memset(SeqCounts, 0, KS.uKmerSpace*sizeof(unsigned));
+	for (unsigned uEntry = 0; uEntry < KS.uEntryCount; ++uEntry)
+		++(SeqCounts[GetSigKmer(KS, uEntry)]);
+	double dSharedCount = 0;
+	for (unsigned w = 0; w < KS.uKmerSpace; ++w)
+		{
+		const double n = SeqCounts[w];
+		dSharedCount += n*(n - 1)/2;
+		}
+	delete[] SeqCounts;
+
+	const double dIndexCost = dBlocksPerSide*uThreadCount*KS.uKmerSpace +
+	  dEntryCount*(dBlocksPerSide + 1)/2 + dSharedCount;
+	const double dMergeCost = dEntryCount*(uSeqCount - 1);
+#if	TRACE
+	Log("UseKmerIndex index cost %.3g merge cost %.3g\n", dIndexCost, dMergeCost);
+#endif
+	return dIndexCost < dMergeCost;
+	}
+
+void DistKmerSigs(const KMER_SIGS &KS, KMER_DIST_FN Fn, void *ptrUser,
+  DistFunc &DF)
+	{
+	const unsigned uSeqCount = KS.uSeqCount;
+	for (unsigned i = 0; i < uSeqCount; ++i)
+		DF.SetDist(i, i, 0);
+	if (uSeqCount < 2)
+		return;
+
+	const unsigned uBytesPerSeq = (KS.uEntryCount/uSeqCount)*sizeof(unsigned);
+
+	KMER_DIST KD;
+	KD.ptrKS = &KS;
+	KD.uBlockSize = GetPairBlockSize(uBytesPerSeq);
+	KD.Fn = Fn;
+	KD.ptrUser = ptrUser;
+	KD.ptrDF = &DF;
+	KD.Indexes = 0;
+	KD.CommonFn = 0;
+
+	const unsigned uThreadCount = GetPairBlockThreadCount(uSeqCount, KD.uBlockSize);
+	if (!UseKmerIndex(KS, KD.uBlockSize, uThreadCount))
+		{
+		const char *pstrName;
+		KD.CommonFn = GetKmerCommonFn(&pstrName);
+#if	TRACE
+		Log("DistKmerSigs merge (%s)\n", pstrName);
+#endif
+		RunPairBlocks(uSeqCount, KD.uBlockSize, KmerMergeBlock, &KD);
+		return;
+		}
+
+	KD.uMaxBlockEntryCount = 0;
+	for (unsigned uFirst = 0; uFirst < uSeqCount; uFirst += KD.uBlockSize)
+		{
+		const unsigned uEnd = Min2(uFirst + KD.uBlockSize, uSeqCount);
+		const unsigned uEntryCount = KS.Starts[uEnd] - KS.Starts[uFirst];
+		if (uEntryCount > KD.uMaxBlockEntryCount)
+			KD.uMaxBlockEntryCount = uEntryCount;
+		}
+
+	KD.Indexes = new KMER_INDEX[uThreadCount];
+	memset(KD.Indexes, 0, uThreadCount*sizeof(KMER_INDEX));
+	for (unsigned i = 0; i < uThreadCount; ++i)
+		KD.Indexes[i].uColBlock = uInsane;
+
+	RunPairBlocks(uSeqCount, KD.uBlockSize, KmerIndexBlock, &KD);
+
+	for (unsigned i = 0; i < uThreadCount; ++i)
+		{
+		KMER_INDEX &KI = KD.Indexes[i];
+		delete[] KI.Heads;
+		delete[] KI.EntrySeqs;
+		delete[] KI.EntryCounts;
+		delete[] KI.CommonCounts;
+		}
+	delete[] KD.Indexes;
+	}
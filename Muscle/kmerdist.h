@@ -0,0 +1,87 @@
+#ifndef kmerdist_h
+#define kmerdist_h
+
+// Support for the all-vs-all k-mer distance measures
+// (fastdistkmer.cpp, fastdistjones.cpp, fastdistkbit.cpp,
+// fastdistmafft.cpp, fastdistnuc.cpp).
+//
+// The N x N triangle of pairs is tiled into square blocks of rows
+// and columns small enough that the per-sequence data of a block
+// stays in cache, and the blocks are handed out to GetThreadCount()
+// threads. Each pair is computed by exactly one thread, so the
+// DistFunc is written without locking. The diagonal is set to zero.
+// Progress() is called once per block.
+
+// Sparse k-mer signatures of a set of sequences, held in one array.
+// The signature of sequence i is Entries[Starts[i]] .. Entries
+// [Starts[i+1]-1]: its distinct k-mers in increasing order, each
+// packed with its count as (k-mer << uCountBits) | count.
+// Counts are kept modulo 2^uCountBits, matching the byte and short
+// count tables the measures were defined with. A k-mer whose count
+// wraps to zero is dropped, as it can't contribute to a common count.
+struct KMER_SIGS
+	{
+	unsigned uSeqCount;
+	unsigned uMaxSeqCount;
+	unsigned uKmerSpace;
+	unsigned uCountBits;
+	unsigned uEntryCount;
+	unsigned uMaxEntryCount;
+	unsigned *Starts;
+	unsigned *Entries;
+	};
+
+// K-mers must be less than uKmerSpace, and uMaxEntryCount at least
+// the total number of k-mers that will be added.
+void InitKmerSigs(KMER_SIGS &KS, unsigned uMaxSeqCount, unsigned uMaxEntryCount,
+  unsigned uKmerSpace, unsigned uCountBits);
+void FreeKmerSigs(KMER_SIGS &KS);
+
+// Add the signature of the next sequence from its k-mers, in any
+// order and with repeats. Kmers[] is sorted in place.
+void AddKmerSig(KMER_SIGS &KS, unsigned Kmers[], unsigned uCount);
+
+static inline unsigned GetSigKmer(const KMER_SIGS &KS, unsigned uEntry)
+	{
+	return KS.Entries[uEntry] >> KS.uCountBits;
+	}
+
+static inline unsigned GetSigCount(const KMER_SIGS &KS, unsigned uEntry)
+	{
+	return KS.Entries[uEntry] & ((1u << KS.uCountBits) - 1);
+	}
+
+// Sum of the counts, i.e. the common count of a sequence with itself.
+unsigned SelfKmerCount(const KMER_SIGS &KS, unsigned uSeqIndex);
+
+// Sum over the distinct k-mers of MIN(count in sequence i, count in
+// sequence j), by merging the two signatures.
+unsigned CommonKmerCount(const KMER_SIGS &KS, unsigned uSeqIndex1,
+  unsigned uSeqIndex2);
+
+// Set DF(i, j) = Fn(i, j, CommonKmerCount(i, j), ptrUser) for all
+// i > j. Within a block the common counts are either accumulated
+// from an inverted index of the column sequences, which costs in
+// the k-mers that pairs share, or found by merging the signatures
+// of each pair, which costs in the signature lengths; whichever is
+// estimated to be less work for this set of sequences.
+typedef float (*KMER_DIST_FN)(unsigned i, unsigned j, unsigned uCommonCount,
+  void *ptrUser);
+void DistKmerSigs(const KMER_SIGS &KS, KMER_DIST_FN Fn, void *ptrUser,
+  DistFunc &DF);
+
+// Set DF(i, j) = Fn(i, j, ptrUser) for all i > j, for measures that
+// compare fixed-size per-sequence data, uBytesPerSeq bytes each.
+// Fn must be safe to call concurrently.
+typedef float (*PAIR_DIST_FN)(unsigned i, unsigned j, void *ptrUser);
+void DistPairBlocks(unsigned uSeqCount, unsigned uBytesPerSeq, PAIR_DIST_FN Fn,
+  void *ptrUser, DistFunc &DF);
+
+// Merge-intersection kernels, kmerdistsimd.cpp.
+typedef unsigned (*KMER_COMMON_FN)(const unsigned *Entries1, unsigned uCount1,
+  const unsigned *Entries2, unsigned uCount2, unsigned uCountBits);
+unsigned CommonKmerCountScalar(const unsigned *Entries1, unsigned uCount1,
+  const unsigned *Entries2, unsigned uCount2, unsigned uCountBits);
+KMER_COMMON_FN GetKmerCommonFn(const char **ptrName);
+
+#endif	// kmerdist_h
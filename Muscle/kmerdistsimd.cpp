@@ -0,0 +1,108 @@
+#include "muscle.h"
+#include "distfunc.h"
+#include "kmerdist.h"
+#include "simd.h"
+
+// Merge-intersection of two k-mer signatures (see KMER_SIGS):
+// the sum over the k-mers found in both of the smaller count.
+// The SSE4.1 kernel compares a block of 4 entries of each signature
+// all-against-all, by rotating one block through the 4 lanes, and
+// then advances whichever block has the smaller last k-mer (both if
+// equal). K-mers are distinct within a signature, so each matching
+// pair is seen in exactly one block comparison. The tails are
+// finished by the scalar merge.
+
+#if	defined(_MANAGED)
+#pragma managed(push, off)
+#endif
+
+unsigned CommonKmerCountScalar(const unsigned *Entries1, unsigned uCount1,
+  const unsigned *Entries2, unsigned uCount2, unsigned uCountBits)
+	{
+	const unsigned uCountMask = (1u << uCountBits) - 1;
+	unsigned uCommonCount = 0;
+	unsigned i1 = 0;
+	unsigned i2 = 0;
+	while (i1 < uCount1 && i2 < uCount2)
+		{
+		const unsigned uKmer1 = Entries1[i1] >> uCountBits;
+		const unsigned uKmer2 = Entries2[i2] >> uCountBits;
+		if (uKmer1 < uKmer2)
+			++i1;
+		else if (uKmer2 < uKmer1)
+			++i2;
+		else
+			{
+			const unsigned n1 = Entries1[i1++] & uCountMask;
+			const unsigned n2 = Entries2[i2++] & uCountMask;
+			uCommonCount += Min2(n1, n2);
+			}
+		}
+	return uCommonCount;
+	}
+
+#if	SIMD_SSE4
+
+TARGET_SSE4 static unsigned CommonKmerCountSSE4(const unsigned *Entries1,
+  unsigned uCount1, const unsigned *Entries2, unsigned uCount2,
+  unsigned uCountBits)
+	{
+	const __m128i vShift = _mm_cvtsi32_si128((int) uCountBits);
+	const __m128i vMask = _mm_set1_epi32((int) ((1u << uCountBits) - 1));
+
+	__m128i vSum = _mm_setzero_si128();
+	unsigned i1 = 0;
+	unsigned i2 = 0;
+	while (i1 + 4 <= uCount1 && i2 + 4 <= uCount2)
+		{
+		const __m128i v1 = _mm_loadu_si128((const __m128i *) (Entries1 + i1));
+		__m128i v2 = _mm_loadu_si128((const __m128i *) (Entries2 + i2));
+		const __m128i vKmers1 = _mm_srl_epi32(v1, vShift);
+		const __m128i vCounts1 = _mm_and_si128(v1, vMask);
+		for (unsigned r = 0; r < 4; ++r)
+			{
+			const __m128i vKmers2 = _mm_srl_epi32(v2, vShift);
+			const __m128i vCounts2 = _mm_and_si128(v2, vMask);
+			const __m128i vEq = _mm_cmpeq_epi32(vKmers1, vKmers2);
+			const __m128i vMin = _mm_min_epu32(vCounts1, vCounts2);
+			vSum = _mm_add_epi32(vSum, _mm_and_si128(vEq, vMin));
+			v2 = _mm_shuffle_epi32(v2, _MM_SHUFFLE(0, 3, 2, 1));
+			}
+
+		const unsigned uLast1 = Entries1[i1 + 3] >> uCountBits;
+		const unsigned uLast2 = Entries2[i2 + 3] >> uCountBits;
+		if (uLast1 <= uLast2)
+			i1 += 4;
+		if (uLast2 <= uLast1)
+			i2 += 4;
+		}
+
+	vSum = _mm_add_epi32(vSum, _mm_shuffle_epi32(vSum, _MM_SHUFFLE(1, 0, 3, 2)));
+	vSum = _mm_add_epi32(vSum, _mm_shuffle_epi32(vSum, _MM_SHUFFLE(2, 3, 0, 1)));
+	unsigned uCommonCount = (unsigned) _mm_cvtsi128_si32(vSum);
+
+	uCommonCount += CommonKmerCountScalar(Entries1 + i1, uCount1 - i1,
+	  Entries2 + i2, uCount2 - i2, uCountBits);
+	return uCommonCount;
+	}
+
+#endif	// SIMD_SSE4
+
+#if	defined(_MANAGED)
+#pragma managed(pop)
+#endif
+
+KMER_COMMON_FN GetKmerCommonFn(const char **ptrName)
+	{
+	*ptrName = "scalar";
+	if (g_bNoSIMD)
+		return CommonKmerCountScalar;
+#if	SIMD_SSE4
+	if (CPUHasSSE41())
+		{
+		*ptrName = "SSE4.1";
+		return CommonKmerCountSSE4;
+		}
+#endif
+	return CommonKmerCountScalar;
+	}
@@ -19,7 +19,7 @@ static ProfPos *ProfileFromMSALocal(MSA &msa, Tree &tree)
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		msa.SetSeqId(uSeqIndex, uSeqIndex);
 
-	TreeFromMSA(msa, tree, g_Cluster1, g_Distance1, g_Root1);
+	TreeFromMSA(msa, tree, g_Cluster2, g_Distance2, g_Root1);
 	SetMuscleTree(tree);
 	return ProfileFromMSA(msa);
 	}
@@ -63,9 +63,7 @@ void Local()
 
 	msa1.FixAlpha();
 	msa2.FixAlpha();
-
-	if (ALPHA_DNA == Alpha || ALPHA_RNA == Alpha)
-		SetPPScore(PPSCORE_SPN);
+	SetPPScore();
 
 	const unsigned uSeqCount1 = msa1.GetSeqCount();
 	const unsigned uSeqCount2 = msa2.GetSeqCount();
@@ -19,6 +19,11 @@ int main(int argc, char **argv)
 // to run responsively in parallel.
 	SetPriorityClass(GetCurrentProcess(), BELOW_NORMAL_PRIORITY_CLASS);
 #endif
+// All parameters and run state are in the current context.
+// The context is never destroyed because we exit() below.
+	MuscleContext Context;
+	SetMuscleContext(&Context);
+
 	g_argc = argc;
 	g_argv = argv;
 
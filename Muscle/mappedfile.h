@@ -0,0 +1,47 @@
+#ifndef mappedfile_h
+#define mappedfile_h
+
+// A file mapped read-write into memory, for data that may not fit
+// in RAM. Pages are read and written back by the operating system
+// as they are touched. The platform-specific code is in
+// globalslinux.cpp (mmap) and globalswin32.cpp (file mappings).
+// Errors are fatal (Quit).
+
+class MappedFile
+	{
+public:
+	MappedFile();
+	~MappedFile();
+
+// Map FileName, creating it if needed and setting its size to
+// uBytes. Existing contents up to uBytes are kept.
+	void Open(const char *FileName, size_t uBytes);
+
+// Map a new scratch file of uBytes bytes, named PathPrefix with a
+// unique suffix. The file is deleted when it is closed.
+	void OpenTemp(const char *PathPrefix, size_t uBytes);
+
+// Map an existing file read-only. Returns false if it can't be
+// mapped, e.g. if it is a pipe or is empty.
+	bool OpenRead(const char *FileName);
+
+	void Close();
+
+	void *GetData() const
+		{
+		return m_ptrData;
+		}
+	size_t GetSize() const
+		{
+		return m_uBytes;
+		}
+
+private:
+	MappedFile(const MappedFile &);
+	MappedFile &operator=(const MappedFile &);
+
+	void *m_ptrData;
+	size_t m_uBytes;
+	};
+
+#endif	// mappedfile_h
@@ -10,7 +10,7 @@ immediately by gaps.
 Hack this by treating terminal M like X.
 ***/
 
-static bool *M;
+#define M	(GetMuscleContext()->MHackM)
 
 void MHackStart(SeqVect &v)
 	{
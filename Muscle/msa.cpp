@@ -8,7 +8,8 @@
 
 const unsigned DEFAULT_SEQ_LENGTH = 500;
 
-unsigned MSA::m_uIdCount = 0;
+// Shared by all MSAs of a run, see SetIdCount.
+#define m_uIdCount	(GetMuscleContext()->uMSAIdCount)
 
 MSA::MSA()
 	{
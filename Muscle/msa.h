@@ -144,8 +144,8 @@ private:
 	void SetSubtreeWeight2(const ClusterNode *ptrNode) const;
 	void SetSubtreeGSCWeight(ClusterNode *ptrNode) const;
 
-	void CalcHenikoffWeightsColPB(unsigned uColIndex) const;
-	void CalcHenikoffWeightsCol(unsigned uColIndex) const;
+	void CalcHenikoffWeightsColPB(const char Col[]) const;
+	void CalcHenikoffWeightsCol(const char Col[]) const;
 
 private:
 	unsigned m_uSeqCount;
@@ -155,8 +155,6 @@ private:
 	char **m_szSeqs;
 	char **m_szNames;
 
-	static unsigned m_uIdCount;
-
 	unsigned *m_IdToSeqIndex;
 	unsigned *m_SeqIndexToId;
 
@@ -3,15 +3,14 @@
 #include "seqvect.h"
 #include "profile.h"
 #include "tree.h"
+#include "msacols.h"
 
 // These global variables are a hack to allow the tree
 // dependent iteration code to communicate the edge
 // used to divide the tree. The three-way weighting
 // scheme needs to know this edge in order to compute
 // sequence weights.
-static const Tree *g_ptrMuscleTree = 0;
-unsigned g_uTreeSplitNode1 = NULL_NEIGHBOR;
-unsigned g_uTreeSplitNode2 = NULL_NEIGHBOR;
+#define g_ptrMuscleTree		(GetMuscleContext()->ptrMuscleTree)
 
 void MSA::GetFractionalWeightedCounts(unsigned uColIndex, bool bNormalize,
   FCOUNT fcCounts[], FCOUNT *ptrfcGapStart, FCOUNT *ptrfcGapEnd,
@@ -21,20 +20,51 @@ void MSA::GetFractionalWeightedCounts(unsigned uColIndex, bool bNormalize,
 	const unsigned uSeqCount = GetSeqCount();
 	const unsigned uColCount = GetColCount();
 
+	char *Col = new char[uSeqCount];
+	char *PrevCol = (uColIndex > 0) ? new char[uSeqCount] : 0;
+	char *NextCol = (uColIndex < uColCount - 1) ? new char[uSeqCount] : 0;
+	WEIGHT *Weights = new WEIGHT[uSeqCount];
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+		{
+		Col[uSeqIndex] = GetChar(uSeqIndex, uColIndex);
+		if (0 != PrevCol)
+			PrevCol[uSeqIndex] = GetChar(uSeqIndex, uColIndex - 1);
+		if (0 != NextCol)
+			NextCol[uSeqIndex] = GetChar(uSeqIndex, uColIndex + 1);
+		Weights[uSeqIndex] = GetSeqWeight(uSeqIndex);
+		}
+
+	GetColFractionalWeightedCounts(Col, PrevCol, NextCol, uSeqCount, Weights,
+	  bNormalize, fcCounts, ptrfcGapStart, ptrfcGapEnd, ptrfcGapExtend, ptrfOcc,
+	  ptrfcLL, ptrfcLG, ptrfcGL, ptrfcGG);
+
+	delete[] Col;
+	delete[] PrevCol;
+	delete[] NextCol;
+	delete[] Weights;
+	}
+
+void GetColFractionalWeightedCounts(const char Col[], const char PrevCol[],
+  const char NextCol[], unsigned uSeqCount, const WEIGHT Weights[],
+  bool bNormalize, FCOUNT fcCounts[], FCOUNT *ptrfcGapStart,
+  FCOUNT *ptrfcGapEnd, FCOUNT *ptrfcGapExtend, FCOUNT *ptrfOcc,
+  FCOUNT *ptrfcLL, FCOUNT *ptrfcLG, FCOUNT *ptrfcGL, FCOUNT *ptrfcGG)
+	{
 	memset(fcCounts, 0, g_AlphaSize*sizeof(FCOUNT));
 	WEIGHT wTotal = 0;
 	FCOUNT fGap = 0;
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		{
-		const WEIGHT w = GetSeqWeight(uSeqIndex);
-		if (IsGap(uSeqIndex, uColIndex))
+		const WEIGHT w = Weights[uSeqIndex];
+		const char c = Col[uSeqIndex];
+		if (IsGapChar(c))
 			{
 			fGap += w;
 			continue;
 			}
-		else if (IsWildcard(uSeqIndex, uColIndex))
+		else if (IsWildcardChar(c))
 			{
-			const unsigned uLetter = GetLetterEx(uSeqIndex, uColIndex);
+			const unsigned uLetter = CharToLetterEx(c);
 			switch (g_Alpha)
 				{
 			case ALPHA_Amino:
@@ -83,7 +113,9 @@ void MSA::GetFractionalWeightedCounts(unsigned uColIndex, bool bNormalize,
 				}
 			continue;
 			}
-		unsigned uLetter = GetLetter(uSeqIndex, uColIndex);
+		unsigned uLetter = CharToLetter(c);
+		if (uLetter >= 20)
+			Quit("Invalid letter '%c' in profile column", c);
 		fcCounts[uLetter] += w;
 		wTotal += w;
 		}
@@ -99,31 +131,31 @@ void MSA::GetFractionalWeightedCounts(unsigned uColIndex, bool bNormalize,
 		}
 
 	FCOUNT fcStartCount = 0;
-	if (uColIndex == 0)
+	if (0 == PrevCol)
 		{
 		for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
-			if (IsGap(uSeqIndex, uColIndex))
-				fcStartCount += GetSeqWeight(uSeqIndex);
+			if (IsGapChar(Col[uSeqIndex]))
+				fcStartCount += Weights[uSeqIndex];
 		}
 	else
 		{
 		for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
-			if (IsGap(uSeqIndex, uColIndex) && !IsGap(uSeqIndex, uColIndex - 1))
-				fcStartCount += GetSeqWeight(uSeqIndex);
+			if (IsGapChar(Col[uSeqIndex]) && !IsGapChar(PrevCol[uSeqIndex]))
+				fcStartCount += Weights[uSeqIndex];
 		}
 
 	FCOUNT fcEndCount = 0;
-	if (uColCount - 1 == uColIndex)
+	if (0 == NextCol)
 		{
 		for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
-			if (IsGap(uSeqIndex, uColIndex))
-				fcEndCount += GetSeqWeight(uSeqIndex);
+			if (IsGapChar(Col[uSeqIndex]))
+				fcEndCount += Weights[uSeqIndex];
 		}
 	else
 		{
 		for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
-			if (IsGap(uSeqIndex, uColIndex) && !IsGap(uSeqIndex, uColIndex + 1))
-				fcEndCount += GetSeqWeight(uSeqIndex);
+			if (IsGapChar(Col[uSeqIndex]) && !IsGapChar(NextCol[uSeqIndex]))
+				fcEndCount += Weights[uSeqIndex];
 		}
 
 	FCOUNT LL = 0;
@@ -132,9 +164,9 @@ void MSA::GetFractionalWeightedCounts(unsigned uColIndex, bool bNormalize,
 	FCOUNT GG = 0;
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		{
-		WEIGHT w = GetSeqWeight(uSeqIndex);
-		bool bLetterHere = !IsGap(uSeqIndex, uColIndex);
-		bool bLetterPrev = (uColIndex == 0 || !IsGap(uSeqIndex, uColIndex - 1));
+		WEIGHT w = Weights[uSeqIndex];
+		bool bLetterHere = !IsGapChar(Col[uSeqIndex]);
+		bool bLetterPrev = (0 == PrevCol || !IsGapChar(PrevCol[uSeqIndex]));
 		if (bLetterHere)
 			{
 			if (bLetterPrev)
@@ -152,11 +184,11 @@ void MSA::GetFractionalWeightedCounts(unsigned uColIndex, bool bNormalize,
 		}
 
 	FCOUNT fcExtendCount = 0;
-	if (uColIndex > 0 && uColIndex < GetColCount() - 1)
+	if (0 != PrevCol && 0 != NextCol)
 		for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
-			if (IsGap(uSeqIndex, uColIndex) && IsGap(uSeqIndex, uColIndex - 1) &&
-			  IsGap(uSeqIndex, uColIndex + 1))
-				fcExtendCount += GetSeqWeight(uSeqIndex);
+			if (IsGapChar(Col[uSeqIndex]) && IsGapChar(PrevCol[uSeqIndex]) &&
+			  IsGapChar(NextCol[uSeqIndex]))
+				fcExtendCount += Weights[uSeqIndex];
 
 	*ptrfcLL = LL;
 	*ptrfcLG = LG;
@@ -383,8 +415,8 @@ void SetMSAWeightsMuscle(MSA &msa)
 	Quit("SetMSAWeightsMuscle, Invalid method=%d", Method);
 	}
 
-static WEIGHT *g_MuscleWeights;
-static unsigned g_uMuscleIdCount;
+#define g_MuscleWeights		(GetMuscleContext()->MuscleWeights)
+#define g_uMuscleIdCount	(GetMuscleContext()->uMuscleIdCount)
 
 WEIGHT GetMuscleSeqWeightById(unsigned uId)
 	{
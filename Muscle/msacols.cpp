@@ -0,0 +1,219 @@
+#include "muscle.h"
+#include "msa.h"
+#include "msacols.h"
+#include "msaview.h"
+
+// Columns transposed together by FromMSA, so that the words being
+// written stay in cache while the rows are read.
+const unsigned COL_BLOCK = 256;
+
+const unsigned WORD_BITS = 32;
+
+MSACols::MSACols()
+	{
+	m_uSeqCount = 0;
+	m_uColCount = 0;
+	m_uBits = 0;
+	m_uCodesPerWord = 0;
+	m_uWordsPerCol = 0;
+	m_Words = 0;
+	m_uCodeCount = 0;
+	memset(m_CodeToChar, 0, sizeof(m_CodeToChar));
+	for (unsigned i = 0; i < 256; ++i)
+		m_CharToCode[i] = -1;
+	}
+
+MSACols::~MSACols()
+	{
+	Clear();
+	}
+
+void MSACols::Clear()
+	{
+	delete[] m_Words;
+	m_Words = 0;
+	m_uSeqCount = 0;
+	m_uColCount = 0;
+	m_uBits = 0;
+	m_uCodesPerWord = 0;
+	m_uWordsPerCol = 0;
+	m_uCodeCount = 0;
+	for (unsigned i = 0; i < 256; ++i)
+		m_CharToCode[i] = -1;
+	}
+
+static unsigned GetBitsForCodeCount(unsigned uCodeCount)
+	{
+	if (uCodeCount <= 8)
+		return 3;
+	if (uCodeCount <= 32)
+		return 5;
+	return 8;
+	}
+
+// Code of c, adding it to the table if new. The caller must widen
+// the codes if the count no longer fits.
+unsigned MSACols::GetCode(char c)
+	{
+	int iCode = m_CharToCode[(unsigned char) c];
+	if (iCode >= 0)
+		return (unsigned) iCode;
+	const unsigned uCode = m_uCodeCount++;
+	m_CodeToChar[uCode] = c;
+	m_CharToCode[(unsigned char) c] = (int) uCode;
+	return uCode;
+	}
+
+// Set the code width, repacking the letters if there are any.
+void MSACols::SetBits(unsigned uBits)
+	{
+	const unsigned uCodesPerWord = WORD_BITS/uBits;
+	const unsigned uWordsPerCol = (m_uSeqCount + uCodesPerWord - 1)/uCodesPerWord;
+	const size_t uWordCount = (size_t) m_uColCount*uWordsPerCol;
+	unsigned *Words = new unsigned[uWordCount];
+	memset(Words, 0, uWordCount*sizeof(unsigned));
+
+	if (0 != m_Words)
+		{
+		const unsigned uOldMask = (1u << m_uBits) - 1;
+		for (unsigned uColIndex = 0; uColIndex < m_uColCount; ++uColIndex)
+			{
+			const unsigned *OldCol = GetColWords(uColIndex);
+			unsigned *NewCol = Words + (size_t) uColIndex*uWordsPerCol;
+			for (unsigned uSeqIndex = 0; uSeqIndex < m_uSeqCount; ++uSeqIndex)
+				{
+				const unsigned uCode = (OldCol[uSeqIndex/m_uCodesPerWord] >>
+				  ((uSeqIndex%m_uCodesPerWord)*m_uBits)) & uOldMask;
+				NewCol[uSeqIndex/uCodesPerWord] |=
+				  uCode << ((uSeqIndex%uCodesPerWord)*uBits);
+				}
+			}
+		delete[] m_Words;
+		}
+
+	m_Words = Words;
+	m_uBits = uBits;
+	m_uCodesPerWord = uCodesPerWord;
+	m_uWordsPerCol = uWordsPerCol;
+	}
+
+void MSACols::FromMSA(const MSA &msa)
+	{
+	const unsigned uSeqCount = msa.GetSeqCount();
+	const char **Rows = new const char *[uSeqCount];
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+		Rows[uSeqIndex] = msa.GetSeqBuffer(uSeqIndex);
+	FromRows(Rows, uSeqCount, 0, msa.GetColCount());
+	delete[] Rows;
+	}
+
+void MSACols::FromMSAView(const MSAView &v)
+	{
+	const unsigned uSeqCount = v.GetSeqCount();
+	const char **Rows = new const char *[uSeqCount];
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+		Rows[uSeqIndex] = v.GetSeqBuffer(uSeqIndex);
+	FromRows(Rows, uSeqCount, v.GetColIndexes(), v.GetColCount());
+	delete[] Rows;
+	}
+
+// Column uColIndex is Rows[*][ColIndexes[uColIndex]], or
+// Rows[*][uColIndex] if ColIndexes is 0.
+void MSACols::FromRows(const char *const Rows[], unsigned uSeqCount,
+  const unsigned ColIndexes[], unsigned uColCount)
+	{
+	Clear();
+	m_uSeqCount = uSeqCount;
+	m_uColCount = uColCount;
+
+	for (unsigned uSeqIndex = 0; uSeqIndex < m_uSeqCount; ++uSeqIndex)
+		{
+		const char *Row = Rows[uSeqIndex];
+		for (unsigned uColIndex = 0; uColIndex < m_uColCount; ++uColIndex)
+			GetCode(Row[0 == ColIndexes ? uColIndex : ColIndexes[uColIndex]]);
+		}
+	SetBits(GetBitsForCodeCount(m_uCodeCount));
+
+	for (unsigned uColFrom = 0; uColFrom < m_uColCount; uColFrom += COL_BLOCK)
+		{
+		unsigned uColTo = uColFrom + COL_BLOCK;
+		if (uColTo > m_uColCount)
+			uColTo = m_uColCount;
+		for (unsigned uSeqIndex = 0; uSeqIndex < m_uSeqCount; ++uSeqIndex)
+			{
+			const char *Row = Rows[uSeqIndex];
+			const unsigned uWordIndex = uSeqIndex/m_uCodesPerWord;
+			const unsigned uShift = (uSeqIndex%m_uCodesPerWord)*m_uBits;
+			for (unsigned uColIndex = uColFrom; uColIndex < uColTo; ++uColIndex)
+				{
+				const char c = Row[0 == ColIndexes ? uColIndex : ColIndexes[uColIndex]];
+				const unsigned uCode = (unsigned) m_CharToCode[(unsigned char) c];
+				GetColWords(uColIndex)[uWordIndex] |= uCode << uShift;
+				}
+			}
+		}
+	}
+
+char MSACols::GetChar(unsigned uSeqIndex, unsigned uColIndex) const
+	{
+	if (uSeqIndex >= m_uSeqCount || uColIndex >= m_uColCount)
+		Quit("MSACols::GetChar(%u/%u,%u/%u)",
+		  uSeqIndex, m_uSeqCount, uColIndex, m_uColCount);
+	const unsigned uWord = GetColWords(uColIndex)[uSeqIndex/m_uCodesPerWord];
+	const unsigned uCode = (uWord >> ((uSeqIndex%m_uCodesPerWord)*m_uBits)) &
+	  ((1u << m_uBits) - 1);
+	return m_CodeToChar[uCode];
+	}
+
+void MSACols::SetChar(unsigned uSeqIndex, unsigned uColIndex, char c)
+	{
+	if (uSeqIndex >= m_uSeqCount || uColIndex >= m_uColCount)
+		Quit("MSACols::SetChar(%u/%u,%u/%u)",
+		  uSeqIndex, m_uSeqCount, uColIndex, m_uColCount);
+	const unsigned uCode = GetCode(c);
+	if (m_uCodeCount > (1u << m_uBits))
+		SetBits(GetBitsForCodeCount(m_uCodeCount));
+
+	unsigned &uWord = GetColWords(uColIndex)[uSeqIndex/m_uCodesPerWord];
+	const unsigned uShift = (uSeqIndex%m_uCodesPerWord)*m_uBits;
+	uWord &= ~(((1u << m_uBits) - 1) << uShift);
+	uWord |= uCode << uShift;
+	}
+
+void MSACols::GetCol(unsigned uColIndex, char Col[]) const
+	{
+	assert(uColIndex < m_uColCount);
+	const unsigned *Words = GetColWords(uColIndex);
+	const unsigned uMask = (1u << m_uBits) - 1;
+	unsigned uSeqIndex = 0;
+	for (unsigned uWordIndex = 0; uWordIndex < m_uWordsPerCol; ++uWordIndex)
+		{
+		unsigned uWord = Words[uWordIndex];
+		unsigned uCount = m_uSeqCount - uSeqIndex;
+		if (uCount > m_uCodesPerWord)
+			uCount = m_uCodesPerWord;
+		for (unsigned i = 0; i < uCount; ++i)
+			{
+			Col[uSeqIndex++] = m_CodeToChar[uWord & uMask];
+			uWord >>= m_uBits;
+			}
+		}
+	}
+
+void MSACols::GetRow(unsigned uSeqIndex, char Row[]) const
+	{
+	assert(uSeqIndex < m_uSeqCount);
+	const unsigned uWordIndex = uSeqIndex/m_uCodesPerWord;
+	const unsigned uShift = (uSeqIndex%m_uCodesPerWord)*m_uBits;
+	const unsigned uMask = (1u << m_uBits) - 1;
+	for (unsigned uColIndex = 0; uColIndex < m_uColCount; ++uColIndex)
+		Row[uColIndex] = m_CodeToChar[(GetColWords(uColIndex)[uWordIndex] >> uShift) & uMask];
+	}
+
+bool ColIsGaps(const char Col[], unsigned uSeqCount)
+	{
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+		if (!IsGapChar(Col[uSeqIndex]))
+			return false;
+	return true;
+	}
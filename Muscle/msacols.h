@@ -0,0 +1,87 @@
+#ifndef msacols_h
+#define msacols_h
+
+class MSA;
+class MSAView;
+
+/***
+Column-major copy of an MSA for code that scans columns, such as
+profile building and sequence weighting. MSA stores one row per
+sequence, so reading a column touches every row.
+
+Here each column is a contiguous block of 32-bit words holding the
+sequence letters as small codes: 3 bits per letter if the alignment
+uses at most 8 different characters (nucleotides and gaps), 5 bits
+for at most 32 (amino acids, wildcards and gaps), else 8 bits. Codes
+do not straddle words. The code of a character is fixed when it is
+first seen; SetChar widens the codes if a new character needs it.
+***/
+
+class MSACols
+	{
+public:
+	MSACols();
+	virtual ~MSACols();
+
+	void FromMSA(const MSA &msa);
+	void FromMSAView(const MSAView &v);
+	void Clear();
+
+	unsigned GetSeqCount() const
+		{
+		return m_uSeqCount;
+		}
+	unsigned GetColCount() const
+		{
+		return m_uColCount;
+		}
+	unsigned GetBitsPerCode() const
+		{
+		return m_uBits;
+		}
+
+	char GetChar(unsigned uSeqIndex, unsigned uColIndex) const;
+	void SetChar(unsigned uSeqIndex, unsigned uColIndex, char c);
+
+// Characters of a column, one per sequence, and of a row, one per
+// column.
+	void GetCol(unsigned uColIndex, char Col[]) const;
+	void GetRow(unsigned uSeqIndex, char Row[]) const;
+
+private:
+	MSACols(const MSACols &);
+	MSACols &operator=(const MSACols &);
+
+	void FromRows(const char *const Rows[], unsigned uSeqCount,
+	  const unsigned ColIndexes[], unsigned uColCount);
+	void SetBits(unsigned uBits);
+	unsigned GetCode(char c);
+	unsigned *GetColWords(unsigned uColIndex) const
+		{
+		return m_Words + (size_t) uColIndex*m_uWordsPerCol;
+		}
+
+private:
+	unsigned m_uSeqCount;
+	unsigned m_uColCount;
+	unsigned m_uBits;
+	unsigned m_uCodesPerWord;
+	unsigned m_uWordsPerCol;
+	unsigned *m_Words;
+
+	unsigned m_uCodeCount;
+	char m_CodeToChar[256];
+	int m_CharToCode[256];
+	};
+
+// Per-column statistics for profiles, from the characters of a column
+// and of its neighbours. PrevCol is 0 for the first column and NextCol
+// is 0 for the last. See MSA::GetFractionalWeightedCounts.
+void GetColFractionalWeightedCounts(const char Col[], const char PrevCol[],
+  const char NextCol[], unsigned uSeqCount, const WEIGHT Weights[],
+  bool bNormalize, FCOUNT fcCounts[], FCOUNT *ptrfcGapStart,
+  FCOUNT *ptrfcGapEnd, FCOUNT *ptrfcGapExtend, FCOUNT *ptrfOcc,
+  FCOUNT *ptrfcLL, FCOUNT *ptrfcLG, FCOUNT *ptrfcGL, FCOUNT *ptrfcGG);
+bool ColIsGaps(const char Col[], unsigned uSeqCount);
+
+#endif	// msacols_h
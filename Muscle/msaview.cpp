@@ -0,0 +1,160 @@
+#include "muscle.h"
+#include "msa.h"
+#include "msaview.h"
+
+MSAView::MSAView()
+	{
+	m_ptrMSA = 0;
+	m_uSeqCount = 0;
+	m_uColCount = 0;
+	m_SeqIndexes = 0;
+	m_ColIndexes = 0;
+	}
+
+MSAView::~MSAView()
+	{
+	Clear();
+	}
+
+void MSAView::Clear()
+	{
+	delete[] m_SeqIndexes;
+	delete[] m_ColIndexes;
+	m_ptrMSA = 0;
+	m_uSeqCount = 0;
+	m_uColCount = 0;
+	m_SeqIndexes = 0;
+	m_ColIndexes = 0;
+	}
+
+void MSAView::SetAllCols()
+	{
+	m_uColCount = m_ptrMSA->GetColCount();
+	m_ColIndexes = new unsigned[m_uColCount];
+	for (unsigned uColIndex = 0; uColIndex < m_uColCount; ++uColIndex)
+		m_ColIndexes[uColIndex] = uColIndex;
+	}
+
+void MSAView::FromSeqIndexes(const MSA &msa, const unsigned SeqIndexes[],
+  unsigned uSeqCount)
+	{
+	Clear();
+	m_ptrMSA = &msa;
+	m_uSeqCount = uSeqCount;
+	m_SeqIndexes = new unsigned[uSeqCount];
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+		{
+		const unsigned uParentSeqIndex = SeqIndexes[uSeqIndex];
+		if (uParentSeqIndex >= msa.GetSeqCount())
+			Quit("MSAView::FromSeqIndexes, index %u out of range", uParentSeqIndex);
+		m_SeqIndexes[uSeqIndex] = uParentSeqIndex;
+		}
+	SetAllCols();
+	}
+
+void MSAView::FromIds(const MSA &msa, const unsigned Ids[], unsigned uIdCount)
+	{
+	Clear();
+	m_ptrMSA = &msa;
+	m_uSeqCount = uIdCount;
+	m_SeqIndexes = new unsigned[uIdCount];
+	for (unsigned uSeqIndex = 0; uSeqIndex < uIdCount; ++uSeqIndex)
+		m_SeqIndexes[uSeqIndex] = msa.GetSeqIndex(Ids[uSeqIndex]);
+	SetAllCols();
+	}
+
+void MSAView::GetGapCols(bool IsGapCol[]) const
+	{
+	for (unsigned uColIndex = 0; uColIndex < m_uColCount; ++uColIndex)
+		IsGapCol[uColIndex] = true;
+
+	for (unsigned uSeqIndex = 0; uSeqIndex < m_uSeqCount; ++uSeqIndex)
+		{
+		const char *Row = GetSeqBuffer(uSeqIndex);
+		for (unsigned uColIndex = 0; uColIndex < m_uColCount; ++uColIndex)
+			if (!IsGapChar(Row[m_ColIndexes[uColIndex]]))
+				IsGapCol[uColIndex] = false;
+		}
+	}
+
+void MSAView::DeleteGappedCols()
+	{
+	bool *IsGapCol = new bool[m_uColCount];
+	GetGapCols(IsGapCol);
+
+	unsigned uNewColCount = 0;
+	for (unsigned uColIndex = 0; uColIndex < m_uColCount; ++uColIndex)
+		if (!IsGapCol[uColIndex])
+			m_ColIndexes[uNewColCount++] = m_ColIndexes[uColIndex];
+	m_uColCount = uNewColCount;
+
+	delete[] IsGapCol;
+	}
+
+void MSAView::ToMSA(MSA &msa) const
+	{
+	msa.SetSize(m_uSeqCount, m_uColCount);
+	for (unsigned uSeqIndex = 0; uSeqIndex < m_uSeqCount; ++uSeqIndex)
+		{
+		msa.SetSeqName(uSeqIndex, GetSeqName(uSeqIndex));
+		msa.SetSeqId(uSeqIndex, GetSeqId(uSeqIndex));
+		const char *Row = GetSeqBuffer(uSeqIndex);
+		for (unsigned uColIndex = 0; uColIndex < m_uColCount; ++uColIndex)
+			msa.SetChar(uSeqIndex, uColIndex, Row[m_ColIndexes[uColIndex]]);
+		}
+	}
+
+const char *MSAView::GetSeqBuffer(unsigned uSeqIndex) const
+	{
+	assert(uSeqIndex < m_uSeqCount);
+	return m_ptrMSA->GetSeqBuffer(m_SeqIndexes[uSeqIndex]);
+	}
+
+char MSAView::GetChar(unsigned uSeqIndex, unsigned uColIndex) const
+	{
+	if (uSeqIndex >= m_uSeqCount || uColIndex >= m_uColCount)
+		Quit("MSAView::GetChar(%u/%u,%u/%u)",
+		  uSeqIndex, m_uSeqCount, uColIndex, m_uColCount);
+	return GetSeqBuffer(uSeqIndex)[m_ColIndexes[uColIndex]];
+	}
+
+const char *MSAView::GetSeqName(unsigned uSeqIndex) const
+	{
+	assert(uSeqIndex < m_uSeqCount);
+	return m_ptrMSA->GetSeqName(m_SeqIndexes[uSeqIndex]);
+	}
+
+unsigned MSAView::GetSeqId(unsigned uSeqIndex) const
+	{
+	assert(uSeqIndex < m_uSeqCount);
+	return m_ptrMSA->GetSeqId(m_SeqIndexes[uSeqIndex]);
+	}
+
+// ClustalW weights depend only on the ids, so they are looked up
+// directly. Other methods look at the letters and are computed on a
+// copy, so that the weights are exactly those of SetMSAWeightsMuscle.
+void GetMSAViewWeightsMuscle(const MSAView &v, WEIGHT Weights[])
+	{
+	const unsigned uSeqCount = v.GetSeqCount();
+	if (SEQWEIGHT_ClustalW == GetSeqWeightMethod())
+		{
+		WEIGHT wTotal = 0;
+		for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+			{
+			Weights[uSeqIndex] = GetMuscleSeqWeightById(v.GetSeqId(uSeqIndex));
+			wTotal += Weights[uSeqIndex];
+			}
+		if (0 == wTotal)
+			return;
+		const WEIGHT f = (WEIGHT) 1.0/wTotal;
+		for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+			Weights[uSeqIndex] *= f;
+		return;
+		}
+
+	MSA msa;
+	v.ToMSA(msa);
+	SetMSAWeightsMuscle(msa);
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+		Weights[uSeqIndex] = msa.GetSeqWeight(uSeqIndex);
+	}
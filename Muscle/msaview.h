@@ -0,0 +1,86 @@
+#ifndef msaview_h
+#define msaview_h
+
+class MSA;
+
+/***
+A subset of the sequences of an MSA, referenced in place rather than
+copied. Rows are parent sequence indexes and columns are parent
+column indexes, so a view of some of the sequences with the columns
+that are all gaps in the subset removed costs two index lists.
+
+Refinement splits the alignment in two at a tree edge many times per
+iteration. MSASubsetByIds and DeleteGappedCols copied each half
+character by character and then deleted gapped columns one at a time.
+Profiles, paths and the re-aligned MSA can be built from views.
+
+The parent must not change while the view is in use.
+***/
+
+class MSAView
+	{
+public:
+	MSAView();
+	virtual ~MSAView();
+
+	void FromSeqIndexes(const MSA &msa, const unsigned SeqIndexes[],
+	  unsigned uSeqCount);
+	void FromIds(const MSA &msa, const unsigned Ids[], unsigned uIdCount);
+	void Clear();
+
+// Drop the columns that are all gaps in this subset.
+	void DeleteGappedCols();
+
+// Copy the view into a new MSA, with names and ids.
+	void ToMSA(MSA &msa) const;
+
+// IsGapCol[uColIndex] is true if column uColIndex is all gaps. Rows
+// are scanned in order, which is how the parent stores them.
+	void GetGapCols(bool IsGapCol[]) const;
+
+	const MSA &GetMSA() const
+		{
+		return *m_ptrMSA;
+		}
+	unsigned GetSeqCount() const
+		{
+		return m_uSeqCount;
+		}
+	unsigned GetColCount() const
+		{
+		return m_uColCount;
+		}
+	const unsigned *GetSeqIndexes() const
+		{
+		return m_SeqIndexes;
+		}
+	const unsigned *GetColIndexes() const
+		{
+		return m_ColIndexes;
+		}
+
+// Row of the parent; index it with GetColIndexes().
+	const char *GetSeqBuffer(unsigned uSeqIndex) const;
+	char GetChar(unsigned uSeqIndex, unsigned uColIndex) const;
+	const char *GetSeqName(unsigned uSeqIndex) const;
+	unsigned GetSeqId(unsigned uSeqIndex) const;
+
+private:
+	MSAView(const MSAView &);
+	MSAView &operator=(const MSAView &);
+
+	void SetAllCols();
+
+private:
+	const MSA *m_ptrMSA;
+	unsigned m_uSeqCount;
+	unsigned m_uColCount;
+	unsigned *m_SeqIndexes;
+	unsigned *m_ColIndexes;
+	};
+
+// Weights of the sequences of a view, as SetMSAWeightsMuscle would set
+// them on the view copied into an MSA.
+void GetMSAViewWeightsMuscle(const MSAView &v, WEIGHT Weights[]);
+
+#endif	// msaview_h
@@ -92,6 +92,7 @@ void MUSCLE(SeqVect &v, MSA &msaOut)
 	else
 		ProgressiveAlign(v, GuideTree, msaOut);
 	SetCurrentAlignment(msaOut);
+	CheckpointAlignment(msaOut);
 
 	if (1 == g_uMaxIters || 2 == uSeqCount)
 		{
@@ -109,6 +110,7 @@ void MUSCLE(SeqVect &v, MSA &msaOut)
 		}
 	else
 		RefineTree(msaOut, GuideTree);
+	CheckpointAlignment(msaOut);
 
 	extern void DeleteProgNode(ProgNode &Node);
 	const unsigned uNodeCount = GuideTree.GetNodeCount();
@@ -124,7 +126,8 @@ void MUSCLE(SeqVect &v, MSA &msaOut)
 	if (g_bAnchors)
 		RefineVert(msaOut, GuideTree, g_uMaxIters - 2);
 	else
-		RefineHoriz(msaOut, GuideTree, g_uMaxIters - 2, false, false);
+		RefineHoriz(msaOut, GuideTree, g_uMaxIters - 2, false, false, true);
+	UseBestAlignment(msaOut);
 
 	MHackEnd(msaOut);
 	}
@@ -35,6 +35,7 @@
 #include "intmath.h"
 #include "alpha.h"
 #include "params.h"
+#include "musclecontext.h"
 
 #ifndef _WIN32
 #define stricmp strcasecmp
@@ -58,8 +59,15 @@ extern char **g_argv;
 
 const double VERY_LARGE_DOUBLE = 1e20;
 
-extern unsigned g_uTreeSplitNode1;
-extern unsigned g_uTreeSplitNode2;
+#define g_uTreeSplitNode1	(GetMuscleContext()->uTreeSplitNode1)
+#define g_uTreeSplitNode2	(GetMuscleContext()->uTreeSplitNode2)
+
+#define g_bTracePPScore		(GetMuscleContext()->bTracePPScore)
+#define g_ptrPPScoreMSA1	(GetMuscleContext()->ptrPPScoreMSA1)
+#define g_ptrPPScoreMSA2	(GetMuscleContext()->ptrPPScoreMSA2)
+
+#define g_SPScoreLetters	(GetDPWorkspace()->SPScoreLetters)
+#define g_SPScoreGaps		(GetDPWorkspace()->SPScoreGaps)
 
 // Number of elements in array a[]
 #define countof(a)	(sizeof(a)/sizeof(a[0]))
@@ -168,6 +176,9 @@ void CheckMemUse();
 const char *ElapsedTimeAsString();
 char *SecsToHHMMSS(long lSecs, char szStr[]);
 double GetCPUGHz();
+double GetWallSecs();
+bool CPUHasSSE41();
+bool CPUHasAVX2();
 SCORE GetBlosum62(unsigned uLetterA, unsigned uLetterB);
 SCORE GetBlosum62d(unsigned uLetterA, unsigned uLetterB);
 SCORE GetBlosum50(unsigned uLetterA, unsigned uLetterB);
@@ -186,6 +197,8 @@ void DistKmer6_6(const SeqVect &v, DistFunc &DF);
 void DistKmer4_6(const SeqVect &v, DistFunc &DF);
 void DistPWKimura(const SeqVect &v, DistFunc &DF);
 void FastDistKmer(const SeqVect &v, DistFunc &DF);
+void DistMinHash20_4(const SeqVect &v, DistFunc &DF);
+void DistPWKimuraFast(const SeqVect &v, DistFunc &DF);
 void DistUnaligned(const SeqVect &v, DISTANCE DistMethod, DistFunc &DF);
 double PctIdToMAFFTDist(double dPctId);
 double KimuraDist(double dPctId);
@@ -194,12 +207,29 @@ void AssertProfsEq(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB);
 void ValidateMuscleIds(const MSA &msa);
 void ValidateMuscleIds(const Tree &tree);
-void TraceBackToPath(int **TraceBack, unsigned uLengthA,
+
+// Traceback cell of GlobalAlignSP, SPN, LE and SS. The low two bits
+// are the predecessor of M(i,j); the others record where the best
+// delete in column j and the best insert in row i were opened.
+const unsigned char TB_M = 0;
+const unsigned char TB_D = 1;
+const unsigned char TB_I = 2;
+const unsigned char TB_TYPE = 3;
+const unsigned char TB_DOPEN = 4;
+const unsigned char TB_IOPEN = 8;
+
+void AllocPackedTB(PACKED_TB &PTB, unsigned uLengthA, unsigned uLengthB);
+void FreePackedTB(PACKED_TB &PTB);
+void PackTBRow(PACKED_TB &PTB, unsigned i, const unsigned char TBRow[],
+  unsigned uLengthB);
+void TraceBackToPath(const PACKED_TB &PTB, unsigned uLengthA,
   unsigned uLengthB, PWPath &Path);
 void BitTraceBack(char **TraceBack, unsigned uLengthA, unsigned uLengthB,
   char LastEdge, PWPath &Path);
 SCORE AlignTwoMSAs(const MSA &msa1, const MSA &msa2, MSA &msaOut, PWPath &Path,
   bool bLockLeft = false, bool bLockRight = false);
+SCORE AlignTwoMSAs(const MSAView &msa1, const MSAView &msa2, MSA &msaOut,
+  PWPath &Path, bool bLockLeft = false, bool bLockRight = false);
 SCORE AlignTwoProfs(
   const ProfPos *PA, unsigned uLengthA, WEIGHT wA,
   const ProfPos *PB, unsigned uLengthB, WEIGHT wB,
@@ -212,10 +242,15 @@ void AlignTwoMSAsGivenPathSW(const PWPath &Path, const MSA &msaA, const MSA &msa
   MSA &msaCombined);
 void AlignTwoMSAsGivenPath(const PWPath &Path, const MSA &msaA, const MSA &msaB,
   MSA &msaCombined);
+void AlignTwoMSAsGivenPath(const PWPath &Path, const MSAView &msaA,
+  const MSAView &msaB, MSA &msaCombined);
 SCORE FastScorePath2(const ProfPos *PA, unsigned uLengthA,
   const ProfPos *PB, unsigned uLengthB, const PWPath &Path);
 SCORE GlobalAlignDiags(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path);
+bool NWBanded(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
+  unsigned uLengthB, const unsigned Lo[], const unsigned Hi[], PWPath &Path,
+  SCORE *ptrScore);
 SCORE GlobalAlignSimple(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path);
 SCORE GlobalAlignSP(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
@@ -227,7 +262,8 @@ SCORE GlobalAlignLE(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 void CalcThreeWayWeights(const Tree &tree, unsigned uNode1, unsigned uNode2,
   WEIGHT *Weights);
 SCORE GlobalAlignSS(const Seq &seqA, const Seq &seqB, PWPath &Path);
-bool RefineHoriz(MSA &msaIn, const Tree &tree, unsigned uIters, bool bLockLeft, bool bLockRight);
+bool RefineHoriz(MSA &msaIn, const Tree &tree, unsigned uIters, bool bLockLeft, bool bLockRight,
+  bool bCheckpoint = false);
 bool RefineVert(MSA &msaIn, const Tree &tree, unsigned uIters);
 SCORE GlobalAlignNoDiags(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path);
@@ -248,6 +284,15 @@ void SaveCurrentAlignment();
 void SetCurrentAlignment(MSA &msa);
 void SetOutputFileName(const char *out);
 
+// Anytime alignment, see savebest.cpp.
+void SetRefineDeadline(double dSecs);
+void SetRefineCancelFlag(const volatile bool *ptrCancel);
+void SetCheckpointCallback(CHECKPOINT_FN Fn, void *ptrUser);
+bool RefineStopped();
+void CheckpointAlignment(const MSA &msa);
+void UseBestAlignment(MSA &msa);
+const MSA *GetBestAlignment(SCORE *ptrScore = 0);
+
 #if	DEBUG
 void SetMuscleSeqVect(SeqVect &v);
 void SetMuscleInputMSA(MSA &msa);
@@ -264,7 +309,6 @@ void ProcessArgStr(const char *Str);
 void Usage();
 void SetParams();
 
-void SortCounts(const FCOUNT fcCounts[], unsigned SortOrder[]);
 unsigned ResidueGroupFromFCounts(const FCOUNT fcCounts[]);
 FCOUNT SumCounts(const FCOUNT Counts[]);
 
@@ -272,6 +316,7 @@ bool FlagOpt(const char *Name);
 const char *ValueOpt(const char *Name);
 void DoMuscle();
 void ProfDB();
+void ProfSearch();
 void DoSP();
 void ProgAlignSubFams();
 void Run();
@@ -281,6 +326,10 @@ void SetSeqWeightMethod(SEQWEIGHT Method);
 SEQWEIGHT GetSeqWeightMethod();
 WEIGHT GetMuscleSeqWeightById(unsigned uId);
 void ListDiagSavings();
+void ListSPStats();
+void ListNWLinearStats();
+bool UseNWLinear(unsigned uLengthA, unsigned uLengthB);
+void TestNWLinear();
 void CheckMaxTime();
 const char *MaxSecsToStr();
 unsigned long GetStartTime();
@@ -307,6 +356,9 @@ char *GetFastaSeq(FILE *f, unsigned *ptrSeqLength, char **ptrLabel,
   bool DeleteGaps = true);
 SCORE SW(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path);
+SCORE StripedSW(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
+  unsigned uLengthB, unsigned *ptruStartA, unsigned *ptruStartB,
+  unsigned *ptruEndA, unsigned *ptruEndB, char *TB = 0);
 void TraceBackSW(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, const SCORE *DPM_, const SCORE *DPD_, const SCORE *DPI_,
   unsigned uPrefixLengthAMax, unsigned uPrefixLengthBMax, PWPath &Path);
@@ -314,6 +366,7 @@ void DiffPaths(const PWPath &p1, const PWPath &p2, unsigned Edges1[],
   unsigned *ptruDiffCount1, unsigned Edges2[], unsigned *ptruDiffCount2);
 void SetPPScore(bool bRespectFlagOpts = true);
 void SetPPScore(PPSCORE p);
+void SetPPKernels();
 SCORE GlobalAlignDimer(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path);
 bool MissingCommand();
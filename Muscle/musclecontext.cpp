@@ -0,0 +1,165 @@
+#include "muscle.h"
+#include "msa.h"
+#include "tree.h"
+
+DPWorkspace::DPWorkspace()
+	{
+	memset(&DPMemSP, 0, sizeof(DPMemSP));
+	memset(&DPMemSPN, 0, sizeof(DPMemSPN));
+	memset(&DPMemLE, 0, sizeof(DPMemLE));
+	memset(&DPMemSS, 0, sizeof(DPMemSS));
+	memset(&NWSmallMem, 0, sizeof(NWSmallMem));
+	memset(&NWBandedMem, 0, sizeof(NWBandedMem));
+	memset(&NWLinearMem, 0, sizeof(NWLinearMem));
+	memset(&SWStripedMem, 0, sizeof(SWStripedMem));
+
+	SPRowFn = 0;
+	SPRowFnName = 0;
+	dSPCells = 0;
+	tSPTicks = 0;
+
+	dDPAreaWithoutDiags = 0;
+	dDPAreaWithDiags = 0;
+
+	uNWLinearCount = 0;
+	uNWLinearBlockCount = 0;
+
+	memset(&DiagSeedsMem, 0, sizeof(DiagSeedsMem));
+
+	SPScoreLetters = 0;
+	SPScoreGaps = 0;
+
+	Gaps = 0;
+	GapFreeList = 0;
+	uGapMaxSeqCount = 0;
+	uGapMaxColCount = 0;
+	uGapColCount = 0;
+	GapColDiff = 0;
+
+	memset(GapScoreMatrix, 0, sizeof(GapScoreMatrix));
+	bGapScoreMatrixInit = false;
+
+	RefineEdges1 = 0;
+	RefineEdges2 = 0;
+	uRefineEdgesSize = 0;
+	}
+
+DPWorkspace::~DPWorkspace()
+	{
+	FreeDPMem(DPMemSP);
+	FreeDPMem(DPMemSPN);
+	FreeDPMem(DPMemLE);
+	FreeDPMem(DPMemSS);
+	FreeNWSmallMem(NWSmallMem);
+	FreeNWBandedMem(NWBandedMem);
+	FreeSWStripedMem(SWStripedMem);
+
+	FreeDiagSeedsMem(DiagSeedsMem);
+	delete[] Gaps;
+	delete[] GapColDiff;
+	delete[] RefineEdges1;
+	delete[] RefineEdges2;
+	}
+
+// Add the statistics of a worker's workspace, so that the
+// ListXxxStats functions report totals for the run.
+void DPWorkspace::AddStats(const DPWorkspace &w)
+	{
+	dSPCells += w.dSPCells;
+	tSPTicks += w.tSPTicks;
+	dDPAreaWithoutDiags += w.dDPAreaWithoutDiags;
+	dDPAreaWithDiags += w.dDPAreaWithDiags;
+	uNWLinearCount += w.uNWLinearCount;
+	uNWLinearBlockCount += w.uNWLinearBlockCount;
+	if (0 == SPRowFnName)
+		SPRowFnName = w.SPRowFnName;
+	}
+
+MuscleContext::MuscleContext()
+	{
+	memset(&alpha, 0, sizeof(alpha));
+	alpha.Alpha = ALPHA_Undefined;
+
+	ValueOpts = 0;
+	FlagOpts = 0;
+
+	uIter = 0;
+	uLocalMaxIters = 0;
+	fProgress = stderr;
+	memset(strFileName, 0, sizeof(strFileName));
+	tLocalStart = 0;
+	memset(strDesc, 0, sizeof(strDesc));
+	bWipeDesc = false;
+	nPrevDescLength = 0;
+	uTotalSteps = 0;
+
+	memset(strListFileName, 0, sizeof(strListFileName));
+	bListFileAppend = false;
+	fListFile = 0;
+	SeqWeight = SEQWEIGHT_Undefined;
+
+	uMSAIdCount = 0;
+
+	ptrMuscleTree = 0;
+	uTreeSplitNode1 = NULL_NEIGHBOR;
+	uTreeSplitNode2 = NULL_NEIGHBOR;
+	MuscleWeights = 0;
+	uMuscleIdCount = 0;
+
+	ptrBestMSA = 0;
+	pstrOutputFileName = 0;
+	bSaveCalled = false;
+	dRefineDeadline = 0;
+	ptrRefineCancel = 0;
+	CheckpointFn = 0;
+	ptrCheckpointUser = 0;
+	ptrCheckpointMSA = 0;
+	scoreCheckpoint = 0;
+	bRefineStopped = false;
+
+	ptrMuscleSeqVect = 0;
+	ptrMuscleInputMSA = 0;
+
+	bTracePPScore = false;
+	ptrPPScoreMSA1 = 0;
+	ptrPPScoreMSA2 = 0;
+
+	uRefineHeightSubtree = 0;
+	uRefineHeightSubtreeTotal = 0;
+
+	uUPGMALeafCount = 0;
+	uUPGMATriangleSize = 0;
+	uUPGMAInternalNodeCount = 0;
+	uUPGMAInternalNodeIndex = 0;
+	UPGMADist = 0;
+	UPGMAMinDist = 0;
+	UPGMANearestNeighbor = 0;
+	UPGMANodeIndex = 0;
+	UPGMALeft = 0;
+	UPGMARight = 0;
+	UPGMAHeight = 0;
+	UPGMALeftLength = 0;
+	UPGMARightLength = 0;
+
+	MHackM = 0;
+
+	ShortestPathEstimate = 0;
+	Predecessor = 0;
+
+	memset(MxHeading, 0, sizeof(MxHeading));
+	uMxHeadingCount = 0;
+	memset(UserMx, 0, sizeof(UserMx));
+	}
+
+MuscleContext::~MuscleContext()
+	{
+	if (0 != fListFile)
+		fclose(fListFile);
+
+	delete[] ValueOpts;
+	delete[] FlagOpts;
+	delete[] MuscleWeights;
+	delete ptrMuscleInputMSA;
+	delete ptrCheckpointMSA;
+	delete[] MHackM;
+	}
@@ -0,0 +1,505 @@
+#ifndef MuscleContext_h
+#define MuscleContext_h
+
+#include <time.h>
+
+// All state of a MUSCLE run lives in a MuscleContext: the parameters
+// (params.h), the alphabet (alpha.h), the score matrix, the options
+// and the run state of progress, logging, tree weighting etc.
+// Scratch buffers of the DP and scoring code are in a DPWorkspace,
+// one per thread.
+// Each thread has a current context and workspace, set by
+// SetMuscleContext() / SetDPWorkspace(). The g_xxx names in params.h
+// and alpha.h are macros that refer to the current context, so two
+// threads with different contexts can align independently.
+
+struct GAPINFO;
+struct Diag;
+struct ProfPos;
+class PWEdge;
+
+// Vectorized row of GlobalAlignSP, see glbalignspsimd.cpp.
+typedef void (*SP_ROW_FN)(unsigned i, unsigned uLengthB,
+  const unsigned SortOrderAi[], const FCOUNT FreqsAi[], const SCORE ScoreMxB[],
+  unsigned uStride,
+  const SCORE MPrev[], SCORE MCurr[], const SCORE DPrev[], SCORE DCurr[],
+  unsigned uDeletePos[], const SCORE GapOpenB[], const SCORE GapCloseB[],
+  SCORE scoreGapOpenAi, SCORE scoreGapCloseAi_1, SCORE scoreCenter,
+  SCORE scoreM0Gap, unsigned char TBRow[]);
+
+// Kernels specialized for the alphabet size and profile-profile
+// score, chosen by SetPPKernels. See profilefrommsa.cpp and
+// ppscoremx.cpp.
+typedef void (*AASCORES_FN)(ProfPos &PP);
+typedef void (*PPSCORES_FN)(const ProfPos *PA, unsigned uFromA, unsigned uToA,
+  const ProfPos *PB, unsigned uLengthB, SCORE Mx[]);
+
+// Called with each better alignment of an anytime run, see
+// savebest.cpp. Returning false stops refinement.
+typedef bool (*CHECKPOINT_FN)(const MSA &msa, SCORE Score, void *ptrUser);
+
+// Traceback of GlobalAlignSP, SPN, LE and SS, four bits per cell in
+// one slab. See tracebackopt.cpp.
+struct PACKED_TB
+	{
+	unsigned uRowBytes;
+	size_t uSize;
+	unsigned char *Slab;
+	int iLastTB;
+	};
+
+// Row buffers and traceback of GlobalAlignSP, SPN, LE and SS.
+// Not all kernels use all fields. The buffers are carved from Slab,
+// see dpmem.cpp.
+struct DP_MEMORY
+	{
+	unsigned uLength;
+	unsigned uAlphaSize;
+	char *Slab;
+	SCORE *GapOpenA;
+	SCORE *GapOpenB;
+	SCORE *GapCloseA;
+	SCORE *GapCloseB;
+	SCORE *MPrev;
+	SCORE *MCurr;
+	SCORE *MWork;
+	SCORE *DPrev;
+	SCORE *DCurr;
+	SCORE *DWork;
+	SCORE **MxRowA;
+	unsigned *LettersB;
+	SCORE *ScoreMxB;
+	FCOUNT *OccA;
+	FCOUNT *OccB;
+	unsigned *SortOrderA;
+	unsigned *uDeletePos;
+	FCOUNT *FreqsA;
+	unsigned char *TBRow;
+	PACKED_TB TB;
+	};
+
+// Row buffers, match scores and bit traceback of NWSmall.
+struct NWSMALL_MEMORY
+	{
+	unsigned uPrefixCountA;
+	unsigned uPrefixCountB;
+	SCORE *MCurr;
+	SCORE *MNext;
+	SCORE *MPrev;
+	SCORE *DRow;
+	char **TB;
+	size_t uScoreMxSize;
+	SCORE *ScoreMx;
+	};
+
+// Row buffers and banded traceback of NWBanded.
+struct NWBANDED_MEMORY
+	{
+	unsigned uPrefixCountA;
+	unsigned uPrefixCountB;
+	SCORE *MPrev;
+	SCORE *MCurr;
+	SCORE *DPrev;
+	SCORE *DCurr;
+	SCORE *IPrev;
+	SCORE *ICurr;
+	size_t *TBOffset;
+	size_t uTBSize;
+	char *TB;
+	PWEdge *Edges;
+	};
+
+// Seed index of the longer profile and candidate diagonals of
+// FindDiagsSeeds.
+struct DIAGSEEDS_MEMORY
+	{
+	unsigned uTupleCount;
+	unsigned *TupleStart;
+	unsigned uLength;
+	unsigned *TuplesA;
+	unsigned *TuplesB;
+	unsigned *PosB;
+	unsigned *DiagEnd;
+	unsigned *EndCount;
+	unsigned *TreeScore;
+	unsigned *TreeIndex;
+	unsigned uMaxCandCount;
+	unsigned uCandCount;
+	Diag *Cands;
+	unsigned *ChainScore;
+	unsigned *ChainPrev;
+	unsigned *ByEnd;
+	};
+
+// State of one NWLinear call, see nwlinear.cpp.
+struct NWLINEAR_MEMORY
+	{
+	const ProfPos *PA;
+	const ProfPos *PB;
+	unsigned uLengthA;
+	SCORE e;
+	size_t uBlockCells;
+	SCORE *RowM;
+	SCORE *RowD;
+	SCORE *RowI;
+	unsigned *CrossM;
+	unsigned *CrossD;
+	unsigned *CrossI;
+	SCORE *ScoreMx;
+	unsigned uScoreCells;
+	char *TB;
+	PWEdge *Edges;
+	unsigned uEdgeCount;
+	};
+
+// Striped rows and match scores of StripedSW, see swstriped.cpp.
+struct SWSTRIPED_MEMORY
+	{
+	size_t uItemCount;
+	char *Slab;
+	SCORE *GapOpenA;
+	SCORE *GapCloseA;
+	unsigned *Rows;
+	SCORE *MPrev;
+	SCORE *MCurr;
+	SCORE *DPrev;
+	SCORE *DCurr;
+	SCORE *IPrev;
+	SCORE *ICurr;
+	unsigned *OMPrev;
+	unsigned *OMCurr;
+	unsigned *ODPrev;
+	unsigned *ODCurr;
+	unsigned *OIPrev;
+	unsigned *OICurr;
+	unsigned *TBRow;
+	SCORE *Scores;
+	SCORE *Mx;
+	};
+
+void AllocDPMem(DP_MEMORY &DPM, unsigned uLengthA, unsigned uLengthB,
+  unsigned uAlphaSize);
+void FreeDPMem(DP_MEMORY &DPM);
+void FreeNWSmallMem(NWSMALL_MEMORY &NWM);
+void FreeNWBandedMem(NWBANDED_MEMORY &NBM);
+void FreeDiagSeedsMem(DIAGSEEDS_MEMORY &DSM);
+void FreeSWStripedMem(SWSTRIPED_MEMORY &SWM);
+
+struct DPWorkspace
+	{
+	DPWorkspace();
+	~DPWorkspace();
+	void AddStats(const DPWorkspace &w);
+
+	DP_MEMORY DPMemSP;
+	DP_MEMORY DPMemSPN;
+	DP_MEMORY DPMemLE;
+	DP_MEMORY DPMemSS;
+	NWSMALL_MEMORY NWSmallMem;
+	NWBANDED_MEMORY NWBandedMem;
+	NWLINEAR_MEMORY NWLinearMem;
+	SWSTRIPED_MEMORY SWStripedMem;
+
+// glbalignsp.cpp
+	SP_ROW_FN SPRowFn;
+	const char *SPRowFnName;
+	double dSPCells;
+	clock_t tSPTicks;
+
+// glbaligndiag.cpp
+	double dDPAreaWithoutDiags;
+	double dDPAreaWithDiags;
+
+// nwlinear.cpp
+	unsigned uNWLinearCount;
+	unsigned uNWLinearBlockCount;
+
+// finddiags.cpp, finddiagsn.cpp
+	DIAGSEEDS_MEMORY DiagSeedsMem;
+
+// objscore2.cpp
+	SCORE SPScoreLetters;
+	SCORE SPScoreGaps;
+
+// scoregaps.cpp
+	GAPINFO **Gaps;
+	GAPINFO *GapFreeList;
+	unsigned uGapMaxSeqCount;
+	unsigned uGapMaxColCount;
+	unsigned uGapColCount;
+	bool *GapColDiff;
+
+// spfast.cpp
+	SCORE GapScoreMatrix[4][4];
+	bool bGapScoreMatrixInit;
+
+// refinehoriz.cpp
+	unsigned *RefineEdges1;
+	unsigned *RefineEdges2;
+	unsigned uRefineEdgesSize;
+
+private:
+	DPWorkspace(const DPWorkspace &);
+	DPWorkspace &operator=(const DPWorkspace &);
+	};
+
+// Command-line parameters, see params.cpp for defaults.
+struct MuscleParams
+	{
+	MuscleParams();
+
+	const char *pstrInFileName;
+	const char *pstrOutFileName;
+	const char *pstrFASTAOutFileName;
+	const char *pstrMSFOutFileName;
+	const char *pstrClwOutFileName;
+	const char *pstrClwStrictOutFileName;
+	const char *pstrHTMLOutFileName;
+	const char *pstrPHYIOutFileName;
+	const char *pstrPHYSOutFileName;
+	const char *pstrFileName1;
+	const char *pstrFileName2;
+	const char *pstrSPFileName;
+	const char *pstrMatrixFileName;
+	const char *pstrUseTreeFileName;
+	const char *pstrComputeWeightsFileName;
+	const char *pstrScoreFileName;
+	const char *pstrProf1FileName;
+	const char *pstrProf2FileName;
+	const char *pstrDistMxFileName;
+	bool bUseTreeNoWarn;
+
+	SCORE scoreGapOpen;
+	SCORE scoreCenter;
+	SCORE scoreGapExtend;
+	SCORE scoreGapOpen2;
+	SCORE scoreGapExtend2;
+	SCORE scoreGapAmbig;
+	SCORE scoreAmbigFactor;
+	PTR_SCOREMATRIX ptrScoreMatrix;
+
+	unsigned uSmoothWindowLength;
+	unsigned uAnchorSpacing;
+	unsigned uMaxTreeRefineIters;
+	unsigned uMinDiagLength;
+	unsigned uMaxDiagBreak;
+	unsigned uDiagMargin;
+	unsigned uRefineWindow;
+	unsigned uWindowFrom;
+	unsigned uWindowTo;
+	unsigned uSaveWindow;
+	unsigned uWindowOffset;
+	unsigned uMaxSubFamCount;
+	unsigned uHydrophobicRunLength;
+
+	float dHydroFactor;
+	float dSmoothScoreCeil;
+	float dMinBestColScore;
+	float dMinSmoothScore;
+	float dSUEFF;
+
+	bool bPrecompiledCenter;
+	bool bNormalizeCounts;
+	bool bDiags1;
+	bool bDiags2;
+	bool bDiags;
+	bool bAnchors;
+	bool bCatchExceptions;
+	bool bMSF;
+	bool bAln;
+	bool bClwStrict;
+	bool bHTML;
+	bool bPHYI;
+	bool bPHYS;
+	bool bQuiet;
+	bool bVerbose;
+	bool bRefine;
+	bool bRefineW;
+	bool bRefineX;
+	bool bLow;
+	bool bSW;
+	bool bCluster;
+	bool bProfile;
+	bool bProfDB;
+	bool bProfSearch;
+	bool bPPScore;
+	bool bBrenner;
+	bool bDimer;
+	bool bVersion;
+	bool bStable;
+	bool bFASTA;
+	bool bPAS;
+	bool bNoSIMD;
+	bool bDP352;
+	bool bTestNWLinear;
+
+	PPSCORE PPScore;
+	AASCORES_FN AAScoresFn;
+	PPSCORES_FN PPScoresFn;
+	OBJSCORE ObjScore;
+	DISTANCE Distance1;
+	CLUSTER Cluster1;
+	ROOT Root1;
+	SEQWEIGHT SeqWeight1;
+	DISTANCE Distance2;
+	CLUSTER Cluster2;
+	ROOT Root2;
+	SEQWEIGHT SeqWeight2;
+
+	unsigned uMaxIters;
+	unsigned long ulMaxSecs;
+	unsigned uMaxMB;
+	unsigned uMaxTBMB;
+	unsigned uThreads;
+	unsigned uSketchSize;
+	unsigned uTopK;
+
+	SEQTYPE SeqType;
+	TERMGAPS TermGaps;
+	};
+
+// Alphabet tables, see alpha.cpp.
+struct MuscleAlpha
+	{
+	unsigned CharToLetter[MAX_CHAR];
+	unsigned CharToLetterEx[MAX_CHAR];
+	char LetterToChar[MAX_ALPHA];
+	char LetterExToChar[MAX_ALPHA_EX];
+	char UnalignChar[MAX_CHAR];
+	char AlignChar[MAX_CHAR];
+	bool IsWildcardChar[MAX_CHAR];
+	bool IsResidueChar[MAX_CHAR];
+	ALPHA Alpha;
+	unsigned AlphaSize;
+	char InvalidLetters[MAX_CHAR];
+	int InvalidLetterCount;
+	};
+
+const unsigned MAX_LIST_FILE_NAME = 260;
+
+class MuscleContext
+	{
+public:
+	MuscleContext();
+	virtual ~MuscleContext();
+
+public:
+	MuscleParams params;
+	MuscleAlpha alpha;
+
+// options.cpp
+	const char **ValueOpts;
+	bool *FlagOpts;
+
+// progress.cpp
+	unsigned uIter;
+	unsigned uLocalMaxIters;
+	FILE *fProgress;
+	char strFileName[32];
+	time_t tLocalStart;
+	char strDesc[32];
+	bool bWipeDesc;
+	int nPrevDescLength;
+	unsigned uTotalSteps;
+
+// globals.cpp
+	char strListFileName[MAX_LIST_FILE_NAME];
+	bool bListFileAppend;
+	FILE *fListFile;
+	SEQWEIGHT SeqWeight;
+
+// msa.cpp
+	unsigned uMSAIdCount;
+
+// msa2.cpp
+	const Tree *ptrMuscleTree;
+	unsigned uTreeSplitNode1;
+	unsigned uTreeSplitNode2;
+	WEIGHT *MuscleWeights;
+	unsigned uMuscleIdCount;
+
+// savebest.cpp
+	MSA *ptrBestMSA;
+	const char *pstrOutputFileName;
+	bool bSaveCalled;
+	double dRefineDeadline;
+	const volatile bool *ptrRefineCancel;
+	CHECKPOINT_FN CheckpointFn;
+	void *ptrCheckpointUser;
+	MSA *ptrCheckpointMSA;
+	SCORE scoreCheckpoint;
+	bool bRefineStopped;
+
+// validateids.cpp
+	SeqVect *ptrMuscleSeqVect;
+	MSA *ptrMuscleInputMSA;
+
+// ppscore.cpp
+	bool bTracePPScore;
+	MSA *ptrPPScoreMSA1;
+	MSA *ptrPPScoreMSA2;
+
+// refinehoriz.cpp
+	unsigned uRefineHeightSubtree;
+	unsigned uRefineHeightSubtreeTotal;
+
+// upgma2.cpp
+	unsigned uUPGMALeafCount;
+	size_t uUPGMATriangleSize;
+	unsigned uUPGMAInternalNodeCount;
+	unsigned uUPGMAInternalNodeIndex;
+	float *UPGMADist;
+	float *UPGMAMinDist;
+	unsigned *UPGMANearestNeighbor;
+	unsigned *UPGMANodeIndex;
+	unsigned *UPGMALeft;
+	unsigned *UPGMARight;
+	float *UPGMAHeight;
+	float *UPGMALeftLength;
+	float *UPGMARightLength;
+
+// mhack.cpp
+	bool *MHackM;
+
+// subfams.cpp
+	float *ShortestPathEstimate;
+	unsigned *Predecessor;
+
+// readmx.cpp
+	char MxHeading[32];
+	unsigned uMxHeadingCount;
+	SCOREMATRIX UserMx;
+
+// Workspace of the thread that owns the context.
+	DPWorkspace Workspace;
+
+private:
+	MuscleContext(const MuscleContext &);
+	MuscleContext &operator=(const MuscleContext &);
+	};
+
+// Current context and workspace of the calling thread.
+// SetMuscleContext also makes the context's own workspace current.
+// Both return the previous value.
+MuscleContext *SetMuscleContext(MuscleContext *ptrContext);
+DPWorkspace *SetDPWorkspace(DPWorkspace *ptrWorkspace);
+
+#if	WIN32
+MuscleContext *GetMuscleContext();
+DPWorkspace *GetDPWorkspace();
+#else
+extern __thread MuscleContext *g_ptrThreadContext;
+extern __thread DPWorkspace *g_ptrThreadWorkspace;
+
+static inline MuscleContext *GetMuscleContext()
+	{
+	return g_ptrThreadContext;
+	}
+
+static inline DPWorkspace *GetDPWorkspace()
+	{
+	return g_ptrThreadWorkspace;
+	}
+#endif
+
+#endif	// MuscleContext_h
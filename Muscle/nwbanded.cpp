@@ -0,0 +1,361 @@
+#include "muscle.h"
+#include "pwpath.h"
+#include "profile.h"
+
+// NW in a band, see GlobalAlignDiags.
+
+#define	TRACE	0
+
+/***
+Row i of the DP matrices is computed only for prefix lengths j in
+Lo[i] .. Hi[i]. Cells outside the band are minus infinity. Lo and Hi
+must be non-decreasing, with Lo[0] = 0 and Hi[uLengthA] = uLengthB.
+
+The recursion, the special cases for the first row and column and
+the order of the floating-point operations are those of NWSmall. A
+path inside the band therefore gets exactly the score NWSmall would
+give it. The trace-back bits are the same as well.
+
+The score of the path is returned in *ptrScore. Returns false if a
+cell of the best path lies on the edge of the band. A better path
+might then leave the band, so the caller should try again with a
+wider band.
+***/
+
+void FreeNWBandedMem(NWBANDED_MEMORY &NBM)
+	{
+	delete[] NBM.MPrev;
+	delete[] NBM.MCurr;
+	delete[] NBM.DPrev;
+	delete[] NBM.DCurr;
+	delete[] NBM.IPrev;
+	delete[] NBM.ICurr;
+	delete[] NBM.TBOffset;
+	delete[] NBM.TB;
+	delete[] NBM.Edges;
+
+	memset(&NBM, 0, sizeof(NBM));
+	}
+
+static void AllocCache(NWBANDED_MEMORY &NBM, unsigned uPrefixCountA,
+  unsigned uPrefixCountB, size_t uTBSize)
+	{
+	if (uPrefixCountA > NBM.uPrefixCountA || uPrefixCountB > NBM.uPrefixCountB)
+		{
+		FreeNWBandedMem(NBM);
+
+		NBM.uPrefixCountA = uPrefixCountA + 1024;
+		NBM.uPrefixCountB = uPrefixCountB + 1024;
+
+		NBM.MPrev = new SCORE[NBM.uPrefixCountB];
+		NBM.MCurr = new SCORE[NBM.uPrefixCountB];
+		NBM.DPrev = new SCORE[NBM.uPrefixCountB];
+		NBM.DCurr = new SCORE[NBM.uPrefixCountB];
+		NBM.IPrev = new SCORE[NBM.uPrefixCountB];
+		NBM.ICurr = new SCORE[NBM.uPrefixCountB];
+		NBM.TBOffset = new size_t[NBM.uPrefixCountA];
+		NBM.Edges = new PWEdge[NBM.uPrefixCountA + NBM.uPrefixCountB];
+		}
+
+	if (uTBSize > NBM.uTBSize)
+		{
+		delete[] NBM.TB;
+		NBM.uTBSize = uTBSize + uTBSize/4;
+		NBM.TB = new char[NBM.uTBSize];
+		}
+	}
+
+static inline bool InBand(const unsigned Lo[], const unsigned Hi[],
+  unsigned i, unsigned j)
+	{
+	return j >= Lo[i] && j <= Hi[i];
+	}
+
+// True if every neighbour of (i, j) in the matrix is in the band.
+static bool Interior(const unsigned Lo[], const unsigned Hi[],
+  unsigned uLengthA, unsigned uLengthB, unsigned i, unsigned j)
+	{
+	for (int di = -1; di <= 1; ++di)
+		{
+		const int ii = (int) i + di;
+		if (ii < 0 || ii > (int) uLengthA)
+			continue;
+		for (int dj = -1; dj <= 1; ++dj)
+			{
+			const int jj = (int) j + dj;
+			if (jj < 0 || jj > (int) uLengthB)
+				continue;
+			if (!InBand(Lo, Hi, (unsigned) ii, (unsigned) jj))
+				return false;
+			}
+		}
+	return true;
+	}
+
+bool NWBanded(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
+  unsigned uLengthB, const unsigned Lo[], const unsigned Hi[], PWPath &Path,
+  SCORE *ptrScore)
+	{
+	if (uLengthA < 2 || uLengthB < 2)
+		Quit("Internal error, NWBanded: length < 2");
+	if (0 != Lo[0] || uLengthB != Hi[uLengthA])
+		Quit("Internal error, NWBanded: band does not contain both corners");
+
+	SetTermGaps(PA, uLengthA);
+	SetTermGaps(PB, uLengthB);
+
+	const unsigned uPrefixCountA = uLengthA + 1;
+	const unsigned uPrefixCountB = uLengthB + 1;
+	const SCORE e = g_scoreGapExtend;
+
+	size_t uTBSize = 0;
+	for (unsigned i = 0; i < uPrefixCountA; ++i)
+		uTBSize += Hi[i] - Lo[i] + 1;
+
+	NWBANDED_MEMORY &NBM = GetDPWorkspace()->NWBandedMem;
+	AllocCache(NBM, uPrefixCountA, uPrefixCountB, uTBSize);
+
+	SCORE *MPrev = NBM.MPrev;
+	SCORE *MCurr = NBM.MCurr;
+	SCORE *DPrev = NBM.DPrev;
+	SCORE *DCurr = NBM.DCurr;
+	SCORE *IPrev = NBM.IPrev;
+	SCORE *ICurr = NBM.ICurr;
+	size_t *TBOffset = NBM.TBOffset;
+	char *TB = NBM.TB;
+	memset(TB, 0, uTBSize);
+
+// TB[TBOffset[i] + j] is cell (i, j). The offset wraps for j < Lo[i],
+// which is never used.
+	size_t uOffset = 0;
+	for (unsigned i = 0; i < uPrefixCountA; ++i)
+		{
+		TBOffset[i] = uOffset - Lo[i];
+		uOffset += Hi[i] - Lo[i] + 1;
+		}
+
+// Row 0. I(0, j) is only reached through the closed form of M(1, j).
+	for (unsigned j = 0; j <= Hi[0]; ++j)
+		{
+		MPrev[j] = (0 == j) ? 0 : MINUS_INFINITY;
+		DPrev[j] = MINUS_INFINITY;
+		IPrev[j] = MINUS_INFINITY;
+		}
+
+	for (unsigned i = 1; i <= uLengthA; ++i)
+		{
+		const unsigned uLo = Lo[i];
+		const unsigned uHi = Hi[i];
+		const unsigned uLoPrev = Lo[i-1];
+		const unsigned uHiPrev = Hi[i-1];
+		char *TBRow = TB + TBOffset[i];
+		const ProfPos &PPA = PA[i-1];
+
+		unsigned j = uLo;
+		if (0 == j)
+			{
+		// Lo is non-decreasing, so column 0 is in the band for all rows
+		// above this one.
+			MCurr[0] = MINUS_INFINITY;
+			ICurr[0] = MINUS_INFINITY;
+			if (i == uLengthA)
+				DCurr[0] = MINUS_INFINITY;
+			else
+				DCurr[0] = PA[0].m_scoreGapOpen + (i - 1)*e;
+			++j;
+			}
+
+		SCORE Iij = MINUS_INFINITY;
+		for (; j <= uHi; ++j)
+			{
+			const ProfPos &PPB = PB[j-1];
+			const bool bUp = (j <= uHiPrev);
+			const bool bDiag = (j - 1 >= uLoPrev && j - 1 <= uHiPrev);
+			const bool bLeft = (j - 1 >= uLo);
+			char Bits = 0;
+
+			SCORE DD = (bUp ? DPrev[j] : MINUS_INFINITY) + e;
+			SCORE MD = (bUp ? MPrev[j] : MINUS_INFINITY) + PPA.m_scoreGapOpen;
+			SCORE Dij;
+			if (DD > MD)
+				Dij = DD;
+			else
+				{
+				Dij = MD;
+				Bits |= BIT_MD;
+				}
+
+			Iij += e;
+			SCORE MI = (bLeft ? MCurr[j-1] : MINUS_INFINITY) + PPB.m_scoreGapOpen;
+			if (MI >= Iij)
+				{
+				Iij = MI;
+				Bits |= BIT_MI;
+				}
+
+			SCORE Mij;
+			const SCORE Score = ScoreProfPos2(PPA, PPB);
+			if (1 == i && 1 == j)
+				{
+				Mij = Score;
+				Bits |= BIT_MM;
+				}
+			else if (1 == i)
+				{
+				if (Hi[0] >= j - 1)
+					Mij = Score + PB[0].m_scoreGapOpen + (j - 2)*e +
+					  PB[j-2].m_scoreGapClose;
+				else
+					Mij = MINUS_INFINITY;
+				Bits |= BIT_IM;
+				}
+			else if (1 == j)
+				{
+				if (0 != uLoPrev)
+					Mij = MINUS_INFINITY;
+				else if (i == uLengthA)
+					Mij = Score + (uLengthA - 2)*e + PA[0].m_scoreGapOpen +
+					  PA[uLengthA-2].m_scoreGapClose;
+				else
+					Mij = Score + PA[0].m_scoreGapOpen + (i - 2)*e +
+					  PA[i-2].m_scoreGapClose;
+				Bits |= BIT_DM;
+				}
+			else
+				{
+				SCORE MM = MINUS_INFINITY;
+				SCORE DM = MINUS_INFINITY;
+				SCORE IM = MINUS_INFINITY;
+				if (bDiag)
+					{
+					MM = MPrev[j-1];
+					DM = DPrev[j-1] + PA[i-2].m_scoreGapClose;
+					IM = IPrev[j-1] + PB[j-2].m_scoreGapClose;
+					}
+				if (MM >= DM && MM >= IM)
+					{
+					Mij = Score + MM;
+					Bits |= BIT_MM;
+					}
+				else if (DM >= MM && DM >= IM)
+					{
+					Mij = Score + DM;
+					Bits |= BIT_DM;
+					}
+				else
+					{
+					Mij = Score + IM;
+					Bits |= BIT_IM;
+					}
+				}
+
+			MCurr[j] = Mij;
+			DCurr[j] = Dij;
+			ICurr[j] = Iij;
+			TBRow[j] = Bits;
+			}
+
+		SCORE *Tmp = MPrev;
+		MPrev = MCurr;
+		MCurr = Tmp;
+		Tmp = DPrev;
+		DPrev = DCurr;
+		DCurr = Tmp;
+		Tmp = IPrev;
+		IPrev = ICurr;
+		ICurr = Tmp;
+		}
+
+// The last row is now in the Prev buffers.
+	SCORE MAB = MPrev[uLengthB];
+	SCORE DAB = DPrev[uLengthB];
+	SCORE IAB = IPrev[uLengthB];
+
+	SCORE Score = MAB;
+	char cEdgeType = 'M';
+	if (DAB > Score)
+		{
+		Score = DAB;
+		cEdgeType = 'D';
+		}
+	if (IAB > Score)
+		{
+		Score = IAB;
+		cEdgeType = 'I';
+		}
+
+#if	TRACE
+	Log("NWBanded: MAB=%.4g DAB=%.4g IAB=%.4g best=%c\n",
+	  MAB, DAB, IAB, cEdgeType);
+#endif
+
+// Trace back as BitTraceBack does, collecting the edges in reverse.
+	PWEdge *Edges = NBM.Edges;
+	unsigned uEdgeCount = 0;
+	bool bInterior = true;
+	unsigned i = uLengthA;
+	unsigned j = uLengthB;
+	char c = cEdgeType;
+	while (i > 0 || j > 0)
+		{
+		if (!InBand(Lo, Hi, i, j))
+			Quit("NWBanded: trace-back left band at %u,%u", i, j);
+		if (bInterior && !Interior(Lo, Hi, uLengthA, uLengthB, i, j))
+			bInterior = false;
+
+		PWEdge &Edge = Edges[uEdgeCount++];
+		Edge.cType = c;
+		Edge.uPrefixLengthA = i;
+		Edge.uPrefixLengthB = j;
+
+		const char Bits = TB[TBOffset[i] + j];
+		switch (c)
+			{
+		case 'M':
+			if (0 == i || 0 == j)
+				Quit("NWBanded: M trace-back at %u,%u", i, j);
+			switch (Bits & BIT_xM)
+				{
+			case BIT_MM:
+				c = 'M';
+				break;
+			case BIT_DM:
+				c = 'D';
+				break;
+			case BIT_IM:
+				c = 'I';
+				break;
+			default:
+				Quit("NWBanded: bad trace-back bits");
+				}
+			--i;
+			--j;
+			break;
+
+		case 'D':
+			if (0 == i)
+				Quit("NWBanded: D trace-back at %u,%u", i, j);
+			c = ((Bits & BIT_xD) == BIT_MD) ? 'M' : 'D';
+			--i;
+			break;
+
+		case 'I':
+			if (0 == j)
+				Quit("NWBanded: I trace-back at %u,%u", i, j);
+			c = ((Bits & BIT_xI) == BIT_MI) ? 'M' : 'I';
+			--j;
+			break;
+			}
+		}
+
+	Path.Clear();
+	for (unsigned n = uEdgeCount; n > 0; --n)
+		Path.AppendEdge(Edges[n-1]);
+	*ptrScore = Score;
+
+#if	TRACE
+	Log("NWBanded: %u edges, %s\n", uEdgeCount,
+	  bInterior ? "interior" : "touches band edge");
+#endif
+	return bInterior;
+	}
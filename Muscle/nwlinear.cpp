@@ -0,0 +1,734 @@
+#include "muscle.h"
+#include "pwpath.h"
+#include "profile.h"
+#include "seq.h"
+#include <stdio.h>
+
+// Linear-space global profile-profile alignment giving exactly the
+// path of NWSmall, including the resolution of co-optimal paths.
+// Divide-and-conquer in the manner of Hirschberg, but the split is
+// found by following NWSmall's traceback pointers rather than by
+// adding forward and backward scores, which would resolve ties
+// differently.
+// Cells are computed by the recurrences of NWSmall, with the same
+// special cases in row 1 and column 1, the same order of floating
+// point operations and the same tie-breaking, so every cell gets the
+// same scores and traceback bits as in NWSmall's full matrix.
+// A sub-problem is a rectangle of the matrix given the scores of the
+// row above it and of the column to its left, and a state at its
+// bottom-right cell. A forward pass computes the rectangle to its
+// middle row, saves that row, and carries on to the last row while
+// propagating, for each cell and state, the column at which its
+// traceback crosses into the lower half. The crossing of the
+// traceback from the bottom-right cell splits the rectangle into a
+// lower rectangle ending at the crossing column and an upper one
+// ending where the lower traceback leaves, each solved recursively
+// until a rectangle is small enough for a block of traceback bits.
+// Each cell is computed about three times, memory is
+// O((uLengthA + uLengthB) log uLengthA) plus one block of traceback
+// and one slab of match scores.
+
+#define	TRACE	0
+
+SCORE NWSmall(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
+  unsigned uLengthB, PWPath &Path);
+
+#define COMPARE_NWSMALL	0
+
+static const unsigned MAX_BLOCK_CELLS = 4*1024*1024;
+
+// Match scores are computed by ProfPairScores in slabs of rows of at
+// most this many cells.
+static const unsigned MAX_SCORE_CELLS = 1024*1024;
+
+#define g_PA			(GetDPWorkspace()->NWLinearMem.PA)
+#define g_PB			(GetDPWorkspace()->NWLinearMem.PB)
+#define g_uLengthA		(GetDPWorkspace()->NWLinearMem.uLengthA)
+#define g_e				(GetDPWorkspace()->NWLinearMem.e)
+#define g_uBlockCells	(GetDPWorkspace()->NWLinearMem.uBlockCells)
+
+#define g_RowM			(GetDPWorkspace()->NWLinearMem.RowM)
+#define g_RowD			(GetDPWorkspace()->NWLinearMem.RowD)
+#define g_RowI			(GetDPWorkspace()->NWLinearMem.RowI)
+#define g_CrossM		(GetDPWorkspace()->NWLinearMem.CrossM)
+#define g_CrossD		(GetDPWorkspace()->NWLinearMem.CrossD)
+#define g_CrossI		(GetDPWorkspace()->NWLinearMem.CrossI)
+#define g_ScoreMx		(GetDPWorkspace()->NWLinearMem.ScoreMx)
+#define g_uScoreCells	(GetDPWorkspace()->NWLinearMem.uScoreCells)
+#define g_TB			(GetDPWorkspace()->NWLinearMem.TB)
+#define g_Edges			(GetDPWorkspace()->NWLinearMem.Edges)
+#define g_uEdgeCount	(GetDPWorkspace()->NWLinearMem.uEdgeCount)
+
+#define g_uLinearCount	(GetDPWorkspace()->uNWLinearCount)
+#define g_uBlockCount	(GetDPWorkspace()->uNWLinearBlockCount)
+
+// Scores of the M, D and I states along a row or a column.
+struct LINE
+	{
+	SCORE *M;
+	SCORE *D;
+	SCORE *I;
+	};
+
+static void AllocLine(LINE &L, unsigned uSize)
+	{
+	L.M = new SCORE[3*uSize];
+	L.D = L.M + uSize;
+	L.I = L.D + uSize;
+	}
+
+static void FreeLine(LINE &L)
+	{
+	delete[] L.M;
+	memset(&L, 0, sizeof(L));
+	}
+
+static LINE OffsetLine(const LINE &L, unsigned uOffset)
+	{
+	LINE L2;
+	L2.M = L.M + uOffset;
+	L2.D = L.D + uOffset;
+	L2.I = L.I + uOffset;
+	return L2;
+	}
+
+static void CopyLine(const LINE &From, unsigned uSize, SCORE *M, SCORE *D,
+  SCORE *I)
+	{
+	memcpy(M, From.M, uSize*sizeof(SCORE));
+	memcpy(D, From.D, uSize*sizeof(SCORE));
+	memcpy(I, From.I, uSize*sizeof(SCORE));
+	}
+
+// Match scores of A position i-1 with B positions c0 .. c0+w-1, i.e.
+// of the cells in row i. Rows are visited in increasing order, a new
+// slab is computed when row i is past the current one.
+static const SCORE *GetScoreRow(unsigned i, unsigned uLastRow, unsigned c0,
+  unsigned w, unsigned &uSlabFrom, unsigned &uSlabTo)
+	{
+	if (i >= uSlabTo)
+		{
+		unsigned uSlabRows = g_uScoreCells/w;
+		if (uSlabRows < 1)
+			uSlabRows = 1;
+		uSlabFrom = i;
+		uSlabTo = i + uSlabRows;
+		if (uSlabTo > uLastRow + 1)
+			uSlabTo = uLastRow + 1;
+		ProfPairScores(g_PA, uSlabFrom - 1, uSlabTo - 1, g_PB + c0, w, g_ScoreMx);
+		}
+	return g_ScoreMx + (size_t) (i - uSlabFrom)*w;
+	}
+
+// Row i, columns c0 .. c0+w. On entry M, D and I hold row i-1, on
+// return row i, with (LeftM, LeftD, LeftI) in column c0. Traceback
+// bits of columns c0+1 .. c0+w are stored in TBRow[0 .. w-1].
+// This is the inner loop of NWSmall, RECURSE_D, RECURSE_I and
+// RECURSE_M for cell (i, j), including its special cases for M in
+// row 1 and column 1.
+static void DPRow(unsigned i, unsigned c0, unsigned w, SCORE LeftM, SCORE LeftD,
+  SCORE LeftI, const SCORE *ScoreRow, SCORE *M, SCORE *D, SCORE *I,
+  char *TBRow)
+	{
+	const ProfPos *PA = g_PA;
+	const ProfPos *PB = g_PB;
+	const SCORE e = g_e;
+	const unsigned uLengthA = g_uLengthA;
+	const SCORE GapOpenA = PA[i-1].m_scoreGapOpen;
+	const SCORE GapCloseA = (i >= 2) ? PA[i-2].m_scoreGapClose : 0;
+
+	SCORE DiagM = M[0];
+	SCORE DiagD = D[0];
+	SCORE DiagI = I[0];
+	M[0] = LeftM;
+	D[0] = LeftD;
+	I[0] = LeftI;
+	SCORE Iij = LeftI;
+	for (unsigned k = 1; k <= w; ++k)
+		{
+		const unsigned j = c0 + k;
+		const SCORE UpM = M[k];
+		const SCORE UpD = D[k];
+		const SCORE UpI = I[k];
+		char Bits = 0;
+
+		SCORE DD = UpD + e;
+		SCORE MD = UpM + GapOpenA;
+		if (DD > MD)
+			D[k] = DD;
+		else
+			{
+			D[k] = MD;
+			Bits |= BIT_MD;
+			}
+
+		Iij += e;
+		SCORE MI = M[k-1] + PB[j-1].m_scoreGapOpen;
+		if (MI >= Iij)
+			{
+			Iij = MI;
+			Bits |= BIT_MI;
+			}
+		I[k] = Iij;
+
+		if (1 == i)
+			{
+			if (1 == j)
+				M[k] = ScoreProfPos2(PA[0], PB[0]);
+			else
+				{
+				M[k] = ScoreProfPos2(PA[0], PB[j-1]) + PB[0].m_scoreGapOpen +
+				  (j - 2)*e + PB[j-2].m_scoreGapClose;
+				Bits |= BIT_IM;
+				}
+			}
+		else if (1 == j)
+			{
+			if (i < uLengthA)
+				M[k] = ScoreProfPos2(PA[i-1], PB[0]) + PA[0].m_scoreGapOpen +
+				  (i - 2)*e + PA[i-2].m_scoreGapClose;
+			else
+				M[k] = ScoreProfPos2(PA[uLengthA-1], PB[0]) + (uLengthA - 2)*e +
+				  PA[0].m_scoreGapOpen + PA[uLengthA-2].m_scoreGapClose;
+			Bits |= BIT_DM;
+			}
+		else
+			{
+			SCORE DM = DiagD + GapCloseA;
+			SCORE IM = DiagI + PB[j-2].m_scoreGapClose;
+			SCORE MM = DiagM;
+			if (MM >= DM && MM >= IM)
+				M[k] = ScoreRow[k-1] + MM;
+			else if (DM >= MM && DM >= IM)
+				{
+				M[k] = ScoreRow[k-1] + DM;
+				Bits |= BIT_DM;
+				}
+			else
+				{
+				M[k] = ScoreRow[k-1] + IM;
+				Bits |= BIT_IM;
+				}
+			}
+
+		TBRow[k-1] = Bits;
+		DiagM = UpM;
+		DiagD = UpD;
+		DiagI = UpI;
+		}
+	}
+
+// Rows r0+1 .. uToRow of a rectangle, columns c0 .. c0+w. On entry
+// M, D and I hold row r0, on return row uToRow.
+static void ForwardRows(unsigned r0, unsigned uToRow, unsigned c0, unsigned w,
+  const LINE &Left, SCORE *M, SCORE *D, SCORE *I)
+	{
+	unsigned uSlabFrom = 0;
+	unsigned uSlabTo = 0;
+	for (unsigned i = r0 + 1; i <= uToRow; ++i)
+		{
+		const SCORE *ScoreRow = GetScoreRow(i, uToRow, c0, w, uSlabFrom, uSlabTo);
+		const unsigned k = i - r0;
+		DPRow(i, c0, w, Left.M[k], Left.D[k], Left.I[k], ScoreRow, M, D, I, g_TB);
+		}
+	}
+
+// The end state of the full alignment, as NWSmall.
+static char EndState(SCORE MAB, SCORE DAB, SCORE IAB)
+	{
+	SCORE Score = MAB;
+	char cEdgeType = 'M';
+	if (DAB > Score)
+		{
+		Score = DAB;
+		cEdgeType = 'D';
+		}
+	if (IAB > Score)
+		cEdgeType = 'I';
+	return cEdgeType;
+	}
+
+static char NextState(char Bits, char cEdgeType)
+	{
+	switch (cEdgeType)
+		{
+	case 'M':
+		switch (Bits & BIT_xM)
+			{
+		case BIT_MM:
+			return 'M';
+		case BIT_DM:
+			return 'D';
+		case BIT_IM:
+			return 'I';
+			}
+		break;
+	case 'D':
+		return (Bits & BIT_xD) ? 'M' : 'D';
+	case 'I':
+		return (Bits & BIT_xI) ? 'M' : 'I';
+		}
+	Quit("NWLinear: bad edge type %c", cEdgeType);
+	return '?';
+	}
+
+static void AppendTBEdge(char cEdgeType, unsigned i, unsigned j)
+	{
+	PWEdge &Edge = g_Edges[g_uEdgeCount++];
+	Edge.cType = cEdgeType;
+	Edge.uPrefixLengthA = i;
+	Edge.uPrefixLengthB = j;
+	}
+
+// Rectangle with rows r0+1 .. r1 and columns c0+1 .. c1. Top holds row
+// r0, columns c0 .. c1, Left holds column c0, rows r0 .. r1.
+// The traceback starts in state cEdgeType at (r1, c1), or in the end
+// state of NWSmall if cEdgeType is '*'. Its edges are appended to
+// g_Edges until it reaches row r0 or column c0, the edge there (not
+// appended) is returned.
+static PWEdge AlignBlock(unsigned r0, unsigned r1, unsigned c0, unsigned c1,
+  const LINE &Top, const LINE &Left, char cEdgeType)
+	{
+	const unsigned w = c1 - c0;
+	SCORE *M = g_RowM;
+	SCORE *D = g_RowD;
+	SCORE *I = g_RowI;
+	char *TB = g_TB;
+
+	++g_uBlockCount;
+
+	CopyLine(Top, w + 1, M, D, I);
+	unsigned uSlabFrom = 0;
+	unsigned uSlabTo = 0;
+	for (unsigned i = r0 + 1; i <= r1; ++i)
+		{
+		const SCORE *ScoreRow = GetScoreRow(i, r1, c0, w, uSlabFrom, uSlabTo);
+		const unsigned k = i - r0;
+		DPRow(i, c0, w, Left.M[k], Left.D[k], Left.I[k], ScoreRow, M, D, I,
+		  TB + (size_t) (k - 1)*w);
+		}
+
+	if ('*' == cEdgeType)
+		cEdgeType = EndState(M[w], D[w], I[w]);
+
+	unsigned i = r1;
+	unsigned j = c1;
+	while (i > r0 && j > c0)
+		{
+		AppendTBEdge(cEdgeType, i, j);
+		const char Bits = TB[(size_t) (i - r0 - 1)*w + (j - c0 - 1)];
+		switch (cEdgeType)
+			{
+		case 'M':
+			--i;
+			--j;
+			break;
+		case 'D':
+			--i;
+			break;
+		case 'I':
+			--j;
+			break;
+			}
+		cEdgeType = NextState(Bits, cEdgeType);
+		}
+
+	PWEdge Exit;
+	Exit.cType = cEdgeType;
+	Exit.uPrefixLengthA = i;
+	Exit.uPrefixLengthB = j;
+	return Exit;
+	}
+
+static PWEdge AlignRect(unsigned r0, unsigned r1, unsigned c0, unsigned c1,
+  const LINE &Top, const LINE &Left, char cEdgeType)
+	{
+	const unsigned h = r1 - r0;
+	const unsigned w = c1 - c0;
+	if (h < 2 || (size_t) h*w <= g_uBlockCells)
+		return AlignBlock(r0, r1, c0, c1, Top, Left, cEdgeType);
+
+	SCORE *M = g_RowM;
+	SCORE *D = g_RowD;
+	SCORE *I = g_RowI;
+	unsigned *CrossM = g_CrossM;
+	unsigned *CrossD = g_CrossD;
+	unsigned *CrossI = g_CrossI;
+	const char *TBRow = g_TB;
+
+	const unsigned uMidRow = r0 + h/2;
+	CopyLine(Top, w + 1, M, D, I);
+	ForwardRows(r0, uMidRow, c0, w, Left, M, D, I);
+
+	LINE MidRow;
+	AllocLine(MidRow, w + 1);
+	memcpy(MidRow.M, M, (w + 1)*sizeof(SCORE));
+	memcpy(MidRow.D, D, (w + 1)*sizeof(SCORE));
+	memcpy(MidRow.I, I, (w + 1)*sizeof(SCORE));
+
+// Cross[k] is the column, relative to c0, at which the traceback from
+// the cell in column c0+k in the given state enters row uMidRow+1 from
+// above, or 0 if it reaches column c0 first.
+	CrossM[0] = 0;
+	CrossD[0] = 0;
+	CrossI[0] = 0;
+	unsigned uSlabFrom = 0;
+	unsigned uSlabTo = 0;
+	for (unsigned i = uMidRow + 1; i <= r1; ++i)
+		{
+		const SCORE *ScoreRow = GetScoreRow(i, r1, c0, w, uSlabFrom, uSlabTo);
+		const unsigned r = i - r0;
+		DPRow(i, c0, w, Left.M[r], Left.D[r], Left.I[r], ScoreRow, M, D, I,
+		  g_TB);
+
+		unsigned DiagM = 0;
+		unsigned DiagD = 0;
+		unsigned DiagI = 0;
+		for (unsigned k = 1; k <= w; ++k)
+			{
+			const char Bits = TBRow[k-1];
+			const unsigned UpM = CrossM[k];
+			const unsigned UpD = CrossD[k];
+			const unsigned UpI = CrossI[k];
+			if (uMidRow + 1 == i)
+				{
+				CrossM[k] = k;
+				CrossD[k] = k;
+				}
+			else
+				{
+				switch (Bits & BIT_xM)
+					{
+				case BIT_MM:
+					CrossM[k] = DiagM;
+					break;
+				case BIT_DM:
+					CrossM[k] = DiagD;
+					break;
+				case BIT_IM:
+					CrossM[k] = DiagI;
+					break;
+					}
+				CrossD[k] = (Bits & BIT_xD) ? UpM : UpD;
+				}
+			CrossI[k] = (Bits & BIT_xI) ? CrossM[k-1] : CrossI[k-1];
+			DiagM = UpM;
+			DiagD = UpD;
+			DiagI = UpI;
+			}
+		}
+
+	if ('*' == cEdgeType)
+		cEdgeType = EndState(M[w], D[w], I[w]);
+
+	unsigned uCross = 0;
+	switch (cEdgeType)
+		{
+	case 'M':
+		uCross = CrossM[w];
+		break;
+	case 'D':
+		uCross = CrossD[w];
+		break;
+	case 'I':
+		uCross = CrossI[w];
+		break;
+	default:
+		Quit("NWLinear: bad edge type %c", cEdgeType);
+		}
+
+#if	TRACE
+	Log("NWLinear rows %u-%u cols %u-%u %c mid %u cross %u\n",
+	  r0, r1, c0, c1, cEdgeType, uMidRow, uCross);
+#endif
+
+// The traceback stays below the middle row.
+	const LINE LowerLeft = OffsetLine(Left, uMidRow - r0);
+	if (0 == uCross)
+		{
+		PWEdge Exit = AlignRect(uMidRow, r1, c0, c1, MidRow, LowerLeft, cEdgeType);
+		FreeLine(MidRow);
+		return Exit;
+		}
+
+// Lower rectangle from the column left of the crossing, which needs
+// the scores in that column below the middle row.
+	LINE Col = LowerLeft;
+	const unsigned uColw = uCross - 1;
+	if (uColw > 0)
+		{
+		const unsigned uColSize = r1 - uMidRow + 1;
+		AllocLine(Col, uColSize);
+		Col.M[0] = MidRow.M[uColw];
+		Col.D[0] = MidRow.D[uColw];
+		Col.I[0] = MidRow.I[uColw];
+		CopyLine(MidRow, uColw + 1, M, D, I);
+		uSlabFrom = 0;
+		uSlabTo = 0;
+		for (unsigned i = uMidRow + 1; i <= r1; ++i)
+			{
+			const SCORE *ScoreRow = GetScoreRow(i, r1, c0, uColw, uSlabFrom,
+			  uSlabTo);
+			const unsigned r = i - r0;
+			DPRow(i, c0, uColw, Left.M[r], Left.D[r], Left.I[r], ScoreRow, M, D, I,
+			  g_TB);
+			const unsigned k = i - uMidRow;
+			Col.M[k] = M[uColw];
+			Col.D[k] = D[uColw];
+			Col.I[k] = I[uColw];
+			}
+		}
+
+	PWEdge Exit = AlignRect(uMidRow, r1, c0 + uColw, c1,
+	  OffsetLine(MidRow, uColw), Col, cEdgeType);
+	if (uColw > 0)
+		FreeLine(Col);
+	FreeLine(MidRow);
+
+	if (Exit.uPrefixLengthA != uMidRow)
+		Quit("NWLinear: traceback does not cross row %u", uMidRow);
+	if (Exit.uPrefixLengthB == c0)
+		return Exit;
+	return AlignRect(r0, uMidRow, c0, Exit.uPrefixLengthB, Top, Left, Exit.cType);
+	}
+
+// True if NWSmall would allocate more than -maxtbmb for the traceback.
+bool UseNWLinear(unsigned uLengthA, unsigned uLengthB)
+	{
+	if (0 == g_uMaxTBMB)
+		return false;
+	const double dTBMB = ((double) (uLengthA + 1)*(double) (uLengthB + 1))/1e6;
+	return dTBMB > (double) g_uMaxTBMB;
+	}
+
+static SCORE NWLinearCells(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
+  unsigned uLengthB, size_t uBlockCells, PWPath &Path)
+	{
+// NWSmall's traceback is at most two rows or columns here.
+	if (uLengthA < 2 || uLengthB < 2)
+		return NWSmall(PA, uLengthA, PB, uLengthB, Path);
+
+	SetTermGaps(PA, uLengthA);
+	SetTermGaps(PB, uLengthB);
+
+	const SCORE e = g_scoreGapExtend;
+	g_PA = PA;
+	g_PB = PB;
+	g_uLengthA = uLengthA;
+	g_e = e;
+	g_uBlockCells = uBlockCells;
+
+// A block of one row is always allowed, must fit.
+	const unsigned uPrefixCountA = uLengthA + 1;
+	const unsigned uPrefixCountB = uLengthB + 1;
+	size_t uTBSize = uBlockCells;
+	if (uTBSize < uPrefixCountB)
+		uTBSize = uPrefixCountB;
+	g_uScoreCells = MAX_SCORE_CELLS;
+	if (g_uScoreCells < uLengthB)
+		g_uScoreCells = uLengthB;
+
+	g_RowM = new SCORE[uPrefixCountB];
+	g_RowD = new SCORE[uPrefixCountB];
+	g_RowI = new SCORE[uPrefixCountB];
+	g_CrossM = new unsigned[uPrefixCountB];
+	g_CrossD = new unsigned[uPrefixCountB];
+	g_CrossI = new unsigned[uPrefixCountB];
+	g_ScoreMx = new SCORE[g_uScoreCells];
+	g_TB = new char[uTBSize];
+	g_Edges = new PWEdge[uLengthA + uLengthB];
+	g_uEdgeCount = 0;
+
+// Row 0 and column 0 as in NWSmall.
+	LINE Top;
+	AllocLine(Top, uPrefixCountB);
+	Top.M[0] = 0;
+	Top.D[0] = MINUS_INFINITY;
+	Top.I[0] = MINUS_INFINITY;
+	for (unsigned j = 1; j <= uLengthB; ++j)
+		{
+		Top.M[j] = MINUS_INFINITY;
+		Top.D[j] = MINUS_INFINITY;
+		Top.I[j] = (1 == j) ? PB[0].m_scoreGapOpen : Top.I[j-1] + e;
+		}
+
+	LINE Left;
+	AllocLine(Left, uPrefixCountA);
+	Left.M[0] = 0;
+	Left.D[0] = MINUS_INFINITY;
+	Left.I[0] = MINUS_INFINITY;
+	for (unsigned i = 1; i <= uLengthA; ++i)
+		{
+		Left.M[i] = MINUS_INFINITY;
+		Left.D[i] = (i < uLengthA) ? PA[0].m_scoreGapOpen + (i - 1)*e :
+		  MINUS_INFINITY;
+		Left.I[i] = MINUS_INFINITY;
+		}
+
+	++g_uLinearCount;
+	PWEdge Exit = AlignRect(0, uLengthA, 0, uLengthB, Top, Left, '*');
+
+// In row 0 and column 0 all traceback bits are zero, so the state
+// does not change, as in BitTraceBack.
+	char cEdgeType = Exit.cType;
+	unsigned i = Exit.uPrefixLengthA;
+	unsigned j = Exit.uPrefixLengthB;
+	while (i > 0 || j > 0)
+		{
+		AppendTBEdge(cEdgeType, i, j);
+		switch (cEdgeType)
+			{
+		case 'M':
+			if (0 == i || 0 == j)
+				Quit("NWLinear: M edge at (%u, %u)", i, j);
+			--i;
+			--j;
+			break;
+		case 'D':
+			if (0 == i)
+				Quit("NWLinear: D edge at (%u, %u)", i, j);
+			--i;
+			break;
+		case 'I':
+			if (0 == j)
+				Quit("NWLinear: I edge at (%u, %u)", i, j);
+			--j;
+			break;
+		default:
+			Quit("NWLinear: bad edge type %c", cEdgeType);
+			}
+		}
+
+	Path.Clear();
+	for (unsigned k = g_uEdgeCount; k > 0; --k)
+		Path.AppendEdge(g_Edges[k-1]);
+
+	FreeLine(Top);
+	FreeLine(Left);
+	delete[] g_RowM;
+	delete[] g_RowD;
+	delete[] g_RowI;
+	delete[] g_CrossM;
+	delete[] g_CrossD;
+	delete[] g_CrossI;
+	delete[] g_ScoreMx;
+	delete[] g_TB;
+	delete[] g_Edges;
+
+#if	DEBUG
+	Path.Validate();
+#endif
+
+	return 0;
+	}
+
+SCORE NWLinear(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
+  unsigned uLengthB, PWPath &Path)
+	{
+	if (0 == uLengthB || 0 == uLengthA )
+		Quit("Internal error, NWLinear: length=0");
+
+	size_t uBlockCells = MAX_BLOCK_CELLS;
+	if (0 != g_uMaxTBMB && (double) uBlockCells > g_uMaxTBMB*1e6)
+		uBlockCells = (size_t) (g_uMaxTBMB*1e6);
+
+	SCORE Score = NWLinearCells(PA, uLengthA, PB, uLengthB, uBlockCells, Path);
+
+#if	COMPARE_NWSMALL
+	PWPath SmallPath;
+	NWSmall(PA, uLengthA, PB, uLengthB, SmallPath);
+	if (!Path.Equal(SmallPath))
+		{
+		Log("Small:\n");
+		SmallPath.LogMe();
+		Log("Linear:\n");
+		Path.LogMe();
+		Quit("NWLinear: paths differ");
+		}
+#endif
+
+	return Score;
+	}
+
+void ListNWLinearStats()
+	{
+	if (0 == g_uLinearCount)
+		return;
+	Log("NWLinear %u alignments, %u blocks (max traceback %u MB)\n",
+	  g_uLinearCount, g_uBlockCount, g_uMaxTBMB);
+	}
+
+// Repeats and low-complexity sequences, which have many co-optimal
+// alignments.
+static const char *TestSeqs[] =
+	{
+	"ACDEFGHIKLACDEFGHIKLACDEFGHIKLACDEFGHIKLACDEFGHIKLACDEFGHIKL"
+	  "ACDEFGHIKLACDEFGHIKLACDEFGHIKLACDEFGHIKLACDEFGHIKL",
+	"ACDEFGHIKLACDEFGHIKLACDEFGHIKLACDEFGHIKLACDEFGHIKLACDEFGHIKL"
+	  "ACDEFGHIKLACDEFGHIKL",
+	"AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAGGGGGGGGGGGGGGGGGGGG"
+	  "GGGGGGGGGGAAAAAAAAAAAAAAAAAAAA",
+	"AAAAAAAAAAAAAAAAAAAAAAAAAGGGGGGGGGGGGGGGGGGGGGGGGGGGGGGGGGGG"
+	  "GGGGGAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA",
+	"QQQQPQQQQPQQQQPQQQQPQQQQPQQQQPQQQQPQQQQPSTSTSTSTSTSTSTSTSTST"
+	  "STSTSTSTSTSTSTSTSTSTSTSTSTSTSTSTSTSTSTST",
+	"QQQQQPQQQQQPQQQQQPQQQQQPQQQQQPSTSTSTSTSTSTSTSTSTSTSTSTSTSTST"
+	  "STSTSTSTSTSTSTSTSTSTSTSTSTSTST",
+	"MKVLAAGIVALLLAAGCSSSKEETKPAEPAKPAEPAKPAEPAKPAEPAKPAEPAKPAEPA"
+	  "KPAEPAKPAEPAKPAEPAKPAEPAKPAEPAKPAEPAKPAEPAKPAEPAKPAEGNW",
+	"MKVLAAGIVALLLAAGCSSSKEETKPAEPAKPAEPAKPAEPAKPAEPAKPAEPAKPAEPA"
+	  "KPAEPAKPAEPAKPAEPAKPAEGNW",
+	};
+static const unsigned TEST_SEQ_COUNT = sizeof(TestSeqs)/sizeof(TestSeqs[0]);
+
+// Aligns every pair of TestSeqs by NWSmall and by NWLinear with
+// blocks from one row up, Quit()s if any path differs.
+void TestNWLinear()
+	{
+	SetAlpha(ALPHA_Amino);
+	SetPPScore();
+
+	ProfPos *Profs[TEST_SEQ_COUNT];
+	unsigned Lengths[TEST_SEQ_COUNT];
+	for (unsigned n = 0; n < TEST_SEQ_COUNT; ++n)
+		{
+		char Name[16];
+		sprintf(Name, "test%u", n);
+		Seq s;
+		s.FromString(TestSeqs[n], Name);
+		Profs[n] = ProfileFromSeq(s);
+		Lengths[n] = s.Length();
+		}
+
+	const size_t BlockCells[] = { 1, 64, 1024, MAX_BLOCK_CELLS };
+	const unsigned BLOCK_CELLS_COUNT = sizeof(BlockCells)/sizeof(BlockCells[0]);
+	unsigned uPairCount = 0;
+	for (unsigned n1 = 0; n1 < TEST_SEQ_COUNT; ++n1)
+		for (unsigned n2 = 0; n2 < TEST_SEQ_COUNT; ++n2)
+			{
+			PWPath SmallPath;
+			NWSmall(Profs[n1], Lengths[n1], Profs[n2], Lengths[n2], SmallPath);
+			for (unsigned b = 0; b < BLOCK_CELLS_COUNT; ++b)
+				{
+				PWPath LinearPath;
+				NWLinearCells(Profs[n1], Lengths[n1], Profs[n2], Lengths[n2],
+				  BlockCells[b], LinearPath);
+				if (!LinearPath.Equal(SmallPath))
+					{
+					Log("Small:\n");
+					SmallPath.LogMe();
+					Log("Linear:\n");
+					LinearPath.LogMe();
+					Quit("NWLinear test: paths differ, seqs %u and %u, block %u cells",
+					  n1, n2, (unsigned) BlockCells[b]);
+					}
+				}
+			++uPairCount;
+			}
+
+	for (unsigned n = 0; n < TEST_SEQ_COUNT; ++n)
+		delete[] Profs[n];
+
+	Log("NWLinear test: %u pairs, paths same as NWSmall\n", uPairCount);
+	printf("NWLinear test: %u pairs, paths same as NWSmall\n", uPairCount);
+	}
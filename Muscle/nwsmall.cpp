@@ -8,6 +8,11 @@
 
 #define	TRACE	0
 
+// Match scores are computed by ProfPairScores in slabs of rows of at
+// most this many cells, i.e. the whole matrix at once unless the
+// profiles are long.
+static const unsigned MAX_SCORE_CELLS = 4*1024*1024;
+
 #if	TRACE
 extern bool g_bKeepSimpleDP;
 extern SCORE *g_DPM;
@@ -457,38 +462,50 @@ static inline void SetBitTBI(char **TB, unsigned i, unsigned j, char c)
 #define LogMatrices()	/* empty */
 #endif
 
-static unsigned uCachePrefixCountB;
-static unsigned uCachePrefixCountA;
-static SCORE *CacheMCurr;
-static SCORE *CacheMNext;
-static SCORE *CacheMPrev;
-static SCORE *CacheDRow;
-static char **CacheTB;
+void FreeNWSmallMem(NWSMALL_MEMORY &NWM)
+	{
+	delete[] NWM.MCurr;
+	delete[] NWM.MNext;
+	delete[] NWM.MPrev;
+	delete[] NWM.DRow;
+	for (unsigned i = 0; i < NWM.uPrefixCountA; ++i)
+		delete[] NWM.TB[i];
+	delete[] NWM.TB;
+	delete[] NWM.ScoreMx;
+
+	memset(&NWM, 0, sizeof(NWM));
+	}
 
-static void AllocCache(unsigned uPrefixCountA, unsigned uPrefixCountB)
+static void AllocCache(NWSMALL_MEMORY &NWM, unsigned uPrefixCountA,
+  unsigned uPrefixCountB)
 	{
-	if (uPrefixCountA <= uCachePrefixCountA && uPrefixCountB <= uCachePrefixCountB)
+	if (uPrefixCountA <= NWM.uPrefixCountA && uPrefixCountB <= NWM.uPrefixCountB)
 		return;
 
-	delete[] CacheMCurr;
-	delete[] CacheMNext;
-	delete[] CacheMPrev;
-	delete[] CacheDRow;
-	for (unsigned i = 0; i < uCachePrefixCountA; ++i)
-		delete[] CacheTB[i];
-	delete[] CacheTB;
-
-	uCachePrefixCountA = uPrefixCountA + 1024;
-	uCachePrefixCountB = uPrefixCountB + 1024;
-
-	CacheMCurr = new SCORE[uCachePrefixCountB];
-	CacheMNext = new SCORE[uCachePrefixCountB];
-	CacheMPrev = new SCORE[uCachePrefixCountB];
-	CacheDRow = new SCORE[uCachePrefixCountB];
-
-	CacheTB = new char *[uCachePrefixCountA];
-	for (unsigned i = 0; i < uCachePrefixCountA; ++i)
-		CacheTB[i] = new char [uCachePrefixCountB];
+	FreeNWSmallMem(NWM);
+
+	NWM.uPrefixCountA = uPrefixCountA + 1024;
+	NWM.uPrefixCountB = uPrefixCountB + 1024;
+
+	NWM.MCurr = new SCORE[NWM.uPrefixCountB];
+	NWM.MNext = new SCORE[NWM.uPrefixCountB];
+	NWM.MPrev = new SCORE[NWM.uPrefixCountB];
+	NWM.DRow = new SCORE[NWM.uPrefixCountB];
+
+	NWM.TB = new char *[NWM.uPrefixCountA];
+	for (unsigned i = 0; i < NWM.uPrefixCountA; ++i)
+		NWM.TB[i] = new char [NWM.uPrefixCountB];
+	}
+
+static SCORE *AllocScoreMx(NWSMALL_MEMORY &NWM, size_t uSize)
+	{
+	if (uSize > NWM.uScoreMxSize)
+		{
+		delete[] NWM.ScoreMx;
+		NWM.uScoreMxSize = uSize + uSize/4;
+		NWM.ScoreMx = new SCORE[NWM.uScoreMxSize];
+		}
+	return NWM.ScoreMx;
 	}
 
 SCORE NWSmall(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
@@ -506,17 +523,27 @@ SCORE NWSmall(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 
 	ALLOC_TRACE()
 
-	AllocCache(uPrefixCountA, uPrefixCountB);
+	NWSMALL_MEMORY &NWM = GetDPWorkspace()->NWSmallMem;
+	AllocCache(NWM, uPrefixCountA, uPrefixCountB);
 
-	SCORE *MCurr = CacheMCurr;
-	SCORE *MNext = CacheMNext;
-	SCORE *MPrev = CacheMPrev;
-	SCORE *DRow = CacheDRow;
+	SCORE *MCurr = NWM.MCurr;
+	SCORE *MNext = NWM.MNext;
+	SCORE *MPrev = NWM.MPrev;
+	SCORE *DRow = NWM.DRow;
 
-	char **TB = CacheTB;
+	char **TB = NWM.TB;
 	for (unsigned i = 0; i < uPrefixCountA; ++i)
 		memset(TB[i], 0, uPrefixCountB);
 
+	unsigned uSlabRows = MAX_SCORE_CELLS/uLengthB;
+	if (uSlabRows < 1)
+		uSlabRows = 1;
+	if (uSlabRows > uLengthA)
+		uSlabRows = uLengthA;
+	SCORE *ScoreMx = AllocScoreMx(NWM, (size_t) uSlabRows*uLengthB);
+	unsigned uSlabFrom = 0;
+	unsigned uSlabTo = 0;
+
 	SCORE Iij = MINUS_INFINITY;
 	SetDPI(0, 0, Iij);
 
@@ -590,8 +617,17 @@ SCORE NWSmall(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
 		SetDPM(i, 0, MCurr[0]);
 		SetDPM(i, 1, MCurr[1]);
 
+		if (i >= uSlabTo)
+			{
+			uSlabFrom = i;
+			uSlabTo = i + uSlabRows;
+			if (uSlabTo > uLengthA)
+				uSlabTo = uLengthA;
+			ProfPairScores(PA, uSlabFrom, uSlabTo, PB, uLengthB, ScoreMx);
+			}
+		const SCORE *ScoreRow = ScoreMx + (size_t) (i - uSlabFrom)*uLengthB;
 		for (unsigned j = 1; j < uLengthB; ++j)
-			MNext[j+1] = ScoreProfPos2(PA[i], PB[j]);
+			MNext[j+1] = ScoreRow[j];
 
 		for (unsigned j = 1; j < uLengthB; ++j)
 			{
@@ -27,4 +27,62 @@ SCORE DiffObjScore(
   const MSA &msa1, const PWPath &Path1, const unsigned Edges1[], unsigned uEdgeCount1, 
   const MSA &msa2, const PWPath &Path2, const unsigned Edges2[], unsigned uEdgeCount2);
 
+// The SP dimer score (ObjScoreSPDimer) of an MSA being refined, kept
+// as one score per column so that a realignment is scored by summing
+// the column scores again and recomputing only the columns on edges
+// that changed, and the column after each of them since a column's gap
+// score depends on the column before it. Column scores are computed
+// with the sequences in id order and ClustalW weights looked up by id,
+// so a column has the same score whatever the row order of the MSA.
+// The totals are exactly those of rescoring every column.
+class SPColScores
+	{
+public:
+	SPColScores();
+	virtual ~SPColScores();
+
+// True if refinement of msa is scored with the SP dimer objective and
+// ClustalW weights.
+	static bool CanUse(const MSA &msa);
+
+	void FromMSA(const MSA &msa);
+	SCORE GetScore() const
+		{
+		return m_Total/2;
+		}
+
+// Score of msaNew, the current MSA with two subsets realigned. The
+// paths and diff edges are those of TryRealign and DiffPaths.
+	SCORE ScoreRealigned(const MSA &msaNew, const PWPath &PathBefore,
+	  const unsigned Edges1[], unsigned uDiffCount1, const PWPath &PathAfter,
+	  const unsigned Edges2[], unsigned uDiffCount2);
+
+// msaNew from the last ScoreRealigned is now the current MSA.
+	void Accept();
+
+private:
+	SPColScores(const SPColScores &);
+	SPColScores &operator=(const SPColScores &);
+
+	void SetRows(const MSA &msa);
+
+private:
+	unsigned m_uSeqCount;
+	unsigned *m_Ids;
+	WEIGHT *m_Weights;
+	const char **m_Rows;
+
+	unsigned m_uColCount;
+	unsigned m_uMaxColCount;
+	SCORE *m_ColScores;
+	SCORE m_Total;
+
+	unsigned m_uNewColCount;
+	unsigned m_uNewMaxColCount;
+	SCORE *m_NewColScores;
+	unsigned *m_NewToOld;
+	unsigned m_uNewToOldSize;
+	SCORE m_NewTotal;
+	};
+
 #endif // ObjScore_h
@@ -13,7 +13,9 @@ struct FLAG_OPT
 	bool m_bSet;
 	};
 
-static VALUE_OPT ValueOpts[] =
+// Option names and defaults. The values set on the command line
+// are in the current MuscleContext.
+static const VALUE_OPT ValueOpts[] =
 	{
 	"in",				0,
 	"in1",				0,
@@ -63,9 +65,14 @@ static VALUE_OPT ValueOpts[] =
 	"SPScore",			0,
 	"SeqType",			0,
 	"MaxMB",			0,
+	"MaxTBMB",			0,
+	"Threads",			0,
+	"SketchSize",		0,
+	"TopK",				0,
 	"ComputeWeights",	0,
 	"MaxSubFam",		0,
 	"ScoreFile",		0,
+	"DistMx",			0,
 	"TermGaps",			0,
 	"FASTAOut",			0,
 	"CLWOut",			0,
@@ -78,7 +85,7 @@ static VALUE_OPT ValueOpts[] =
 	};
 static int ValueOptCount = sizeof(ValueOpts)/sizeof(ValueOpts[0]);
 
-static FLAG_OPT FlagOpts[] =
+static const FLAG_OPT FlagOpts[] =
 	{
 	"LE",					false,
 	"SP",					false,
@@ -110,18 +117,46 @@ static FLAG_OPT FlagOpts[] =
 	"Group",				false,
 	"FASTA",				false,
 	"ProfDB",				false,
+	"ProfSearch",			false,
 	"PAS",					false,
 	"PHYI",					false,
 	"PHYS",					false,
+	"NoSIMD",				false,
+	"DP352",				false,
+	"TestNWLinear",			false,
 	};
 static int FlagOptCount = sizeof(FlagOpts)/sizeof(FlagOpts[0]);
 
+static const char **GetValueOpts()
+	{
+	const char **&Values = GetMuscleContext()->ValueOpts;
+	if (0 == Values)
+		{
+		Values = new const char *[ValueOptCount];
+		for (int i = 0; i < ValueOptCount; ++i)
+			Values[i] = ValueOpts[i].m_pstrValue;
+		}
+	return Values;
+	}
+
+static bool *GetFlagOpts()
+	{
+	bool *&Flags = GetMuscleContext()->FlagOpts;
+	if (0 == Flags)
+		{
+		Flags = new bool[FlagOptCount];
+		for (int i = 0; i < FlagOptCount; ++i)
+			Flags[i] = FlagOpts[i].m_bSet;
+		}
+	return Flags;
+	}
+
 static bool TestSetFlagOpt(const char *Arg)
 	{
 	for (int i = 0; i < FlagOptCount; ++i)
 		if (!stricmp(Arg, FlagOpts[i].m_pstrName))
 			{
-			FlagOpts[i].m_bSet = true;
+			GetFlagOpts()[i] = true;
 			return true;
 			}
 	return false;
@@ -137,7 +172,7 @@ static bool TestSetValueOpt(const char *Arg, const char *Value)
 				fprintf(stderr, "Option -%s must have value\n", Arg);
 				exit(EXIT_NotStarted);
 				}
-			ValueOpts[i].m_pstrValue = strsave(Value);
+			GetValueOpts()[i] = strsave(Value);
 			return true;
 			}
 	return false;
@@ -147,7 +182,7 @@ bool FlagOpt(const char *Name)
 	{
 	for (int i = 0; i < FlagOptCount; ++i)
 		if (!stricmp(Name, FlagOpts[i].m_pstrName))
-			return FlagOpts[i].m_bSet;
+			return GetFlagOpts()[i];
 	Quit("FlagOpt(%s) invalid", Name);
 	return false;
 	}
@@ -156,7 +191,7 @@ const char *ValueOpt(const char *Name)
 	{
 	for (int i = 0; i < ValueOptCount; ++i)
 		if (!stricmp(Name, ValueOpts[i].m_pstrName))
-			return ValueOpts[i].m_pstrValue;
+			return GetValueOpts()[i];
 	Quit("ValueOpt(%s) invalid", Name);
 	return 0;
 	}
@@ -229,5 +264,5 @@ void ProcessArgStr(const char *ArgStr)
 void ListFlagOpts()
 	{
 	for (int i = 0; i < FlagOptCount; ++i)
-		Log("%s %d\n", FlagOpts[i].m_pstrName, FlagOpts[i].m_bSet);
+		Log("%s %d\n", FlagOpts[i].m_pstrName, GetFlagOpts()[i]);
 	}
@@ -5,13 +5,6 @@
 
 const double DEFAULT_MAX_MB_FRACT = 0.8;
 
-SCORE g_scoreCenter = 0;
-SCORE g_scoreGapExtend = 0;
-SCORE g_scoreGapOpen2 = MINUS_INFINITY;
-SCORE g_scoreGapExtend2 = MINUS_INFINITY;
-SCORE g_scoreGapAmbig = 0;
-SCORE g_scoreAmbigFactor = 0;
-
 extern SCOREMATRIX VTML_LA;
 extern SCOREMATRIX PAM200;
 extern SCOREMATRIX PAM200NoCenter;
@@ -19,122 +12,143 @@ extern SCOREMATRIX VTML_SP;
 extern SCOREMATRIX VTML_SPNoCenter;
 extern SCOREMATRIX NUC_SP;
 
-PTR_SCOREMATRIX g_ptrScoreMatrix;
-
-const char *g_pstrInFileName = "-";
-const char *g_pstrOutFileName = "-";
-const char *g_pstrFASTAOutFileName = 0;
-const char *g_pstrMSFOutFileName = 0;
-const char *g_pstrClwOutFileName = 0;
-const char *g_pstrClwStrictOutFileName = 0;
-const char *g_pstrHTMLOutFileName = 0;
-const char *g_pstrPHYIOutFileName = 0;
-const char *g_pstrPHYSOutFileName = 0;
-
-const char *g_pstrFileName1 = 0;
-const char *g_pstrFileName2 = 0;
-
-const char *g_pstrSPFileName = 0;
-const char *g_pstrMatrixFileName = 0;
-
-const char *g_pstrUseTreeFileName = 0;
-bool g_bUseTreeNoWarn = false;
-
-const char *g_pstrComputeWeightsFileName;
-const char *g_pstrScoreFileName;
-
-const char *g_pstrProf1FileName = 0;
-const char *g_pstrProf2FileName = 0;
-
-unsigned g_uSmoothWindowLength = 7;
-unsigned g_uAnchorSpacing = 32;
-unsigned g_uMaxTreeRefineIters = 1;
-
-unsigned g_uRefineWindow = 200;
-unsigned g_uWindowFrom = 0;
-unsigned g_uWindowTo = 0;
-unsigned g_uSaveWindow = uInsane;
-unsigned g_uWindowOffset = 0;
-
-unsigned g_uMaxSubFamCount = 5;
-
-unsigned g_uHydrophobicRunLength = 5;
-float g_dHydroFactor = (float) 1.2;
-
-unsigned g_uMinDiagLength = 24;	// TODO alpha -- should depend on alphabet?
-unsigned g_uMaxDiagBreak = 1;
-unsigned g_uDiagMargin = 5;
-
-float g_dSUEFF = (float) 0.1;
-
-bool g_bPrecompiledCenter = true;
-bool g_bNormalizeCounts = false;
-bool g_bDiags1 = false;
-bool g_bDiags2 = false;
-bool g_bAnchors = true;
-bool g_bQuiet = false;
-bool g_bVerbose = false;
-bool g_bRefine = false;
-bool g_bRefineW = false;
-bool g_bProfDB = false;
-bool g_bLow = false;
-bool g_bSW = false;
-bool g_bCluster = false;
-bool g_bProfile = false;
-bool g_bPPScore = false;
-bool g_bBrenner = false;
-bool g_bDimer = false;
-bool g_bVersion = false;
-bool g_bStable = false;
-bool g_bFASTA = false;
-bool g_bPAS = false;
+// Defaults of the command-line parameters, see params.h.
+MuscleParams::MuscleParams()
+	{
+	scoreCenter = 0;
+	scoreGapExtend = 0;
+	scoreGapOpen2 = MINUS_INFINITY;
+	scoreGapExtend2 = MINUS_INFINITY;
+	scoreGapAmbig = 0;
+	scoreAmbigFactor = 0;
+	ptrScoreMatrix = 0;
+
+	pstrInFileName = "-";
+	pstrOutFileName = "-";
+	pstrFASTAOutFileName = 0;
+	pstrMSFOutFileName = 0;
+	pstrClwOutFileName = 0;
+	pstrClwStrictOutFileName = 0;
+	pstrHTMLOutFileName = 0;
+	pstrPHYIOutFileName = 0;
+	pstrPHYSOutFileName = 0;
+
+	pstrFileName1 = 0;
+	pstrFileName2 = 0;
+
+	pstrSPFileName = 0;
+	pstrMatrixFileName = 0;
+
+	pstrUseTreeFileName = 0;
+	bUseTreeNoWarn = false;
+
+	pstrComputeWeightsFileName = 0;
+	pstrScoreFileName = 0;
+
+	pstrProf1FileName = 0;
+	pstrProf2FileName = 0;
+	pstrDistMxFileName = 0;
+
+	uSmoothWindowLength = 7;
+	uAnchorSpacing = 32;
+	uMaxTreeRefineIters = 1;
+
+	uRefineWindow = 200;
+	uWindowFrom = 0;
+	uWindowTo = 0;
+	uSaveWindow = uInsane;
+	uWindowOffset = 0;
+
+	uMaxSubFamCount = 5;
+
+	uHydrophobicRunLength = 5;
+	dHydroFactor = (float) 1.2;
+
+	uMinDiagLength = 24;	// TODO alpha -- should depend on alphabet?
+	uMaxDiagBreak = 1;
+	uDiagMargin = 5;
+
+	dSUEFF = (float) 0.1;
+
+	bPrecompiledCenter = true;
+	bNormalizeCounts = false;
+	bDiags1 = false;
+	bDiags2 = false;
+	bAnchors = true;
+	bQuiet = false;
+	bVerbose = false;
+	bRefine = false;
+	bRefineW = false;
+	bProfDB = false;
+	bProfSearch = false;
+	bLow = false;
+	bSW = false;
+	bCluster = false;
+	bProfile = false;
+	bPPScore = false;
+	bBrenner = false;
+	bDimer = false;
+	bVersion = false;
+	bStable = false;
+	bFASTA = false;
+	bPAS = false;
+	bNoSIMD = false;
+	bDP352 = false;
+	bTestNWLinear = false;
 
 #if	DEBUG
-bool g_bCatchExceptions = false;
+	bCatchExceptions = false;
 #else
-bool g_bCatchExceptions = true;
+	bCatchExceptions = true;
 #endif
 
-bool g_bMSF = false;
-bool g_bAln = false;
-bool g_bClwStrict = false;
-bool g_bHTML = false;
-bool g_bPHYI = false;
-bool g_bPHYS = false;
+	bMSF = false;
+	bAln = false;
+	bClwStrict = false;
+	bHTML = false;
+	bPHYI = false;
+	bPHYS = false;
 
-unsigned g_uMaxIters = 8;
-unsigned long g_ulMaxSecs = 0;
-unsigned g_uMaxMB = 500;
+	uMaxIters = 8;
+	ulMaxSecs = 0;
+	uMaxMB = 500;
+	uMaxTBMB = 256;
+	uThreads = 1;
+	uSketchSize = 128;
+	uTopK = 10;
 
-PPSCORE g_PPScore = PPSCORE_LE;
-OBJSCORE g_ObjScore = OBJSCORE_SPM;
+	PPScore = PPSCORE_LE;
+	AAScoresFn = 0;
+	PPScoresFn = 0;
+	ObjScore = OBJSCORE_SPM;
 
-SEQWEIGHT g_SeqWeight1 = SEQWEIGHT_ClustalW;
-SEQWEIGHT g_SeqWeight2 = SEQWEIGHT_ClustalW;
+	SeqWeight1 = SEQWEIGHT_ClustalW;
+	SeqWeight2 = SEQWEIGHT_ClustalW;
 
-DISTANCE g_Distance1 = DISTANCE_Kmer6_6;
-DISTANCE g_Distance2 = DISTANCE_PctIdKimura;
+	Distance1 = DISTANCE_Kmer6_6;
+	Distance2 = DISTANCE_PctIdKimura;
 
-CLUSTER g_Cluster1 = CLUSTER_UPGMB;
-CLUSTER g_Cluster2 = CLUSTER_UPGMB;
+	Cluster1 = CLUSTER_UPGMB;
+	Cluster2 = CLUSTER_UPGMB;
 
-ROOT g_Root1 = ROOT_Pseudo;
-ROOT g_Root2 = ROOT_Pseudo;
+	Root1 = ROOT_Pseudo;
+	Root2 = ROOT_Pseudo;
 
-bool g_bDiags;
+	bDiags = false;
 
-SEQTYPE g_SeqType = SEQTYPE_Auto;
+	SeqType = SEQTYPE_Auto;
 
-TERMGAPS g_TermGaps = TERMGAPS_Half;
+	TermGaps = TERMGAPS_Half;
 
-//------------------------------------------------------
 // These parameters depending on the chosen prof-prof
 // score (g_PPScore), initialized to "Undefined".
-float g_dSmoothScoreCeil = fInsane;
-float g_dMinBestColScore = fInsane;
-float g_dMinSmoothScore = fInsane;
-SCORE g_scoreGapOpen = fInsane;
-//------------------------------------------------------
+	dSmoothScoreCeil = fInsane;
+	dMinBestColScore = fInsane;
+	dMinSmoothScore = fInsane;
+	scoreGapOpen = fInsane;
+
+	bRefineX = false;
+	}
 
 static unsigned atou(const char *s)
 	{
@@ -159,6 +173,10 @@ void ListParams()
 	Log("Max trees                %u\n", g_uMaxTreeRefineIters);
 	Log("Max time                 %s\n", MaxSecsToStr());
 	Log("Max MB                   %u\n", g_uMaxMB);
+	Log("Max traceback MB         %u\n", g_uMaxTBMB);
+	Log("Threads                  %u\n", g_uThreads);
+	Log("Sketch size              %u\n", g_uSketchSize);
+	Log("Top K hits               %u\n", g_uTopK);
 	Log("Gap open                 %g\n", g_scoreGapOpen);
 	Log("Gap extend (dimer)       %g\n", g_scoreGapExtend);
 	Log("Gap ambig factor         %g\n", g_scoreAmbigFactor);
@@ -193,6 +211,7 @@ void ListParams()
 	Log("Quiet                    %s\n", BoolToStr(g_bQuiet));
 	Log("Refine                   %s\n", BoolToStr(g_bRefine));
 	Log("ProdfDB                  %s\n", BoolToStr(g_bProfDB));
+	Log("ProfSearch               %s\n", BoolToStr(g_bProfSearch));
 	Log("Low complexity profiles  %s\n", BoolToStr(g_bLow));
 
 	Log("Objective score          %s\n", OBJSCOREToStr(g_ObjScore));
@@ -447,6 +466,7 @@ void SetPPScore(bool bRespectFlagOpts)
 
 	SetPPDefaultParams();
 	SetPPCommandLineParams();
+	SetPPKernels();
 
 	if (g_bVerbose)
 		ListParams();
@@ -458,6 +478,14 @@ void SetPPScore(PPSCORE p)
 	SetPPScore(true);
 	}
 
+// Called when the alphabet or profile-profile score changes, so the
+// scoring loops are not switched per call.
+void SetPPKernels()
+	{
+	g_AAScoresFn = GetAAScoresFn(g_AlphaSize);
+	g_PPScoresFn = GetPPScoresFn(g_AlphaSize, g_PPScore);
+	}
+
 static void SetMaxSecs()
 	{
 	float fMaxHours = 0.0;
@@ -484,6 +512,8 @@ bool MissingCommand()
 		return false;
 	if (0 != g_pstrSPFileName)
 		return false;
+	if (g_bTestNWLinear)
+		return false;
 	return true;
 	}
 
@@ -515,6 +545,7 @@ void SetParams()
 	StrParam("UseTree", &g_pstrUseTreeFileName);
 	StrParam("ComputeWeights", &g_pstrComputeWeightsFileName);
 	StrParam("ScoreFile", &g_pstrScoreFileName);
+	StrParam("DistMx", &g_pstrDistMxFileName);
 
 	FlagParam("Core", &g_bCatchExceptions, false);
 	FlagParam("NoCore", &g_bCatchExceptions, true);
@@ -541,6 +572,7 @@ void SetParams()
 	FlagParam("Refine", &g_bRefine, true);
 	FlagParam("RefineW", &g_bRefineW, true);
 	FlagParam("ProfDB", &g_bProfDB, true);
+	FlagParam("ProfSearch", &g_bProfSearch, true);
 	FlagParam("SW", &g_bSW, true);
 	FlagParam("Cluster", &g_bCluster, true);
 	FlagParam("Profile", &g_bProfile, true);
@@ -555,6 +587,9 @@ void SetParams()
 	FlagParam("HTML", &g_bHTML, true);
 	FlagParam("FASTA", &g_bFASTA, true);
 	FlagParam("PAS", &g_bPAS, true);
+	FlagParam("NoSIMD", &g_bNoSIMD, true);
+	FlagParam("DP352", &g_bDP352, true);
+	FlagParam("TestNWLinear", &g_bTestNWLinear, true);
 
 	bool b = false;
 	FlagParam("clwstrict", &b, true);
@@ -602,6 +637,10 @@ void SetParams()
 	if (g_bDimer)
 		g_bPrecompiledCenter = false;
 
+	UintParam("MaxTBMB", &g_uMaxTBMB);
+	UintParam("Threads", &g_uThreads);
+	UintParam("SketchSize", &g_uSketchSize);
+	UintParam("TopK", &g_uTopK);
 	UintParam("MaxMB", &g_uMaxMB);
 	if (0 == ValueOpt("MaxMB"))
 		g_uMaxMB = (unsigned) (GetRAMSizeMB()*DEFAULT_MAX_MB_FRACT);
@@ -1,114 +1,130 @@
 #ifndef params_h
 #define params_h
 
-extern const char *g_pstrInFileName;
-extern const char *g_pstrOutFileName;
-
-extern const char *g_pstrFASTAOutFileName;
-extern const char *g_pstrMSFOutFileName;
-extern const char *g_pstrClwOutFileName;
-extern const char *g_pstrClwStrictOutFileName;
-extern const char *g_pstrHTMLOutFileName;
-extern const char *g_pstrPHYIOutFileName;
-extern const char *g_pstrPHYSOutFileName;
-
-extern const char *g_pstrFileName1;
-extern const char *g_pstrFileName2;
-
-extern const char *g_pstrSPFileName;
-extern const char *g_pstrMatrixFileName;
-
-extern const char *g_pstrUseTreeFileName;
-extern bool g_bUseTreeNoWarn;
-
-extern const char *g_pstrComputeWeightsFileName;
-extern const char *g_pstrScoreFileName;
-
-extern SCORE g_scoreGapOpen;
-extern SCORE g_scoreCenter;
-extern SCORE g_scoreGapExtend;
-extern SCORE g_scoreGapAmbig;
-
-#if	DOUBLE_AFFINE
-extern SCORE g_scoreGapOpen2;
-extern SCORE g_scoreGapExtend2;
-#endif
-
-extern unsigned g_uSmoothWindowLength;
-extern unsigned g_uAnchorSpacing;
-extern unsigned g_uMaxTreeRefineIters;
-
-extern unsigned g_uMinDiagLength;
-extern unsigned g_uMaxDiagBreak;
-extern unsigned g_uDiagMargin;
-
-extern unsigned g_uRefineWindow;
-extern unsigned g_uWindowFrom;
-extern unsigned g_uWindowTo;
-extern unsigned g_uSaveWindow;
-extern unsigned g_uWindowOffset;
-
-extern unsigned g_uMaxSubFamCount;
-
-extern unsigned g_uHydrophobicRunLength;
-extern float g_dHydroFactor;
-
-extern float g_dSmoothScoreCeil;
-extern float g_dMinBestColScore;
-extern float g_dMinSmoothScore;
-extern float g_dSUEFF;
-
-extern bool g_bPrecompiledCenter;
-extern bool g_bNormalizeCounts;
-extern bool g_bDiags1;
-extern bool g_bDiags2;
-extern bool g_bDiags;
-extern bool g_bAnchors;
-extern bool g_bCatchExceptions;
-
-extern bool g_bMSF;
-extern bool g_bAln;
-extern bool g_bClwStrict;
-extern bool g_bHTML;
-extern bool g_bPHYI;
-extern bool g_bPHYS;
-
-extern bool g_bQuiet;
-extern bool g_bVerbose;
-extern bool g_bRefine;
-extern bool g_bRefineW;
-extern bool g_bRefineX;
-extern bool g_bLow;
-extern bool g_bSW;
-extern bool g_bCluster;
-extern bool g_bProfile;
-extern bool g_bProfDB;
-extern bool g_bPPScore;
-extern bool g_bBrenner;
-extern bool g_bDimer;
-extern bool g_bVersion;
-extern bool g_bStable;
-extern bool g_bFASTA;
-extern bool g_bPAS;
-
-extern PPSCORE g_PPScore;
-extern OBJSCORE g_ObjScore;
-
-extern DISTANCE g_Distance1;
-extern CLUSTER g_Cluster1;
-extern ROOT g_Root1;
-extern SEQWEIGHT g_SeqWeight1;
-
-extern DISTANCE g_Distance2;
-extern CLUSTER g_Cluster2;
-extern ROOT g_Root2;
-extern SEQWEIGHT g_SeqWeight2;
-
-extern unsigned g_uMaxIters;
-extern unsigned long g_ulMaxSecs;
-extern unsigned g_uMaxMB;
-
-extern SEQTYPE g_SeqType;
-extern TERMGAPS g_TermGaps;
+// Parameters are members of the current MuscleContext,
+// see musclecontext.h.
+
+#define g_pstrInFileName	(GetMuscleContext()->params.pstrInFileName)
+#define g_pstrOutFileName	(GetMuscleContext()->params.pstrOutFileName)
+
+#define g_pstrFASTAOutFileName	(GetMuscleContext()->params.pstrFASTAOutFileName)
+#define g_pstrMSFOutFileName	(GetMuscleContext()->params.pstrMSFOutFileName)
+#define g_pstrClwOutFileName	(GetMuscleContext()->params.pstrClwOutFileName)
+#define g_pstrClwStrictOutFileName	(GetMuscleContext()->params.pstrClwStrictOutFileName)
+#define g_pstrHTMLOutFileName	(GetMuscleContext()->params.pstrHTMLOutFileName)
+#define g_pstrPHYIOutFileName	(GetMuscleContext()->params.pstrPHYIOutFileName)
+#define g_pstrPHYSOutFileName	(GetMuscleContext()->params.pstrPHYSOutFileName)
+
+#define g_pstrFileName1	(GetMuscleContext()->params.pstrFileName1)
+#define g_pstrFileName2	(GetMuscleContext()->params.pstrFileName2)
+
+#define g_pstrSPFileName	(GetMuscleContext()->params.pstrSPFileName)
+#define g_pstrMatrixFileName	(GetMuscleContext()->params.pstrMatrixFileName)
+
+#define g_pstrUseTreeFileName	(GetMuscleContext()->params.pstrUseTreeFileName)
+#define g_bUseTreeNoWarn	(GetMuscleContext()->params.bUseTreeNoWarn)
+
+#define g_pstrComputeWeightsFileName	(GetMuscleContext()->params.pstrComputeWeightsFileName)
+#define g_pstrScoreFileName	(GetMuscleContext()->params.pstrScoreFileName)
+#define g_pstrProf1FileName	(GetMuscleContext()->params.pstrProf1FileName)
+#define g_pstrProf2FileName	(GetMuscleContext()->params.pstrProf2FileName)
+#define g_pstrDistMxFileName	(GetMuscleContext()->params.pstrDistMxFileName)
+
+#define g_scoreGapOpen	(GetMuscleContext()->params.scoreGapOpen)
+#define g_scoreCenter	(GetMuscleContext()->params.scoreCenter)
+#define g_scoreGapExtend	(GetMuscleContext()->params.scoreGapExtend)
+#define g_scoreGapAmbig	(GetMuscleContext()->params.scoreGapAmbig)
+#define g_scoreAmbigFactor	(GetMuscleContext()->params.scoreAmbigFactor)
+#define g_ptrScoreMatrix	(GetMuscleContext()->params.ptrScoreMatrix)
+
+#define g_scoreGapOpen2	(GetMuscleContext()->params.scoreGapOpen2)
+#define g_scoreGapExtend2	(GetMuscleContext()->params.scoreGapExtend2)
+
+#define g_uSmoothWindowLength	(GetMuscleContext()->params.uSmoothWindowLength)
+#define g_uAnchorSpacing	(GetMuscleContext()->params.uAnchorSpacing)
+#define g_uMaxTreeRefineIters	(GetMuscleContext()->params.uMaxTreeRefineIters)
+
+#define g_uMinDiagLength	(GetMuscleContext()->params.uMinDiagLength)
+#define g_uMaxDiagBreak	(GetMuscleContext()->params.uMaxDiagBreak)
+#define g_uDiagMargin	(GetMuscleContext()->params.uDiagMargin)
+
+#define g_uRefineWindow	(GetMuscleContext()->params.uRefineWindow)
+#define g_uWindowFrom	(GetMuscleContext()->params.uWindowFrom)
+#define g_uWindowTo	(GetMuscleContext()->params.uWindowTo)
+#define g_uSaveWindow	(GetMuscleContext()->params.uSaveWindow)
+#define g_uWindowOffset	(GetMuscleContext()->params.uWindowOffset)
+
+#define g_uMaxSubFamCount	(GetMuscleContext()->params.uMaxSubFamCount)
+
+#define g_uHydrophobicRunLength	(GetMuscleContext()->params.uHydrophobicRunLength)
+#define g_dHydroFactor	(GetMuscleContext()->params.dHydroFactor)
+
+#define g_dSmoothScoreCeil	(GetMuscleContext()->params.dSmoothScoreCeil)
+#define g_dMinBestColScore	(GetMuscleContext()->params.dMinBestColScore)
+#define g_dMinSmoothScore	(GetMuscleContext()->params.dMinSmoothScore)
+#define g_dSUEFF	(GetMuscleContext()->params.dSUEFF)
+
+#define g_bPrecompiledCenter	(GetMuscleContext()->params.bPrecompiledCenter)
+#define g_bNormalizeCounts	(GetMuscleContext()->params.bNormalizeCounts)
+#define g_bDiags1	(GetMuscleContext()->params.bDiags1)
+#define g_bDiags2	(GetMuscleContext()->params.bDiags2)
+#define g_bDiags	(GetMuscleContext()->params.bDiags)
+#define g_bAnchors	(GetMuscleContext()->params.bAnchors)
+#define g_bCatchExceptions	(GetMuscleContext()->params.bCatchExceptions)
+
+#define g_bMSF	(GetMuscleContext()->params.bMSF)
+#define g_bAln	(GetMuscleContext()->params.bAln)
+#define g_bClwStrict	(GetMuscleContext()->params.bClwStrict)
+#define g_bHTML	(GetMuscleContext()->params.bHTML)
+#define g_bPHYI	(GetMuscleContext()->params.bPHYI)
+#define g_bPHYS	(GetMuscleContext()->params.bPHYS)
+
+#define g_bQuiet	(GetMuscleContext()->params.bQuiet)
+#define g_bVerbose	(GetMuscleContext()->params.bVerbose)
+#define g_bRefine	(GetMuscleContext()->params.bRefine)
+#define g_bRefineW	(GetMuscleContext()->params.bRefineW)
+#define g_bRefineX	(GetMuscleContext()->params.bRefineX)
+#define g_bLow	(GetMuscleContext()->params.bLow)
+#define g_bSW	(GetMuscleContext()->params.bSW)
+#define g_bCluster	(GetMuscleContext()->params.bCluster)
+#define g_bProfile	(GetMuscleContext()->params.bProfile)
+#define g_bProfDB	(GetMuscleContext()->params.bProfDB)
+#define g_bProfSearch	(GetMuscleContext()->params.bProfSearch)
+#define g_bPPScore	(GetMuscleContext()->params.bPPScore)
+#define g_bBrenner	(GetMuscleContext()->params.bBrenner)
+#define g_bDimer	(GetMuscleContext()->params.bDimer)
+#define g_bVersion	(GetMuscleContext()->params.bVersion)
+#define g_bStable	(GetMuscleContext()->params.bStable)
+#define g_bFASTA	(GetMuscleContext()->params.bFASTA)
+#define g_bPAS	(GetMuscleContext()->params.bPAS)
+#define g_bNoSIMD	(GetMuscleContext()->params.bNoSIMD)
+#define g_bDP352	(GetMuscleContext()->params.bDP352)
+#define g_bTestNWLinear	(GetMuscleContext()->params.bTestNWLinear)
+
+#define g_PPScore	(GetMuscleContext()->params.PPScore)
+#define g_AAScoresFn	(GetMuscleContext()->params.AAScoresFn)
+#define g_PPScoresFn	(GetMuscleContext()->params.PPScoresFn)
+#define g_ObjScore	(GetMuscleContext()->params.ObjScore)
+
+#define g_Distance1	(GetMuscleContext()->params.Distance1)
+#define g_Cluster1	(GetMuscleContext()->params.Cluster1)
+#define g_Root1	(GetMuscleContext()->params.Root1)
+#define g_SeqWeight1	(GetMuscleContext()->params.SeqWeight1)
+
+#define g_Distance2	(GetMuscleContext()->params.Distance2)
+#define g_Cluster2	(GetMuscleContext()->params.Cluster2)
+#define g_Root2	(GetMuscleContext()->params.Root2)
+#define g_SeqWeight2	(GetMuscleContext()->params.SeqWeight2)
+
+#define g_uMaxIters	(GetMuscleContext()->params.uMaxIters)
+#define g_ulMaxSecs	(GetMuscleContext()->params.ulMaxSecs)
+#define g_uMaxMB	(GetMuscleContext()->params.uMaxMB)
+#define g_uMaxTBMB	(GetMuscleContext()->params.uMaxTBMB)
+#define g_uThreads	(GetMuscleContext()->params.uThreads)
+#define g_uSketchSize	(GetMuscleContext()->params.uSketchSize)
+#define g_uTopK	(GetMuscleContext()->params.uTopK)
+
+#define g_SeqType	(GetMuscleContext()->params.SeqType)
+#define g_TermGaps	(GetMuscleContext()->params.TermGaps)
 
 #endif // params_h
@@ -0,0 +1,169 @@
+#include "muscle.h"
+#include "profile.h"
+
+/***
+Match scores of a block of profile positions against a whole profile,
+computed as a matrix product.
+
+For the SP-type scores, ScoreProfPos2(PA[i], PB[j]) is a sum over
+letters x of PA[i].m_fcCounts[x]*PB[j].m_AAScores[x], i.e. row i of
+(frequencies of A) x (AAScores of B)^T, an (uToA - uFromA) x 20 by
+20 x uLengthB product. It is computed in the usual blocked way:
+
+	for each block of COL_BLOCK columns of B
+		copy AAScores of the block into a letter-major panel
+		for each row i of A
+			for each tile of TILE columns in the block
+				Acc[TILE] = sum over the letters of row i
+				  of freq*Panel[letter][tile]
+
+The panel (20 x COL_BLOCK scores) stays in L1 cache while all rows of
+A are passed over it, and the tile accumulators stay in registers;
+the tile loop is written so the compiler vectorizes it.
+
+Unlike a generic GEMM, the letters of row i are summed in the order
+of PA[i].m_uLetters, exactly as ScoreProfPos2 does. Every score is therefore bit-identical to the
+one ScoreProfPos2 would return, so alignments do not change.
+
+Mx[(i - uFromA)*uLengthB + j] is the score of PA[i] with PB[j].
+
+The kernel is instantiated for each alphabet size (4, 20) and for
+linear (SP, SV, SPN) or log-expectation (LE) scores; SetPPKernels
+picks one when the alphabet or score is set.
+***/
+
+static const unsigned COL_BLOCK = 256;
+static const unsigned TILE = 16;
+
+// Alphabets up to this size are summed over all letters, padded with
+// zero counts, so the letter loop has a fixed trip count and is
+// unrolled. Adding 0*x leaves a finite sum unchanged, so the scores
+// are the same as summing the non-zero letters only.
+static const unsigned MAX_UNROLL_ALPHA = 4;
+
+template<unsigned ALPHA> static inline unsigned GetRowLetters(const ProfPos &PP,
+  unsigned Letters[ALPHA], FCOUNT Freqs[ALPHA])
+	{
+	const unsigned uCount = PP.m_uLetterCount;
+	for (unsigned n = 0; n < uCount; ++n)
+		{
+		const unsigned uLetter = PP.m_uLetters[n];
+		Letters[n] = uLetter;
+		Freqs[n] = PP.m_fcCounts[uLetter];
+		}
+	if (ALPHA > MAX_UNROLL_ALPHA)
+		return uCount;
+	for (unsigned n = uCount; n < ALPHA; ++n)
+		{
+		Letters[n] = 0;
+		Freqs[n] = 0;
+		}
+	return ALPHA;
+	}
+
+// One tile: Out[t] = sum over n of Freqs[n]*Panel[Letters[n]*COL_BLOCK + t].
+template<unsigned ALPHA> static inline void Tile(const unsigned Letters[ALPHA],
+  const FCOUNT Freqs[ALPHA], unsigned uCount, const SCORE *Panel,
+  SCORE Out[TILE])
+	{
+	const unsigned uLoopCount = (ALPHA > MAX_UNROLL_ALPHA) ? uCount : ALPHA;
+	SCORE Acc[TILE];
+	for (unsigned t = 0; t < TILE; ++t)
+		Acc[t] = 0;
+	for (unsigned n = 0; n < uLoopCount; ++n)
+		{
+		const FCOUNT fcLetter = Freqs[n];
+		const SCORE *Row = Panel + Letters[n]*COL_BLOCK;
+		for (unsigned t = 0; t < TILE; ++t)
+			Acc[t] += fcLetter*Row[t];
+		}
+	for (unsigned t = 0; t < TILE; ++t)
+		Out[t] = Acc[t];
+	}
+
+// ALPHA is the alphabet size, LOG selects the LE score.
+template<unsigned ALPHA, bool LOG> static void ProfPairScoresT(
+  const ProfPos *PA, unsigned uFromA, unsigned uToA, const ProfPos *PB,
+  unsigned uLengthB, SCORE Mx[])
+	{
+	SCORE Panel[ALPHA*COL_BLOCK];
+	SCORE Out[TILE];
+	unsigned Letters[ALPHA];
+	FCOUNT Freqs[ALPHA];
+	const SCORE scoreCenter = g_scoreCenter;
+
+	for (unsigned uFromB = 0; uFromB < uLengthB; uFromB += COL_BLOCK)
+		{
+		unsigned uWidth = uLengthB - uFromB;
+		if (uWidth > COL_BLOCK)
+			uWidth = COL_BLOCK;
+		const unsigned uTileCount = (uWidth + TILE - 1)/TILE;
+
+	// Columns of the last tile beyond uWidth are zero and never stored.
+		for (unsigned uLetter = 0; uLetter < ALPHA; ++uLetter)
+			{
+			SCORE *PanelRow = Panel + uLetter*COL_BLOCK;
+			for (unsigned j = 0; j < uWidth; ++j)
+				PanelRow[j] = PB[uFromB + j].m_AAScores[uLetter];
+			for (unsigned j = uWidth; j < uTileCount*TILE; ++j)
+				PanelRow[j] = 0;
+			}
+
+		for (unsigned i = uFromA; i < uToA; ++i)
+			{
+			const ProfPos &PPA = PA[i];
+			const unsigned uCount = GetRowLetters<ALPHA>(PPA, Letters, Freqs);
+
+			SCORE *MxRow = Mx + (size_t) (i - uFromA)*uLengthB + uFromB;
+			for (unsigned uTile = 0; uTile < uTileCount; ++uTile)
+				{
+				const unsigned uFrom = uTile*TILE;
+				unsigned uTo = uFrom + TILE;
+				if (uTo > uWidth)
+					uTo = uWidth;
+				Tile<ALPHA>(Letters, Freqs, uCount, Panel + uFrom, Out);
+
+				if (LOG)
+					{
+				// As ScoreProfPos2LA
+					for (unsigned j = uFrom; j < uTo; ++j)
+						{
+						const SCORE Score = Out[j - uFrom];
+						if (0 == Score)
+							MxRow[j] = -2.5;
+						else
+							MxRow[j] = (SCORE) ((logf(Score) - scoreCenter)*
+							  (PPA.m_fOcc * PB[uFromB + j].m_fOcc));
+						}
+					}
+				else
+					{
+					for (unsigned j = uFrom; j < uTo; ++j)
+						MxRow[j] = Out[j - uFrom] - scoreCenter;
+					}
+				}
+			}
+		}
+	}
+
+PPSCORES_FN GetPPScoresFn(unsigned uAlphaSize, PPSCORE PPScore)
+	{
+	const bool bLog = (PPSCORE_LE == PPScore);
+	switch (uAlphaSize)
+		{
+	case 4:
+		return bLog ? ProfPairScoresT<4, true> : ProfPairScoresT<4, false>;
+	case 20:
+		return bLog ? ProfPairScoresT<20, true> : ProfPairScoresT<20, false>;
+		}
+	Quit("GetPPScoresFn: invalid alphabet size %u", uAlphaSize);
+	return 0;
+	}
+
+void ProfPairScores(const ProfPos *PA, unsigned uFromA, unsigned uToA,
+  const ProfPos *PB, unsigned uLengthB, SCORE Mx[])
+	{
+	if (0 == g_PPScoresFn)
+		SetPPKernels();
+	g_PPScoresFn(PA, uFromA, uToA, PB, uLengthB, Mx);
+	}
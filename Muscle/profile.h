@@ -11,7 +11,9 @@ class WeightList;
 struct ProfPos
 	{
 	bool m_bAllGaps;
-	unsigned m_uSortOrder[21];
+// Letters with non-zero count, by decreasing count. See SortLetters.
+	unsigned char m_uLetterCount;
+	unsigned char m_uLetters[20];
 	FCOUNT m_fcCounts[20];
 	FCOUNT m_LL;
 	FCOUNT m_LG;
@@ -48,12 +50,34 @@ struct ProgNode
 	WEIGHT m_Weight;
 	};
 
+// Striped match scores of a profile with each letter class of a
+// sequence, see swstriped.cpp.
+struct SW_QUERY
+	{
+	unsigned uLengthA;
+	unsigned uLaneCount;
+	unsigned uSegCount;
+	unsigned uClassCount;
+	char *Slab;
+	SCORE *GapOpenA;
+	SCORE *GapCloseA;
+	unsigned *Rows;
+	SCORE *Scores;
+	};
+
+void MakeSWQuery(const ProfPos *PA, unsigned uLengthA, const ProfPos *ClassPos,
+  unsigned uClassCount, SW_QUERY &Q);
+void FreeSWQuery(SW_QUERY &Q);
+SCORE StripedSWQuery(const SW_QUERY &Q, const ProfPos *PB,
+  const unsigned char ClassB[], unsigned uLengthB, unsigned *ptruStartA,
+  unsigned *ptruStartB, unsigned *ptruEndA, unsigned *ptruEndB);
+
 extern unsigned ResidueGroup[];
 const unsigned RESIDUE_GROUP_MULTIPLE = (unsigned) ~0;
 
-extern PTR_SCOREMATRIX g_ptrScoreMatrix;
-
 ProfPos *ProfileFromMSA(const MSA &a);
+ProfPos *ProfileFromMSAView(const MSAView &v);
+ProfPos *ProfileFromSeq(const Seq &s);
 
 SCORE TraceBack(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, const SCORE *DPM_, const SCORE *DPD_, const SCORE *DPI_,
@@ -104,6 +128,10 @@ void SetScoreMatrix();
 extern bool IsHydrophobic(const FCOUNT fcCounts[]);
 void Hydro(ProfPos *Prof, unsigned uLength);
 void SetTermGaps(const ProfPos *Prof, unsigned uLength);
+void SortLetters(ProfPos &PP);
+void SetAAScores(ProfPos &PP);
+AASCORES_FN GetAAScoresFn(unsigned uAlphaSize);
+PPSCORES_FN GetPPScoresFn(unsigned uAlphaSize, PPSCORE PPScore);
 
 // Macros to simulate 2D matrices
 #define DPL(PLA, PLB)	DPL_[(PLB)*uPrefixCountA + (PLA)]
@@ -119,9 +147,13 @@ void SetTermGaps(const ProfPos *Prof, unsigned uLength);
 #define TBI(PLA, PLB)	TBI_[(PLB)*uPrefixCountA + (PLA)]
 #define TBJ(PLA, PLB)	TBJ_[(PLB)*uPrefixCountA + (PLA)]
 
+SP_ROW_FN GetSPRowFn(const char **ptrName);
+
 SCORE ScoreProfPos2LA(const ProfPos &PPA, const ProfPos &PPB);
 SCORE ScoreProfPos2NS(const ProfPos &PPA, const ProfPos &PPB);
 SCORE ScoreProfPos2SP(const ProfPos &PPA, const ProfPos &PPB);
 SCORE ScoreProfPos2SPN(const ProfPos &PPA, const ProfPos &PPB);
+void ProfPairScores(const ProfPos *PA, unsigned uFromA, unsigned uToA,
+  const ProfPos *PB, unsigned uLengthB, SCORE Mx[]);
 
 #endif // FastProf_h
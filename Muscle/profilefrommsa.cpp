@@ -1,6 +1,9 @@
 #include "muscle.h"
 #include "msa.h"
 #include "profile.h"
+#include "msacols.h"
+#include "msaview.h"
+#include "seq.h"
 
 #define TRACE	0
 
@@ -153,32 +156,63 @@ void ListProfile(const ProfPos *Prof, unsigned uLength, const MSA *ptrMSA)
 	}
 #endif
 
-void SortCounts(const FCOUNT fcCounts[], unsigned SortOrder[])
+/***
+Set m_uLetters to the letters with non-zero count, by decreasing
+count; letters with equal counts stay in alphabet order. This is the
+order the scoring loops used to get by walking a full sort order of
+all letters up to the first zero count, so sums are unchanged. Most
+columns have only a few letters, so the insertion sort is short.
+***/
+void SortLetters(ProfPos &PP)
 	{
-	static unsigned InitialSortOrder[MAX_ALPHA] =
+	unsigned uCount = 0;
+	for (unsigned uLetter = 0; uLetter < g_AlphaSize; ++uLetter)
 		{
-		0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19
-		};
-	memcpy(SortOrder, InitialSortOrder, g_AlphaSize*sizeof(unsigned));
+		const FCOUNT fc = PP.m_fcCounts[uLetter];
+		if (0 == fc)
+			continue;
+		unsigned n = uCount++;
+		for (; n > 0 && PP.m_fcCounts[PP.m_uLetters[n-1]] < fc; --n)
+			PP.m_uLetters[n] = PP.m_uLetters[n-1];
+		PP.m_uLetters[n] = (unsigned char) uLetter;
+		}
+	PP.m_uLetterCount = (unsigned char) uCount;
+	}
 
-	bool bAny = true;
-	while (bAny)
+// m_AAScores[i] = sum over j of m_fcCounts[j]*Matrix[i][j], with the
+// alphabet size known at compile time.
+template<unsigned ALPHA> static void SetAAScoresT(ProfPos &PP)
+	{
+	const SCOREMATRIX &Mx = *g_ptrScoreMatrix;
+	for (unsigned i = 0; i < ALPHA; ++i)
 		{
-		bAny = false;
-		for (unsigned n = 0; n < g_AlphaSize - 1; ++n)
-			{
-			unsigned i1 = SortOrder[n];
-			unsigned i2 = SortOrder[n+1];
-			if (fcCounts[i1] < fcCounts[i2])
-				{
-				SortOrder[n+1] = i1;
-				SortOrder[n] = i2;
-				bAny = true;
-				}
-			}
+		SCORE scoreSum = 0;
+		for (unsigned j = 0; j < ALPHA; ++j)
+			scoreSum += PP.m_fcCounts[j]*Mx[i][j];
+		PP.m_AAScores[i] = scoreSum;
 		}
 	}
 
+AASCORES_FN GetAAScoresFn(unsigned uAlphaSize)
+	{
+	switch (uAlphaSize)
+		{
+	case 4:
+		return SetAAScoresT<4>;
+	case 20:
+		return SetAAScoresT<20>;
+		}
+	Quit("GetAAScoresFn: invalid alphabet size %u", uAlphaSize);
+	return 0;
+	}
+
+void SetAAScores(ProfPos &PP)
+	{
+	if (0 == g_AAScoresFn)
+		SetPPKernels();
+	g_AAScoresFn(PP);
+	}
+
 static unsigned AminoGroupFromFCounts(const FCOUNT fcCounts[])
 	{
 	bool bAny = false;
@@ -240,43 +274,52 @@ unsigned ResidueGroupFromFCounts(const FCOUNT fcCounts[])
 	return 0;
 	}
 
-ProfPos *ProfileFromMSA(const MSA &a)
+// Columns are read in order from a column-major copy, keeping the
+// previous, current and next columns for the gap counts.
+static ProfPos *ProfileFromCols(const MSACols &Cols, const WEIGHT Weights[])
 	{
-	const unsigned uSeqCount = a.GetSeqCount();
-	const unsigned uColCount = a.GetColCount();
-
-// Yuck -- cast away const (inconsistent design here).
-	SetMSAWeightsMuscle((MSA &) a);
+	const unsigned uSeqCount = Cols.GetSeqCount();
+	const unsigned uColCount = Cols.GetColCount();
 
 	ProfPos *Pos = new ProfPos[uColCount];
 
+	char *PrevCol = new char[uSeqCount];
+	char *Col = new char[uSeqCount];
+	char *NextCol = new char[uSeqCount];
+	if (uColCount > 0)
+		Cols.GetCol(0, NextCol);
+
 	unsigned uHydrophobicRunLength = 0;
 	for (unsigned uColIndex = 0; uColIndex < uColCount; ++uColIndex)
 		{
 		ProfPos &PP = Pos[uColIndex];
 
-		PP.m_bAllGaps = a.IsGapColumn(uColIndex);
+		char *Tmp = PrevCol;
+		PrevCol = Col;
+		Col = NextCol;
+		NextCol = Tmp;
+		if (uColIndex + 1 < uColCount)
+			Cols.GetCol(uColIndex + 1, NextCol);
+
+		PP.m_bAllGaps = ColIsGaps(Col, uSeqCount);
 
 		FCOUNT fcGapStart;
 		FCOUNT fcGapEnd;
 		FCOUNT fcGapExtend;
 		FCOUNT fOcc;
-		a.GetFractionalWeightedCounts(uColIndex, g_bNormalizeCounts, PP.m_fcCounts,
+		GetColFractionalWeightedCounts(Col,
+		  (0 == uColIndex) ? 0 : PrevCol,
+		  (uColIndex + 1 == uColCount) ? 0 : NextCol,
+		  uSeqCount, Weights, g_bNormalizeCounts, PP.m_fcCounts,
 		  &fcGapStart, &fcGapEnd, &fcGapExtend, &fOcc,
 		  &PP.m_LL, &PP.m_LG, &PP.m_GL, &PP.m_GG);
 		PP.m_fOcc = fOcc;
 
-		SortCounts(PP.m_fcCounts, PP.m_uSortOrder);
+		SortLetters(PP);
 
 		PP.m_uResidueGroup = ResidueGroupFromFCounts(PP.m_fcCounts);
 
-		for (unsigned i = 0; i < g_AlphaSize; ++i)
-			{
-			SCORE scoreSum = 0;
-			for (unsigned j = 0; j < g_AlphaSize; ++j)
-				scoreSum += PP.m_fcCounts[j]*(*g_ptrScoreMatrix)[i][j];
-			PP.m_AAScores[i] = scoreSum;
-			}
+		SetAAScores(PP);
 
 		SCORE sStartOcc = (SCORE) (1.0 - fcGapStart);
 		SCORE sEndOcc = (SCORE) (1.0 - fcGapEnd);
@@ -302,16 +345,75 @@ ProfPos *ProfileFromMSA(const MSA &a)
 			}
 #endif
 		}
+	delete[] PrevCol;
+	delete[] Col;
+	delete[] NextCol;
 
 #if	HYDRO
 	if (ALPHA_Amino == g_Alpha)
 		Hydro(Pos, uColCount);
 #endif
+	return Pos;
+	}
+
+ProfPos *ProfileFromMSA(const MSA &a)
+	{
+	const unsigned uSeqCount = a.GetSeqCount();
+
+// Yuck -- cast away const (inconsistent design here).
+	SetMSAWeightsMuscle((MSA &) a);
+
+	MSACols Cols;
+	Cols.FromMSA(a);
+	WEIGHT *Weights = new WEIGHT[uSeqCount];
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+		Weights[uSeqIndex] = a.GetSeqWeight(uSeqIndex);
+
+	ProfPos *Pos = ProfileFromCols(Cols, Weights);
+	delete[] Weights;
 
 #if	TRACE
 	{
 	Log("ProfileFromMSA\n");
-	ListProfile(Pos, uColCount, &a);
+	ListProfile(Pos, a.GetColCount(), &a);
+	}
+#endif
+	return Pos;
+	}
+
+// Profile of a single sequence. Its weight is 1 whatever the weighting
+// method, so unlike ProfileFromMSA this needs no tree or sequence ids
+// and may be called by any thread.
+ProfPos *ProfileFromSeq(const Seq &s)
+	{
+	const unsigned uLength = s.Length();
+	MSA a;
+	a.SetSize(1, uLength);
+	a.SetSeqName(0, s.GetName());
+	for (unsigned n = 0; n < uLength; ++n)
+		a.SetChar(0, n, s[n]);
+
+	MSACols Cols;
+	Cols.FromMSA(a);
+	const WEIGHT Weight = 1;
+	return ProfileFromCols(Cols, &Weight);
+	}
+
+ProfPos *ProfileFromMSAView(const MSAView &v)
+	{
+	WEIGHT *Weights = new WEIGHT[v.GetSeqCount()];
+	GetMSAViewWeightsMuscle(v, Weights);
+
+	MSACols Cols;
+	Cols.FromMSAView(v);
+
+	ProfPos *Pos = ProfileFromCols(Cols, Weights);
+	delete[] Weights;
+
+#if	TRACE
+	{
+	Log("ProfileFromMSAView\n");
+	ListProfile(Pos, v.GetColCount());
 	}
 #endif
 	return Pos;
@@ -0,0 +1,395 @@
+#include "muscle.h"
+#include "textfile.h"
+#include "msa.h"
+#include "seq.h"
+#include "profile.h"
+#include "pwpath.h"
+#include "tree.h"
+#include "threads.h"
+#include <stdio.h>
+#include <errno.h>
+#include <algorithm>
+
+#define TRACE	0
+
+/***
+-profsearch: search a FASTA database (-in2) with a profile (-in1),
+keeping the -topk sequences with the best local alignment score.
+
+The profile and its SW query (see StripedSWQuery in swstriped.cpp)
+are made once. The database is never held in memory: the threads
+share the open file, and a thread that needs work reads the next
+batch of records under the lock, at most PS_BATCH_SEQS records or
+PS_BATCH_LETTERS letters. Each thread then scores its batch without
+the lock, reusing its buffers from one record to the next, and offers
+the scores to the hit list in one go. The hit list is a heap of the
+-topk best hits with the worst on top, so a record is compared with
+one hit and kept only if it beats it. Memory is the profile, one
+batch per thread and the hits, whatever the size of the database.
+
+Hits are ordered by score, then by position in the database, so the
+hits and their order do not depend on the number of threads. Only
+the final hits are aligned by SW, which gives the same score, to get
+their paths.
+***/
+
+static const unsigned PS_BATCH_SEQS = 256;
+static const unsigned PS_BATCH_LETTERS = 1024*1024;
+static const unsigned PS_PROGRESS_SEQS = 10000;
+
+struct PS_HIT
+	{
+	unsigned uIndex;
+	char *Label;
+	char *Seq;
+	unsigned uLength;
+	SCORE Score;
+	};
+
+// True if h1 is a better hit than h2.
+static bool BetterHit(const PS_HIT &h1, const PS_HIT &h2)
+	{
+	if (h1.Score != h2.Score)
+		return h1.Score > h2.Score;
+	return h1.uIndex < h2.uIndex;
+	}
+
+struct PS_SEARCH
+	{
+	const ProfPos *ClassPos;
+	unsigned char CharToClass[256];
+	SW_QUERY Query;
+	unsigned uTopK;
+
+// Protected by Lock
+	Mutex Lock;
+	FILE *f;
+	bool bEOF;
+	unsigned uSeqCount;
+	double dLetterCount;
+	PS_HIT *Hits;
+	unsigned uHitCount;
+	};
+
+// Per-thread buffers, grown to the longest record seen.
+struct PS_BUFFERS
+	{
+	unsigned uSize;
+	unsigned char *Classes;
+	ProfPos *Prof;
+	};
+
+static void FreeHit(PS_HIT &Hit)
+	{
+	delete[] Hit.Label;
+	delete[] Hit.Seq;
+	Hit.Label = 0;
+	Hit.Seq = 0;
+	}
+
+// Letter classes of a record, and its profile: a copy of the
+// position of each class, with the gap scores of ProfileFromSeq.
+static void SeqProfile(const PS_SEARCH &PS, const PS_HIT &Rec,
+  PS_BUFFERS &Buffers)
+	{
+	const unsigned uLength = Rec.uLength;
+	if (uLength > Buffers.uSize)
+		{
+		delete[] Buffers.Classes;
+		delete[] Buffers.Prof;
+		Buffers.uSize = uLength + uLength/4;
+		Buffers.Classes = new unsigned char[Buffers.uSize];
+		Buffers.Prof = new ProfPos[Buffers.uSize];
+		}
+
+	for (unsigned n = 0; n < uLength; ++n)
+		{
+		const unsigned c = PS.CharToClass[(unsigned char) Rec.Seq[n]];
+		Buffers.Classes[n] = (unsigned char) c;
+		Buffers.Prof[n] = PS.ClassPos[c];
+		}
+#if	HYDRO
+	if (ALPHA_Amino == g_Alpha)
+		Hydro(Buffers.Prof, uLength);
+#endif
+	}
+
+// Called with the lock held. Returns the number of records read.
+static unsigned ReadBatch(PS_SEARCH &PS, PS_HIT Batch[])
+	{
+	unsigned uCount = 0;
+	unsigned uLetterCount = 0;
+	while (!PS.bEOF && uCount < PS_BATCH_SEQS && uLetterCount < PS_BATCH_LETTERS)
+		{
+		PS_HIT &Rec = Batch[uCount];
+		Rec.Seq = GetFastaSeq(PS.f, &Rec.uLength, &Rec.Label);
+		if (0 == Rec.Seq)
+			{
+			PS.bEOF = true;
+			break;
+			}
+		Rec.uIndex = PS.uSeqCount++;
+		Rec.Score = MINUS_INFINITY;
+		uLetterCount += Rec.uLength;
+		++uCount;
+		}
+	PS.dLetterCount += uLetterCount;
+	return uCount;
+	}
+
+// Called with the lock held. Takes the record if it is kept.
+static void OfferHit(PS_SEARCH &PS, PS_HIT &Rec)
+	{
+	PS_HIT *Hits = PS.Hits;
+	if (PS.uHitCount < PS.uTopK)
+		{
+		Hits[PS.uHitCount++] = Rec;
+		std::push_heap(Hits, Hits + PS.uHitCount, BetterHit);
+		}
+	else if (BetterHit(Rec, Hits[0]))
+		{
+		std::pop_heap(Hits, Hits + PS.uHitCount, BetterHit);
+		FreeHit(Hits[PS.uHitCount - 1]);
+		Hits[PS.uHitCount - 1] = Rec;
+		std::push_heap(Hits, Hits + PS.uHitCount, BetterHit);
+		}
+	else
+		return;
+	Rec.Label = 0;
+	Rec.Seq = 0;
+	}
+
+static void SearchThread(unsigned /* uThreadIndex */, void *ptrUser)
+	{
+	PS_SEARCH &PS = *(PS_SEARCH *) ptrUser;
+	PS_HIT *Batch = new PS_HIT[PS_BATCH_SEQS];
+	PS_BUFFERS Buffers;
+	memset(&Buffers, 0, sizeof(Buffers));
+
+	for (;;)
+		{
+		PS.Lock.Lock();
+		const unsigned uCount = ReadBatch(PS, Batch);
+		PS.Lock.Unlock();
+		if (0 == uCount)
+			break;
+
+		for (unsigned n = 0; n < uCount; ++n)
+			{
+			PS_HIT &Rec = Batch[n];
+			SeqProfile(PS, Rec, Buffers);
+
+			unsigned uStartA;
+			unsigned uStartB;
+			unsigned uEndA;
+			unsigned uEndB;
+			Rec.Score = StripedSWQuery(PS.Query, Buffers.Prof, Buffers.Classes,
+			  Rec.uLength, &uStartA, &uStartB, &uEndA, &uEndB);
+#if	TRACE
+			Log("Seq %u %s score %g\n", Rec.uIndex, Rec.Label, Rec.Score);
+#endif
+			}
+
+		PS.Lock.Lock();
+		for (unsigned n = 0; n < uCount; ++n)
+			{
+			PS_HIT &Rec = Batch[n];
+			OfferHit(PS, Rec);
+			if (0 == Rec.uIndex%PS_PROGRESS_SEQS && Rec.uIndex > 0)
+				Progress("%u seqs searched", Rec.uIndex);
+			}
+		PS.Lock.Unlock();
+
+		for (unsigned n = 0; n < uCount; ++n)
+			FreeHit(Batch[n]);
+		}
+
+	delete[] Buffers.Classes;
+	delete[] Buffers.Prof;
+	delete[] Batch;
+	}
+
+// A letter a profile column may hold: one of the alphabet or a
+// wildcard (see GetColFractionalWeightedCounts).
+static bool IsClassChar(unsigned char c)
+	{
+	return IsWildcardChar(c) || CharToLetter(c) < g_AlphaSize;
+	}
+
+// Letter classes: one per letter of the alphabet and wildcard, other
+// letters are the wildcard of the alphabet, as for MSA::FixAlpha.
+// ClassPos[c] is the profile of a sequence of one letter of class c.
+static unsigned MakeClasses(unsigned char CharToClass[256], ProfPos **ptrClassPos)
+	{
+	const unsigned char cWildcard = (unsigned char) GetWildcardChar();
+	if (!IsClassChar(cWildcard))
+		Quit("Internal error, MakeClasses: wildcard '%c'", cWildcard);
+
+	char ClassChar[256];
+	unsigned uClassCount = 0;
+	for (unsigned c = 'A'; c <= 'Z'; ++c)
+		if (IsClassChar((unsigned char) c))
+			{
+			CharToClass[c] = (unsigned char) uClassCount;
+			ClassChar[uClassCount++] = (char) c;
+			}
+	for (unsigned c = 0; c < 256; ++c)
+		if (c < 'A' || c > 'Z' || !IsClassChar((unsigned char) c))
+			CharToClass[c] = CharToClass[cWildcard];
+
+	ProfPos *ClassPos = new ProfPos[uClassCount];
+	for (unsigned n = 0; n < uClassCount; ++n)
+		{
+		Seq s;
+		s.SetName("Class");
+		s.AppendChar(ClassChar[n]);
+		ProfPos *Prof = ProfileFromSeq(s);
+		ClassPos[n] = Prof[0];
+		delete[] Prof;
+		}
+	*ptrClassPos = ClassPos;
+	return uClassCount;
+	}
+
+// Path as a run-length string, e.g. 12M2D30M.
+static void PathToStr(const PWPath &Path, TextFile &File)
+	{
+	const unsigned uEdgeCount = Path.GetEdgeCount();
+	unsigned uRunLength = 0;
+	for (unsigned uEdgeIndex = 0; uEdgeIndex < uEdgeCount; ++uEdgeIndex)
+		{
+		const char c = Path.GetEdge(uEdgeIndex).cType;
+		++uRunLength;
+		if (uEdgeIndex + 1 == uEdgeCount ||
+		  Path.GetEdge(uEdgeIndex + 1).cType != c)
+			{
+			File.PutFormat("%u%c", uRunLength, c);
+			uRunLength = 0;
+			}
+		}
+	}
+
+static void WriteHits(PS_SEARCH &PS, const ProfPos *Prof, unsigned uLength)
+	{
+	PS_HIT *Hits = PS.Hits;
+	const unsigned uHitCount = PS.uHitCount;
+	std::sort_heap(Hits, Hits + uHitCount, BetterHit);
+
+	TextFile fileOut(g_pstrOutFileName, true);
+	fileOut.PutFormat("# Profile %s, %u columns\n", g_pstrFileName1, uLength);
+	fileOut.PutFormat("# Database %s, %u seqs, %.0f letters\n", g_pstrFileName2,
+	  PS.uSeqCount, PS.dLetterCount);
+	fileOut.PutString("# Rank\tScore\tFrom1\tTo1\tFrom2\tTo2\tLength2\tPath\tLabel\n");
+
+	PS_BUFFERS Buffers;
+	memset(&Buffers, 0, sizeof(Buffers));
+	for (unsigned uHitIndex = 0; uHitIndex < uHitCount; ++uHitIndex)
+		{
+		const PS_HIT &Hit = Hits[uHitIndex];
+		SeqProfile(PS, Hit, Buffers);
+
+		PWPath Path;
+		const SCORE Score = SW(Prof, uLength, Buffers.Prof, Hit.uLength, Path);
+		if (Score != Hit.Score)
+			Quit("Internal error, -profsearch: %s score %g, SW %g",
+			  Hit.Label, Hit.Score, Score);
+
+		const PWEdge &First = Path.GetEdge(0);
+		const PWEdge &Last = Path.GetEdge(Path.GetEdgeCount() - 1);
+		fileOut.PutFormat("%u\t%.2f\t%u\t%u\t%u\t%u\t%u\t", uHitIndex + 1,
+		  Hit.Score, First.uPrefixLengthA, Last.uPrefixLengthA,
+		  First.uPrefixLengthB, Last.uPrefixLengthB, Hit.uLength);
+		PathToStr(Path, fileOut);
+		fileOut.PutFormat("\t%s\n", Hit.Label);
+		}
+	delete[] Buffers.Classes;
+	delete[] Buffers.Prof;
+	}
+
+void ProfSearch()
+	{
+	if (0 == g_pstrFileName1 || 0 == g_pstrFileName2)
+		Quit("-profsearch needs -in1 and -in2");
+	if (0 == g_uTopK)
+		Quit("-topk must be at least 1");
+
+	SetOutputFileName(g_pstrOutFileName);
+	SetInputFileName(g_pstrFileName2);
+	SetStartTime();
+	SetSeqWeightMethod(g_SeqWeight1);
+
+	TextFile file1(g_pstrFileName1);
+	MSA msa1;
+	msa1.FromFile(file1);
+	const unsigned uSeqCount1 = msa1.GetSeqCount();
+	const unsigned uLength1 = msa1.GetColCount();
+	if (0 == uSeqCount1 || 0 == uLength1)
+		Quit("No sequences in input alignment");
+
+	ALPHA Alpha = ALPHA_Undefined;
+	switch (g_SeqType)
+		{
+	case SEQTYPE_Auto:
+		Alpha = msa1.GuessAlpha();
+		break;
+
+	case SEQTYPE_Protein:
+		Alpha = ALPHA_Amino;
+		break;
+
+	case SEQTYPE_DNA:
+		Alpha = ALPHA_DNA;
+		break;
+
+	case SEQTYPE_RNA:
+		Alpha = ALPHA_RNA;
+		break;
+
+	default:
+		Quit("Invalid SeqType");
+		}
+	SetAlpha(Alpha);
+	msa1.FixAlpha();
+	SetPPScore();
+
+	MSA::SetIdCount(uSeqCount1);
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount1; ++uSeqIndex)
+		msa1.SetSeqId(uSeqIndex, uSeqIndex);
+
+	Tree tree1;
+	TreeFromMSA(msa1, tree1, g_Cluster2, g_Distance2, g_Root1);
+	SetMuscleTree(tree1);
+	ProfPos *Prof1 = ProfileFromMSA(msa1);
+
+	PS_SEARCH PS;
+	ProfPos *ClassPos;
+	const unsigned uClassCount = MakeClasses(PS.CharToClass, &ClassPos);
+	PS.ClassPos = ClassPos;
+	MakeSWQuery(Prof1, uLength1, ClassPos, uClassCount, PS.Query);
+	PS.uTopK = g_uTopK;
+	PS.bEOF = false;
+	PS.uSeqCount = 0;
+	PS.dLetterCount = 0;
+	PS.Hits = new PS_HIT[g_uTopK];
+	PS.uHitCount = 0;
+
+	PS.f = fopen(g_pstrFileName2, "rb");
+	if (0 == PS.f)
+		Quit("Cannot open %s, errno=%d %s", g_pstrFileName2, errno,
+		  strerror(errno));
+
+	const unsigned uThreadCount = GetThreadCount();
+	Progress("Searching %s, %u threads", g_pstrFileName2, uThreadCount);
+	RunThreads(uThreadCount, SearchThread, &PS);
+	fclose(PS.f);
+	Progress("%u seqs searched, %u hits", PS.uSeqCount, PS.uHitCount);
+
+	WriteHits(PS, Prof1, uLength1);
+
+	for (unsigned uHitIndex = 0; uHitIndex < PS.uHitCount; ++uHitIndex)
+		FreeHit(PS.Hits[uHitIndex]);
+	delete[] PS.Hits;
+	FreeSWQuery(PS.Query);
+	delete[] ClassPos;
+	delete[] Prof1;
+	}
@@ -5,15 +5,16 @@
 // Functions that provide visible feedback to the user
 // that progress is being made.
 
-static unsigned g_uIter = 0;		// Main MUSCLE iteration 1, 2..
-static unsigned g_uLocalMaxIters = 0;	// Max iters
-static FILE *g_fProgress = stderr;	// Default to standard error
-static char g_strFileName[32];		// File name
-static time_t g_tLocalStart;				// Start time
-static char g_strDesc[32];			// Description
-static bool g_bWipeDesc = false;
-static int g_nPrevDescLength;
-static unsigned g_uTotalSteps;
+// Progress state is in the current MuscleContext.
+#define g_uIter				(GetMuscleContext()->uIter)				// Main MUSCLE iteration 1, 2..
+#define g_uLocalMaxIters	(GetMuscleContext()->uLocalMaxIters)	// Max iters
+#define g_fProgress			(GetMuscleContext()->fProgress)			// Default to standard error
+#define g_strFileName		(GetMuscleContext()->strFileName)		// File name
+#define g_tLocalStart		(GetMuscleContext()->tLocalStart)		// Start time
+#define g_strDesc			(GetMuscleContext()->strDesc)			// Description
+#define g_bWipeDesc			(GetMuscleContext()->bWipeDesc)
+#define g_nPrevDescLength	(GetMuscleContext()->nPrevDescLength)
+#define g_uTotalSteps		(GetMuscleContext()->uTotalSteps)
 
 double GetCheckMemUseMB()
 	{
@@ -6,9 +6,61 @@
 #include "msa.h"
 #include "pwpath.h"
 #include "distfunc.h"
+#include "treetasks.h"
 
 #define TRACE 0
 
+struct PROG_ALIGN
+	{
+	const SeqVect *ptrSeqs;
+	const Tree *ptrTree;
+	ProgNode *ProgNodes;
+	unsigned uNodeCount;
+	};
+
+// Align one node of the guide tree. Called by RunTreeTasks after
+// both children are done, possibly on several threads at once.
+static void AlignNode(unsigned uTreeNodeIndex, void *ptrUser)
+	{
+	PROG_ALIGN &PA = *(PROG_ALIGN *) ptrUser;
+	const SeqVect &v = *PA.ptrSeqs;
+	const Tree &GuideTree = *PA.ptrTree;
+	ProgNode *ProgNodes = PA.ProgNodes;
+	const unsigned uSeqCount = v.Length();
+
+	if (GuideTree.IsLeaf(uTreeNodeIndex))
+		{
+		if (uTreeNodeIndex >= PA.uNodeCount)
+			Quit("TreeNodeIndex=%u NodeCount=%u\n", uTreeNodeIndex, PA.uNodeCount);
+		ProgNode &Node = ProgNodes[uTreeNodeIndex];
+		unsigned uId = GuideTree.GetLeafId(uTreeNodeIndex);
+		if (uId >= uSeqCount)
+			Quit("Seq index out of range");
+		const Seq &s = *(v[uId]);
+		Node.m_MSA.FromSeq(s);
+		Node.m_MSA.SetSeqId(0, uId);
+		Node.m_uLength = Node.m_MSA.GetColCount();
+		}
+	else
+		{
+		const unsigned uMergeNodeIndex = uTreeNodeIndex;
+		ProgNode &Parent = ProgNodes[uMergeNodeIndex];
+
+		const unsigned uLeft = GuideTree.GetLeft(uTreeNodeIndex);
+		const unsigned uRight = GuideTree.GetRight(uTreeNodeIndex);
+
+		ProgNode &Node1 = ProgNodes[uLeft];
+		ProgNode &Node2 = ProgNodes[uRight];
+
+		PWPath Path;
+		AlignTwoMSAs(Node1.m_MSA, Node2.m_MSA, Parent.m_MSA, Path);
+		Parent.m_uLength = Parent.m_MSA.GetColCount();
+
+		Node1.m_MSA.Clear();
+		Node2.m_MSA.Clear();
+		}
+	}
+
 void ProgressiveAlign(const SeqVect &v, const Tree &GuideTree, MSA &a)
 	{
 	assert(GuideTree.IsRooted());
@@ -23,48 +75,14 @@ void ProgressiveAlign(const SeqVect &v, const Tree &GuideTree, MSA &a)
 
 	ProgNode *ProgNodes = new ProgNode[uNodeCount];
 
-	unsigned uJoin = 0;
-	unsigned uTreeNodeIndex = GuideTree.FirstDepthFirstNode();
+	PROG_ALIGN PA;
+	PA.ptrSeqs = &v;
+	PA.ptrTree = &GuideTree;
+	PA.ProgNodes = ProgNodes;
+	PA.uNodeCount = uNodeCount;
+
 	SetProgressDesc("Align node");
-	do
-		{
-		if (GuideTree.IsLeaf(uTreeNodeIndex))
-			{
-			if (uTreeNodeIndex >= uNodeCount)
-				Quit("TreeNodeIndex=%u NodeCount=%u\n", uTreeNodeIndex, uNodeCount);
-			ProgNode &Node = ProgNodes[uTreeNodeIndex];
-			unsigned uId = GuideTree.GetLeafId(uTreeNodeIndex);
-			if (uId >= uSeqCount)
-				Quit("Seq index out of range");
-			const Seq &s = *(v[uId]);
-			Node.m_MSA.FromSeq(s);
-			Node.m_MSA.SetSeqId(0, uId);
-			Node.m_uLength = Node.m_MSA.GetColCount();
-			}
-		else
-			{
-			Progress(uJoin, uSeqCount - 1);
-			++uJoin;
-
-			const unsigned uMergeNodeIndex = uTreeNodeIndex;
-			ProgNode &Parent = ProgNodes[uMergeNodeIndex];
-
-			const unsigned uLeft = GuideTree.GetLeft(uTreeNodeIndex);
-			const unsigned uRight = GuideTree.GetRight(uTreeNodeIndex);
-
-			ProgNode &Node1 = ProgNodes[uLeft];
-			ProgNode &Node2 = ProgNodes[uRight];
-
-			PWPath Path;
-			AlignTwoMSAs(Node1.m_MSA, Node2.m_MSA, Parent.m_MSA, Path);
-			Parent.m_uLength = Parent.m_MSA.GetColCount();
-
-			Node1.m_MSA.Clear();
-			Node2.m_MSA.Clear();
-			}
-		uTreeNodeIndex = GuideTree.NextDepthFirstNode(uTreeNodeIndex);
-		}
-	while (NULL_NEIGHBOR != uTreeNodeIndex);
+	RunTreeTasks(GuideTree, AlignNode, &PA);
 	ProgressStepsDone();
 
 	unsigned uRootNodeIndex = GuideTree.GetRootNodeIndex();
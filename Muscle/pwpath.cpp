@@ -3,6 +3,7 @@
 #include "seq.h"
 #include "textfile.h"
 #include "msa.h"
+#include "msaview.h"
 
 PWPath::PWPath()
 	{
@@ -145,20 +146,18 @@ void PWPath::Copy(const PWPath &Path)
 		}
 	}
 
-void PWPath::FromMSAPair(const MSA &msaA, const MSA &msaB)
+// Columns that are gaps in both A and B are skipped.
+static void PathFromGapCols(const bool IsGapColA[], const bool IsGapColB[],
+  unsigned uColCount, PWPath &Path)
 	{
-	const unsigned uColCount = msaA.GetColCount();
-	if (uColCount != msaB.GetColCount())
-		Quit("PWPath::FromMSAPair, lengths differ");
-
-	Clear();
+	Path.Clear();
 
 	unsigned uPrefixLengthA = 0;
 	unsigned uPrefixLengthB = 0;
 	for (unsigned uColIndex = 0; uColIndex < uColCount; ++uColIndex)
 		{
-		bool bIsGapA = msaA.IsGapColumn(uColIndex);
-		bool bIsGapB = msaB.IsGapColumn(uColIndex);
+		bool bIsGapA = IsGapColA[uColIndex];
+		bool bIsGapB = IsGapColB[uColIndex];
 
 		PWEdge Edge;
 		char cType;
@@ -187,10 +186,43 @@ void PWPath::FromMSAPair(const MSA &msaA, const MSA &msaB)
 		Edge.cType = cType;
 		Edge.uPrefixLengthA = uPrefixLengthA;
 		Edge.uPrefixLengthB = uPrefixLengthB;
-		AppendEdge(Edge);
+		Path.AppendEdge(Edge);
 		}
 	}
 
+void PWPath::FromMSAPair(const MSA &msaA, const MSA &msaB)
+	{
+	const unsigned uColCount = msaA.GetColCount();
+	if (uColCount != msaB.GetColCount())
+		Quit("PWPath::FromMSAPair, lengths differ");
+
+	bool *IsGapColA = new bool[uColCount];
+	bool *IsGapColB = new bool[uColCount];
+	for (unsigned uColIndex = 0; uColIndex < uColCount; ++uColIndex)
+		{
+		IsGapColA[uColIndex] = msaA.IsGapColumn(uColIndex);
+		IsGapColB[uColIndex] = msaB.IsGapColumn(uColIndex);
+		}
+	PathFromGapCols(IsGapColA, IsGapColB, uColCount, *this);
+	delete[] IsGapColA;
+	delete[] IsGapColB;
+	}
+
+void PWPath::FromMSAPair(const MSAView &msaA, const MSAView &msaB)
+	{
+	const unsigned uColCount = msaA.GetColCount();
+	if (uColCount != msaB.GetColCount())
+		Quit("PWPath::FromMSAPair, lengths differ");
+
+	bool *IsGapColA = new bool[uColCount];
+	bool *IsGapColB = new bool[uColCount];
+	msaA.GetGapCols(IsGapColA);
+	msaB.GetGapCols(IsGapColB);
+	PathFromGapCols(IsGapColA, IsGapColB, uColCount, *this);
+	delete[] IsGapColA;
+	delete[] IsGapColB;
+	}
+
 // Very similar to HMMPath::FromFile, should consolidate.
 void PWPath::FromFile(TextFile &File)
 	{
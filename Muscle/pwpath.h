@@ -36,6 +36,7 @@ of a gap in the first position.
 
 class Seq;
 class MSA;
+class MSAView;
 class SatchmoParams;
 class PW;
 class TextFile;
@@ -82,6 +83,7 @@ public:
 	void FromFile(TextFile &File);
 	void ToFile(TextFile &File) const;
 	void FromMSAPair(const MSA &msaA, const MSA &msaB);
+	void FromMSAPair(const MSAView &msaA, const MSAView &msaB);
 	void AssertEqual(const PWPath &Path) const;
 	bool Equal(const PWPath &Path) const;
 	unsigned GetMatchCount() const;
@@ -5,9 +5,9 @@
 
 const int MAX_LINE = 4096;
 const int MAX_HEADINGS = 32;
-static char Heading[MAX_HEADINGS];
-static unsigned HeadingCount = 0;
-static float Mx[32][32];
+#define Heading			(GetMuscleContext()->MxHeading)
+#define HeadingCount	(GetMuscleContext()->uMxHeadingCount)
+#define Mx				(GetMuscleContext()->UserMx)
 
 static void LogMx()
 	{
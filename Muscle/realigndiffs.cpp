@@ -1,5 +1,6 @@
 #include "muscle.h"
 #include "msa.h"
+#include "msaview.h"
 #include "tree.h"
 #include "profile.h"
 #include "pwpath.h"
@@ -27,13 +28,14 @@ static void MakeNode(const MSA &msaIn, const Tree &Diffs, unsigned uDiffsNodeInd
 	if (0 == uSeqsInDiffCount)
 		Quit("MakeNode: no seqs in diff");
 
-	MSASubsetByIds(msaIn, Ids, uSeqsInDiffCount, Node.m_MSA);
+	MSAView v;
+	v.FromIds(msaIn, Ids, uSeqsInDiffCount);
+	v.DeleteGappedCols();
+	v.ToMSA(Node.m_MSA);
 
 #if	DEBUG
 	ValidateMuscleIds(Node.m_MSA);
 #endif
-
-	DeleteGappedCols(Node.m_MSA);
 	delete[] Ids;
 	}
 
@@ -1,21 +1,27 @@
 #include "muscle.h"
 #include "tree.h"
 #include "msa.h"
+#include "msaview.h"
 #include "pwpath.h"
 #include "profile.h"
 #include "scorehistory.h"
 #include "objscore.h"
+#include "threads.h"
 
-unsigned g_uRefineHeightSubtree;
-unsigned g_uRefineHeightSubtreeTotal;
+#define g_uRefineHeightSubtree		(GetMuscleContext()->uRefineHeightSubtree)
+#define g_uRefineHeightSubtreeTotal	(GetMuscleContext()->uRefineHeightSubtreeTotal)
 
-#define TRACE			0
-#define DIFFOBJSCORE	0
+#define TRACE	0
 
+// Realign the two subsets of msaIn and return true if that improves
+// the score; the new alignment is then in msaRealigned. msaIn is not
+// changed, except for its weights. If ptrSPCols is not 0 it holds the
+// column scores of msaIn, and the realigned MSA is scored
+// incrementally instead of by ObjScoreIds.
 static bool TryRealign(MSA &msaIn, const Tree &tree, const unsigned Leaves1[],
   unsigned uCount1, const unsigned Leaves2[], unsigned uCount2,
   SCORE *ptrscoreBefore, SCORE *ptrscoreAfter,
-  bool bLockLeft, bool bLockRight)
+  bool bLockLeft, bool bLockRight, SPColScores *ptrSPCols, MSA &msaRealigned)
 	{
 #if	TRACE
 	Log("TryRealign, msaIn=\n");
@@ -30,16 +36,13 @@ static bool TryRealign(MSA &msaIn, const Tree &tree, const unsigned Leaves1[],
 	LeafIndexesToIds(tree, Leaves1, uCount1, Ids1);
 	LeafIndexesToIds(tree, Leaves2, uCount2, Ids2);
 
-	MSA msa1;
-	MSA msa2;
+// The two subtrees are views of msaIn, which is not changed until
+// the realigned MSA is accepted.
+	MSAView msa1;
+	MSAView msa2;
 
-	MSASubsetByIds(msaIn, Ids1, uCount1, msa1);
-	MSASubsetByIds(msaIn, Ids2, uCount2, msa2);
-
-#if	DEBUG
-	ValidateMuscleIds(msa1);
-	ValidateMuscleIds(msa2);
-#endif
+	msa1.FromIds(msaIn, Ids1, uCount1);
+	msa2.FromIds(msaIn, Ids2, uCount2);
 
 // Computing the objective score may be expensive for
 // large numbers of sequences. As a speed optimization,
@@ -50,13 +53,18 @@ static bool TryRealign(MSA &msaIn, const Tree &tree, const unsigned Leaves1[],
 	PWPath pathBefore;
 	pathBefore.FromMSAPair(msa1, msa2);
 
-	DeleteGappedCols(msa1);
-	DeleteGappedCols(msa2);
+	msa1.DeleteGappedCols();
+	msa2.DeleteGappedCols();
 
 	if (0 == msa1.GetColCount() || 0 == msa2.GetColCount())
+		{
+		*ptrscoreBefore = 0;
+		*ptrscoreAfter = 0;
+		delete[] Ids1;
+		delete[] Ids2;
 		return false;
+		}
 
-	MSA msaRealigned;
 	PWPath pathAfter;
 
 	AlignTwoMSAs(msa1, msa2, msaRealigned, pathAfter, bLockLeft, bLockRight);
@@ -64,15 +72,32 @@ static bool TryRealign(MSA &msaIn, const Tree &tree, const unsigned Leaves1[],
 	bool bAnyChanges = !pathAfter.Equal(pathBefore);
 	unsigned uDiffCount1;
 	unsigned uDiffCount2;
-	static unsigned Edges1[10000];
-	static unsigned Edges2[10000];
+	DPWorkspace &w = *GetDPWorkspace();
+	unsigned uMaxEdgeCount = pathBefore.GetEdgeCount();
+	if (pathAfter.GetEdgeCount() > uMaxEdgeCount)
+		uMaxEdgeCount = pathAfter.GetEdgeCount();
+	if (uMaxEdgeCount > w.uRefineEdgesSize)
+		{
+		delete[] w.RefineEdges1;
+		delete[] w.RefineEdges2;
+		w.uRefineEdgesSize = uMaxEdgeCount + 1024;
+		w.RefineEdges1 = new unsigned[w.uRefineEdgesSize];
+		w.RefineEdges2 = new unsigned[w.uRefineEdgesSize];
+		}
+	unsigned *Edges1 = w.RefineEdges1;
+	unsigned *Edges2 = w.RefineEdges2;
 	DiffPaths(pathBefore, pathAfter, Edges1, &uDiffCount1, Edges2, &uDiffCount2);
 
 #if	TRACE
+	{
+	MSA msaTmp;
 	Log("TryRealign, msa1=\n");
-	msa1.LogMe();
+	msa1.ToMSA(msaTmp);
+	msaTmp.LogMe();
 	Log("\nmsa2=\n");
-	msa2.LogMe();
+	msa2.ToMSA(msaTmp);
+	msaTmp.LogMe();
+	}
 	Log("\nRealigned (changes %s)=\n", bAnyChanges ? "TRUE" : "FALSE");
 	msaRealigned.LogMe();
 #endif
@@ -81,24 +106,27 @@ static bool TryRealign(MSA &msaIn, const Tree &tree, const unsigned Leaves1[],
 		{
 		*ptrscoreBefore = 0;
 		*ptrscoreAfter = 0;
+		delete[] Ids1;
+		delete[] Ids2;
 		return false;
 		}
 
-	SetMSAWeightsMuscle(msaIn);
-	SetMSAWeightsMuscle(msaRealigned);
-
-#if	DIFFOBJSCORE
-	const SCORE scoreDiff = DiffObjScore(msaIn, pathBefore, Edges1, uDiffCount1,
-	  msaRealigned, pathAfter, Edges2, uDiffCount2);
-	bool bAccept = (scoreDiff > 0);
-	*ptrscoreBefore = 0;
-	*ptrscoreAfter = scoreDiff;
-	//const SCORE scoreBefore = ObjScoreIds(msaIn, Ids1, uCount1, Ids2, uCount2);
-	//const SCORE scoreAfter = ObjScoreIds(msaRealigned, Ids1, uCount1, Ids2, uCount2);
-	//Log("Diff = %.3g %.3g\n", scoreDiff, scoreAfter - scoreBefore);
-#else
-	const SCORE scoreBefore = ObjScoreIds(msaIn, Ids1, uCount1, Ids2, uCount2);
-	const SCORE scoreAfter = ObjScoreIds(msaRealigned, Ids1, uCount1, Ids2, uCount2);
+	SCORE scoreBefore;
+	SCORE scoreAfter;
+	if (0 != ptrSPCols)
+		{
+		scoreBefore = ptrSPCols->GetScore();
+		scoreAfter = ptrSPCols->ScoreRealigned(msaRealigned, pathBefore, Edges1,
+		  uDiffCount1, pathAfter, Edges2, uDiffCount2);
+		}
+	else
+		{
+		SetMSAWeightsMuscle(msaIn);
+		SetMSAWeightsMuscle(msaRealigned);
+
+		scoreBefore = ObjScoreIds(msaIn, Ids1, uCount1, Ids2, uCount2);
+		scoreAfter = ObjScoreIds(msaRealigned, Ids1, uCount1, Ids2, uCount2);
+		}
 
 	bool bAccept = (scoreAfter > scoreBefore);
 
@@ -108,99 +136,252 @@ static bool TryRealign(MSA &msaIn, const Tree &tree, const unsigned Leaves1[],
 
 	*ptrscoreBefore = scoreBefore;
 	*ptrscoreAfter = scoreAfter;
-#endif
 
-	if (bAccept)
-		msaIn.Copy(msaRealigned);
 	delete[] Ids1;
 	delete[] Ids2;
 	return bAccept;
 	}
 
+/***
+Parallel refinement. With more than one thread, the bipartitions of a
+pass are tried in batches of one per thread, all against the same
+alignment. Each thread realigns from its own copy of the alignment,
+since scoring sets weights and column scores on it. The results are
+then taken in tree order, as the serial loop would: tries that are
+rejected are final, and the first accepted one is committed. Tries
+after it were made against the old alignment, so they are thrown away
+and the next batch starts after the accepted edge. Accepted edges are
+rare after the first iterations, so most batches are used in full.
+
+Because every try sees exactly the alignment that the serial loop
+would give it, the result does not depend on the number of threads.
+Three-way weights depend on the split being tried, which is global
+state, so they are always refined serially.
+***/
+
+struct REFINE_TRY
+	{
+	unsigned uInternalNodeIndex;
+	unsigned uNeighborNodeIndex;
+	unsigned *Leaves1;
+	unsigned *Leaves2;
+	unsigned uCount1;
+	unsigned uCount2;
+	MSA msaRealigned;
+	SCORE scoreBefore;
+	SCORE scoreAfter;
+	bool bAccepted;
+	};
+
+struct REFINE_THREAD
+	{
+	MSA msa;
+	SPColScores SPCols;
+	bool bCurrent;
+	};
+
+struct REFINE_BATCH
+	{
+	const MSA *ptrMSA;
+	const Tree *ptrTree;
+	REFINE_TRY *Tries;
+	unsigned uTryCount;
+	REFINE_THREAD *Threads;
+	unsigned uThreadCount;
+	bool bSPCols;
+	bool bLockLeft;
+	bool bLockRight;
+	};
+
+static void RefineBatchThread(unsigned uThreadIndex, void *ptrUser)
+	{
+	REFINE_BATCH &RB = *(REFINE_BATCH *) ptrUser;
+	REFINE_THREAD &RT = RB.Threads[uThreadIndex];
+	if (uThreadIndex >= RB.uTryCount)
+		return;
+
+	if (!RT.bCurrent)
+		{
+		RT.msa.Copy(*RB.ptrMSA);
+		if (RB.bSPCols)
+			RT.SPCols.FromMSA(RT.msa);
+		RT.bCurrent = true;
+		}
+
+	for (unsigned i = uThreadIndex; i < RB.uTryCount; i += RB.uThreadCount)
+		{
+		REFINE_TRY &Try = RB.Tries[i];
+		Try.bAccepted = TryRealign(RT.msa, *RB.ptrTree, Try.Leaves1, Try.uCount1,
+		  Try.Leaves2, Try.uCount2, &Try.scoreBefore, &Try.scoreAfter,
+		  RB.bLockLeft, RB.bLockRight, RB.bSPCols ? &RT.SPCols : 0,
+		  Try.msaRealigned);
+		}
+	}
+
 static void RefineHeightParts(MSA &msaIn, const Tree &tree,
  const unsigned InternalNodeIndexes[], bool bReversed, bool bRight,
  unsigned uIter, 
  ScoreHistory &History,
- bool *ptrbAnyChanges, bool *ptrbOscillating, bool bLockLeft, bool bLockRight)
+ bool *ptrbAnyChanges, bool *ptrbOscillating, bool bLockLeft, bool bLockRight,
+ SPColScores *ptrSPCols, REFINE_THREAD *Threads, unsigned uThreadCount)
 	{
 	*ptrbOscillating = false;
 
 	const unsigned uSeqCount = msaIn.GetSeqCount();
 	const unsigned uInternalNodeCount = uSeqCount - 1;
 
-	unsigned *Leaves1 = new unsigned[uSeqCount];
-	unsigned *Leaves2 = new unsigned[uSeqCount];
+	REFINE_TRY *Tries = new REFINE_TRY[uThreadCount];
+	for (unsigned i = 0; i < uThreadCount; ++i)
+		{
+		Tries[i].Leaves1 = new unsigned[uSeqCount];
+		Tries[i].Leaves2 = new unsigned[uSeqCount];
+		}
 
 	const unsigned uRootNodeIndex = tree.GetRootNodeIndex();
 	bool bAnyAccepted = false;
-	for (unsigned i = 0; i < uInternalNodeCount; ++i)
+	unsigned i = 0;
+	while (i < uInternalNodeCount)
 		{
-		const unsigned uInternalNodeIndex = InternalNodeIndexes[i];
-		unsigned uNeighborNodeIndex;
-		if (tree.IsRoot(uInternalNodeIndex) && !bRight)
-			continue;
-		else if (bRight)
-			uNeighborNodeIndex = tree.GetRight(uInternalNodeIndex);
-		else
-			uNeighborNodeIndex = tree.GetLeft(uInternalNodeIndex);
-
-		g_uTreeSplitNode1 = uInternalNodeIndex;
-		g_uTreeSplitNode2 = uNeighborNodeIndex;
-
-		unsigned uCount1;
-		unsigned uCount2;
+		if (RefineStopped())
+			break;
 
-		GetLeaves(tree, uNeighborNodeIndex, Leaves1, &uCount1);
-		GetLeavesExcluding(tree, uRootNodeIndex, uNeighborNodeIndex,
-		  Leaves2, &uCount2);
+	// Next batch of bipartitions, and the index to continue from if
+	// none is accepted.
+		unsigned uTryCount = 0;
+		unsigned *NextIndexes = new unsigned[uThreadCount];
+		for (; i < uInternalNodeCount && uTryCount < uThreadCount; ++i)
+			{
+			const unsigned uInternalNodeIndex = InternalNodeIndexes[i];
+			unsigned uNeighborNodeIndex;
+			if (tree.IsRoot(uInternalNodeIndex) && !bRight)
+				continue;
+			else if (bRight)
+				uNeighborNodeIndex = tree.GetRight(uInternalNodeIndex);
+			else
+				uNeighborNodeIndex = tree.GetLeft(uInternalNodeIndex);
+
+			REFINE_TRY &Try = Tries[uTryCount];
+			Try.uInternalNodeIndex = uInternalNodeIndex;
+			Try.uNeighborNodeIndex = uNeighborNodeIndex;
+			GetLeaves(tree, uNeighborNodeIndex, Try.Leaves1, &Try.uCount1);
+			GetLeavesExcluding(tree, uRootNodeIndex, uNeighborNodeIndex,
+			  Try.Leaves2, &Try.uCount2);
+			NextIndexes[uTryCount] = i + 1;
+			++uTryCount;
+			}
+		if (0 == uTryCount)
+			{
+			delete[] NextIndexes;
+			break;
+			}
 
 #if	TRACE
-		Log("\nRefineHeightParts node %u\n", uInternalNodeIndex);
-		Log("Group1=");
-		for (unsigned n = 0; n < uCount1; ++n)
-			Log(" %u(%s)", Leaves1[n], tree.GetName(Leaves1[n]));
-		Log("\n");
-		Log("Group2=");
-		for (unsigned n = 0; n < uCount2; ++n)
-			Log(" %u(%s)", Leaves2[n], tree.GetName(Leaves2[n]));
-		Log("\n");
+		for (unsigned n = 0; n < uTryCount; ++n)
+			{
+			const REFINE_TRY &Try = Tries[n];
+			Log("\nRefineHeightParts node %u\n", Try.uInternalNodeIndex);
+			Log("Group1=");
+			for (unsigned k = 0; k < Try.uCount1; ++k)
+				Log(" %u(%s)", Try.Leaves1[k], tree.GetName(Try.Leaves1[k]));
+			Log("\n");
+			Log("Group2=");
+			for (unsigned k = 0; k < Try.uCount2; ++k)
+				Log(" %u(%s)", Try.Leaves2[k], tree.GetName(Try.Leaves2[k]));
+			Log("\n");
+			}
 #endif
 
-		SCORE scoreBefore;
-		SCORE scoreAfter;
-		bool bAccepted = TryRealign(msaIn, tree, Leaves1, uCount1, Leaves2, uCount2,
-		  &scoreBefore, &scoreAfter, bLockLeft, bLockRight);
-		SetCurrentAlignment(msaIn);
+		if (1 == uThreadCount)
+			{
+			REFINE_TRY &Try = Tries[0];
+			g_uTreeSplitNode1 = Try.uInternalNodeIndex;
+			g_uTreeSplitNode2 = Try.uNeighborNodeIndex;
+			Try.bAccepted = TryRealign(msaIn, tree, Try.Leaves1, Try.uCount1,
+			  Try.Leaves2, Try.uCount2, &Try.scoreBefore, &Try.scoreAfter,
+			  bLockLeft, bLockRight, ptrSPCols, Try.msaRealigned);
+			}
+		else
+			{
+			REFINE_BATCH RB;
+			RB.ptrMSA = &msaIn;
+			RB.ptrTree = &tree;
+			RB.Tries = Tries;
+			RB.uTryCount = uTryCount;
+			RB.Threads = Threads;
+			RB.uThreadCount = uThreadCount;
+			RB.bSPCols = (0 != ptrSPCols);
+			RB.bLockLeft = bLockLeft;
+			RB.bLockRight = bLockRight;
+			RunThreads(uThreadCount, RefineBatchThread, &RB);
+			}
+
+		for (unsigned n = 0; n < uTryCount; ++n)
+			{
+			REFINE_TRY &Try = Tries[n];
+			g_uTreeSplitNode1 = Try.uInternalNodeIndex;
+			g_uTreeSplitNode2 = Try.uNeighborNodeIndex;
+			if (Try.bAccepted)
+				{
+				msaIn.Copy(Try.msaRealigned);
+				if (1 == uThreadCount)
+					{
+					if (0 != ptrSPCols)
+						ptrSPCols->Accept();
+					}
+				else
+					{
+					for (unsigned t = 0; t < uThreadCount; ++t)
+						Threads[t].bCurrent = false;
+					}
+				bAnyAccepted = true;
+				}
+			SetCurrentAlignment(msaIn);
 
-		++g_uRefineHeightSubtree;
-		Progress(g_uRefineHeightSubtree, g_uRefineHeightSubtreeTotal);
+			++g_uRefineHeightSubtree;
+			Progress(g_uRefineHeightSubtree, g_uRefineHeightSubtreeTotal);
 
 #if	TRACE
-		if (uIter > 0)
-			Log("Before %g %g\n", scoreBefore,
-			  History.GetScore(uIter - 1, uInternalNodeIndex, bReversed, bRight));
+			if (uIter > 0)
+				Log("Before %g %g\n", Try.scoreBefore,
+				  History.GetScore(uIter - 1, Try.uInternalNodeIndex, bReversed, bRight));
 #endif
-		SCORE scoreMax = scoreAfter > scoreBefore? scoreAfter : scoreBefore;
-		bool bRepeated = History.SetScore(uIter, uInternalNodeIndex, bRight, scoreMax);
-		if (bRepeated)
-			{
-			*ptrbOscillating = true;
-			break;
-			}
+			const SCORE scoreBefore = Try.scoreBefore;
+			const SCORE scoreAfter = Try.scoreAfter;
+			SCORE scoreMax = scoreAfter > scoreBefore? scoreAfter : scoreBefore;
+			bool bRepeated = History.SetScore(uIter, Try.uInternalNodeIndex, bRight, scoreMax);
+			if (bRepeated)
+				{
+				*ptrbOscillating = true;
+				delete[] NextIndexes;
+				goto Done;
+				}
 
-		if (bAccepted)
-			bAnyAccepted = true;
+			if (Try.bAccepted)
+				{
+				i = NextIndexes[n];
+				break;
+				}
+			}
+		delete[] NextIndexes;
 		}
 
-	delete[] Leaves1;
-	delete[] Leaves2;
+Done:
+	for (unsigned n = 0; n < uThreadCount; ++n)
+		{
+		delete[] Tries[n].Leaves1;
+		delete[] Tries[n].Leaves2;
+		}
+	delete[] Tries;
 
 	*ptrbAnyChanges = bAnyAccepted;
 	}
 
 // Return true if any changes made
+// bCheckpoint is set by the drivers when msaIn is the whole alignment, to
+// checkpoint it after each iteration. RefineVert and RefineSubfams pass
+// parts of it, which are not.
 bool RefineHoriz(MSA &msaIn, const Tree &tree, unsigned uIters, bool bLockLeft,
-  bool bLockRight)
+  bool bLockRight, bool bCheckpoint)
 	{
 #if	TRACE
 	tree.LogMe();
@@ -221,6 +402,25 @@ bool RefineHoriz(MSA &msaIn, const Tree &tree, unsigned uIters, bool bLockLeft,
 
 	ScoreHistory History(uIters, 2*uSeqCount - 1);
 
+	SPColScores SPCols;
+	SPColScores *ptrSPCols = 0;
+	if (SPColScores::CanUse(msaIn))
+		{
+		SPCols.FromMSA(msaIn);
+		ptrSPCols = &SPCols;
+		}
+
+	unsigned uThreadCount = GetThreadCount();
+	if (uThreadCount > uInternalNodeCount || SEQWEIGHT_ThreeWay == GetSeqWeightMethod())
+		uThreadCount = 1;
+	REFINE_THREAD *Threads = 0;
+	if (uThreadCount > 1)
+		{
+		Threads = new REFINE_THREAD[uThreadCount];
+		for (unsigned n = 0; n < uThreadCount; ++n)
+			Threads[n].bCurrent = false;
+		}
+
 	bool bAnyChangesAnyIter = false;
 	for (unsigned n = 0; n < uInternalNodeCount; ++n)
 		InternalNodeIndexesR[uInternalNodeCount - 1 - n] = InternalNodeIndexes[n];
@@ -259,7 +459,8 @@ bool RefineHoriz(MSA &msaIn, const Tree &tree, unsigned uIters, bool bLockLeft,
 			RefineHeightParts(msaIn, tree, Internals, bReverse, bRight,
 			  uIter, 
 			  History, 
-			  &bAnyChanges, &bOscillating, bLockLeft, bLockRight);
+			  &bAnyChanges, &bOscillating, bLockLeft, bLockRight, ptrSPCols,
+			  Threads, uThreadCount);
 			if (bOscillating)
 				{
 				ProgressStepsDone();
@@ -273,7 +474,9 @@ bool RefineHoriz(MSA &msaIn, const Tree &tree, unsigned uIters, bool bLockLeft,
 			}
 
 		ProgressStepsDone();
-		if (bOscillating)
+		if (bCheckpoint)
+			CheckpointAlignment(msaIn);
+		if (bOscillating || RefineStopped())
 			break;
 
 		if (!bAnyChangesThisIter)
@@ -281,6 +484,7 @@ bool RefineHoriz(MSA &msaIn, const Tree &tree, unsigned uIters, bool bLockLeft,
 		}
 
 Osc:
+	delete[] Threads;
 	delete[] InternalNodeIndexes;
 	delete[] InternalNodeIndexesR;
 
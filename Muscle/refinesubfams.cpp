@@ -1,5 +1,6 @@
 #include "muscle.h"
 #include "msa.h"
+#include "msaview.h"
 #include "tree.h"
 #include "clust.h"
 #include "profile.h"
@@ -85,8 +86,10 @@ bool RefineSubfams(MSA &msa, const Tree &tree, unsigned uIters)
 		LeafIndexesToIds(tree, Leaves, uLeafCount, Ids);
 
 		MSA &msaSubfam = SubfamMSAs[uSubfamIndex];
-		MSASubsetByIds(msa, Ids, uLeafCount, msaSubfam);
-		DeleteGappedCols(msaSubfam);
+		MSAView v;
+		v.FromIds(msa, Ids, uLeafCount);
+		v.DeleteGappedCols();
+		v.ToMSA(msaSubfam);
 
 #if	TRACE
 		Log("Subfam %u MSA=\n", uSubfamIndex);
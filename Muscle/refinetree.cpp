@@ -23,6 +23,9 @@ void RefineTree(MSA &msa, Tree &tree)
 	Tree Tree2;
 	for (unsigned uIter = 0; uIter < g_uMaxTreeRefineIters; ++uIter)
 		{
+		if (RefineStopped())
+			break;
+
 		TreeFromMSA(msa, Tree2, g_Cluster2, g_Distance2, g_Root2);
 
 #if	DEBUG
@@ -53,6 +56,7 @@ void RefineTree(MSA &msa, Tree &tree)
 
 		msa.Copy(msa2);
 		SetCurrentAlignment(msa);
+		CheckpointAlignment(msa);
 		}
 
 	delete[] IdToDiffsLeafNodeIndex;
@@ -12,7 +12,7 @@ void RefineTreeE(MSA &msa, const SeqVect &v, Tree &tree, ProgNode *ProgNodes)
 	if (tree.GetLeafCount() != uSeqCount)
 		Quit("Refine tree, tree has different number of nodes");
 
-	if (uSeqCount < 3)
+	if (uSeqCount < 3 || RefineStopped())
 		return;
 
 #if	DEBUG
@@ -141,8 +141,7 @@ void RefineW(const MSA &msaIn, MSA &msaOut)
 			}
 
 #if	MEMDEBUG
-		void FreeDPMemSPN();
-		FreeDPMemSPN();
+		FreeDPMem(GetDPWorkspace()->DPMemSPN);
 
 		_CrtMemState s2;
 		_CrtMemCheckpoint(&s2);
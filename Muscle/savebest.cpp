@@ -1,10 +1,18 @@
 #include "muscle.h"
 #include "msa.h"
 #include "textfile.h"
+#include "objscore.h"
 #include <time.h>
 
-static MSA *ptrBestMSA;
-static const char *pstrOutputFileName;
+#define ptrBestMSA			(GetMuscleContext()->ptrBestMSA)
+#define pstrOutputFileName	(GetMuscleContext()->pstrOutputFileName)
+#define dRefineDeadline		(GetMuscleContext()->dRefineDeadline)
+#define ptrRefineCancel		(GetMuscleContext()->ptrRefineCancel)
+#define CheckpointFn		(GetMuscleContext()->CheckpointFn)
+#define ptrCheckpointUser	(GetMuscleContext()->ptrCheckpointUser)
+#define ptrCheckpointMSA	(GetMuscleContext()->ptrCheckpointMSA)
+#define scoreCheckpoint		(GetMuscleContext()->scoreCheckpoint)
+#define bRefineStopped		(GetMuscleContext()->bRefineStopped)
 
 void SetOutputFileName(const char *out)
 	{
@@ -18,7 +26,7 @@ void SetCurrentAlignment(MSA &msa)
 
 void SaveCurrentAlignment()
 	{
-	static bool bCalled = false;
+	bool &bCalled = GetMuscleContext()->bSaveCalled;
 	if (bCalled)
 		{
 		fprintf(stderr,
@@ -64,3 +72,121 @@ void CheckMaxTime()
 	SaveCurrentAlignment();
 	exit(EXIT_Success);
 	}
+
+/***
+Anytime alignment, for callers that cannot have the process exit when
+time runs out. Before aligning, the caller may set a deadline, a
+cancel flag and a checkpoint callback. Refinement checks
+RefineStopped() between tree edges and stops early when it returns
+true, which leaves a valid alignment.
+
+The drivers call CheckpointAlignment() after each stage, and
+RefineHoriz after each of its iterations. It keeps the best alignment
+so far in the context and passes each new best to the callback.
+Stages use different trees and sequence weights, so checkpoints are
+compared by the SP dimer score with uniform weights. If refinement
+was stopped, UseBestAlignment() replaces the final alignment with the
+best checkpoint; a run that finishes keeps its own result.
+GetBestAlignment() returns the best checkpoint either way.
+
+None of this is active unless one of the three is set, so the
+command line is unchanged: -maxhours still saves and exits through
+CheckMaxTime.
+***/
+
+static bool AnytimeActive()
+	{
+	return 0 != dRefineDeadline || 0 != ptrRefineCancel || 0 != CheckpointFn;
+	}
+
+// Seconds from now, 0 for no deadline.
+void SetRefineDeadline(double dSecs)
+	{
+	if (dSecs > 0)
+		dRefineDeadline = GetWallSecs() + dSecs;
+	else
+		dRefineDeadline = 0;
+	}
+
+void SetRefineCancelFlag(const volatile bool *ptrCancel)
+	{
+	ptrRefineCancel = ptrCancel;
+	}
+
+void SetCheckpointCallback(CHECKPOINT_FN Fn, void *ptrUser)
+	{
+	CheckpointFn = Fn;
+	ptrCheckpointUser = ptrUser;
+	}
+
+// Once true, stays true for the rest of the run.
+bool RefineStopped()
+	{
+	if (bRefineStopped)
+		return true;
+
+	if (0 != ptrRefineCancel && *ptrRefineCancel)
+		{
+		Log("Refinement cancelled\n");
+		bRefineStopped = true;
+		}
+	else if (0 != dRefineDeadline && GetWallSecs() >= dRefineDeadline)
+		{
+		Log("Refinement deadline reached\n");
+		bRefineStopped = true;
+		}
+	return bRefineStopped;
+	}
+
+void CheckpointAlignment(const MSA &msa)
+	{
+	if (!AnytimeActive())
+		return;
+
+	MSA *ptrMSA = new MSA;
+	ptrMSA->Copy(msa);
+	const unsigned uSeqCount = ptrMSA->GetSeqCount();
+	if (0 == uSeqCount)
+		{
+		delete ptrMSA;
+		return;
+		}
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+		ptrMSA->SetSeqWeight(uSeqIndex, (WEIGHT) 1.0/uSeqCount);
+	const SCORE Score = ObjScoreSPDimer(*ptrMSA);
+
+	if (0 != ptrCheckpointMSA && Score <= scoreCheckpoint)
+		{
+		delete ptrMSA;
+		return;
+		}
+
+	delete ptrCheckpointMSA;
+	ptrCheckpointMSA = ptrMSA;
+	scoreCheckpoint = Score;
+	Log("Checkpoint alignment score %g\n", Score);
+
+	if (0 != CheckpointFn && !CheckpointFn(*ptrMSA, Score, ptrCheckpointUser))
+		{
+		Log("Refinement stopped by checkpoint callback\n");
+		bRefineStopped = true;
+		}
+	}
+
+// End of an anytime run: checkpoint msa, then, if refinement was
+// stopped early, replace it with the best checkpoint. Does nothing
+// unless anytime alignment is active.
+void UseBestAlignment(MSA &msa)
+	{
+	CheckpointAlignment(msa);
+	if (bRefineStopped && 0 != ptrCheckpointMSA)
+		msa.Copy(*ptrCheckpointMSA);
+	}
+
+// Best checkpoint, 0 if there is none.
+const MSA *GetBestAlignment(SCORE *ptrScore)
+	{
+	if (0 != ptrScore)
+		*ptrScore = scoreCheckpoint;
+	return ptrCheckpointMSA;
+	}
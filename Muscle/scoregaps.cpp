@@ -11,12 +11,12 @@ struct GAPINFO
 	unsigned End;
 	};
 
-static GAPINFO **g_Gaps;
-static GAPINFO *g_FreeList;
-static unsigned g_MaxSeqCount;
-static unsigned g_MaxColCount;
-static unsigned g_ColCount;
-static bool *g_ColDiff;
+#define g_Gaps			(GetDPWorkspace()->Gaps)
+#define g_FreeList		(GetDPWorkspace()->GapFreeList)
+#define g_MaxSeqCount	(GetDPWorkspace()->uGapMaxSeqCount)
+#define g_MaxColCount	(GetDPWorkspace()->uGapMaxColCount)
+#define g_ColCount		(GetDPWorkspace()->uGapColCount)
+#define g_ColDiff		(GetDPWorkspace()->GapColDiff)
 
 static GAPINFO *NewGapInfo()
 	{
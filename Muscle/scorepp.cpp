@@ -33,13 +33,11 @@ char ConsensusChar(const ProfPos &PP)
 SCORE ScoreProfPos2LA(const ProfPos &PPA, const ProfPos &PPB)
 	{
 	SCORE Score = 0;
-	for (unsigned n = 0; n < 20; ++n)
+	const unsigned uLetterCount = PPA.m_uLetterCount;
+	for (unsigned n = 0; n < uLetterCount; ++n)
 		{
-		const unsigned uLetter = PPA.m_uSortOrder[n];
-		const FCOUNT fcLetter = PPA.m_fcCounts[uLetter];
-		if (0 == fcLetter)
-			break;
-		Score += fcLetter*PPB.m_AAScores[uLetter];
+		const unsigned uLetter = PPA.m_uLetters[n];
+		Score += PPA.m_fcCounts[uLetter]*PPB.m_AAScores[uLetter];
 		}
 	if (0 == Score)
 		return -2.5;
@@ -50,13 +48,11 @@ SCORE ScoreProfPos2LA(const ProfPos &PPA, const ProfPos &PPB)
 SCORE ScoreProfPos2NS(const ProfPos &PPA, const ProfPos &PPB)
 	{
 	SCORE Score = 0;
-	for (unsigned n = 0; n < 20; ++n)
+	const unsigned uLetterCount = PPA.m_uLetterCount;
+	for (unsigned n = 0; n < uLetterCount; ++n)
 		{
-		const unsigned uLetter = PPA.m_uSortOrder[n];
-		const FCOUNT fcLetter = PPA.m_fcCounts[uLetter];
-		if (0 == fcLetter)
-			break;
-		Score += fcLetter*PPB.m_AAScores[uLetter];
+		const unsigned uLetter = PPA.m_uLetters[n];
+		Score += PPA.m_fcCounts[uLetter]*PPB.m_AAScores[uLetter];
 		}
 	return Score - g_scoreCenter;
 	}
@@ -64,13 +60,11 @@ SCORE ScoreProfPos2NS(const ProfPos &PPA, const ProfPos &PPB)
 SCORE ScoreProfPos2SP(const ProfPos &PPA, const ProfPos &PPB)
 	{
 	SCORE Score = 0;
-	for (unsigned n = 0; n < 20; ++n)
+	const unsigned uLetterCount = PPA.m_uLetterCount;
+	for (unsigned n = 0; n < uLetterCount; ++n)
 		{
-		const unsigned uLetter = PPA.m_uSortOrder[n];
-		const FCOUNT fcLetter = PPA.m_fcCounts[uLetter];
-		if (0 == fcLetter)
-			break;
-		Score += fcLetter*PPB.m_AAScores[uLetter];
+		const unsigned uLetter = PPA.m_uLetters[n];
+		Score += PPA.m_fcCounts[uLetter]*PPB.m_AAScores[uLetter];
 		}
 	return Score - g_scoreCenter;
 	}
@@ -78,13 +72,11 @@ SCORE ScoreProfPos2SP(const ProfPos &PPA, const ProfPos &PPB)
 SCORE ScoreProfPos2SPN(const ProfPos &PPA, const ProfPos &PPB)
 	{
 	SCORE Score = 0;
-	for (unsigned n = 0; n < 4; ++n)
+	const unsigned uLetterCount = PPA.m_uLetterCount;
+	for (unsigned n = 0; n < uLetterCount; ++n)
 		{
-		const unsigned uLetter = PPA.m_uSortOrder[n];
-		const FCOUNT fcLetter = PPA.m_fcCounts[uLetter];
-		if (0 == fcLetter)
-			break;
-		Score += fcLetter*PPB.m_AAScores[uLetter];
+		const unsigned uLetter = PPA.m_uLetters[n];
+		Score += PPA.m_fcCounts[uLetter]*PPB.m_AAScores[uLetter];
 		}
 	return Score - g_scoreCenter;
 	}
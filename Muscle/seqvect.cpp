@@ -2,6 +2,7 @@
 #include "seqvect.h"
 #include "textfile.h"
 #include "msa.h"
+#include "fastamap.h"
 
 const size_t MAX_FASTA_LINE = 16000;
 
@@ -30,6 +31,29 @@ void SeqVect::FromFASTAFile(TextFile &File)
 	{
 	Clear();
 
+	FastaMap Map;
+	if (Map.Open(File))
+		{
+		std::vector<char> Letters;
+		FASTA_RECORD Rec;
+		while (Map.GetRecord(Rec))
+			{
+			if (Letters.size() < Rec.uDataBytes)
+				Letters.resize(Rec.uDataBytes);
+			const unsigned uLength = FastaMap::GetLetters(Rec, &Letters[0], true);
+			if (0 == uLength)
+				continue;
+			Seq *ptrSeq = new Seq;
+			ptrSeq->assign(Letters.begin(), Letters.begin() + uLength);
+
+			char *Label = FastaMap::GetLabel(Rec);
+			ptrSeq->SetName(Label);
+			delete[] Label;
+			push_back(ptrSeq);
+			}
+		return;
+		}
+
 	FILE *f = File.GetStdioFile();
 	for (;;)
 		{
@@ -0,0 +1,29 @@
+#ifndef simd_h
+#define simd_h
+
+// SIMD_SSE4 and SIMD_AVX2 are 1 if the compiler can build SSE4.1 and
+// AVX2 kernels for this target. A kernel is marked TARGET_SSE4 or
+// TARGET_AVX2 so that only it is compiled for that instruction set,
+// the rest of the program needs no special flags. Kernels are called
+// only if CPUHasSSE41() or CPUHasAVX2() and not -nosimd.
+
+#if	defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_SSE4	1
+#define SIMD_AVX2	1
+#define TARGET_SSE4	__attribute__((target("sse4.1")))
+#define TARGET_AVX2	__attribute__((target("avx2")))
+#elif	defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define SIMD_SSE4	1
+#define SIMD_AVX2	(_MSC_VER >= 1700)
+#define TARGET_SSE4	/* empty */
+#define TARGET_AVX2	/* empty */
+#else
+#define SIMD_SSE4	0
+#define SIMD_AVX2	0
+#endif
+
+#if	SIMD_SSE4 || SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+#endif	// simd_h
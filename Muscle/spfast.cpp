@@ -1,5 +1,9 @@
 #include "muscle.h"
 #include "profile.h"
+#include "msa.h"
+#include "pwpath.h"
+#include "objscore.h"
+#include <algorithm>
 
 #define TRACE	0
 
@@ -24,7 +28,7 @@ static char *GapTypeToStr(int GapType)
 	return "?";
 	}
 
-static SCORE GapScoreMatrix[4][4];
+#define GapScoreMatrix	(GetDPWorkspace()->GapScoreMatrix)
 
 static void InitGapScoreMatrix()
 	{
@@ -188,7 +192,11 @@ static SCORE SPFreqs(const FCOUNT Freqs[])
 	return TotalOffDiag*2 + TotalDiag;
 	}
 
-static SCORE ObjScoreSPCol(const MSA &msa, unsigned uColIndex)
+// Score of a column times 2. Rows and Weights give the sequences in
+// the order their counts are summed, which may change the result in
+// the last bits.
+static SCORE ObjScoreSPCol(const char *const Rows[], const WEIGHT Weights[],
+  unsigned uSeqCount, unsigned uColIndex)
 	{
 	FCOUNT Freqs[20];
 	FCOUNT GapFreqs[4];
@@ -196,21 +204,21 @@ static SCORE ObjScoreSPCol(const MSA &msa, unsigned uColIndex)
 	memset(Freqs, 0, sizeof(Freqs));
 	memset(GapFreqs, 0, sizeof(GapFreqs));
 
-	const unsigned uSeqCount = msa.GetSeqCount();
 #if	TRACE
 	Log("Weights=");
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
-		Log(" %u=%.3g", uSeqIndex, msa.GetSeqWeight(uSeqIndex));
+		Log(" %u=%.3g", uSeqIndex, Weights[uSeqIndex]);
 	Log("\n");
 #endif
 	SCORE SelfOverCount = 0;
 	SCORE GapSelfOverCount = 0;
 	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
 		{
-		WEIGHT w = msa.GetSeqWeight(uSeqIndex);
+		WEIGHT w = Weights[uSeqIndex];
+		const char *Row = Rows[uSeqIndex];
 
-		bool bGapThisCol = msa.IsGap(uSeqIndex, uColIndex);
-		bool bGapPrevCol = (uColIndex == 0 ? false : msa.IsGap(uSeqIndex, uColIndex - 1));
+		bool bGapThisCol = IsGapChar(Row[uColIndex]);
+		bool bGapPrevCol = (uColIndex == 0 ? false : IsGapChar(Row[uColIndex - 1]));
 		int GapType = bGapThisCol + 2*bGapPrevCol;
 		assert(GapType >= 0 && GapType < 4);
 		GapFreqs[GapType] += w;
@@ -219,7 +227,7 @@ static SCORE ObjScoreSPCol(const MSA &msa, unsigned uColIndex)
 
 		if (bGapThisCol)
 			continue;
-		unsigned uLetter = msa.GetLetterEx(uSeqIndex, uColIndex);
+		unsigned uLetter = CharToLetterEx(Row[uColIndex]);
 		if (uLetter >= 20)
 			continue;
 		Freqs[uLetter] += w;
@@ -242,18 +250,30 @@ static SCORE ObjScoreSPCol(const MSA &msa, unsigned uColIndex)
 	return Col + ColGaps;
 	}
 
-SCORE ObjScoreSPDimer(const MSA &msa)
+static void InitGapScoreMatrixOnce()
 	{
-	static bool bGapScoreMatrixInit = false;
+	bool &bGapScoreMatrixInit = GetDPWorkspace()->bGapScoreMatrixInit;
 	if (!bGapScoreMatrixInit)
 		InitGapScoreMatrix();
+	}
+
+SCORE ObjScoreSPDimer(const MSA &msa)
+	{
+	InitGapScoreMatrixOnce();
 
 	SCORE Total = 0;
 	const unsigned uSeqCount = msa.GetSeqCount();
 	const unsigned uColCount = msa.GetColCount();
+	const char **Rows = new const char *[uSeqCount];
+	WEIGHT *Weights = new WEIGHT[uSeqCount];
+	for (unsigned uSeqIndex = 0; uSeqIndex < uSeqCount; ++uSeqIndex)
+		{
+		Rows[uSeqIndex] = msa.GetSeqBuffer(uSeqIndex);
+		Weights[uSeqIndex] = msa.GetSeqWeight(uSeqIndex);
+		}
 	for (unsigned uColIndex = 0; uColIndex < uColCount; ++uColIndex)
 		{
-		SCORE Col = ObjScoreSPCol(msa, uColIndex);
+		SCORE Col = ObjScoreSPCol(Rows, Weights, uSeqCount, uColIndex);
 #if	TRACE
 		{
 		SCORE ColCheck = SPColBrute(msa, uColIndex);
@@ -262,8 +282,199 @@ SCORE ObjScoreSPDimer(const MSA &msa)
 #endif
 		Total += Col;
 		}
+	delete[] Rows;
+	delete[] Weights;
 #if TRACE
 	Log("Total/2 = %.3g (final result from fast)\n", Total/2);
 #endif
 	return Total/2;
 	}
+
+SPColScores::SPColScores()
+	{
+	m_uSeqCount = 0;
+	m_Ids = 0;
+	m_Weights = 0;
+	m_Rows = 0;
+	m_uColCount = 0;
+	m_uMaxColCount = 0;
+	m_ColScores = 0;
+	m_Total = 0;
+	m_uNewColCount = 0;
+	m_uNewMaxColCount = 0;
+	m_NewColScores = 0;
+	m_NewToOld = 0;
+	m_uNewToOldSize = 0;
+	m_NewTotal = 0;
+	}
+
+SPColScores::~SPColScores()
+	{
+	delete[] m_Ids;
+	delete[] m_Weights;
+	delete[] m_Rows;
+	delete[] m_ColScores;
+	delete[] m_NewColScores;
+	delete[] m_NewToOld;
+	}
+
+bool SPColScores::CanUse(const MSA &msa)
+	{
+#if	DOUBLE_AFFINE
+	return false;
+#else
+	if (SEQWEIGHT_ClustalW != GetSeqWeightMethod())
+		return false;
+
+	OBJSCORE OS = g_ObjScore;
+	if (OBJSCORE_SPM == OS)
+		OS = (msa.GetSeqCount() <= 100) ? OBJSCORE_XP : OBJSCORE_SPF;
+	return OBJSCORE_SPF == OS;
+#endif
+	}
+
+void SPColScores::SetRows(const MSA &msa)
+	{
+	if (msa.GetSeqCount() != m_uSeqCount)
+		Quit("SPColScores::SetRows, %u seqs, expected %u",
+		  msa.GetSeqCount(), m_uSeqCount);
+	for (unsigned i = 0; i < m_uSeqCount; ++i)
+		m_Rows[i] = msa.GetSeqBuffer(msa.GetSeqIndex(m_Ids[i]));
+	}
+
+void SPColScores::FromMSA(const MSA &msa)
+	{
+	InitGapScoreMatrixOnce();
+
+	delete[] m_Ids;
+	delete[] m_Weights;
+	delete[] m_Rows;
+
+	m_uSeqCount = msa.GetSeqCount();
+	m_Ids = new unsigned[m_uSeqCount];
+	m_Weights = new WEIGHT[m_uSeqCount];
+	m_Rows = new const char *[m_uSeqCount];
+	for (unsigned uSeqIndex = 0; uSeqIndex < m_uSeqCount; ++uSeqIndex)
+		m_Ids[uSeqIndex] = msa.GetSeqId(uSeqIndex);
+	std::sort(m_Ids, m_Ids + m_uSeqCount);
+
+// As SetClustalWWeightsMuscle, in id order.
+	WEIGHT wTotal = 0;
+	for (unsigned i = 0; i < m_uSeqCount; ++i)
+		{
+		m_Weights[i] = GetMuscleSeqWeightById(m_Ids[i]);
+		wTotal += m_Weights[i];
+		}
+	if (0 != wTotal)
+		{
+		const WEIGHT f = (WEIGHT) 1.0/wTotal;
+		for (unsigned i = 0; i < m_uSeqCount; ++i)
+			m_Weights[i] *= f;
+		}
+
+	m_uColCount = msa.GetColCount();
+	if (m_uColCount > m_uMaxColCount)
+		{
+		delete[] m_ColScores;
+		m_uMaxColCount = m_uColCount;
+		m_ColScores = new SCORE[m_uMaxColCount];
+		}
+
+	SetRows(msa);
+	m_Total = 0;
+	for (unsigned uColIndex = 0; uColIndex < m_uColCount; ++uColIndex)
+		{
+		m_ColScores[uColIndex] = ObjScoreSPCol(m_Rows, m_Weights, m_uSeqCount, uColIndex);
+		m_Total += m_ColScores[uColIndex];
+		}
+	}
+
+SCORE SPColScores::ScoreRealigned(const MSA &msaNew, const PWPath &PathBefore,
+  const unsigned Edges1[], unsigned uDiffCount1, const PWPath &PathAfter,
+  const unsigned Edges2[], unsigned uDiffCount2)
+	{
+// The gap matrix is in the workspace, which may belong to another
+// thread than the one that called FromMSA.
+	InitGapScoreMatrixOnce();
+
+	m_uNewColCount = msaNew.GetColCount();
+	if (m_uNewColCount > m_uNewMaxColCount)
+		{
+		delete[] m_NewColScores;
+		m_uNewMaxColCount = m_uNewColCount;
+		m_NewColScores = new SCORE[m_uNewMaxColCount];
+		}
+	if (m_uNewColCount > m_uNewToOldSize)
+		{
+		delete[] m_NewToOld;
+		m_uNewToOldSize = m_uNewColCount;
+		m_NewToOld = new unsigned[m_uNewToOldSize];
+		}
+
+// Edges are columns unless the old MSA has columns that are all gaps.
+	const bool bIncremental = (PathBefore.GetEdgeCount() == m_uColCount &&
+	  PathAfter.GetEdgeCount() == m_uNewColCount);
+	if (bIncremental)
+		{
+	// Edges that are not in the diffs are the same in both paths and in
+	// the same order.
+		unsigned uDiffIndex1 = 0;
+		unsigned uDiffIndex2 = 0;
+		unsigned uOldColIndex = 0;
+		for (unsigned uColIndex = 0; uColIndex < m_uNewColCount; ++uColIndex)
+			{
+			if (uDiffIndex2 < uDiffCount2 && Edges2[uDiffIndex2] == uColIndex)
+				{
+				m_NewToOld[uColIndex] = uInsane;
+				++uDiffIndex2;
+				continue;
+				}
+			while (uDiffIndex1 < uDiffCount1 && Edges1[uDiffIndex1] == uOldColIndex)
+				{
+				++uDiffIndex1;
+				++uOldColIndex;
+				}
+			assert(uOldColIndex < m_uColCount);
+			m_NewToOld[uColIndex] = uOldColIndex++;
+			}
+		}
+
+	SetRows(msaNew);
+	m_NewTotal = 0;
+	for (unsigned uColIndex = 0; uColIndex < m_uNewColCount; ++uColIndex)
+		{
+	// A column's score depends on the column before it.
+		bool bSame = false;
+		if (bIncremental)
+			{
+			const unsigned uOldColIndex = m_NewToOld[uColIndex];
+			if (0 == uColIndex)
+				bSame = (0 == uOldColIndex);
+			else
+				bSame = (uInsane != uOldColIndex &&
+				  uInsane != m_NewToOld[uColIndex - 1] &&
+				  m_NewToOld[uColIndex - 1] + 1 == uOldColIndex);
+			}
+		if (bSame)
+			m_NewColScores[uColIndex] = m_ColScores[m_NewToOld[uColIndex]];
+		else
+			m_NewColScores[uColIndex] =
+			  ObjScoreSPCol(m_Rows, m_Weights, m_uSeqCount, uColIndex);
+		m_NewTotal += m_NewColScores[uColIndex];
+		}
+	return m_NewTotal/2;
+	}
+
+void SPColScores::Accept()
+	{
+	SCORE *Tmp = m_ColScores;
+	m_ColScores = m_NewColScores;
+	m_NewColScores = Tmp;
+
+	unsigned uTmp = m_uMaxColCount;
+	m_uMaxColCount = m_uNewMaxColCount;
+	m_uNewMaxColCount = uTmp;
+
+	m_uColCount = m_uNewColCount;
+	m_Total = m_NewTotal;
+	}
@@ -4,8 +4,8 @@
 const float INFINITY = float(1e29);
 const unsigned NILL = uInsane;
 
-static float *ShortestPathEstimate;
-static unsigned *Predecessor;
+#define ShortestPathEstimate	(GetMuscleContext()->ShortestPathEstimate)
+#define Predecessor				(GetMuscleContext()->Predecessor)
 
 static void GetMostDistantPair(DistFunc &DF, unsigned *ptrIndex1, unsigned *ptrIndex2)
 	{
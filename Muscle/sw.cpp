@@ -4,10 +4,11 @@
 #include "profile.h"
 #include <stdio.h>
 
-// Textbook Smith-Waterman affine gap implementation.
+// Smith-Waterman affine gap implementation.
 
 #define	TRACE	0
 
+#if	TRACE
 static const char *LocalScoreToStr(SCORE s)
 	{
 	static char str[16];
@@ -16,191 +17,112 @@ static const char *LocalScoreToStr(SCORE s)
 	sprintf(str, "%6.2f", s);
 	return str;
 	}
+#endif
 
-static void ListDP(const SCORE *DPM_, const ProfPos *PA, const ProfPos *PB,
-  unsigned uPrefixCountA, unsigned uPrefixCountB)
-	{
-	Log("        ");
-	for (unsigned uPrefixLengthB = 0; uPrefixLengthB < uPrefixCountB; ++uPrefixLengthB)
-		{
-		char c = ' ';
-		if (uPrefixLengthB > 0)
-			c = ConsensusChar(PB[uPrefixLengthB - 1]);
-		Log(" %4u:%c", uPrefixLengthB, c);
-		}
-	Log("\n");
-	for (unsigned uPrefixLengthA = 0; uPrefixLengthA < uPrefixCountA; ++uPrefixLengthA)
-		{
-		char c = ' ';
-		if (uPrefixLengthA > 0)
-			c = ConsensusChar(PA[uPrefixLengthA - 1]);
-		Log("%4u:%c  ", uPrefixLengthA, c);
-		for (unsigned uPrefixLengthB = 0; uPrefixLengthB < uPrefixCountB; ++uPrefixLengthB)
-			Log(" %s", LocalScoreToStr(DPM(uPrefixLengthA, uPrefixLengthB)));
-		Log("\n");
-		}
-	}
-
+/***
+Textbook recursion, with no gap extension:
+
+	M(i, j) = max(0, M(i-1, j-1), D(i-1, j-1) + PA[i-2].close,
+	  I(i-1, j-1) + PB[j-2].close) + ScoreProfPos2(PA[i-1], PB[j-1])
+	D(i, j) = max(M(i-1, j) + PA[i-1].open, D(i-1, j))
+	I(i, j) = max(M(i, j-1) + PB[j-1].open, I(i, j-1))
+
+The cells are computed by StripedSW (swstriped.cpp), first in linear
+space to find the best cell and the start of its path. The best path
+starts with a fresh M at (uStartA, uStartB) and ends at (uEndA, uEndB).
+Within the sub-profiles spanned by these cells the path gets the same
+score, and no cell can score more than in the whole matrix, so the
+sub-profiles have the same best score and end cell. Only they are
+run again, keeping one byte of trace-back bits per cell instead of
+the three score matrices of TraceBackSW. The trace-back ties are
+broken with the same 0.1 tolerance, but on the rectangle's scores,
+so the path is not always the one the full matrices gave.
+***/
 SCORE SW(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
   unsigned uLengthB, PWPath &Path)
 	{
 	assert(uLengthB > 0 && uLengthA > 0);
 
-	const unsigned uPrefixCountA = uLengthA + 1;
-	const unsigned uPrefixCountB = uLengthB + 1;
-
-// Allocate DP matrices
-	const size_t LM = uPrefixCountA*uPrefixCountB;
-	SCORE *DPM_ = new SCORE[LM];
-	SCORE *DPD_ = new SCORE[LM];
-	SCORE *DPI_ = new SCORE[LM];
-
-	DPM(0, 0) = 0;
-	DPD(0, 0) = MINUS_INFINITY;
-	DPI(0, 0) = MINUS_INFINITY;
-
-	DPM(1, 0) = MINUS_INFINITY;
-	DPD(1, 0) = MINUS_INFINITY;
-	DPI(1, 0) = MINUS_INFINITY;
-
-	DPM(0, 1) = MINUS_INFINITY;
-	DPD(0, 1) = MINUS_INFINITY;
-	DPI(0, 1) = MINUS_INFINITY;
-
-// Empty prefix of B is special case
-	for (unsigned uPrefixLengthA = 2; uPrefixLengthA < uPrefixCountA; ++uPrefixLengthA)
-		{
-	// M=LetterA+LetterB, impossible with empty prefix
-		DPM(uPrefixLengthA, 0) = MINUS_INFINITY;
-
-	// D=LetterA+GapB, never optimal in local alignment with gap penalties
-		DPD(uPrefixLengthA, 0) = MINUS_INFINITY;
-
-	// I=GapA+LetterB, impossible with empty prefix
-		DPI(uPrefixLengthA, 0) = MINUS_INFINITY;
-		}
-
-// Empty prefix of A is special case
-	for (unsigned uPrefixLengthB = 2; uPrefixLengthB < uPrefixCountB; ++uPrefixLengthB)
+	unsigned uStartA;
+	unsigned uStartB;
+	unsigned uEndA;
+	unsigned uEndB;
+	const SCORE scoreMax = StripedSW(PA, uLengthA, PB, uLengthB, &uStartA,
+	  &uStartB, &uEndA, &uEndB);
+
+	const unsigned uOffsetA = uStartA - 1;
+	const unsigned uOffsetB = uStartB - 1;
+	const unsigned uSubLengthA = uEndA - uOffsetA;
+	const unsigned uSubLengthB = uEndB - uOffsetB;
+	const unsigned uPrefixCountA = uSubLengthA + 1;
+	const unsigned uPrefixCountB = uSubLengthB + 1;
+
+	char *TB = new char[(size_t) uPrefixCountA*uPrefixCountB];
+	unsigned uSubStartA;
+	unsigned uSubStartB;
+	unsigned uSubEndA;
+	unsigned uSubEndB;
+	const SCORE scoreSub = StripedSW(PA + uOffsetA, uSubLengthA, PB + uOffsetB,
+	  uSubLengthB, &uSubStartA, &uSubStartB, &uSubEndA, &uSubEndB, TB);
+	if (scoreSub != scoreMax || uSubEndA != uSubLengthA || uSubEndB != uSubLengthB)
+		Quit("Internal error, SW: score %g in %u..%u x %u..%u, %g in full matrix",
+		  scoreSub, uStartA, uEndA, uStartB, uEndB, scoreMax);
+
+// Trace back from the end cell, collecting the edges in reverse.
+	PWEdge *Edges = new PWEdge[uSubLengthA + uSubLengthB];
+	unsigned uEdgeCount = 0;
+	unsigned i = uSubLengthA;
+	unsigned j = uSubLengthB;
+	char c = 'M';
+	for (;;)
 		{
-	// M=LetterA+LetterB, impossible with empty prefix
-		DPM(0, uPrefixLengthB) = MINUS_INFINITY;
+		if (0 == i || 0 == j)
+			Quit("SW: trace-back at %u,%u", i, j);
 
-	// D=LetterA+GapB, impossible with empty prefix
-		DPD(0, uPrefixLengthB) = MINUS_INFINITY;
-
-	// I=GapA+LetterB, never optimal in local alignment with gap penalties
-		DPI(0, uPrefixLengthB) = MINUS_INFINITY;
-		}
-
-	SCORE scoreMax = MINUS_INFINITY;
-	unsigned uPrefixLengthAMax = uInsane;
-	unsigned uPrefixLengthBMax = uInsane;
-
-// ============
-// Main DP loop
-// ============
-	SCORE scoreGapCloseB = MINUS_INFINITY;
-	for (unsigned uPrefixLengthB = 1; uPrefixLengthB < uPrefixCountB; ++uPrefixLengthB)
-		{
-		const ProfPos &PPB = PB[uPrefixLengthB - 1];
-
-		SCORE scoreGapCloseA = MINUS_INFINITY;
-		for (unsigned uPrefixLengthA = 1; uPrefixLengthA < uPrefixCountA; ++uPrefixLengthA)
-			{
-			const ProfPos &PPA = PA[uPrefixLengthA - 1];
+		PWEdge &Edge = Edges[uEdgeCount++];
+		Edge.cType = c;
+		Edge.uPrefixLengthA = uOffsetA + i;
+		Edge.uPrefixLengthB = uOffsetB + j;
 
+		const char Bits = TB[(size_t) j*uPrefixCountA + i];
+		if ('M' == c)
 			{
-		// Match M=LetterA+LetterB
-			SCORE scoreLL = ScoreProfPos2(PPA, PPB);
-
-			SCORE scoreMM = DPM(uPrefixLengthA-1, uPrefixLengthB-1);
-			SCORE scoreDM = DPD(uPrefixLengthA-1, uPrefixLengthB-1) + scoreGapCloseA;
-			SCORE scoreIM = DPI(uPrefixLengthA-1, uPrefixLengthB-1) + scoreGapCloseB;
-
-			SCORE scoreBest;
-			if (scoreMM >= scoreDM && scoreMM >= scoreIM)
-				scoreBest = scoreMM;
-			else if (scoreDM >= scoreMM && scoreDM >= scoreIM)
-				scoreBest = scoreDM;
-			else 
-				{
-				assert(scoreIM >= scoreMM && scoreIM >= scoreDM);
-				scoreBest = scoreIM;
-				}
-			if (scoreBest < 0)
-				scoreBest = 0;
-			scoreBest += scoreLL;
-			if (scoreBest > scoreMax)
-				{
-				scoreMax = scoreBest;
-				uPrefixLengthAMax = uPrefixLengthA;
-				uPrefixLengthBMax = uPrefixLengthB;
-				}
-			DPM(uPrefixLengthA, uPrefixLengthB) = scoreBest;
-			}
-
-			{
-		// Delete D=LetterA+GapB
-			SCORE scoreMD = DPM(uPrefixLengthA-1, uPrefixLengthB) +
-			  PA[uPrefixLengthA-1].m_scoreGapOpen;
-			SCORE scoreDD = DPD(uPrefixLengthA-1, uPrefixLengthB);
-
-			SCORE scoreBest;
-			if (scoreMD >= scoreDD)
-				scoreBest = scoreMD;
+			const char BitsM = Bits & BIT_xM;
+			if (BIT_SM == BitsM)
+				break;
+			if (BIT_MM == BitsM)
+				c = 'M';
+			else if (BIT_DM == BitsM)
+				c = 'D';
 			else
-				{
-				assert(scoreDD >= scoreMD);
-				scoreBest = scoreDD;
-				}
-			DPD(uPrefixLengthA, uPrefixLengthB) = scoreBest;
+				c = 'I';
+			--i;
+			--j;
 			}
-
-		// Insert I=GapA+LetterB
+		else if ('D' == c)
 			{
-			SCORE scoreMI = DPM(uPrefixLengthA, uPrefixLengthB-1) +
-			  PB[uPrefixLengthB - 1].m_scoreGapOpen;
-			SCORE scoreII = DPI(uPrefixLengthA, uPrefixLengthB-1);
-
-			SCORE scoreBest;
-			if (scoreMI >= scoreII)
-				scoreBest = scoreMI;
-			else 
-				{
-				assert(scoreII > scoreMI);
-				scoreBest = scoreII;
-				}
-			DPI(uPrefixLengthA, uPrefixLengthB) = scoreBest;
+			c = ((Bits & BIT_xD) == BIT_MD) ? 'M' : 'D';
+			--i;
 			}
-
-			scoreGapCloseA = PPA.m_scoreGapClose;
+		else
+			{
+			c = ((Bits & BIT_xI) == BIT_MI) ? 'M' : 'I';
+			--j;
 			}
-		scoreGapCloseB = PPB.m_scoreGapClose;
 		}
 
-#if TRACE
-	Log("DPM:\n");
-	ListDP(DPM_, PA, PB, uPrefixLengthA, uPrefixLengthB);
-	Log("DPD:\n");
-	ListDP(DPD_, PA, PB, uPrefixLengthA, uPrefixLengthB);
-	Log("DPI:\n");
-	ListDP(DPI_, PA, PB, uPrefixLengthA, uPrefixLengthB);
-#endif
+	Path.Clear();
+	for (unsigned n = uEdgeCount; n > 0; --n)
+		Path.AppendEdge(Edges[n-1]);
 
-	assert(scoreMax == DPM(uPrefixLengthAMax, uPrefixLengthBMax));
-	TraceBackSW(PA, uLengthA, PB, uLengthB, DPM_, DPD_, DPI_, 
-	  uPrefixLengthAMax, uPrefixLengthBMax, Path);
+	delete[] TB;
+	delete[] Edges;
 
 #if	TRACE
 	SCORE scorePath = FastScorePath2(PA, uLengthA, PB, uLengthB, Path);
 	Path.LogMe();
-	Log("Score = %s Path = %s\n", LocalScoreToStr(scoreMax), LocalScoreToStr(scorePath));
+	Log("Score = %s Path = %s, %u..%u x %u..%u\n", LocalScoreToStr(scoreMax),
+	  LocalScoreToStr(scorePath), uStartA, uEndA, uStartB, uEndB);
 #endif
-
-	delete[] DPM_;
-	delete[] DPD_;
-	delete[] DPI_;
-
 	return scoreMax;
 	}
@@ -0,0 +1,982 @@
+#include "muscle.h"
+#include "profile.h"
+#include "simd.h"
+#include <math.h>
+
+// Cells of SW in linear space: the best local alignment score, its
+// end cell and the cell where it starts, and optionally the trace-back
+// bits of every cell.
+
+#define	TRACE	0
+
+#define EQ(a, b)	(fabs(a-b) < 0.1)
+
+/***
+Striped Smith-Waterman (Farrar, Bioinformatics 23:156, 2007) for the
+recursion of SW in sw.cpp.
+
+Rows are prefixes j of B, as in the textbook loop, and A is striped
+across W lanes (W = 4 with SSE4.1, 8 with AVX2, 1 for the scalar
+code). With S = ceil(LA/W) segments, item s*W + k of a striped vector
+is position a = k*S + s of A, i.e. prefix length i = a + 1. Lane k of
+segment s - 1 is therefore the neighbour above lane k of segment s,
+and the neighbour above segment 0 is the last segment shifted up one
+lane. Items beyond LA have match score MINUS_INFINITY and are never
+the best cell.
+
+M and I of row j only need row j - 1, so they are computed for all
+segments at once. D is a running max down the row: it is first run
+within each lane, then the lane carries are propagated by the "lazy
+F" loop, which stops as soon as no lane is improved, at most W - 1
+times.
+
+Each cell is computed by the same float adds and compares as the
+textbook loop, so every M, D and I is bit-identical to it, and the
+best cell is the first maximum in the same order.
+
+Along with the scores, each cell carries the start of the path that
+reaches it: the cell (i, j) where its M was last reset to zero,
+packed as j*(LA + 1) + i. The caller then only needs to trace back
+in the rectangle from the start to the end cell.
+
+If TB is given, the trace-back bits of cell (i, j), i, j > 0, are
+stored in TB[j*(LA + 1) + i], as SINGLE_AFFINE bits (types.h), with
+BIT_SM where M starts the alignment. The edges are chosen as by
+TraceBackSW, the first one whose score is within 0.1 of the cell's.
+The caller runs this on the start..end rectangle only, where cells
+near its edges can score less than in the full matrix, so where two
+edges tie within 0.1 the path can differ from TraceBackSW's. The
+score and end cell are the same.
+***/
+
+// Match scores are computed by ProfPairScores for this many rows at
+// a time, then transposed to striped order.
+static const unsigned SW_SLAB_ROWS = 32;
+
+static const size_t SW_ALIGN = 64;
+
+struct SW_ROW
+	{
+	unsigned uSegCount;
+	unsigned uOriginBase;	// j*(LA + 1)
+	SCORE scoreGapOpenB;	// PB[j-1].m_scoreGapOpen
+	SCORE scoreGapCloseB;	// PB[j-2].m_scoreGapClose, MINUS_INFINITY if j = 1
+	const SCORE *Scores;	// Match scores of row j
+	const SCORE *GapOpenA;	// PA[a+1].m_scoreGapOpen, for D of a + 1
+	const SCORE *GapCloseA;	// PA[a-1].m_scoreGapClose, MINUS_INFINITY if a = 0
+	const unsigned *Rows;	// a + 1
+	SCORE *MPrev;
+	SCORE *DPrev;
+	SCORE *IPrev;
+	unsigned *OMPrev;
+	unsigned *ODPrev;
+	unsigned *OIPrev;
+	SCORE *MCurr;
+	SCORE *DCurr;
+	SCORE *ICurr;
+	unsigned *OMCurr;
+	unsigned *ODCurr;
+	unsigned *OICurr;
+	unsigned *TBRow;		// Trace-back bits, or 0
+	};
+
+// Best cell so far, and the start of its path packed as in the rows.
+struct SW_BEST
+	{
+	SCORE scoreMax;
+	unsigned uEndA;
+	unsigned uEndB;
+	unsigned uOrigin;
+	};
+
+// Returns the largest M of the row and sets *ptruPos to the first
+// position a where it occurs.
+typedef SCORE (*SW_ROW_FN)(const SW_ROW &R, unsigned *ptruPos);
+
+#if	defined(_MANAGED)
+#pragma managed(push, off)
+#endif
+
+static SCORE SWRowScalar(const SW_ROW &R, unsigned *ptruPos)
+	{
+	const unsigned uLength = R.uSegCount;
+	SCORE MDiag = MINUS_INFINITY;
+	SCORE IDiag = MINUS_INFINITY;
+	SCORE DDiag = MINUS_INFINITY;
+	unsigned uOMDiag = 0;
+	unsigned uOIDiag = 0;
+	unsigned uODDiag = 0;
+	SCORE D = MINUS_INFINITY;
+	unsigned uOD = 0;
+	SCORE scoreMDPrev = MINUS_INFINITY;
+	SCORE scoreMax = MINUS_INFINITY;
+	unsigned uPosMax = 0;
+	for (unsigned a = 0; a < uLength; ++a)
+		{
+		const SCORE scoreDM = DDiag + R.GapCloseA[a];
+		const SCORE scoreIM = IDiag + R.scoreGapCloseB;
+		SCORE scoreBest = MDiag;
+		unsigned uOrigin = uOMDiag;
+		if (scoreDM > scoreBest)
+			{
+			scoreBest = scoreDM;
+			uOrigin = uODDiag;
+			}
+		if (scoreIM > scoreBest)
+			{
+			scoreBest = scoreIM;
+			uOrigin = uOIDiag;
+			}
+		if (scoreBest < 0)
+			{
+			scoreBest = 0;
+			uOrigin = R.uOriginBase + R.Rows[a];
+			}
+		const SCORE M = scoreBest + R.Scores[a];
+
+		const SCORE scoreMI = R.MPrev[a] + R.scoreGapOpenB;
+		const SCORE scoreII = R.IPrev[a];
+		if (scoreII > scoreMI)
+			{
+			R.ICurr[a] = scoreII;
+			R.OICurr[a] = R.OIPrev[a];
+			}
+		else
+			{
+			R.ICurr[a] = scoreMI;
+			R.OICurr[a] = R.OMPrev[a];
+			}
+
+		if (0 != R.TBRow)
+			{
+			const SCORE scoreMatch = R.Scores[a];
+			const SCORE scoreMM = MDiag + scoreMatch;
+			const SCORE scoreDMMatch = scoreDM + scoreMatch;
+			const SCORE scoreIMMatch = scoreIM + scoreMatch;
+			unsigned uBits;
+			if (EQ(scoreMM, M))
+				uBits = BIT_MM;
+			else if (EQ(scoreDMMatch, M))
+				uBits = BIT_DM;
+			else if (EQ(scoreIMMatch, M))
+				uBits = BIT_IM;
+			else
+				uBits = BIT_SM;
+			if (EQ(D, scoreMDPrev))
+				uBits |= BIT_MD;
+			if (EQ(R.ICurr[a], scoreMI))
+				uBits |= BIT_MI;
+			R.TBRow[a] = uBits;
+			}
+
+		MDiag = R.MPrev[a];
+		IDiag = R.IPrev[a];
+		DDiag = R.DPrev[a];
+		uOMDiag = R.OMPrev[a];
+		uOIDiag = R.OIPrev[a];
+		uODDiag = R.ODPrev[a];
+
+		R.MCurr[a] = M;
+		R.OMCurr[a] = uOrigin;
+		R.DCurr[a] = D;
+		R.ODCurr[a] = uOD;
+
+		const SCORE scoreMD = M + R.GapOpenA[a];
+		if (scoreMD >= D)
+			{
+			D = scoreMD;
+			uOD = uOrigin;
+			}
+		scoreMDPrev = scoreMD;
+		if (M > scoreMax)
+			{
+			scoreMax = M;
+			uPosMax = a;
+			}
+		}
+	*ptruPos = uPosMax;
+	return scoreMax;
+	}
+
+#if	SIMD_SSE4
+
+// Lane k = lane k - 1, lane 0 = Fill.
+TARGET_SSE4 static inline __m128 ShiftSSE4(__m128 v, __m128 vFill)
+	{
+	const __m128 vShifted = _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4));
+	return _mm_blend_ps(vShifted, vFill, 1);
+	}
+
+TARGET_SSE4 static inline __m128 ShiftSSE4(__m128 v)
+	{
+	return _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4));
+	}
+
+// Origins are kept in float registers as raw bits, so they can be
+// selected by the same masks as the scores.
+#define LD4(p)		_mm_load_ps((const float *) (p))
+#define ST4(p, v)	_mm_store_ps((float *) (p), (v))
+#define SEL4(a, b, m)	_mm_blendv_ps((a), (b), (m))
+
+// As EQ: |a - b| < 0.1, which for floats is the same as < 0.1f.
+#define EQ4(a, b)	_mm_cmplt_ps(_mm_andnot_ps(vSignMask, _mm_sub_ps((a), (b))), vEQ)
+
+TARGET_SSE4 static SCORE SWRowSSE4(const SW_ROW &R, unsigned *ptruPos)
+	{
+	const unsigned W = 4;
+	const unsigned uSegCount = R.uSegCount;
+	const __m128 vMinusInf = _mm_set1_ps(MINUS_INFINITY);
+	const __m128 vZero = _mm_setzero_ps();
+	const __m128 vOpenB = _mm_set1_ps(R.scoreGapOpenB);
+	const __m128 vSignMask = _mm_set1_ps(-0.0f);
+	const __m128 vEQ = _mm_set1_ps(0.1f);
+	const __m128 vBitMM = _mm_castsi128_ps(_mm_set1_epi32(BIT_MM));
+	const __m128 vBitDM = _mm_castsi128_ps(_mm_set1_epi32(BIT_DM));
+	const __m128 vBitIM = _mm_castsi128_ps(_mm_set1_epi32(BIT_IM));
+	const __m128 vBitSM = _mm_castsi128_ps(_mm_set1_epi32(BIT_SM));
+	const __m128 vBitMD = _mm_castsi128_ps(_mm_set1_epi32(BIT_MD));
+	const __m128 vBitMI = _mm_castsi128_ps(_mm_set1_epi32(BIT_MI));
+	const __m128 vCloseB = _mm_set1_ps(R.scoreGapCloseB);
+	const __m128i vBase = _mm_set1_epi32((int) R.uOriginBase);
+	const size_t uLast = (size_t) (uSegCount - 1)*W;
+
+	__m128 vMDiag = ShiftSSE4(LD4(R.MPrev + uLast), vMinusInf);
+	__m128 vIDiag = ShiftSSE4(LD4(R.IPrev + uLast), vMinusInf);
+	__m128 vDDiag = ShiftSSE4(LD4(R.DPrev + uLast), vMinusInf);
+	__m128 vOMDiag = ShiftSSE4(LD4(R.OMPrev + uLast));
+	__m128 vOIDiag = ShiftSSE4(LD4(R.OIPrev + uLast));
+	__m128 vODDiag = ShiftSSE4(LD4(R.ODPrev + uLast));
+
+	__m128 vD = vMinusInf;
+	__m128 vOD = vZero;
+	__m128 vMax = vMinusInf;
+	__m128i vSegMax = _mm_setzero_si128();
+
+	for (unsigned s = 0; s < uSegCount; ++s)
+		{
+		const size_t n = (size_t) s*W;
+
+		const __m128 vDM = _mm_add_ps(vDDiag, LD4(R.GapCloseA + n));
+		const __m128 vIM = _mm_add_ps(vIDiag, vCloseB);
+		__m128 vBest = vMDiag;
+		__m128 vOrigin = vOMDiag;
+		__m128 vMask = _mm_cmpgt_ps(vDM, vBest);
+		vBest = SEL4(vBest, vDM, vMask);
+		vOrigin = SEL4(vOrigin, vODDiag, vMask);
+		vMask = _mm_cmpgt_ps(vIM, vBest);
+		vBest = SEL4(vBest, vIM, vMask);
+		vOrigin = SEL4(vOrigin, vOIDiag, vMask);
+		vMask = _mm_cmplt_ps(vBest, vZero);
+		vBest = SEL4(vBest, vZero, vMask);
+		const __m128 vFresh = _mm_castsi128_ps(_mm_add_epi32(vBase,
+		  _mm_load_si128((const __m128i *) (R.Rows + n))));
+		vOrigin = SEL4(vOrigin, vFresh, vMask);
+		const __m128 vM = _mm_add_ps(vBest, LD4(R.Scores + n));
+
+		const __m128 vUpM = LD4(R.MPrev + n);
+		const __m128 vUpI = LD4(R.IPrev + n);
+		const __m128 vUpOM = LD4(R.OMPrev + n);
+		const __m128 vUpOI = LD4(R.OIPrev + n);
+		const __m128 vMI = _mm_add_ps(vUpM, vOpenB);
+		vMask = _mm_cmpgt_ps(vUpI, vMI);
+		const __m128 vNewI = SEL4(vMI, vUpI, vMask);
+		ST4(R.ICurr + n, vNewI);
+		ST4(R.OICurr + n, SEL4(vUpOM, vUpOI, vMask));
+
+		if (0 != R.TBRow)
+			{
+		// Later selects take precedence, as the order of TraceBackSW.
+			const __m128 vMatch = LD4(R.Scores + n);
+			__m128 vBits = vBitSM;
+			vBits = SEL4(vBits, vBitIM, EQ4(_mm_add_ps(vIM, vMatch), vM));
+			vBits = SEL4(vBits, vBitDM, EQ4(_mm_add_ps(vDM, vMatch), vM));
+			vBits = SEL4(vBits, vBitMM, EQ4(_mm_add_ps(vMDiag, vMatch), vM));
+			vBits = _mm_or_ps(vBits, _mm_and_ps(EQ4(vNewI, vMI), vBitMI));
+			ST4(R.TBRow + n, vBits);
+			}
+
+		vMDiag = vUpM;
+		vIDiag = vUpI;
+		vDDiag = LD4(R.DPrev + n);
+		vOMDiag = vUpOM;
+		vOIDiag = vUpOI;
+		vODDiag = LD4(R.ODPrev + n);
+
+		ST4(R.MCurr + n, vM);
+		ST4(R.OMCurr + n, vOrigin);
+
+	// D within the lane
+		ST4(R.DCurr + n, vD);
+		ST4(R.ODCurr + n, vOD);
+		const __m128 vMD = _mm_add_ps(vM, LD4(R.GapOpenA + n));
+		vMask = _mm_cmpge_ps(vMD, vD);
+		vD = SEL4(vD, vMD, vMask);
+		vOD = SEL4(vOD, vOrigin, vMask);
+
+		vMask = _mm_cmpgt_ps(vM, vMax);
+		vMax = SEL4(vMax, vM, vMask);
+		vSegMax = _mm_blendv_epi8(vSegMax, _mm_set1_epi32((int) s),
+		  _mm_castps_si128(vMask));
+		}
+
+// Lazy F: carry D out of each lane into the next one. A carry equal
+// to the lane's own D is dropped, as the running max prefers the
+// later position on ties.
+	__m128 vOut = vD;
+	__m128 vOOut = vOD;
+	for (unsigned t = 1; t < W; ++t)
+		{
+		__m128 vCarry = ShiftSSE4(vOut, vMinusInf);
+		__m128 vOCarry = ShiftSSE4(vOOut);
+		bool bDone = false;
+		for (unsigned s = 0; s < uSegCount; ++s)
+			{
+			const size_t n = (size_t) s*W;
+			const __m128 vCur = LD4(R.DCurr + n);
+			const __m128 vMask = _mm_cmpgt_ps(vCarry, vCur);
+			if (0 == _mm_movemask_ps(vMask))
+				{
+				bDone = true;
+				break;
+				}
+			ST4(R.DCurr + n, SEL4(vCur, vCarry, vMask));
+			ST4(R.ODCurr + n, SEL4(LD4(R.ODCurr + n), vOCarry, vMask));
+			}
+		if (bDone)
+			break;
+		const __m128 vMask = _mm_cmpgt_ps(vCarry, vOut);
+		vOut = SEL4(vOut, vCarry, vMask);
+		vOOut = SEL4(vOOut, vOCarry, vMask);
+		}
+
+// D comes from M if it is within 0.1 of M(i-1, j) + PA[i-1].m_scoreGapOpen.
+	if (0 != R.TBRow)
+		{
+		__m128 vMD = _mm_add_ps(ShiftSSE4(LD4(R.MCurr + uLast)),
+		  ShiftSSE4(LD4(R.GapOpenA + uLast)));
+		for (unsigned s = 0; s < uSegCount; ++s)
+			{
+			const size_t n = (size_t) s*W;
+			const __m128 vBits = _mm_or_ps(LD4(R.TBRow + n),
+			  _mm_and_ps(EQ4(LD4(R.DCurr + n), vMD), vBitMD));
+			ST4(R.TBRow + n, vBits);
+			vMD = _mm_add_ps(LD4(R.MCurr + n), LD4(R.GapOpenA + n));
+			}
+		}
+
+	float Max[W];
+	unsigned SegMax[W];
+	_mm_storeu_ps(Max, vMax);
+	_mm_storeu_si128((__m128i *) SegMax, vSegMax);
+	SCORE scoreMax = Max[0];
+	unsigned uPos = SegMax[0];
+	for (unsigned k = 1; k < W; ++k)
+		if (Max[k] > scoreMax)
+			{
+			scoreMax = Max[k];
+			uPos = k*uSegCount + SegMax[k];
+			}
+	*ptruPos = uPos;
+	return scoreMax;
+	}
+
+#undef LD4
+#undef ST4
+#undef SEL4
+#undef EQ4
+
+#endif	// SIMD_SSE4
+
+#if	SIMD_AVX2
+
+// Lane k = lane k - 1, lane 0 = Fill.
+TARGET_AVX2 static inline __m256 ShiftAVX2(__m256 v, __m256 vFill)
+	{
+	const __m256i vPerm = _mm256_setr_epi32(7, 0, 1, 2, 3, 4, 5, 6);
+	return _mm256_blend_ps(_mm256_permutevar8x32_ps(v, vPerm), vFill, 1);
+	}
+
+#define LD8(p)		_mm256_load_ps((const float *) (p))
+#define ST8(p, v)	_mm256_store_ps((float *) (p), (v))
+#define SEL8(a, b, m)	_mm256_blendv_ps((a), (b), (m))
+#define EQ8(a, b)	_mm256_cmp_ps(_mm256_andnot_ps(vSignMask, \
+			  _mm256_sub_ps((a), (b))), vEQ, _CMP_LT_OQ)
+
+TARGET_AVX2 static SCORE SWRowAVX2(const SW_ROW &R, unsigned *ptruPos)
+	{
+	const unsigned W = 8;
+	const unsigned uSegCount = R.uSegCount;
+	const __m256 vMinusInf = _mm256_set1_ps(MINUS_INFINITY);
+	const __m256 vZero = _mm256_setzero_ps();
+	const __m256 vOpenB = _mm256_set1_ps(R.scoreGapOpenB);
+	const __m256 vSignMask = _mm256_set1_ps(-0.0f);
+	const __m256 vEQ = _mm256_set1_ps(0.1f);
+	const __m256 vBitMM = _mm256_castsi256_ps(_mm256_set1_epi32(BIT_MM));
+	const __m256 vBitDM = _mm256_castsi256_ps(_mm256_set1_epi32(BIT_DM));
+	const __m256 vBitIM = _mm256_castsi256_ps(_mm256_set1_epi32(BIT_IM));
+	const __m256 vBitSM = _mm256_castsi256_ps(_mm256_set1_epi32(BIT_SM));
+	const __m256 vBitMD = _mm256_castsi256_ps(_mm256_set1_epi32(BIT_MD));
+	const __m256 vBitMI = _mm256_castsi256_ps(_mm256_set1_epi32(BIT_MI));
+	const __m256 vCloseB = _mm256_set1_ps(R.scoreGapCloseB);
+	const __m256i vBase = _mm256_set1_epi32((int) R.uOriginBase);
+	const size_t uLast = (size_t) (uSegCount - 1)*W;
+
+	__m256 vMDiag = ShiftAVX2(LD8(R.MPrev + uLast), vMinusInf);
+	__m256 vIDiag = ShiftAVX2(LD8(R.IPrev + uLast), vMinusInf);
+	__m256 vDDiag = ShiftAVX2(LD8(R.DPrev + uLast), vMinusInf);
+	__m256 vOMDiag = ShiftAVX2(LD8(R.OMPrev + uLast), vZero);
+	__m256 vOIDiag = ShiftAVX2(LD8(R.OIPrev + uLast), vZero);
+	__m256 vODDiag = ShiftAVX2(LD8(R.ODPrev + uLast), vZero);
+
+	__m256 vD = vMinusInf;
+	__m256 vOD = vZero;
+	__m256 vMax = vMinusInf;
+	__m256 vSegMax = vZero;
+
+	for (unsigned s = 0; s < uSegCount; ++s)
+		{
+		const size_t n = (size_t) s*W;
+
+		const __m256 vDM = _mm256_add_ps(vDDiag, LD8(R.GapCloseA + n));
+		const __m256 vIM = _mm256_add_ps(vIDiag, vCloseB);
+		__m256 vBest = vMDiag;
+		__m256 vOrigin = vOMDiag;
+		__m256 vMask = _mm256_cmp_ps(vDM, vBest, _CMP_GT_OQ);
+		vBest = SEL8(vBest, vDM, vMask);
+		vOrigin = SEL8(vOrigin, vODDiag, vMask);
+		vMask = _mm256_cmp_ps(vIM, vBest, _CMP_GT_OQ);
+		vBest = SEL8(vBest, vIM, vMask);
+		vOrigin = SEL8(vOrigin, vOIDiag, vMask);
+		vMask = _mm256_cmp_ps(vBest, vZero, _CMP_LT_OQ);
+		vBest = SEL8(vBest, vZero, vMask);
+		const __m256 vFresh = _mm256_castsi256_ps(_mm256_add_epi32(vBase,
+		  _mm256_load_si256((const __m256i *) (R.Rows + n))));
+		vOrigin = SEL8(vOrigin, vFresh, vMask);
+		const __m256 vM = _mm256_add_ps(vBest, LD8(R.Scores + n));
+
+		const __m256 vUpM = LD8(R.MPrev + n);
+		const __m256 vUpI = LD8(R.IPrev + n);
+		const __m256 vUpOM = LD8(R.OMPrev + n);
+		const __m256 vUpOI = LD8(R.OIPrev + n);
+		const __m256 vMI = _mm256_add_ps(vUpM, vOpenB);
+		vMask = _mm256_cmp_ps(vUpI, vMI, _CMP_GT_OQ);
+		const __m256 vNewI = SEL8(vMI, vUpI, vMask);
+		ST8(R.ICurr + n, vNewI);
+		ST8(R.OICurr + n, SEL8(vUpOM, vUpOI, vMask));
+
+		if (0 != R.TBRow)
+			{
+		// Later selects take precedence, as the order of TraceBackSW.
+			const __m256 vMatch = LD8(R.Scores + n);
+			__m256 vBits = vBitSM;
+			vBits = SEL8(vBits, vBitIM, EQ8(_mm256_add_ps(vIM, vMatch), vM));
+			vBits = SEL8(vBits, vBitDM, EQ8(_mm256_add_ps(vDM, vMatch), vM));
+			vBits = SEL8(vBits, vBitMM, EQ8(_mm256_add_ps(vMDiag, vMatch), vM));
+			vBits = _mm256_or_ps(vBits, _mm256_and_ps(EQ8(vNewI, vMI), vBitMI));
+			ST8(R.TBRow + n, vBits);
+			}
+
+		vMDiag = vUpM;
+		vIDiag = vUpI;
+		vDDiag = LD8(R.DPrev + n);
+		vOMDiag = vUpOM;
+		vOIDiag = vUpOI;
+		vODDiag = LD8(R.ODPrev + n);
+
+		ST8(R.MCurr + n, vM);
+		ST8(R.OMCurr + n, vOrigin);
+
+	// D within the lane
+		ST8(R.DCurr + n, vD);
+		ST8(R.ODCurr + n, vOD);
+		const __m256 vMD = _mm256_add_ps(vM, LD8(R.GapOpenA + n));
+		vMask = _mm256_cmp_ps(vMD, vD, _CMP_GE_OQ);
+		vD = SEL8(vD, vMD, vMask);
+		vOD = SEL8(vOD, vOrigin, vMask);
+
+		vMask = _mm256_cmp_ps(vM, vMax, _CMP_GT_OQ);
+		vMax = SEL8(vMax, vM, vMask);
+		vSegMax = SEL8(vSegMax, _mm256_castsi256_ps(_mm256_set1_epi32((int) s)),
+		  vMask);
+		}
+
+// Lazy F, as SWRowSSE4.
+	__m256 vOut = vD;
+	__m256 vOOut = vOD;
+	for (unsigned t = 1; t < W; ++t)
+		{
+		__m256 vCarry = ShiftAVX2(vOut, vMinusInf);
+		__m256 vOCarry = ShiftAVX2(vOOut, vZero);
+		bool bDone = false;
+		for (unsigned s = 0; s < uSegCount; ++s)
+			{
+			const size_t n = (size_t) s*W;
+			const __m256 vCur = LD8(R.DCurr + n);
+			const __m256 vMask = _mm256_cmp_ps(vCarry, vCur, _CMP_GT_OQ);
+			if (0 == _mm256_movemask_ps(vMask))
+				{
+				bDone = true;
+				break;
+				}
+			ST8(R.DCurr + n, SEL8(vCur, vCarry, vMask));
+			ST8(R.ODCurr + n, SEL8(LD8(R.ODCurr + n), vOCarry, vMask));
+			}
+		if (bDone)
+			break;
+		const __m256 vMask = _mm256_cmp_ps(vCarry, vOut, _CMP_GT_OQ);
+		vOut = SEL8(vOut, vCarry, vMask);
+		vOOut = SEL8(vOOut, vOCarry, vMask);
+		}
+
+// D comes from M if it is within 0.1 of M(i-1, j) + PA[i-1].m_scoreGapOpen.
+	if (0 != R.TBRow)
+		{
+		__m256 vMD = _mm256_add_ps(ShiftAVX2(LD8(R.MCurr + uLast), vZero),
+		  ShiftAVX2(LD8(R.GapOpenA + uLast), vZero));
+		for (unsigned s = 0; s < uSegCount; ++s)
+			{
+			const size_t n = (size_t) s*W;
+			const __m256 vBits = _mm256_or_ps(LD8(R.TBRow + n),
+			  _mm256_and_ps(EQ8(LD8(R.DCurr + n), vMD), vBitMD));
+			ST8(R.TBRow + n, vBits);
+			vMD = _mm256_add_ps(LD8(R.MCurr + n), LD8(R.GapOpenA + n));
+			}
+		}
+
+	float Max[W];
+	unsigned SegMax[W];
+	_mm256_storeu_ps(Max, vMax);
+	_mm256_storeu_ps((float *) SegMax, vSegMax);
+	SCORE scoreMax = Max[0];
+	unsigned uPos = SegMax[0];
+	for (unsigned k = 1; k < W; ++k)
+		if (Max[k] > scoreMax)
+			{
+			scoreMax = Max[k];
+			uPos = k*uSegCount + SegMax[k];
+			}
+	*ptruPos = uPos;
+	return scoreMax;
+	}
+
+#undef LD8
+#undef ST8
+#undef SEL8
+#undef EQ8
+
+#endif	// SIMD_AVX2
+
+#if	defined(_MANAGED)
+#pragma managed(pop)
+#endif
+
+static SW_ROW_FN GetSWRowFn(unsigned *ptruLaneCount, const char **ptrName)
+	{
+	*ptruLaneCount = 1;
+	*ptrName = "scalar";
+	if (g_bNoSIMD)
+		return SWRowScalar;
+#if	SIMD_AVX2
+	if (CPUHasAVX2())
+		{
+		*ptruLaneCount = 8;
+		*ptrName = "AVX2";
+		return SWRowAVX2;
+		}
+#endif
+#if	SIMD_SSE4
+	if (CPUHasSSE41())
+		{
+		*ptruLaneCount = 4;
+		*ptrName = "SSE4.1";
+		return SWRowSSE4;
+		}
+#endif
+	return SWRowScalar;
+	}
+
+template<class T> static void Carve(char *Base, size_t &uOffset, T *&Ptr,
+  size_t uCount)
+	{
+	uOffset = (uOffset + SW_ALIGN - 1) & ~(SW_ALIGN - 1);
+	Ptr = (0 == Base) ? 0 : (T *) (Base + uOffset);
+	uOffset += uCount*sizeof(T);
+	}
+
+static size_t Layout(SWSTRIPED_MEMORY &SWM, char *Base, size_t uItemCount)
+	{
+	size_t uOffset = 0;
+	Carve(Base, uOffset, SWM.GapOpenA, uItemCount);
+	Carve(Base, uOffset, SWM.GapCloseA, uItemCount);
+	Carve(Base, uOffset, SWM.Rows, uItemCount);
+	Carve(Base, uOffset, SWM.MPrev, uItemCount);
+	Carve(Base, uOffset, SWM.MCurr, uItemCount);
+	Carve(Base, uOffset, SWM.DPrev, uItemCount);
+	Carve(Base, uOffset, SWM.DCurr, uItemCount);
+	Carve(Base, uOffset, SWM.IPrev, uItemCount);
+	Carve(Base, uOffset, SWM.ICurr, uItemCount);
+	Carve(Base, uOffset, SWM.OMPrev, uItemCount);
+	Carve(Base, uOffset, SWM.OMCurr, uItemCount);
+	Carve(Base, uOffset, SWM.ODPrev, uItemCount);
+	Carve(Base, uOffset, SWM.ODCurr, uItemCount);
+	Carve(Base, uOffset, SWM.OIPrev, uItemCount);
+	Carve(Base, uOffset, SWM.OICurr, uItemCount);
+	Carve(Base, uOffset, SWM.TBRow, uItemCount);
+	Carve(Base, uOffset, SWM.Scores, uItemCount*SW_SLAB_ROWS);
+	Carve(Base, uOffset, SWM.Mx, uItemCount*SW_SLAB_ROWS);
+	return uOffset;
+	}
+
+static void AllocSWStripedMem(SWSTRIPED_MEMORY &SWM, size_t uItemCount)
+	{
+	if (uItemCount <= SWM.uItemCount)
+		return;
+	if (uItemCount < 2*SWM.uItemCount)
+		uItemCount = 2*SWM.uItemCount;
+	const size_t uSize = Layout(SWM, 0, uItemCount);
+	delete[] SWM.Slab;
+	SWM.Slab = new char[uSize + SW_ALIGN];
+	char *Base = SWM.Slab + (SW_ALIGN - (size_t) SWM.Slab%SW_ALIGN)%SW_ALIGN;
+	Layout(SWM, Base, uItemCount);
+	SWM.uItemCount = uItemCount;
+	}
+
+void FreeSWStripedMem(SWSTRIPED_MEMORY &SWM)
+	{
+	delete[] SWM.Slab;
+	memset(&SWM, 0, sizeof(SWM));
+	}
+
+// Items of A in striped order: the gap scores of each position and its
+// prefix length, 0 for the padding beyond LA.
+static void SetStripes(const ProfPos *PA, unsigned uLengthA, unsigned W,
+  unsigned uSegCount, SCORE GapOpenA[], SCORE GapCloseA[], unsigned Rows[])
+	{
+	for (unsigned k = 0; k < W; ++k)
+		for (unsigned s = 0; s < uSegCount; ++s)
+			{
+			const size_t n = (size_t) s*W + k;
+			const unsigned a = k*uSegCount + s;
+			if (a < uLengthA)
+				{
+				GapOpenA[n] = (a + 1 == uLengthA) ? MINUS_INFINITY :
+				  PA[a+1].m_scoreGapOpen;
+				GapCloseA[n] = (0 == a) ? MINUS_INFINITY : PA[a-1].m_scoreGapClose;
+				Rows[n] = a + 1;
+				}
+			else
+				{
+				GapOpenA[n] = MINUS_INFINITY;
+				GapCloseA[n] = MINUS_INFINITY;
+				Rows[n] = 0;
+				}
+			}
+	}
+
+// Point the rows of R at SWM and set row 0.
+static void InitRows(SWSTRIPED_MEMORY &SWM, size_t uItemCount, SW_ROW &R)
+	{
+	R.MPrev = SWM.MPrev;
+	R.MCurr = SWM.MCurr;
+	R.DPrev = SWM.DPrev;
+	R.DCurr = SWM.DCurr;
+	R.IPrev = SWM.IPrev;
+	R.ICurr = SWM.ICurr;
+	R.OMPrev = SWM.OMPrev;
+	R.OMCurr = SWM.OMCurr;
+	R.ODPrev = SWM.ODPrev;
+	R.ODCurr = SWM.ODCurr;
+	R.OIPrev = SWM.OIPrev;
+	R.OICurr = SWM.OICurr;
+	for (size_t n = 0; n < uItemCount; ++n)
+		{
+		R.MPrev[n] = MINUS_INFINITY;
+		R.DPrev[n] = MINUS_INFINITY;
+		R.IPrev[n] = MINUS_INFINITY;
+		R.OMPrev[n] = 0;
+		R.ODPrev[n] = 0;
+		R.OIPrev[n] = 0;
+		}
+	}
+
+// After row j, keep the row if it has a new best cell, then make it
+// the previous row.
+static void NextRow(SW_ROW &R, unsigned W, unsigned j, SCORE scoreRow,
+  unsigned uPos, SW_BEST &Best)
+	{
+	if (scoreRow > Best.scoreMax)
+		{
+		Best.scoreMax = scoreRow;
+		Best.uEndA = uPos + 1;
+		Best.uEndB = j;
+		Best.uOrigin = R.OMCurr[(uPos%R.uSegCount)*W + uPos/R.uSegCount];
+		}
+
+	SCORE *Tmp = R.MPrev;
+	R.MPrev = R.MCurr;
+	R.MCurr = Tmp;
+	Tmp = R.DPrev;
+	R.DPrev = R.DCurr;
+	R.DCurr = Tmp;
+	Tmp = R.IPrev;
+	R.IPrev = R.ICurr;
+	R.ICurr = Tmp;
+	unsigned *uTmp = R.OMPrev;
+	R.OMPrev = R.OMCurr;
+	R.OMCurr = uTmp;
+	uTmp = R.ODPrev;
+	R.ODPrev = R.ODCurr;
+	R.ODCurr = uTmp;
+	uTmp = R.OIPrev;
+	R.OIPrev = R.OICurr;
+	R.OICurr = uTmp;
+	}
+
+static void GetBest(const SW_BEST &Best, unsigned uPrefixCountA,
+  unsigned *ptruStartA, unsigned *ptruStartB, unsigned *ptruEndA,
+  unsigned *ptruEndB)
+	{
+	*ptruStartA = Best.uOrigin%uPrefixCountA;
+	*ptruStartB = Best.uOrigin/uPrefixCountA;
+	*ptruEndA = Best.uEndA;
+	*ptruEndB = Best.uEndB;
+	}
+
+SCORE StripedSW(const ProfPos *PA, unsigned uLengthA, const ProfPos *PB,
+  unsigned uLengthB, unsigned *ptruStartA, unsigned *ptruStartB,
+  unsigned *ptruEndA, unsigned *ptruEndB, char *TB)
+	{
+	if (0 == uLengthA || 0 == uLengthB)
+		Quit("Internal error, StripedSW: empty profile");
+	if ((double) (uLengthA + 1)*(double) (uLengthB + 1) >= 4294967296.0)
+		Quit("SW: profiles too long (%u x %u)", uLengthA, uLengthB);
+
+	unsigned W;
+	const char *pstrName;
+	const SW_ROW_FN RowFn = GetSWRowFn(&W, &pstrName);
+
+	const unsigned uPrefixCountA = uLengthA + 1;
+	const unsigned uSegCount = (uLengthA + W - 1)/W;
+	const size_t uItemCount = (size_t) uSegCount*W;
+
+	SWSTRIPED_MEMORY &SWM = GetDPWorkspace()->SWStripedMem;
+	AllocSWStripedMem(SWM, uItemCount);
+
+	SCORE *Scores = SWM.Scores;
+	SCORE *Mx = SWM.Mx;
+
+	SetStripes(PA, uLengthA, W, uSegCount, SWM.GapOpenA, SWM.GapCloseA,
+	  SWM.Rows);
+
+	SW_ROW R;
+	R.uSegCount = uSegCount;
+	R.GapOpenA = SWM.GapOpenA;
+	R.GapCloseA = SWM.GapCloseA;
+	R.Rows = SWM.Rows;
+	R.TBRow = (0 == TB) ? 0 : SWM.TBRow;
+	InitRows(SWM, uItemCount, R);
+
+	SW_BEST Best;
+	Best.scoreMax = MINUS_INFINITY;
+	Best.uEndA = uInsane;
+	Best.uEndB = uInsane;
+	Best.uOrigin = 0;
+	for (unsigned uFromB = 0; uFromB < uLengthB; uFromB += SW_SLAB_ROWS)
+		{
+		unsigned uRowCount = uLengthB - uFromB;
+		if (uRowCount > SW_SLAB_ROWS)
+			uRowCount = SW_SLAB_ROWS;
+
+	// Mx[a*uRowCount + r] is the score of PA[a] with PB[uFromB + r].
+		ProfPairScores(PA, 0, uLengthA, PB + uFromB, uRowCount, Mx);
+		for (unsigned k = 0; k < W; ++k)
+			for (unsigned s = 0; s < uSegCount; ++s)
+				{
+				const size_t n = (size_t) s*W + k;
+				const unsigned a = k*uSegCount + s;
+				if (a < uLengthA)
+					{
+					const SCORE *MxRow = Mx + (size_t) a*uRowCount;
+					for (unsigned r = 0; r < uRowCount; ++r)
+						Scores[r*uItemCount + n] = MxRow[r];
+					}
+				else
+					{
+					for (unsigned r = 0; r < uRowCount; ++r)
+						Scores[r*uItemCount + n] = MINUS_INFINITY;
+					}
+				}
+
+		for (unsigned r = 0; r < uRowCount; ++r)
+			{
+			const unsigned j = uFromB + r + 1;
+			R.Scores = Scores + r*uItemCount;
+			R.uOriginBase = j*uPrefixCountA;
+			R.scoreGapOpenB = PB[j-1].m_scoreGapOpen;
+			R.scoreGapCloseB = (1 == j) ? MINUS_INFINITY : PB[j-2].m_scoreGapClose;
+
+			unsigned uPos;
+			const SCORE scoreRow = RowFn(R, &uPos);
+
+			if (0 != TB)
+				{
+				char *TBRow = TB + (size_t) j*uPrefixCountA;
+				for (unsigned k = 0; k < W; ++k)
+					for (unsigned s = 0; s < uSegCount; ++s)
+						{
+						const unsigned a = k*uSegCount + s;
+						if (a >= uLengthA)
+							break;
+						TBRow[a + 1] = (char) SWM.TBRow[(size_t) s*W + k];
+						}
+				}
+			NextRow(R, W, j, scoreRow, uPos, Best);
+			}
+		}
+	GetBest(Best, uPrefixCountA, ptruStartA, ptruStartB, ptruEndA, ptruEndB);
+
+#if	TRACE
+	Log("StripedSW(%s) %ux%u score=%.4g start=%u,%u end=%u,%u\n",
+	  pstrName, uLengthA, uLengthB, Best.scoreMax, *ptruStartA, *ptruStartB,
+	  *ptruEndA, *ptruEndB);
+#endif
+	return Best.scoreMax;
+	}
+
+// The buffers of a query are carved from one block, as those of
+// SWSTRIPED_MEMORY, since the kernels load striped items aligned.
+static size_t QueryLayout(SW_QUERY &Q, char *Base, size_t uItemCount,
+  unsigned uClassCount)
+	{
+	size_t uOffset = 0;
+	Carve(Base, uOffset, Q.GapOpenA, uItemCount);
+	Carve(Base, uOffset, Q.GapCloseA, uItemCount);
+	Carve(Base, uOffset, Q.Rows, uItemCount);
+	Carve(Base, uOffset, Q.Scores, uItemCount*uClassCount);
+	return uOffset;
+	}
+
+/***
+Query profile (Farrar's term) of A for a B that is a single sequence.
+
+In the profile of an ungapped sequence, positions with the same
+letter have the same counts and occupancy; only their gap scores may
+differ (see Hydro). Their match scores with A therefore take only one
+row per letter. MakeSWQuery computes these rows once, in striped
+order, by ProfPairScores of A with ClassPos[c], the profile position
+of letter class c. StripedSWQuery is then given the class of each
+position of B along with its profile, of which only the gap scores
+are used. It returns exactly what StripedSW would, without computing
+any match scores, but keeps no trace-back bits: SW aligns the few
+sequences for which a path is wanted.
+
+An SW_QUERY is only read by StripedSWQuery, so one query can be used
+by several threads at once.
+***/
+void MakeSWQuery(const ProfPos *PA, unsigned uLengthA, const ProfPos *ClassPos,
+  unsigned uClassCount, SW_QUERY &Q)
+	{
+	if (0 == uLengthA || 0 == uClassCount)
+		Quit("Internal error, MakeSWQuery: empty profile");
+
+	unsigned W;
+	const char *pstrName;
+	GetSWRowFn(&W, &pstrName);
+
+	const unsigned uSegCount = (uLengthA + W - 1)/W;
+	const size_t uItemCount = (size_t) uSegCount*W;
+
+	Q.uLengthA = uLengthA;
+	Q.uLaneCount = W;
+	Q.uSegCount = uSegCount;
+	Q.uClassCount = uClassCount;
+
+	const size_t uSize = QueryLayout(Q, 0, uItemCount, uClassCount);
+	Q.Slab = new char[uSize + SW_ALIGN];
+	char *Base = Q.Slab + (SW_ALIGN - (size_t) Q.Slab%SW_ALIGN)%SW_ALIGN;
+	QueryLayout(Q, Base, uItemCount, uClassCount);
+
+	SetStripes(PA, uLengthA, W, uSegCount, Q.GapOpenA, Q.GapCloseA, Q.Rows);
+
+	SCORE *Mx = new SCORE[(size_t) uLengthA*uClassCount];
+	ProfPairScores(PA, 0, uLengthA, ClassPos, uClassCount, Mx);
+	for (unsigned c = 0; c < uClassCount; ++c)
+		{
+		SCORE *Row = Q.Scores + c*uItemCount;
+		for (unsigned k = 0; k < W; ++k)
+			for (unsigned s = 0; s < uSegCount; ++s)
+				{
+				const unsigned a = k*uSegCount + s;
+				Row[(size_t) s*W + k] = (a < uLengthA) ?
+				  Mx[(size_t) a*uClassCount + c] : MINUS_INFINITY;
+				}
+		}
+	delete[] Mx;
+
+#if	TRACE
+	Log("MakeSWQuery(%s) LA=%u classes=%u\n", pstrName, uLengthA, uClassCount);
+#endif
+	}
+
+void FreeSWQuery(SW_QUERY &Q)
+	{
+	delete[] Q.Slab;
+	memset(&Q, 0, sizeof(Q));
+	}
+
+SCORE StripedSWQuery(const SW_QUERY &Q, const ProfPos *PB,
+  const unsigned char ClassB[], unsigned uLengthB, unsigned *ptruStartA, unsigned *ptruStartB,
+  unsigned *ptruEndA, unsigned *ptruEndB)
+	{
+	const unsigned uLengthA = Q.uLengthA;
+	if (0 == uLengthB)
+		Quit("Internal error, StripedSWQuery: empty sequence");
+	if ((double) (uLengthA + 1)*(double) (uLengthB + 1) >= 4294967296.0)
+		Quit("SW: sequence too long (%u x %u)", uLengthA, uLengthB);
+
+	unsigned W;
+	const char *pstrName;
+	const SW_ROW_FN RowFn = GetSWRowFn(&W, &pstrName);
+	if (W != Q.uLaneCount)
+		Quit("Internal error, StripedSWQuery: query made for %u lanes", Q.uLaneCount);
+
+	const unsigned uPrefixCountA = uLengthA + 1;
+	const size_t uItemCount = (size_t) Q.uSegCount*W;
+
+	SWSTRIPED_MEMORY &SWM = GetDPWorkspace()->SWStripedMem;
+	AllocSWStripedMem(SWM, uItemCount);
+
+	SW_ROW R;
+	R.uSegCount = Q.uSegCount;
+	R.GapOpenA = Q.GapOpenA;
+	R.GapCloseA = Q.GapCloseA;
+	R.Rows = Q.Rows;
+	R.TBRow = 0;
+	InitRows(SWM, uItemCount, R);
+
+	SW_BEST Best;
+	Best.scoreMax = MINUS_INFINITY;
+	Best.uEndA = uInsane;
+	Best.uEndB = uInsane;
+	Best.uOrigin = 0;
+	for (unsigned j = 1; j <= uLengthB; ++j)
+		{
+		const unsigned c = ClassB[j-1];
+		R.Scores = Q.Scores + c*uItemCount;
+		R.uOriginBase = j*uPrefixCountA;
+		R.scoreGapOpenB = PB[j-1].m_scoreGapOpen;
+		R.scoreGapCloseB = (1 == j) ? MINUS_INFINITY : PB[j-2].m_scoreGapClose;
+
+		unsigned uPos;
+		const SCORE scoreRow = RowFn(R, &uPos);
+		NextRow(R, W, j, scoreRow, uPos, Best);
+		}
+	GetBest(Best, uPrefixCountA, ptruStartA, ptruStartB, ptruEndA, ptruEndB);
+
+#if	TRACE
+	Log("StripedSWQuery(%s) %ux%u score=%.4g start=%u,%u end=%u,%u\n",
+	  pstrName, uLengthA, uLengthB, Best.scoreMax, *ptruStartA, *ptruStartB,
+	  *ptruEndA, *ptruEndB);
+#endif
+	return Best.scoreMax;
+	}
@@ -0,0 +1,64 @@
+#include "muscle.h"
+#include "threads.h"
+
+struct THREAD_ARGS
+	{
+	unsigned uThreadIndex;
+	THREAD_FN Fn;
+	void *ptrUser;
+	MuscleContext *ptrContext;
+	DPWorkspace *ptrWorkspace;
+	};
+
+static void ThreadMain(void *ptrArg)
+	{
+	THREAD_ARGS &Args = *(THREAD_ARGS *) ptrArg;
+	SetMuscleContext(Args.ptrContext);
+	SetDPWorkspace(Args.ptrWorkspace);
+	Args.Fn(Args.uThreadIndex, Args.ptrUser);
+	SetMuscleContext(0);
+	}
+
+unsigned GetThreadCount()
+	{
+	unsigned uThreadCount = g_uThreads;
+	if (0 == uThreadCount)
+		uThreadCount = GetCPUCount();
+	if (0 == uThreadCount)
+		uThreadCount = 1;
+	return uThreadCount;
+	}
+
+void RunThreads(unsigned uThreadCount, THREAD_FN Fn, void *ptrUser)
+	{
+	if (uThreadCount <= 1)
+		{
+		Fn(0, ptrUser);
+		return;
+		}
+
+	THREAD_ARGS *Args = new THREAD_ARGS[uThreadCount];
+	THREAD_HANDLE *Handles = new THREAD_HANDLE[uThreadCount];
+	for (unsigned i = 1; i < uThreadCount; ++i)
+		{
+		Args[i].uThreadIndex = i;
+		Args[i].Fn = Fn;
+		Args[i].ptrUser = ptrUser;
+		Args[i].ptrContext = GetMuscleContext();
+		Args[i].ptrWorkspace = new DPWorkspace;
+		Handles[i] = StartThread(ThreadMain, &Args[i]);
+		}
+
+	Fn(0, ptrUser);
+
+	DPWorkspace *ptrWorkspace = GetDPWorkspace();
+	for (unsigned i = 1; i < uThreadCount; ++i)
+		{
+		WaitThread(Handles[i]);
+		ptrWorkspace->AddStats(*Args[i].ptrWorkspace);
+		delete Args[i].ptrWorkspace;
+		}
+
+	delete[] Args;
+	delete[] Handles;
+	}
@@ -0,0 +1,43 @@
+#ifndef threads_h
+#define threads_h
+
+// Threading support for the parallel stages.
+// The platform-specific primitives are in globalslinux.cpp
+// (pthreads) and globalswin32.cpp (Win32 threads).
+
+class Mutex
+	{
+public:
+	Mutex();
+	~Mutex();
+
+	void Lock();
+	void Unlock();
+
+private:
+	Mutex(const Mutex &);
+	Mutex &operator=(const Mutex &);
+
+	void *m_ptrImpl;
+	};
+
+typedef void *THREAD_HANDLE;
+typedef void (*THREAD_START_FN)(void *ptrArg);
+
+THREAD_HANDLE StartThread(THREAD_START_FN Fn, void *ptrArg);
+void WaitThread(THREAD_HANDLE hThread);
+void YieldThread();
+unsigned GetCPUCount();
+
+// Number of threads to use, from -threads (0 = one per CPU).
+unsigned GetThreadCount();
+
+// Call Fn(i, ptrUser) for i = 0 .. uThreadCount-1, each on its own
+// thread, and return when all have finished. Thread 0 is the calling
+// thread. All threads use the caller's MuscleContext. Threads 1 .. n-1
+// get their own DPWorkspace; its statistics are added to the caller's
+// workspace at the end.
+typedef void (*THREAD_FN)(unsigned uThreadIndex, void *ptrUser);
+void RunThreads(unsigned uThreadCount, THREAD_FN Fn, void *ptrUser);
+
+#endif	// threads_h
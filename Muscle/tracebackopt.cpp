@@ -1,7 +1,94 @@
 #include "muscle.h"
 #include "pwpath.h"
 
-void TraceBackToPath(int **TraceBack, unsigned uLengthA,
+/***
+The trace-back of the optimized aligners (GlobalAlignSP, SPN, LE and
+SS) was an int per cell: 0 for a match from M(i-1,j-1), i - k for a
+delete opened at row k, k - j for an insert opened at column k. Here
+each cell is four bits, two cells per byte, rows of (uLengthB+1)/2
+bytes in one slab:
+
+	TB_TYPE		predecessor of M(i,j), TB_M, TB_D or TB_I.
+	TB_DOPEN	the delete position of column j was set to i.
+	TB_IOPEN	the insert position of row i was set to j.
+
+The gap length is recovered by scanning back from the cell to the
+last open bit, which gives the value the aligner held in uDeletePos
+or uInsertPos at that point, so the path is the same as before.
+Row 0 and column 0 are implied (-j and i). The last cell is computed
+outside the row loop and is kept as an int.
+***/
+
+void AllocPackedTB(PACKED_TB &PTB, unsigned uLengthA, unsigned uLengthB)
+	{
+	const unsigned uRowBytes = (uLengthB + 1)/2;
+	const size_t uSize = (size_t) uLengthA*uRowBytes;
+	if (uSize > PTB.uSize)
+		{
+		delete[] PTB.Slab;
+		PTB.uSize = uSize + uSize/4;
+		PTB.Slab = new unsigned char[PTB.uSize];
+		}
+	PTB.uRowBytes = uRowBytes;
+	PTB.iLastTB = 0;
+	}
+
+void FreePackedTB(PACKED_TB &PTB)
+	{
+	delete[] PTB.Slab;
+	memset(&PTB, 0, sizeof(PTB));
+	}
+
+void PackTBRow(PACKED_TB &PTB, unsigned i, const unsigned char TBRow[],
+  unsigned uLengthB)
+	{
+	unsigned char *Row = PTB.Slab + (size_t) i*PTB.uRowBytes;
+	unsigned j = 0;
+	for (; j + 1 < uLengthB; j += 2)
+		*Row++ = (unsigned char) (TBRow[j] | (TBRow[j+1] << 4));
+	if (j < uLengthB)
+		*Row = TBRow[j];
+	}
+
+static inline unsigned GetCell(const PACKED_TB &PTB, unsigned i, unsigned j)
+	{
+	const unsigned c = PTB.Slab[(size_t) i*PTB.uRowBytes + j/2];
+	return (j & 1) ? c >> 4 : c & 0xf;
+	}
+
+static int GetTraceBack(const PACKED_TB &PTB, unsigned uLengthA,
+  unsigned uLengthB, unsigned i, unsigned j)
+	{
+	if (uLengthA == i && uLengthB == j)
+		return PTB.iLastTB;
+	if (0 == i)
+		return -(int) j;
+	if (0 == j)
+		return (int) i;
+
+	switch (GetCell(PTB, i, j) & TB_TYPE)
+		{
+	case TB_D:
+		{
+	// Delete position of column j-1 as of row i.
+		unsigned k = i;
+		while (k > 1 && 0 == (GetCell(PTB, k, j-1) & TB_DOPEN))
+			--k;
+		return (int) i - (int) k;
+		}
+
+	case TB_I:
+		{
+		unsigned k = j;
+		while (k > 1 && 0 == (GetCell(PTB, i, k) & TB_IOPEN))
+			--k;
+		return (int) k - (int) j;
+		}
+		}
+	return 0;
+	}
+
+void TraceBackToPath(const PACKED_TB &PTB, unsigned uLengthA,
   unsigned uLengthB, PWPath &Path)
 	{
 	Path.Clear();
@@ -15,7 +102,8 @@ void TraceBackToPath(int **TraceBack, unsigned uLengthA,
 		if (0 == Edge.uPrefixLengthA && 0 == Edge.uPrefixLengthB)
 			break;
 
-		int iDelta = TraceBack[Edge.uPrefixLengthA][Edge.uPrefixLengthB];
+		int iDelta = GetTraceBack(PTB, uLengthA, uLengthB, Edge.uPrefixLengthA,
+		  Edge.uPrefixLengthB);
 #if	TRACE
 		Log("TraceBack[%u][%u] = %d\n",
 		  Edge.uPrefixLengthA, Edge.uPrefixLengthB, iDelta);
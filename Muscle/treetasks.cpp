@@ -0,0 +1,194 @@
+#include "muscle.h"
+#include "tree.h"
+#include "threads.h"
+#include "treetasks.h"
+
+// Deque of ready nodes owned by one thread. The owner pushes and
+// pops at the bottom, other threads steal from the top.
+struct TASK_DEQUE
+	{
+	Mutex Lock;
+	unsigned *Nodes;
+	unsigned uTop;
+	unsigned uBottom;
+	};
+
+struct TREE_TASKS
+	{
+	const Tree *ptrTree;
+	TREE_TASK_FN Fn;
+	void *ptrUser;
+	unsigned uThreadCount;
+	TASK_DEQUE *Deques;
+
+// Protected by Lock
+	Mutex Lock;
+	unsigned *ChildrenPending;
+	unsigned uNodeCount;
+	unsigned uDoneCount;
+	unsigned uJoinCount;
+	unsigned uInternalNodeCount;
+	};
+
+static void PushBottom(TASK_DEQUE &d, unsigned uNodeIndex)
+	{
+	d.Lock.Lock();
+	d.Nodes[d.uBottom++] = uNodeIndex;
+	d.Lock.Unlock();
+	}
+
+static unsigned PopBottom(TASK_DEQUE &d)
+	{
+	unsigned uNodeIndex = NULL_NEIGHBOR;
+	d.Lock.Lock();
+	if (d.uBottom > d.uTop)
+		uNodeIndex = d.Nodes[--d.uBottom];
+	d.Lock.Unlock();
+	return uNodeIndex;
+	}
+
+static unsigned PopTop(TASK_DEQUE &d)
+	{
+	unsigned uNodeIndex = NULL_NEIGHBOR;
+	d.Lock.Lock();
+	if (d.uBottom > d.uTop)
+		uNodeIndex = d.Nodes[d.uTop++];
+	d.Lock.Unlock();
+	return uNodeIndex;
+	}
+
+static unsigned GetTask(TREE_TASKS &TT, unsigned uThreadIndex)
+	{
+	unsigned uNodeIndex = PopBottom(TT.Deques[uThreadIndex]);
+	if (NULL_NEIGHBOR != uNodeIndex)
+		return uNodeIndex;
+
+	for (unsigned i = 1; i < TT.uThreadCount; ++i)
+		{
+		unsigned uVictim = (uThreadIndex + i)%TT.uThreadCount;
+		uNodeIndex = PopTop(TT.Deques[uVictim]);
+		if (NULL_NEIGHBOR != uNodeIndex)
+			return uNodeIndex;
+		}
+	return NULL_NEIGHBOR;
+	}
+
+static void TreeTaskThread(unsigned uThreadIndex, void *ptrUser)
+	{
+	TREE_TASKS &TT = *(TREE_TASKS *) ptrUser;
+	const Tree &tree = *TT.ptrTree;
+	for (;;)
+		{
+		unsigned uNodeIndex = GetTask(TT, uThreadIndex);
+		if (NULL_NEIGHBOR == uNodeIndex)
+			{
+			TT.Lock.Lock();
+			bool bDone = (TT.uDoneCount == TT.uNodeCount);
+			TT.Lock.Unlock();
+			if (bDone)
+				return;
+			YieldThread();
+			continue;
+			}
+
+		if (!tree.IsLeaf(uNodeIndex))
+			{
+			TT.Lock.Lock();
+			Progress(TT.uJoinCount++, TT.uInternalNodeCount);
+			TT.Lock.Unlock();
+			}
+
+		TT.Fn(uNodeIndex, TT.ptrUser);
+
+		unsigned uReadyNodeIndex = NULL_NEIGHBOR;
+		TT.Lock.Lock();
+		++TT.uDoneCount;
+		if (!tree.IsRoot(uNodeIndex))
+			{
+			const unsigned uParent = tree.GetParent(uNodeIndex);
+			assert(TT.ChildrenPending[uParent] > 0);
+			if (0 == --TT.ChildrenPending[uParent])
+				uReadyNodeIndex = uParent;
+			}
+		TT.Lock.Unlock();
+
+		if (NULL_NEIGHBOR != uReadyNodeIndex)
+			PushBottom(TT.Deques[uThreadIndex], uReadyNodeIndex);
+		}
+	}
+
+void RunTreeTasks(const Tree &tree, TREE_TASK_FN Fn, void *ptrUser)
+	{
+	assert(tree.IsRooted());
+
+	const unsigned uNodeCount = tree.GetNodeCount();
+	const unsigned uLeafCount = tree.GetLeafCount();
+	unsigned uThreadCount = GetThreadCount();
+	if (uThreadCount > uLeafCount/2)
+		uThreadCount = uLeafCount/2;
+
+	if (uThreadCount <= 1)
+		{
+		unsigned uJoin = 0;
+		unsigned uNodeIndex = tree.FirstDepthFirstNode();
+		do
+			{
+			if (!tree.IsLeaf(uNodeIndex))
+				Progress(uJoin++, uLeafCount - 1);
+			Fn(uNodeIndex, ptrUser);
+			uNodeIndex = tree.NextDepthFirstNode(uNodeIndex);
+			}
+		while (NULL_NEIGHBOR != uNodeIndex);
+		return;
+		}
+
+	TREE_TASKS TT;
+	TT.ptrTree = &tree;
+	TT.Fn = Fn;
+	TT.ptrUser = ptrUser;
+	TT.uThreadCount = uThreadCount;
+	TT.uNodeCount = uNodeCount;
+	TT.uDoneCount = 0;
+	TT.uJoinCount = 0;
+	TT.uInternalNodeCount = uLeafCount - 1;
+
+	TT.ChildrenPending = new unsigned[uNodeCount];
+	for (unsigned uNodeIndex = 0; uNodeIndex < uNodeCount; ++uNodeIndex)
+		TT.ChildrenPending[uNodeIndex] = tree.IsLeaf(uNodeIndex) ? 0 : 2;
+
+	TT.Deques = new TASK_DEQUE[uThreadCount];
+	for (unsigned i = 0; i < uThreadCount; ++i)
+		{
+		TASK_DEQUE &d = TT.Deques[i];
+		d.Nodes = new unsigned[uNodeCount];
+		d.uTop = 0;
+		d.uBottom = 0;
+		}
+
+// Deal the leaves out in depth-first order, so that each thread
+// starts with adjacent leaves and finds their parents in its own
+// deque. Leaves are pushed in reverse so that the first leaf of
+// each block is at the bottom.
+	unsigned *Leaves = new unsigned[uLeafCount];
+	unsigned uLeafIndex = 0;
+	for (unsigned uNodeIndex = tree.FirstDepthFirstNode();
+	  NULL_NEIGHBOR != uNodeIndex; uNodeIndex = tree.NextDepthFirstNode(uNodeIndex))
+		if (tree.IsLeaf(uNodeIndex))
+			Leaves[uLeafIndex++] = uNodeIndex;
+	assert(uLeafIndex == uLeafCount);
+
+	for (unsigned i = uLeafCount; i > 0; --i)
+		{
+		const unsigned uThreadIndex = (unsigned)
+		  (((double) (i - 1)*uThreadCount)/uLeafCount);
+		PushBottom(TT.Deques[uThreadIndex], Leaves[i - 1]);
+		}
+	delete[] Leaves;
+
+	RunThreads(uThreadCount, TreeTaskThread, &TT);
+
+	for (unsigned i = 0; i < uThreadCount; ++i)
+		delete[] TT.Deques[i].Nodes;
+	delete[] TT.Deques;
+	delete[] TT.ChildrenPending;
+	}
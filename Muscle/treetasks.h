@@ -0,0 +1,17 @@
+#ifndef treetasks_h
+#define treetasks_h
+
+// Call Fn(uNodeIndex, ptrUser) once for every node of a rooted tree,
+// each node after both of its children.
+// With one thread (-threads 1) the nodes are visited in depth-first
+// order, as FirstDepthFirstNode / NextDepthFirstNode.
+// With more threads, each thread has a deque of ready nodes. It runs
+// nodes from the bottom of its own deque and steals from the top of
+// the others when its own is empty. A parent becomes ready when its
+// second child is done, and is pushed onto the deque of the thread
+// that finished that child.
+// Progress() is called once for each internal node.
+typedef void (*TREE_TASK_FN)(unsigned uNodeIndex, void *ptrUser);
+void RunTreeTasks(const Tree &tree, TREE_TASK_FN Fn, void *ptrUser);
+
+#endif	// treetasks_h
@@ -8,6 +8,7 @@ typedef float SCOREMATRIX[32][32];
 typedef SCOREMATRIX *PTR_SCOREMATRIX;
 
 class MSA;
+class MSAView;
 class Seq;
 class ClusterTree;
 class DistFunc;
@@ -27,6 +28,7 @@ enum
 	BIT_MM = 0x00,
 	BIT_DM = 0x01,
 	BIT_IM = 0x02,
+	BIT_SM = 0x03,	// Start of a local alignment, see StripedSW
 	BIT_xM = 0x03,
 
 	BIT_DD = 0x00,
@@ -1,6 +1,7 @@
 #include "muscle.h"
 #include "tree.h"
 #include "distcalc.h"
+#include "distfunc.h"
 
 // UPGMA clustering in O(N^2) time and space.
 
@@ -10,13 +11,14 @@
 #define	MAX(x, y)	((x) > (y) ? (x) : (y))
 #define	AVG(x, y)	(((x) + (y))/2)
 
-static unsigned g_uLeafCount;
-static unsigned g_uTriangleSize;
-static unsigned g_uInternalNodeCount;
-static unsigned g_uInternalNodeIndex;
+#define g_uLeafCount	(GetMuscleContext()->uUPGMALeafCount)
+#define g_uTriangleSize	(GetMuscleContext()->uUPGMATriangleSize)
+#define g_uInternalNodeCount	(GetMuscleContext()->uUPGMAInternalNodeCount)
+#define g_uInternalNodeIndex	(GetMuscleContext()->uUPGMAInternalNodeIndex)
 
 // Triangular distance matrix is g_Dist, which is allocated
-// as a one-dimensional vector of length g_uTriangleSize.
+// as a one-dimensional vector of length g_uTriangleSize,
+// in a scratch file if -distmx is set (see AllocDistTriangle).
 // TriangleSubscript(i,j) maps row,column=i,j to the subscript
 // into this vector.
 // Row / column coordinates are a bit messy.
@@ -25,43 +27,43 @@ static unsigned g_uInternalNodeIndex;
 // we re-use one of the two rows that become available (the children
 // of the new node). This saves memory.
 // We keep track of this through the g_uNodeIndex vector.
-static dist_t *g_Dist;
+#define g_Dist	(GetMuscleContext()->UPGMADist)
 
 // Distance to nearest neighbor in row i of distance matrix.
 // Subscript is distance matrix row.
-static dist_t *g_MinDist;
+#define g_MinDist	(GetMuscleContext()->UPGMAMinDist)
 
 // Nearest neighbor to row i of distance matrix.
 // Subscript is distance matrix row.
-static unsigned *g_uNearestNeighbor;
+#define g_uNearestNeighbor	(GetMuscleContext()->UPGMANearestNeighbor)
 
 // Node index of row i in distance matrix.
 // Node indexes are 0..N-1 for leaves, N..2N-2 for internal nodes.
 // Subscript is distance matrix row.
-static unsigned *g_uNodeIndex;
+#define g_uNodeIndex	(GetMuscleContext()->UPGMANodeIndex)
 
 // The following vectors are defined on internal nodes,
 // subscripts are internal node index 0..N-2.
 // For g_uLeft/Right, value is the node index 0 .. 2N-2
 // because a child can be internal or leaf.
-static unsigned *g_uLeft;
-static unsigned *g_uRight;
-static dist_t *g_Height;
-static dist_t *g_LeftLength;
-static dist_t *g_RightLength;
+#define g_uLeft	(GetMuscleContext()->UPGMALeft)
+#define g_uRight	(GetMuscleContext()->UPGMARight)
+#define g_Height	(GetMuscleContext()->UPGMAHeight)
+#define g_LeftLength	(GetMuscleContext()->UPGMALeftLength)
+#define g_RightLength	(GetMuscleContext()->UPGMARightLength)
 
-static inline unsigned TriangleSubscript(unsigned uIndex1, unsigned uIndex2)
+static inline size_t TriangleSubscript(unsigned uIndex1, unsigned uIndex2)
 	{
 #if	DEBUG
 	if (uIndex1 >= g_uLeafCount || uIndex2 >= g_uLeafCount)
 		Quit("TriangleSubscript(%u,%u) %u", uIndex1, uIndex2, g_uLeafCount);
 #endif
-	unsigned v;
+	size_t v;
 	if (uIndex1 >= uIndex2)
-		v = uIndex2 + (uIndex1*(uIndex1 - 1))/2;
+		v = uIndex2 + ((size_t) uIndex1*(uIndex1 - 1))/2;
 	else
-		v = uIndex1 + (uIndex2*(uIndex2 - 1))/2;
-	assert(v < (g_uLeafCount*(g_uLeafCount - 1))/2);
+		v = uIndex1 + ((size_t) uIndex2*(uIndex2 - 1))/2;
+	assert(v < g_uTriangleSize);
 	return v;
 	}
 
@@ -90,7 +92,7 @@ static void ListState()
 				Log("       ");
 			else
 				{
-				unsigned v = TriangleSubscript(i, j);
+				size_t v = TriangleSubscript(i, j);
 				Log("%5.2g  ", g_Dist[v]);
 				}
 			}
@@ -128,10 +130,11 @@ void UPGMA2(const DistCalc &DC, Tree &tree, LINKAGE Linkage)
 	{
 	g_uLeafCount = DC.GetCount();
 
-	g_uTriangleSize = (g_uLeafCount*(g_uLeafCount - 1))/2;
+	g_uTriangleSize = ((size_t) g_uLeafCount*(g_uLeafCount - 1))/2;
 	g_uInternalNodeCount = g_uLeafCount - 1;
 
-	g_Dist = new dist_t[g_uTriangleSize];
+	MappedFile *ptrDistFile;
+	g_Dist = AllocDistTriangle(g_uTriangleSize, &ptrDistFile);
 
 	g_uNodeIndex = new unsigned[g_uLeafCount];
 	g_uNearestNeighbor = new unsigned[g_uLeafCount];
@@ -245,8 +248,8 @@ void UPGMA2(const DistCalc &DC, Tree &tree, LINKAGE Linkage)
 			if (uInsane == g_uNodeIndex[j])
 				continue;
 
-			const unsigned vL = TriangleSubscript(Lmin, j);
-			const unsigned vR = TriangleSubscript(Rmin, j);
+			const size_t vL = TriangleSubscript(Lmin, j);
+			const size_t vR = TriangleSubscript(Rmin, j);
 			const dist_t dL = g_Dist[vL];
 			const dist_t dR = g_Dist[vR];
 			dist_t dtNewDist;
@@ -300,7 +303,7 @@ void UPGMA2(const DistCalc &DC, Tree &tree, LINKAGE Linkage)
 		assert(g_uInternalNodeIndex < g_uLeafCount - 1 || BIG_DIST != dtNewMinDist);
 		assert(g_uInternalNodeIndex < g_uLeafCount - 1 || uInsane != uNewNearestNeighbor);
 
-		const unsigned v = TriangleSubscript(Lmin, Rmin);
+		const size_t v = TriangleSubscript(Lmin, Rmin);
 		const dist_t dLR = g_Dist[v];
 		const dist_t dHeightNew = dLR/2;
 		const unsigned uLeft = g_uNodeIndex[Lmin];
@@ -339,7 +342,7 @@ void UPGMA2(const DistCalc &DC, Tree &tree, LINKAGE Linkage)
 	tree.LogMe();
 #endif
 
-	delete[] g_Dist;
+	FreeDistTriangle(g_Dist, ptrDistFile);
 
 	delete[] g_uNodeIndex;
 	delete[] g_uNearestNeighbor;
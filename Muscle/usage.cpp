@@ -31,6 +31,11 @@ void Usage()
 "    -maxiters <n>      Maximum number of iterations (integer, default 16)\n"
 "    -maxhours <h>      Maximum time to iterate in hours (default no limit)\n"
 "    -maxmb <m>         Maximum memory to allocate in Mb (default 80%% of RAM)\n"
+"    -threads <n>       Number of threads, 0 = one per CPU (default 1)\n"
+"    -maxtbmb <m>       Traceback Mb limit, linear space above it (default 256)\n"
+"    -nosimd            Do not use the SSE4/AVX2 kernels\n"
+"    -dp352             Use the 3.52 SP/SPN/LE recurrences; this changes the\n"
+"                       scoring path, so alignments may differ\n"
 "    -html              Write output in HTML format (default FASTA)\n"
 "    -msf               Write output in GCG MSF format (default FASTA)\n"
 "    -clw               Write output in CLUSTALW format (default FASTA)\n"
@@ -43,5 +48,9 @@ void Usage()
 "\n"
 "Without refinement (very fast, avg accuracy similar to T-Coffee): -maxiters 2\n"
 "Fastest possible (amino acids): -maxiters 1 -diags -sv -distance1 kbit20_3\n"
-"Fastest possible (nucleotides): -maxiters 1 -diags\n");
+"Fastest possible (nucleotides): -maxiters 1 -diags\n"
+"Very large protein sets: -maxiters 1 -distance1 minhash20_4 [-sketchsize <n>]\n"
+"Guide tree from pairwise alignments: -distance1 pwkimurafast\n"
+"Guide tree distances in a file, reused by later runs: -distmx <file>\n"
+"Search a database with a profile: -profsearch -in1 <aln> -in2 <db> [-topk <n>]\n");
 	}
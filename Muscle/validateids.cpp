@@ -4,8 +4,16 @@
 #include "seqvect.h"
 
 #if	DEBUG
-static SeqVect *g_ptrMuscleSeqVect = 0;
-static MSA MuscleInputMSA;
+#define g_ptrMuscleSeqVect	(GetMuscleContext()->ptrMuscleSeqVect)
+#define MuscleInputMSA		(*GetMuscleInputMSA())
+
+static MSA *GetMuscleInputMSA()
+	{
+	MSA *&ptrMSA = GetMuscleContext()->ptrMuscleInputMSA;
+	if (0 == ptrMSA)
+		ptrMSA = new MSA;
+	return ptrMSA;
+	}
 
 void SetMuscleInputMSA(MSA &msa)
 	{